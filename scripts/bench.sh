@@ -0,0 +1,101 @@
+#!/bin/bash
+set -euo pipefail
+
+# Build and run a microbenchmark against the static libs in build/.
+# Usage: scripts/bench.sh [css] [iterations]
+#        scripts/bench.sh layout [rows] [passes]
+#        scripts/bench.sh render [iterations] [workload]
+#        scripts/bench.sh test
+#   css    - CSS parsing throughput (build/css_bench; needs build/lexbor)
+#   layout - memo list, contained panels, virtual scroll (build/layout_bench; needs build/{skia,yoga,lexbor,quickjs})
+#   render - headless mount/style/layout/paint/composite timings as JSON (build/render_bench; same libs as layout)
+#   test   - layout checks in src/tests/layout_test.cpp; exits 1 on a failed check (build/layout_test; same libs)
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+ROOT_DIR="$(cd "$SCRIPT_DIR/.." && pwd)"
+BUILD_DIR="$ROOT_DIR/build"
+
+SRC_DIR="$ROOT_DIR/src"
+SKIA_LIB="$BUILD_DIR/skia/libskia.a"
+YOGA_LIB="$BUILD_DIR/yoga/libyogacore.a"
+LEXBOR_LIB="$BUILD_DIR/lexbor/liblexbor_static.a"
+QUICKJS_LIB="$BUILD_DIR/quickjs/libqjs.a"
+
+BENCH="css"
+if [ $# -gt 0 ] && [[ "$1" == "css" || "$1" == "layout" || "$1" == "render" || "$1" == "test" ]]; then
+  BENCH="$1"
+  shift
+fi
+
+case "$BENCH" in
+  css)
+    REQUIRED=("$LEXBOR_LIB")
+    SOURCES=(
+      "$SRC_DIR/bench/css_bench.cpp"
+      "$SRC_DIR/renderer/css_parser.cpp"
+      "$SRC_DIR/renderer/css_color.cpp"
+      "$SRC_DIR/renderer/computed_style.cpp"
+      "$SRC_DIR/renderer/style_cache.cpp"
+    )
+    LIBS=("$LEXBOR_LIB")
+    ;;
+  layout | render | test)
+    REQUIRED=("$SKIA_LIB" "$YOGA_LIB" "$LEXBOR_LIB" "$QUICKJS_LIB")
+    SOURCES=(
+      "$SRC_DIR/wapis/dom.cpp"
+      "$SRC_DIR/renderer/element_data.cpp"
+      "$SRC_DIR/renderer/layout_yoga.cpp"
+      "$SRC_DIR/renderer/css_parser.cpp"
+      "$SRC_DIR/renderer/css_color.cpp"
+      "$SRC_DIR/renderer/computed_style.cpp"
+      "$SRC_DIR/renderer/style_cache.cpp"
+      "$SRC_DIR/renderer/style_sheet.cpp"
+      "$SRC_DIR/renderer/animation.cpp"
+      "$SRC_DIR/renderer/text_layout.cpp"
+      "$SRC_DIR/renderer/worker_pool.cpp"
+      "$SRC_DIR/renderer/renderer.cpp"
+      "$SRC_DIR/renderer/scheduler.cpp"
+    )
+    if [[ "$BENCH" == "test" ]]; then
+      SOURCES+=("$SRC_DIR/tests/layout_test.cpp")
+    else
+      SOURCES+=("$SRC_DIR/bench/${BENCH}_bench.cpp")
+    fi
+    if [[ "$BENCH" == "render" ]]; then
+      SOURCES+=(
+        "$SRC_DIR/renderer/compositor.cpp"
+        "$SRC_DIR/renderer/sk_canvas_view.cpp"
+      )
+    fi
+    LIBS=("$SKIA_LIB" "$YOGA_LIB" "$LEXBOR_LIB" "$QUICKJS_LIB" -lpthread -lm)
+    if [[ "$(uname)" == "Darwin" ]]; then
+      LIBS+=(-framework CoreFoundation -framework CoreGraphics -framework CoreText)
+    else
+      LIBS+=(-lfontconfig -lfreetype)
+    fi
+    ;;
+esac
+OUT_BIN="$BUILD_DIR/${BENCH}_bench"
+if [[ "$BENCH" == "test" ]]; then
+  OUT_BIN="$BUILD_DIR/layout_test"
+fi
+
+for lib in "${REQUIRED[@]}"; do
+  if [ ! -f "$lib" ]; then
+    echo "Missing static lib: $lib" >&2
+    echo "Run: scripts/build_libs.sh first." >&2
+    exit 1
+  fi
+done
+
+mkdir -p "$BUILD_DIR"
+
+CXX=${CXX:-c++}
+CXXFLAGS="${CXXFLAGS:--O3 -DNDEBUG}"
+
+"$CXX" -std=c++20 $CXXFLAGS "${SOURCES[@]}" \
+  -I"$ROOT_DIR/external/skia" -I"$ROOT_DIR/external/quickjs" -I"$ROOT_DIR/external/yoga" \
+  -I"$ROOT_DIR/external/lexbor/source" -I"$SRC_DIR" -I"$SRC_DIR/wapis" \
+  "${LIBS[@]}" -o "$OUT_BIN"
+
+"$OUT_BIN" "$@"
@@ -93,6 +93,14 @@ SOURCES=(
   "$SRC_DIR/wapis/dom.cpp"
   "$SRC_DIR/renderer/layout_yoga.cpp"
   "$SRC_DIR/renderer/css_parser.cpp"
+  "$SRC_DIR/renderer/css_color.cpp"
+  "$SRC_DIR/renderer/computed_style.cpp"
+  "$SRC_DIR/renderer/style_cache.cpp"
+  "$SRC_DIR/renderer/style_sheet.cpp"
+  "$SRC_DIR/renderer/animation.cpp"
+  "$SRC_DIR/renderer/text_layout.cpp"
+  "$SRC_DIR/renderer/worker_pool.cpp"
+  "$SRC_DIR/renderer/compositor.cpp"
   "$SRC_DIR/wapis/whatwg.c"
   "$SRC_DIR/input/input.cpp"
   "$SRC_DIR/input/mac.mm"
@@ -0,0 +1,122 @@
+// css_bench.cpp - inline style parsing throughput (declarations/sec). Build with scripts/bench.sh.
+// The style_cache line resolves the same styles through StyleCache; the run fails (exit 1) when its hit and
+// sharing counts differ from what hash-consing guarantees.
+#include "renderer/computed_style.h"
+#include "renderer/css_color.h"
+#include "renderer/css_parser.h"
+#include "renderer/style_cache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+// Representative inline styles (taken from src/tests and the compositor's common cases).
+const std::vector<std::string> kStyles = {
+   "display:flex; flex-direction:column;",
+   "flex:2;",
+   "display:flex; flex-direction:row; flex:1;",
+   "flex:1;",
+   "position:relative; width:800px; height:600px; display:block;",
+   "width:120px; height:80px; left:40px; top:25px; background-color: rgb(200, 60, 60);",
+   "color: blue; font-weight: bold;",
+   "flex: 1 1 50%; background: rgb(10%, 20%, 30%);",
+   "background-color: #3366cc80; color: rebeccapurple;",
+   "background: hsl(210 40% 96% / 0.9); color: rgba(0, 0, 0, .87);",
+};
+
+// One of each colour syntax (counted as one declaration each)
+const std::vector<std::string> kColors = {
+   "red", "LightGoldenrodYellow", "transparent", "#fff", "#3366cc80", "rgb(200, 60, 60)", "rgba(0, 0, 0, .5)",
+   "rgb(10% 20% 30% / 50%)", "hsl(120, 100%, 25%)", "hsla(0.5turn 60% 40% / 0.25)",
+};
+
+size_t declaration_count()
+{
+   size_t n = 0;
+   for (const auto& s : kStyles) {
+      css::DeclScanner scanner(s);
+      css::Decl d;
+      while (scanner.next(d))
+         ++n;
+   }
+   return n;
+}
+
+template <typename Fn> void run(const char* label, int iterations, size_t declsPerIter, Fn&& fn)
+{
+   using clock = std::chrono::steady_clock;
+   auto t0 = clock::now();
+   size_t sink = 0;
+   for (int i = 0; i < iterations; ++i)
+      sink += fn();
+   double secs = std::chrono::duration<double>(clock::now() - t0).count();
+   double decls = (double)declsPerIter * iterations;
+   std::printf("%-16s %10.0f decls/sec  (%.3f ms, %zu)\n", label, decls / secs, secs * 1000.0, sink);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+   int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+   if (iterations <= 0)
+      iterations = 1;
+   const size_t perIter = declaration_count();
+   std::printf("[css_bench] %zu styles, %zu declarations, %d iterations\n", kStyles.size(), perIter, iterations);
+
+   run("scan", iterations, perIter, [] {
+      size_t bytes = 0;
+      for (const auto& s : kStyles) {
+         css::DeclScanner scanner(s);
+         css::Decl d;
+         while (scanner.next(d))
+            bytes += d.name.size() + d.value.size();
+      }
+      return bytes;
+   });
+   run("parse_inline", iterations, perIter, [] {
+      size_t n = 0;
+      for (const auto& s : kStyles)
+         n += css::parse_inline(s).kv.size();
+      return n;
+   });
+   run("compute_style", iterations, perIter, [] {
+      size_t mask = 0;
+      css::ComputedStyle cs;
+      for (const auto& s : kStyles) {
+         css::compute_style(s, cs);
+         mask += cs.setMask;
+      }
+      return mask;
+   });
+   // The same styles through one document's cache: only the first sight of each string is tokenised
+   StyleCache cache;
+   run("style_cache", iterations, perIter, [&cache] {
+      size_t mask = 0;
+      for (const auto& s : kStyles)
+         mask += cache.resolve(s)->setMask;
+      return mask;
+   });
+   // 1000 list rows over the same distinct strings (as in bruteforce.js): one ComputedStyle per string
+   std::vector<std::shared_ptr<const css::ComputedStyle>> rows;
+   for (size_t i = 0; i < 1000; ++i)
+      rows.push_back(cache.resolve(kStyles[i % kStyles.size()]));
+   const StyleCacheStats st = cache.stats();
+   std::printf("%-16s hit rate %.6f (%zu/%zu), %zu entries, %zu bytes saved over %zu rows\n", "style_cache",
+               st.hitRate(), st.hits, st.lookups, st.entries, st.bytesSaved, rows.size());
+   if (st.hits != st.lookups - kStyles.size() || st.entries != kStyles.size() ||
+       st.bytesSaved != (rows.size() - kStyles.size()) * sizeof(css::ComputedStyle)) {
+      std::fprintf(stderr, "[css_bench] style_cache: unexpected hit or sharing counts\n");
+      return 1;
+   }
+   run("parse_color", iterations, kColors.size(), [] {
+      size_t ok = 0;
+      SkColor4f c;
+      for (const auto& s : kColors)
+         ok += css::parse_color(s, c) ? 1 : 0;
+      return ok;
+   });
+   return 0;
+}
@@ -0,0 +1,230 @@
+// layout_bench.cpp - layout microbenchmarks. Build with scripts/bench.sh layout.
+//   list:   relayout of a long list where one row changes per pass, with and without data-layout-memo
+//   panels: dashboard of fixed-size panels that all change every pass (contained subtrees, laid out in parallel;
+//           compare UI_WORKER_THREADS=0 against the default)
+//   scroll: a 100k-row overflow:auto list scrolled a little each pass, with and without data-virtualize
+//   labels: full relayout of 5k rows of wrapping text whose strings never change (target: under one 16.7 ms frame).
+//           Every text measurement in those passes must be a cache hit; the run exits 1 when one is not.
+#include "renderer/element_data.h"
+#include "renderer/layout_yoga.h"
+#include "renderer/text_layout.h"
+#include "renderer/worker_pool.h"
+#include "wapis/dom.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The bench drives layout_run directly; these satisfy layout_maybe_run's app glue, which it never calls.
+extern "C" void* dom_get_cpp_node_opaque(JSContext*, JSValueConst)
+{
+   return nullptr;
+}
+float dom_get_display_scale(JSContext*)
+{
+   return 1.f;
+}
+void native_request_composite(JSContext*)
+{
+}
+void native_request_animation_frame(JSContext*)
+{
+}
+int g_winW = 800;
+int g_winH = 600;
+
+namespace {
+struct ListDoc {
+   std::shared_ptr<dom::Document> doc;
+   std::shared_ptr<dom::Element> body;
+   std::vector<std::shared_ptr<dom::Element>> values; // the text leaf of each row that the bench rewrites
+};
+
+ListDoc build_list(int rows, bool memo)
+{
+   ListDoc d;
+   d.doc = std::make_shared<dom::Document>();
+   d.body = d.doc->createElement("body");
+   d.doc->appendChild(d.body);
+   auto list = d.doc->createElement("div");
+   list->setAttribute("style", "display:flex; flex-direction:column;");
+   d.body->appendChild(list);
+   for (int i = 0; i < rows; ++i) {
+      auto row = d.doc->createElement("div");
+      row->setAttribute("style", "display:flex; flex-direction:row; padding:4px; border-bottom-width:1px;");
+      if (memo)
+         row->setAttribute("data-layout-memo", "");
+      auto label = d.doc->createElement("span");
+      label->setAttribute("style", "flex:1;");
+      label->appendChild(d.doc->createTextNode("Row label"));
+      auto value = d.doc->createElement("span");
+      value->setAttribute("style", "width:80px; padding:0 8px;");
+      value->appendChild(d.doc->createTextNode("0"));
+      row->appendChild(label);
+      row->appendChild(value);
+      list->appendChild(row);
+      d.values.push_back(value);
+   }
+   return d;
+}
+
+// Fixed px width/height panels: each is a containment boundary and gets its own Yoga tree
+ListDoc build_panels(int panels, int cellsPerPanel)
+{
+   ListDoc d;
+   d.doc = std::make_shared<dom::Document>();
+   d.body = d.doc->createElement("body");
+   d.doc->appendChild(d.body);
+   auto grid = d.doc->createElement("div");
+   grid->setAttribute("style", "display:flex; flex-direction:row;");
+   d.body->appendChild(grid);
+   for (int p = 0; p < panels; ++p) {
+      auto panel = d.doc->createElement("div");
+      panel->setAttribute("style", "display:flex; flex-direction:column; width:240px; height:180px; padding:6px;");
+      for (int c = 0; c < cellsPerPanel; ++c) {
+         auto row = d.doc->createElement("div");
+         row->setAttribute("style", "display:flex; flex-direction:row; margin:1px;");
+         auto name = d.doc->createElement("span");
+         name->setAttribute("style", "flex:1;");
+         name->appendChild(d.doc->createTextNode("Metric " + std::to_string(c)));
+         auto value = d.doc->createElement("span");
+         value->appendChild(d.doc->createTextNode("0"));
+         row->appendChild(name);
+         row->appendChild(value);
+         panel->appendChild(row);
+         if (c == 0)
+            d.values.push_back(value);
+      }
+      grid->appendChild(panel);
+   }
+   return d;
+}
+
+void run_panels(int panels, int cellsPerPanel, int passes)
+{
+   using clock = std::chrono::steady_clock;
+   ListDoc d = build_panels(panels, cellsPerPanel);
+   layout_run(d.body.get(), (float)g_winW, (float)g_winH, 1.f);
+   auto t0 = clock::now();
+   for (int i = 0; i < passes; ++i) {
+      // Every panel changes each pass, so every contained subtree is laid out again
+      for (auto& v : d.values)
+         v->firstChild()->setTextContent(std::to_string(i * 1000003));
+      layout_run(d.body.get(), (float)g_winW, (float)g_winH, 1.f);
+   }
+   double passMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count() / passes;
+   std::printf("%-8s panels=%d cells=%d workers=%zu relayout=%.3f ms/pass\n", "panels", panels, cellsPerPanel,
+               worker_count(), passMs);
+   release_all_render_data();
+}
+
+void run_scroll(const char* label, int rows, int passes, bool virtualize)
+{
+   using clock = std::chrono::steady_clock;
+   auto doc = std::make_shared<dom::Document>();
+   auto body = doc->createElement("body");
+   doc->appendChild(body);
+   auto list = doc->createElement("div");
+   list->setAttribute("style", "display:flex; flex-direction:column; overflow:auto; height:600px;");
+   if (virtualize)
+      list->setAttribute("data-virtualize", "");
+   body->appendChild(list);
+   for (int i = 0; i < rows; ++i) {
+      auto row = doc->createElement("div");
+      row->setAttribute("style", "padding:4px;");
+      row->appendChild(doc->createTextNode("Row " + std::to_string(i)));
+      list->appendChild(row);
+   }
+   auto t0 = clock::now();
+   layout_run(body.get(), (float)g_winW, (float)g_winH, 1.f);
+   double firstMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+   t0 = clock::now();
+   for (int i = 0; i < passes; ++i) {
+      layout_scroll_by(list.get(), 0, 37.f);
+      layout_run(body.get(), (float)g_winW, (float)g_winH, 1.f);
+   }
+   double passMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count() / passes;
+   std::printf("%-8s rows=%d first=%.3f ms scroll=%.3f ms/pass\n", label, rows, firstMs, passMs);
+   release_all_render_data();
+}
+
+// Every row is laid out again each pass (the viewport width alternates), but no string changes, so text is
+// measured from the per-(string, font, width) cache rather than re-shaped. False when some measurement missed.
+bool run_labels(int rows, int passes)
+{
+   using clock = std::chrono::steady_clock;
+   auto doc = std::make_shared<dom::Document>();
+   auto body = doc->createElement("body");
+   doc->appendChild(body);
+   auto list = doc->createElement("div");
+   list->setAttribute("style", "display:flex; flex-direction:column;");
+   body->appendChild(list);
+   for (int i = 0; i < rows; ++i) {
+      auto row = doc->createElement("div");
+      row->setAttribute("style", "display:flex; flex-direction:row; padding:2px;");
+      auto label = doc->createElement("span");
+      label->setAttribute("style", "flex:1;");
+      label->appendChild(doc->createTextNode("Item " + std::to_string(i) + " with a label long enough to wrap"));
+      auto value = doc->createElement("span");
+      value->setAttribute("style", "width:60px;");
+      value->appendChild(doc->createTextNode(std::to_string(i * 37)));
+      row->appendChild(label);
+      row->appendChild(value);
+      list->appendChild(row);
+   }
+   auto t0 = clock::now();
+   layout_run(body.get(), (float)g_winW, (float)g_winH, 1.f);
+   double firstMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+   const text::TextCacheStats before = text::text_cache_stats();
+   t0 = clock::now();
+   for (int i = 0; i < passes; ++i)
+      layout_run(body.get(), (float)(g_winW - (i & 1)), (float)g_winH, 1.f);
+   double passMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count() / passes;
+   const text::TextCacheStats after = text::text_cache_stats();
+   const size_t lookups = after.layoutLookups - before.layoutLookups;
+   const size_t hits = after.layoutHits - before.layoutHits;
+   std::printf("%-8s rows=%d first=%.3f ms relayout=%.3f ms/pass (%s a 16.7 ms frame) text hits=%zu/%zu\n",
+               "labels", rows, firstMs, passMs, passMs < 16.7 ? "under" : "over", hits, lookups);
+   release_all_render_data();
+   if (hits != lookups)
+      std::fprintf(stderr, "[layout_bench] labels: %zu text measurements missed the cache\n", lookups - hits);
+   return hits == lookups;
+}
+
+void run(const char* label, int rows, int passes, bool memo)
+{
+   using clock = std::chrono::steady_clock;
+   ListDoc d = build_list(rows, memo);
+   auto t0 = clock::now();
+   layout_run(d.body.get(), (float)g_winW, (float)g_winH, 1.f);
+   double firstMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+   t0 = clock::now();
+   for (int i = 0; i < passes; ++i) {
+      // One row changes per pass; every other row is structurally identical and untouched
+      d.values[(size_t)(i * 7919) % d.values.size()]->firstChild()->setTextContent(std::to_string(i));
+      layout_run(d.body.get(), (float)g_winW, (float)g_winH, 1.f);
+   }
+   double passMs = std::chrono::duration<double, std::milli>(clock::now() - t0).count() / passes;
+   std::printf("%-8s rows=%d first=%.3f ms relayout=%.3f ms/pass\n", label, rows, firstMs, passMs);
+   release_all_render_data();
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+   int rows = argc > 1 ? std::atoi(argv[1]) : 10000;
+   int passes = argc > 2 ? std::atoi(argv[2]) : 50;
+   if (rows <= 0)
+      rows = 1;
+   if (passes <= 0)
+      passes = 1;
+   std::printf("[layout_bench] %d rows, %d passes, one row changed per pass\n", rows, passes);
+   run("plain", rows, passes, false);
+   run("memo", rows, passes, true);
+   run_panels(256, 40, passes);
+   run_scroll("scroll", 100000, passes, false);
+   run_scroll("virtual", 100000, passes, true);
+   return run_labels(5000, passes) ? 0 : 1;
+}
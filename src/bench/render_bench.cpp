@@ -0,0 +1,520 @@
+// render_bench.cpp - headless frame benchmark over synthetic workloads. Build with scripts/bench.sh render.
+// Times mount, style, layout, paint and composite separately for every iteration and prints JSON (median, p95 and
+// operator-new allocations per phase) on stdout, so runs can be diffed between releases. No window, no JS.
+//   mount:     build the workload's DOM from scratch (one fresh document per iteration)
+//   style:     resolve computed styles of everything the iteration's mutation dirtied
+//   layout:    layout_run
+//   paint:     refresh paint records and text blobs of every layer
+//   composite: collect damage, then clear and repaint the damaged region of a raster surface (the window's
+//              compositor, minus presenting); damage_px_median is the area it repainted per iteration.
+// Usage: render_bench [iterations] [workload] [device scale] [viewport WxH in CSS px]; e.g. the 4K full-frame case
+// is `render_bench 50 repaint 2 1920x1080`.
+#include "renderer/animation.h"
+#include "renderer/compositor.h"
+#include "renderer/element_data.h"
+#include "renderer/layout_yoga.h"
+#include "renderer/renderer.h"
+#include "renderer/sk_canvas_view.h"
+#include "wapis/dom.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <include/core/SkCanvas.h>
+#include <include/core/SkImageInfo.h>
+#include <include/core/SkRegion.h>
+#include <include/core/SkSurface.h>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Allocation counting (C++ operator new only; Skia's own malloc calls are not included)
+static std::atomic<size_t> g_allocCount{0};
+static std::atomic<size_t> g_allocBytes{0};
+
+void* operator new(size_t n)
+{
+   g_allocCount.fetch_add(1, std::memory_order_relaxed);
+   g_allocBytes.fetch_add(n, std::memory_order_relaxed);
+   void* p = std::malloc(n ? n : 1);
+   if (!p)
+      std::abort();
+   return p;
+}
+
+void operator delete(void* p) noexcept
+{
+   std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+   std::free(p);
+}
+
+// App glue normally provided by main.mm and dom_adapter.cpp. The bench drives layout_run and the compositor
+// directly, so none of these are reached.
+extern "C" void* dom_get_cpp_node_opaque(JSContext*, JSValueConst)
+{
+   return nullptr;
+}
+float dom_get_display_scale(JSContext*)
+{
+   return 1.f;
+}
+void native_request_composite(JSContext*)
+{
+}
+void native_request_animation_frame(JSContext*)
+{
+}
+GfxStateHandle* dom_gfx_state(JSContext*)
+{
+   return nullptr;
+}
+int g_winW = 1024;
+int g_winH = 768;
+float g_deviceScale = 1.f;
+
+namespace {
+enum Phase { Mount, Style, Layout, Paint, Composite, PhaseCount };
+const char* const kPhaseNames[PhaseCount] = {"mount", "style", "layout", "paint", "composite"};
+
+struct Sample {
+   double ms;
+   size_t allocs;
+   size_t bytes;
+};
+
+// One document plus everything the app would attach to it
+struct Scene {
+   std::shared_ptr<dom::Document> doc;
+   std::shared_ptr<dom::Element> body;
+   std::shared_ptr<dom::Element> root;
+   std::unique_ptr<Renderer> renderer;
+   std::vector<std::shared_ptr<dom::Element>> items; // workload-specific handles
+   GfxStateHandle* gfx = nullptr;
+   std::unordered_map<dom::Element*, int> canvasIds;
+   uint32_t rng = 12345;
+
+   uint32_t next()
+   {
+      rng = rng * 1664525u + 1013904223u;
+      return rng >> 8;
+   }
+
+   ~Scene()
+   {
+      release_all_render_data();
+      if (doc && renderer)
+         doc->removeObserver(renderer.get());
+      if (gfx)
+         gfx_state_destroy(gfx);
+   }
+};
+
+std::unique_ptr<Scene> new_scene(const char* rootStyle)
+{
+   auto s = std::make_unique<Scene>();
+   s->doc = std::make_shared<dom::Document>();
+   s->renderer = std::make_unique<Renderer>();
+   s->renderer->attach(s->doc.get());
+   s->body = s->doc->createElement("body");
+   s->doc->appendChild(s->body);
+   s->root = s->doc->createElement("div");
+   s->root->setAttribute("style", rootStyle);
+   s->body->appendChild(s->root);
+   return s;
+}
+
+std::shared_ptr<dom::Element> add_box(Scene& s, dom::Element* parent, const std::string& style,
+                                      const std::string& text = std::string())
+{
+   auto el = s.doc->createElement("div");
+   el->setAttribute("style", style);
+   if (!text.empty())
+      el->appendChild(s.doc->createTextNode(text));
+   parent->appendChild(el);
+   return el;
+}
+
+std::string rgb(uint32_t v)
+{
+   return "rgb(" + std::to_string(v & 255) + ", " + std::to_string((v >> 8) & 255) + ", " +
+          std::to_string((v >> 16) & 255) + ")";
+}
+
+struct Workload {
+   const char* name;
+   void (*build)(Scene&);
+   void (*mutate)(Scene&, int iteration);
+};
+
+// Many siblings under one flex column; one child changes width per iteration
+void build_wide(Scene& s)
+{
+   for (int i = 0; i < 5000; ++i)
+      s.items.push_back(add_box(s, s.root.get(), "height:4px; background-color:" + rgb((uint32_t)i * 2654435761u)));
+}
+void mutate_wide(Scene& s, int i)
+{
+   s.items[s.next() % s.items.size()]->setAttribute("style", "height:4px; width:" + std::to_string(100 + i % 400) +
+                                                              "px; background-color:rgb(40, 90, 160)");
+}
+
+// The same 5000 siblings with nothing changing: the cost of a frame that only replays retained pictures
+void mutate_static(Scene&, int)
+{
+}
+
+// The same 5000 siblings under a root whose background changes: every frame damages and rasters the whole viewport
+void mutate_repaint(Scene& s, int i)
+{
+   s.root->setStyleProperty("background-color", rgb((uint32_t)i * 2654435761u));
+}
+
+// A 500-deep chain; the innermost box changes size, so every ancestor is laid out again
+void build_deep(Scene& s)
+{
+   dom::Element* parent = s.root.get();
+   for (int i = 0; i < 500; ++i) {
+      s.items.push_back(add_box(s, parent, "display:flex; padding:1px;"));
+      parent = s.items.back().get();
+   }
+   s.items.push_back(add_box(s, parent, "width:10px; height:10px;"));
+}
+void mutate_deep(Scene& s, int i)
+{
+   std::string px = std::to_string(10 + i % 20) + "px";
+   s.items.back()->setAttribute("style", "width:" + px + "; height:" + px + ";");
+}
+
+// 60 x 40 flex grid of text cells; 20 cells change text per iteration
+void build_grid(Scene& s)
+{
+   for (int r = 0; r < 60; ++r) {
+      auto row = add_box(s, s.root.get(), "display:flex; flex-direction:row;");
+      for (int c = 0; c < 40; ++c)
+         s.items.push_back(add_box(s, row.get(), "flex:1; padding:1px;", std::to_string(r * 40 + c)));
+   }
+}
+void mutate_grid(Scene& s, int i)
+{
+   for (int k = 0; k < 20; ++k)
+      s.items[s.next() % s.items.size()]->firstChild()->setTextContent(std::to_string(i * 1000 + k));
+}
+
+// 2000 boxes; a fifth of them get a new inline style per iteration (colour and width alternate)
+void build_churn(Scene& s)
+{
+   auto wrap = add_box(s, s.root.get(), "display:flex; flex-direction:row; flex-wrap:wrap;");
+   for (int i = 0; i < 2000; ++i)
+      s.items.push_back(add_box(s, wrap.get(), "width:20px; height:20px; background-color:rgb(80, 80, 80)"));
+}
+void mutate_churn(Scene& s, int i)
+{
+   for (size_t k = 0; k < s.items.size() / 5; ++k) {
+      uint32_t v = s.next();
+      std::string w = std::to_string(16 + (v % 3) * 4) + "px";
+      s.items[v % s.items.size()]->setAttribute("style", "width:" + w + "; height:20px; background-color:" +
+                                                            rgb(v + (uint32_t)i));
+   }
+}
+
+// 2000-row list; each iteration inserts a row, removes a row and moves a row
+void build_list(Scene& s)
+{
+   for (int i = 0; i < 2000; ++i) {
+      auto row = add_box(s, s.root.get(), "display:flex; flex-direction:row; padding:2px;");
+      add_box(s, row.get(), "flex:1;", "Row " + std::to_string(i));
+      add_box(s, row.get(), "width:60px;", std::to_string(i));
+      s.items.push_back(row);
+   }
+}
+void mutate_list(Scene& s, int i)
+{
+   auto row = s.doc->createElement("div");
+   row->setAttribute("style", "display:flex; flex-direction:row; padding:2px;");
+   add_box(s, row.get(), "flex:1;", "New " + std::to_string(i));
+   size_t at = s.next() % s.items.size();
+   s.root->insertBefore(row, s.items[at]);
+   s.items.insert(s.items.begin() + (long)at, row);
+   size_t gone = s.next() % s.items.size();
+   s.root->removeChild(s.items[gone]);
+   s.items.erase(s.items.begin() + (long)gone);
+   size_t from = s.next() % s.items.size(), to = s.next() % s.items.size();
+   if (from != to) {
+      auto moved = s.items[from];
+      s.root->insertBefore(moved, s.items[to]); // insertBefore re-parents: a move, not a copy
+      s.items.erase(s.items.begin() + (long)from);
+      s.items.insert(s.items.begin() + (long)(to > from ? to - 1 : to), moved);
+   }
+}
+
+// One absolutely positioned 50x50 box dragged across 2000 small ones, (7, 5) CSS px per step
+void build_drag(Scene& s)
+{
+   for (int i = 0; i < 2000; ++i) {
+      int x = (i % 50) * 20, y = (i / 50) * 18;
+      const char* size = i == 0 ? "px; width:50px; height:50px;" : "px; width:16px; height:14px;";
+      s.items.push_back(add_box(s, s.root.get(),
+                                "position:absolute; left:" + std::to_string(x) + "px; top:" + std::to_string(y) +
+                                    size + " background-color:rgb(60, 120, 90)"));
+   }
+}
+void mutate_drag(Scene& s, int i)
+{
+   s.items[0]->setAttribute("style", "position:absolute; left:" + std::to_string((i * 7) % 900) + "px; top:" +
+                                         std::to_string((i * 5) % 700) +
+                                         "px; width:50px; height:50px; background-color:rgb(200, 60, 60)");
+}
+// The same box moved as a native drag: a compositor-layer offset, with no style write or relayout
+void mutate_drag_layer(Scene& s, int i)
+{
+   set_drag_offset(s.items[0].get(), true, (float)((i * 7) % 900), (float)((i * 5) % 700));
+}
+
+// 2000 boxes; 500 get a new background colour per iteration through the CSSOM path (repaint only, no layout)
+void build_recolor(Scene& s)
+{
+   auto wrap = add_box(s, s.root.get(), "display:flex; flex-direction:row; flex-wrap:wrap;");
+   for (int i = 0; i < 2000; ++i)
+      s.items.push_back(add_box(s, wrap.get(), "width:20px; height:20px; background-color:rgb(80, 80, 80)"));
+}
+void mutate_recolor(Scene& s, int i)
+{
+   for (int k = 0; k < 500; ++k) {
+      uint32_t v = s.next();
+      s.items[v % s.items.size()]->setStyleProperty("background-color", rgb(v + (uint32_t)i));
+   }
+}
+
+// 1000 boxes with an infinite opacity/transform animation; each iteration is one 60 Hz tick of the frame clock
+// (no style resolve or layout: values go straight into the paint records)
+void build_animate(Scene& s)
+{
+   auto wrap = add_box(s, s.root.get(), "display:flex; flex-direction:row; flex-wrap:wrap;");
+   auto keyframes = css::parse_keyframes("pulse", "from { opacity: 0.2; transform: rotate(0deg) }"
+                                                  "to { opacity: 1; transform: rotate(360deg) scale(1.5) }");
+   css::AnimationTiming timing;
+   timing.duration = 1000.f;
+   timing.iterations = INFINITY;
+   timing.direction = css::PlaybackDirection::Alternate;
+   for (int i = 0; i < 1000; ++i) {
+      auto el = add_box(s, wrap.get(), "width:20px; height:20px; background-color:rgb(90, 140, 200)");
+      animation_play(el.get(), keyframes, timing);
+      s.items.push_back(el);
+   }
+}
+void mutate_animate(Scene&, int i)
+{
+   animations_tick(i * 1000.0 / 60.0);
+}
+
+// 200 canvas-backed elements; 20 are redrawn per iteration and all are composited from snapshots
+void build_canvas(Scene& s)
+{
+   s.gfx = gfx_state_create();
+   auto wrap = add_box(s, s.root.get(), "display:flex; flex-direction:row; flex-wrap:wrap;");
+   for (int i = 0; i < 200; ++i) {
+      auto el = add_box(s, wrap.get(), "width:64px; height:64px; margin:2px;");
+      int id = gfx_create_canvas(s.gfx, 64, 64);
+      gfx_fill_rect(s.gfx, id, 0, 0, 64, 64, 0x202020FFu);
+      s.canvasIds[el.get()] = id;
+      s.items.push_back(el);
+   }
+}
+void mutate_canvas(Scene& s, int i)
+{
+   for (int k = 0; k < 20; ++k) {
+      uint32_t v = s.next();
+      int id = s.canvasIds[s.items[v % s.items.size()].get()];
+      gfx_fill_circle(s.gfx, id, (int)(v % 64), (int)((v >> 6) % 64), 4 + i % 8, (v << 8) | 0xFFu);
+   }
+}
+
+const Workload kWorkloads[] = {
+    {"wide", build_wide, mutate_wide},          {"static", build_wide, mutate_static},
+    {"repaint", build_wide, mutate_repaint},    {"deep", build_deep, mutate_deep},
+    {"grid", build_grid, mutate_grid},          {"churn", build_churn, mutate_churn},
+    {"list", build_list, mutate_list},          {"drag", build_drag, mutate_drag},
+    {"recolor", build_recolor, mutate_recolor}, {"canvas", build_canvas, mutate_canvas},
+    {"animate", build_animate, mutate_animate}, {"drag-layer", build_drag, mutate_drag_layer},
+};
+
+// Resolve styles the mutation dirtied, skipping subtrees with nothing pending
+void resolve_styles(dom::Element* el)
+{
+   auto* rd = ensure_render_data(el);
+   if (!rd)
+      return;
+   if (!(rd->dirtyFlags() & (kDirtyStyle | kDirtyLayout | kDirtyDescendant)))
+      return;
+   resolve_style(el, rd);
+   for (auto& c : el->childNodes) {
+      if (c && c->nodeType == dom::NodeType::ELEMENT)
+         resolve_styles(static_cast<dom::Element*>(c.get()));
+   }
+}
+
+void refresh_paint(Scene& s)
+{
+   s.renderer->forEachLayer([](RenderLayer* rl) {
+      paint_props(rl->element);
+      text_blob(rl->element);
+   });
+}
+
+template <typename Fn> Sample measure(Fn&& fn)
+{
+   using clock = std::chrono::steady_clock;
+   size_t a0 = g_allocCount.load(), b0 = g_allocBytes.load();
+   auto t0 = clock::now();
+   fn();
+   double ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+   return {ms, g_allocCount.load() - a0, g_allocBytes.load() - b0};
+}
+
+struct Stats {
+   double median = 0, p95 = 0;
+   double allocs = 0, bytes = 0; // mean per iteration
+};
+
+Stats summarize(std::vector<Sample>& samples)
+{
+   Stats st;
+   if (samples.empty())
+      return st;
+   std::vector<double> ms;
+   ms.reserve(samples.size());
+   for (const Sample& s : samples) {
+      ms.push_back(s.ms);
+      st.allocs += (double)s.allocs;
+      st.bytes += (double)s.bytes;
+   }
+   std::sort(ms.begin(), ms.end());
+   st.median = ms[ms.size() / 2];
+   st.p95 = ms[std::min(ms.size() - 1, (size_t)((double)ms.size() * 0.95))];
+   st.allocs /= (double)samples.size();
+   st.bytes /= (double)samples.size();
+   return st;
+}
+
+size_t count_elements(dom::Element* el)
+{
+   size_t n = 1;
+   for (auto& c : el->childNodes) {
+      if (c && c->nodeType == dom::NodeType::ELEMENT)
+         n += count_elements(static_cast<dom::Element*>(c.get()));
+   }
+   return n;
+}
+
+void run_workload(const Workload& w, int iterations, sk_sp<SkSurface> surface, bool first)
+{
+   std::vector<Sample> samples[PhaseCount];
+   const char* rootStyle = "display:flex; flex-direction:column;";
+   for (int i = 0; i < iterations; ++i) {
+      std::unique_ptr<Scene> scene;
+      samples[Mount].push_back(measure([&] {
+         scene = new_scene(rootStyle);
+         w.build(*scene);
+      }));
+   }
+   // Updates run against one document, starting from a fully rendered first frame
+   std::unique_ptr<Scene> scene = new_scene(rootStyle);
+   w.build(*scene);
+   Scene& s = *scene;
+   auto snapshot = [&s](dom::Element* el) -> sk_sp<SkImage> {
+      auto it = s.canvasIds.find(el);
+      return it == s.canvasIds.end() ? nullptr : gfx_snapshot(s.gfx, it->second);
+   };
+   SkCanvas* canvas = surface->getCanvas();
+   const SkIRect full = SkIRect::MakeWH(surface->width(), surface->height());
+   std::vector<double> damagedPx; // device pixels cleared and repainted per iteration
+   auto frame = [&](bool record) {
+      Sample st = measure([&] { resolve_styles(s.body.get()); });
+      Sample lt = measure([&] { layout_run(s.body.get(), (float)g_winW, (float)g_winH, g_deviceScale); });
+      Sample pt = measure([&] { refresh_paint(s); });
+      SkRegion damage;
+      Sample ct = measure([&] {
+         damage = collect_damage(*s.renderer, g_deviceScale, snapshot);
+         damage.op(full, SkRegion::kIntersect_Op);
+         if (damage.isEmpty())
+            return;
+         canvas->save();
+         canvas->clipRegion(damage);
+         canvas->clear(SK_ColorBLACK);
+         composite_layers(canvas, *s.renderer, &damage);
+         canvas->restore();
+      });
+      if (record) {
+         samples[Style].push_back(st);
+         samples[Layout].push_back(lt);
+         samples[Paint].push_back(pt);
+         samples[Composite].push_back(ct);
+         double px = 0;
+         for (SkRegion::Iterator it(damage); !it.done(); it.next())
+            px += (double)it.rect().width() * it.rect().height();
+         damagedPx.push_back(px);
+      }
+   };
+   frame(false);
+   // Paint and composite time the document's render tree; an empty one would make them time empty loops
+   size_t layers = 0;
+   s.renderer->forEachLayer([&layers](RenderLayer*) { ++layers; });
+   if (layers == 0)
+      std::fprintf(stderr, "[render_bench] %s: no render layers, paint and composite timings are empty\n", w.name);
+   for (int i = 0; i < iterations; ++i) {
+      w.mutate(s, i);
+      frame(true);
+   }
+   std::printf("%s    {\"name\": \"%s\", \"elements\": %zu, \"layers\": %zu, \"phases\": {", first ? "" : ",\n",
+               w.name, count_elements(s.body.get()), layers);
+   for (int p = 0; p < PhaseCount; ++p) {
+      Stats st = summarize(samples[p]);
+      std::printf("%s\n      \"%s\": {\"median_ms\": %.4f, \"p95_ms\": %.4f, \"allocs\": %.1f, \"alloc_bytes\": %.0f}",
+                  p ? "," : "", kPhaseNames[p], st.median, st.p95, st.allocs, st.bytes);
+   }
+   std::sort(damagedPx.begin(), damagedPx.end());
+   std::printf("\n    }, \"damage_px_median\": %.0f}", damagedPx.empty() ? 0.0 : damagedPx[damagedPx.size() / 2]);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+   int iterations = argc > 1 ? std::atoi(argv[1]) : 50;
+   const char* only = argc > 2 ? argv[2] : nullptr; // run a single workload by name
+   if (iterations <= 0)
+      iterations = 1;
+   if (argc > 3 && std::atof(argv[3]) > 0)
+      g_deviceScale = (float)std::atof(argv[3]);
+   if (argc > 4 && std::sscanf(argv[4], "%dx%d", &g_winW, &g_winH) != 2) {
+      std::fprintf(stderr, "[render_bench] viewport must be WxH, got '%s'\n", argv[4]);
+      return 1;
+   }
+   const int surfaceW = (int)std::lround(g_winW * g_deviceScale), surfaceH = (int)std::lround(g_winH * g_deviceScale);
+   sk_sp<SkSurface> surface =
+       SkSurfaces::Raster(SkImageInfo::Make(surfaceW, surfaceH, kN32_SkColorType, kPremul_SkAlphaType));
+   if (!surface) {
+      std::fprintf(stderr, "[render_bench] could not allocate a %dx%d raster surface\n", surfaceW, surfaceH);
+      return 1;
+   }
+   std::printf("{\n  \"bench\": \"render\",\n  \"iterations\": %d,\n  \"viewport\": [%d, %d],\n"
+               "  \"device_scale\": %.2f,\n  \"workloads\": [\n",
+               iterations, g_winW, g_winH, g_deviceScale);
+   bool first = true;
+   for (const Workload& w : kWorkloads) {
+      if (only && std::strcmp(only, w.name) != 0)
+         continue;
+      run_workload(w, iterations, surface, first);
+      first = false;
+   }
+   std::printf("\n  ]\n}\n");
+   return 0;
+}
@@ -1,57 +1,181 @@
 #include "input.h"
-#include "renderer/css_parser.h"
+#include "renderer/element_data.h"
+#include "renderer/layout_yoga.h"
+#include "renderer/renderer.h"
 #include "wapis/dom.hpp"
 #include <algorithm>
+#include <cstdlib>
 #include <cstdio>
 #include <unordered_map>
 
 namespace input {
 
-static void collectElementsWith(dom::Element* root, std::vector<dom::Element*>& out)
+dom::Element* InputManager::hitTest(int x, int y)
+{
+   // Walks the document's render tree in reverse paint order
+   Renderer* renderer = document_renderer(doc_.get());
+   return renderer ? renderer->hitTest(x, y) : nullptr;
+}
+
+bool InputManager::scroll(int x, int y, float dx, float dy)
+{
+   // Innermost scroll container under the point that can still move; parents take what it cannot
+   for (dom::Element* el = hitTest(x, y); el;) {
+      if (layout_scroll_by(el, dx, dy))
+         return true;
+      auto parent = el->parentNode.lock();
+      el = parent && parent->nodeType == dom::NodeType::ELEMENT ? static_cast<dom::Element*>(parent.get()) : nullptr;
+   }
+   return false;
+}
+
+dom::Element* InputManager::canvasAt(int x, int y)
+{
+   // Canvases are the draggable elements: the one hit, or the nearest one around the hit element
+   dom::Element* el = hitTest(x, y);
+   while (el && el->tagName != "canvas" && el->tagName != "CANVAS") {
+      auto parent = el->parentNode.lock();
+      el = parent && parent->nodeType == dom::NodeType::ELEMENT ? static_cast<dom::Element*>(parent.get()) : nullptr;
+   }
+   return el;
+}
+
+bool InputManager::beginDrag(int x, int y)
+{
+   endDrag();
+   dom::Element* el = canvasAt(x, y);
+   if (!el)
+      return false;
+   dragged_ = std::static_pointer_cast<dom::Element>(el->shared_from_this());
+   moving_ = false;
+   pressX_ = x;
+   pressY_ = y;
+   return true;
+}
+
+bool InputManager::startMoving()
+{
+   DomElementRenderData* rd = get_render_data(dragged_.get());
+   LayoutBox frame, cb;
+   if (!rd || !layout_containing_block(dragged_.get(), frame, cb))
+      return false;
+   const LayoutBox& b = rd->box();
+   boxX_ = b.x;
+   boxY_ = b.y;
+   boxW_ = b.w;
+   boxH_ = b.h;
+   frameX_ = frame.x;
+   frameY_ = frame.y;
+   frameW_ = frame.w;
+   frameH_ = frame.h;
+   cbX_ = cb.x;
+   cbY_ = cb.y;
+   cbW_ = cb.w;
+   cbH_ = cb.h;
+   moving_ = true;
+   return true;
+}
+
+// `pos` for a box of `extent` kept within [lo, lo + size); one that started outside (or is larger) may stay at `start`
+static float clamp_to(float pos, float extent, float lo, float size, float start)
 {
-   if (!root)
+   const float min = std::min(lo, start), max = std::max(lo + size - extent, start);
+   return std::max(min, std::min(max, pos));
+}
+
+bool InputManager::dragTo(int x, int y, int viewportW, int viewportH)
+{
+   if (!dragged_)
+      return false;
+   if (!moving_) {
+      if (std::abs(x - pressX_) < kDragThreshold && std::abs(y - pressY_) < kDragThreshold)
+         return false;
+      if (!startMoving())
+         return false;
+   }
+   // Kept inside the visible part of its containing block, in the coordinates of its laid-out box
+   const float l = std::max(cbX_, 0.f), t = std::max(cbY_, 0.f);
+   const float r = std::min(cbX_ + cbW_, (float)viewportW), b = std::min(cbY_ + cbH_, (float)viewportH);
+   const float nx = clamp_to(boxX_ + (x - pressX_), boxW_, l, r - l, boxX_);
+   const float ny = clamp_to(boxY_ + (y - pressY_), boxH_, t, b - t, boxY_);
+   set_drag_offset(dragged_.get(), true, nx - boxX_, ny - boxY_);
+   return true;
+}
+
+static float resolve(const css::Length& l, float base)
+{
+   return l.unit == css::Unit::Px ? l.value : l.unit == css::Unit::Percent ? base * l.value / 100.f : 0.f;
+}
+
+static void set_px(dom::Element* el, const char* name, float value)
+{
+   char text[32];
+   snprintf(text, sizeof(text), "%gpx", value);
+   el->setStyleProperty(name, text);
+}
+
+// Write the offset as the insets that put the laid-out box where the layer already is, so the relayout that follows
+// moves nothing. A static element becomes position:relative, offset from where it flows; a relative one shifts its
+// resolved offset (the inset that wins: left over right, top over bottom); an absolute one is measured from its
+// containing block's padding box, keeping whichever insets it declares (both, so its size is kept). Percentages and
+// stylesheet values are resolved, and written inline in px.
+void InputManager::commitDrag()
+{
+   dom::Element* el = dragged_.get();
+   const DomElementRenderData* rd = get_render_data(el);
+   if (!rd || (rd->dragX == 0 && rd->dragY == 0))
       return;
-   out.push_back(root);
-   for (auto& c : root->childNodes) {
-      if (c && c->nodeType == dom::NodeType::ELEMENT)
-         collectElementsWith((dom::Element*)c.get(), out);
+   const float dx = rd->dragX, dy = rd->dragY;
+   const css::ComputedStyle& cs = rd->computed();
+   if (cs.position == css::Position::Absolute) {
+      const float x = boxX_ + dx, y = boxY_ + dy;
+      const float ml = resolve(cs.margin[(int)css::Edge::Left], frameW_);
+      const float mr = resolve(cs.margin[(int)css::Edge::Right], frameW_);
+      const float mt = resolve(cs.margin[(int)css::Edge::Top], frameW_);
+      const float mb = resolve(cs.margin[(int)css::Edge::Bottom], frameW_);
+      const bool left = cs.left.isSet() && cs.left.unit != css::Unit::Auto;
+      const bool right = cs.right.isSet() && cs.right.unit != css::Unit::Auto;
+      const bool top = cs.top.isSet() && cs.top.unit != css::Unit::Auto;
+      const bool bottom = cs.bottom.isSet() && cs.bottom.unit != css::Unit::Auto;
+      if (left || !right)
+         set_px(el, "left", x - frameX_ - ml);
+      if (right)
+         set_px(el, "right", frameX_ + frameW_ - (x + boxW_) - mr);
+      if (top || !bottom)
+         set_px(el, "top", y - frameY_ - mt);
+      if (bottom)
+         set_px(el, "bottom", frameY_ + frameH_ - (y + boxH_) - mb);
+   }
+   else if (cs.position == css::Position::Relative) {
+      if (cs.left.unit == css::Unit::Px || cs.left.unit == css::Unit::Percent || !cs.right.isSet())
+         set_px(el, "left", resolve(cs.left, frameW_) + dx);
+      else
+         set_px(el, "right", resolve(cs.right, frameW_) - dx);
+      if (cs.top.unit == css::Unit::Px || cs.top.unit == css::Unit::Percent || !cs.bottom.isSet())
+         set_px(el, "top", resolve(cs.top, frameH_) + dy);
+      else
+         set_px(el, "bottom", resolve(cs.bottom, frameH_) - dy);
+   }
+   else {
+      // Static boxes ignore insets, so any declared ones start at 0
+      el->setStyleProperty("position", "relative");
+      set_px(el, "left", dx);
+      set_px(el, "top", dy);
    }
 }
 
-dom::Element* InputManager::hitTest(int x, int y)
+bool InputManager::endDrag()
 {
-   auto doc = doc_;
-   if (!doc)
-      return nullptr;
-   // breadth-first collection of all elements
-   std::vector<dom::Element*> els;
-   for (auto& c : doc->childNodes)
-      if (c && c->nodeType == dom::NodeType::ELEMENT)
-         collectElementsWith((dom::Element*)c.get(), els);
-   // iterate in insertion order; later elements are on top
-   for (auto it = els.rbegin(); it != els.rend(); ++it) {
-      dom::Element* el = *it;
-      const std::string& cssText = el->styleCssText;
-      auto decls = css::parse_inline(cssText);
-      auto get_px = [&](const char* prop, int defv) {
-         auto it = decls.kv.find(prop);
-         if (it == decls.kv.end())
-            return defv;
-         float v = -1.f;
-         std::string unit;
-         if (css::parse_number_unit(it->second, v, unit) && v >= 0 && (unit.empty() || unit == "px")) {
-            return (int)std::lround(v);
-         }
-         return defv;
-      };
-      int left = get_px("left", 0);
-      int top = get_px("top", 0);
-      int w = get_px("width", 64);
-      int h = get_px("height", 64);
-      if (x >= left && x <= left + w && y >= top && y <= top + h)
-         return el;
+   if (!dragged_)
+      return false;
+   const bool moved = moving_;
+   if (moving_) {
+      commitDrag();
+      set_drag_offset(dragged_.get(), false, 0, 0);
    }
-   return nullptr;
+   dragged_.reset();
+   moving_ = false;
+   return moved;
 }
 
 void InputManager::feed(const InputEvent& ev)
@@ -32,9 +32,39 @@ class InputManager {
 
    void feed(const InputEvent& ev); // platform layer calls this
    dom::Element* hitTest(int x, int y);
+   // Wheel/trackpad scroll by (dx, dy) CSS px at (x, y); true when some container moved (layout is then dirty)
+   bool scroll(int x, int y, float dx, float dy);
+   // Native drag of the <canvas> under (x, y) CSS px. beginDrag grabs it (true when there is one); it starts moving
+   // once the pointer travels kDragThreshold px, so a click promotes and re-rasters nothing. While it moves only its
+   // compositor layer is offset, kept inside its containing block and the viewport: no style writes, relayout or
+   // re-raster. endDrag writes the final position to style once (see commitDrag). dragTo and endDrag return true
+   // when the layer moved (a composite is then pending).
+   bool beginDrag(int x, int y);
+   bool dragTo(int x, int y, int viewportW, int viewportH);
+   bool endDrag();
+   // The <canvas> a press at (x, y) would drag (the one hit, or the nearest one around the hit element), and the
+   // one being dragged. The platform layer hands these to JS as the event target, so listeners and the native
+   // move always agree on the element.
+   dom::Element* canvasAt(int x, int y);
+   dom::Element* dragTarget() const
+   {
+      return dragged_.get();
+   }
 
  private:
    std::shared_ptr<dom::Document> doc_;
+   static constexpr int kDragThreshold = 4; // CSS px the pointer travels before a press becomes a drag
+
+   bool startMoving();
+   void commitDrag();
+
+   std::shared_ptr<dom::Element> dragged_; // kept alive while grabbed
+   bool moving_ = false;                   // past the threshold: its layer follows the pointer
+   int pressX_ = 0, pressY_ = 0;           // where it was grabbed
+   // Its laid-out box and containing block when it started moving (layout_containing_block), CSS px
+   float boxX_ = 0, boxY_ = 0, boxW_ = 0, boxH_ = 0;
+   float frameX_ = 0, frameY_ = 0, frameW_ = 0, frameH_ = 0;
+   float cbX_ = 0, cbY_ = 0, cbW_ = 0, cbH_ = 0;
 };
 
 } // namespace input
@@ -1,6 +1,7 @@
 #include "../renderer/viewport.h"
 #import "InputImageView.h"
 #include "input.h"
+#include "renderer/layout_yoga.h"
 #include "renderer/renderer.h"
 #include "wapis/dom.hpp"
 #include "wapis/dom_adapter.h"
@@ -30,7 +31,9 @@ extern int g_winH;
 
 @implementation InputImageView
 
-- (void)dispatchMouseEventType:(const char*)type x:(int)x y:(int)y
+// target is the element the native side resolved (InputManager::dragTarget / canvasAt); JS dispatches to it instead
+// of hit testing again, so listeners and the native drag never pick different elements
+- (void)dispatchMouseEventType:(const char*)type x:(int)x y:(int)y target:(dom::Element*)target
 {
    InputEvent ev{type, x, y};
    // Forward to per-context input manager if available (no globals)
@@ -50,6 +53,7 @@ extern int g_winH;
       JS_SetPropertyStr(g_deferred_ctx, obj, "type", JS_NewString(g_deferred_ctx, type));
       JS_SetPropertyStr(g_deferred_ctx, obj, "clientX", JS_NewInt32(g_deferred_ctx, x));
       JS_SetPropertyStr(g_deferred_ctx, obj, "clientY", JS_NewInt32(g_deferred_ctx, y));
+      JS_SetPropertyStr(g_deferred_ctx, obj, "target", dom_wrap_node(g_deferred_ctx, target));
       JSValue args[1] = {obj};
       JSValue r = JS_Call(g_deferred_ctx, fn, global, 1, args);
       if (JS_IsException(r)) {
@@ -68,22 +72,59 @@ extern int g_winH;
    return NSMakePoint(p.x, g_winH - p.y);
 }
 
+- (input::InputManager*)inputManager
+{
+   return g_deferred_ctx ? reinterpret_cast<input::InputManager*>(dom_get_host_state(g_deferred_ctx)) : nullptr;
+}
+
 - (void)mouseDown:(NSEvent*)event
 {
    NSPoint tp = [self translatePoint:event];
-   [self dispatchMouseEventType:"mousedown" x:(int)tp.x y:(int)tp.y];
+   auto* im = [self inputManager];
+   if (im)
+      im->beginDrag((int)tp.x, (int)tp.y);
+   [self dispatchMouseEventType:"mousedown" x:(int)tp.x y:(int)tp.y target:im ? im->dragTarget() : nullptr];
 }
 
 - (void)mouseDragged:(NSEvent*)event
 {
    NSPoint tp = [self translatePoint:event];
-   [self dispatchMouseEventType:"mousemove" x:(int)tp.x y:(int)tp.y];
+   // Dragging moves the element's compositor layer natively: only paint is dirty, so this is one composite
+   auto* im = [self inputManager];
+   if (im && im->dragTo((int)tp.x, (int)tp.y, g_winW, g_winH))
+      layout_maybe_run(g_deferred_ctx);
+   dom::Element* target = im ? im->dragTarget() : nullptr;
+   if (im && !target)
+      target = im->canvasAt((int)tp.x, (int)tp.y);
+   [self dispatchMouseEventType:"mousemove" x:(int)tp.x y:(int)tp.y target:target];
 }
 
 - (void)mouseUp:(NSEvent*)event
 {
    NSPoint tp = [self translatePoint:event];
-   [self dispatchMouseEventType:"mouseup" x:(int)tp.x y:(int)tp.y];
+   auto* im = [self inputManager];
+   // The released element is the one that was dragged; hold it across endDrag, which lets go of it
+   std::shared_ptr<dom::Node> released;
+   if (im && im->dragTarget())
+      released = im->dragTarget()->shared_from_this();
+   if (im && im->endDrag())
+      layout_maybe_run(g_deferred_ctx); // lays out the committed left/top
+   [self dispatchMouseEventType:"mouseup"
+                              x:(int)tp.x
+                              y:(int)tp.y
+                         target:static_cast<dom::Element*>(released.get())];
+}
+
+- (void)scrollWheel:(NSEvent*)event
+{
+   auto* im = [self inputManager];
+   if (!im)
+      return;
+   // Trackpads report precise pixel deltas; wheel notches are in lines
+   float unit = [event hasPreciseScrollingDeltas] ? 1.f : 16.f;
+   NSPoint tp = [self translatePoint:event];
+   if (im->scroll((int)tp.x, (int)tp.y, -(float)[event scrollingDeltaX] * unit, -(float)[event scrollingDeltaY] * unit))
+      layout_maybe_run(g_deferred_ctx); // composites once the new offset is laid out
 }
 
 @end
@@ -12,7 +12,8 @@
 #include <unistd.h>
 // Pretty HTML formatting
 #include "input/input.h"
-#include "renderer/css_parser.h"
+#include "renderer/compositor.h"
+#include "renderer/element_data.h"
 #include "renderer/layout_yoga.h"
 #include "renderer/renderer.h"
 #include "renderer/scheduler.h"
@@ -32,6 +33,8 @@
 #include "include/gpu/ganesh/mtl/GrMtlBackendSurface.h"
 #include <include/core/SkCanvas.h>
 #include <include/core/SkImage.h>
+#include <include/core/SkPixmap.h>
+#include <include/core/SkRegion.h>
 #include <include/core/SkSamplingOptions.h>
 #include <include/core/SkSurface.h>
 #include <include/core/SkColorSpace.h>
@@ -242,6 +245,9 @@ static void gpu_shutdown()
 
 // Forward declare CPU composite for GPU wrapper usage
 static void composite_into_surface(sk_sp<SkSurface> surface, int W, int H);
+// Device-px region composited into the raster window surface and not yet presented
+static SkRegion g_presentDamage;
+static NSBitmapImageRep* g_presentRep = nil;
 
 static void gpu_composite_and_present(int W, int H)
 {
@@ -357,99 +363,34 @@ static void composite_into_surface(sk_sp<SkSurface> surface, int W, int H)
       if (deviceScale <= 0.f) deviceScale = 1.0f;
    }
    SkCanvas* canvas = surface->getCanvas();
-   canvas->clear(SkColorSetARGB(255, 0x20, 0x20, 0x20));
-   extern bool gfx_get_size(GfxStateHandle * gs, int id, int* w, int* h);
+   const SkColor background = SkColorSetARGB(255, 0x20, 0x20, 0x20);
    extern sk_sp<SkImage> gfx_snapshot(GfxStateHandle * gs, int id);
    extern int dom_element_canvas_id(DomAdapterState*, dom::Element * el, bool createIfMissing);
    Renderer* renderer = renderer_from_ctx(g_deferred_ctx);
-   if (!renderer)
+   if (!renderer) {
+      canvas->clear(background);
       return;
-   renderer->forEachLayer([&](RenderLayer* rl) {
-      if (!rl || !rl->element)
-         return;
-      int id = st_for_canvas ? dom_element_canvas_id(st_for_canvas, rl->element, false) : 0;
-      int x = 0, y = 0, w = 0, h = 0;
-      if (!layout_get_box(rl->element, x, y, w, h)) {
-         // Fallback for elements without layout box: use lexbor tokenizer helpers
-         const std::string& st_fallback = rl->element->styleCssText;
-         auto decls = css::parse_inline(st_fallback);
-         auto get_px = [&](const char* prop, int defv) {
-            auto it = decls.kv.find(prop);
-            if (it == decls.kv.end())
-               return defv;
-            float v = -1.f;
-            std::string unit;
-            if (css::parse_number_unit(it->second, v, unit) && v >= 0 && (unit.empty() || unit == "px"))
-               return (int)std::lround(v);
-            return defv;
-         };
-         int fx = get_px("left", -1);
-         int fy = get_px("top", -1);
-         int fw = get_px("width", -1);
-         int fh = get_px("height", -1);
-         if (fx >= 0) x = fx;
-         if (fy >= 0) y = fy;
-         if (fw > 0) w = fw;
-         if (fh > 0) h = fh;
-         if (w <= 0) w = 50;
-         if (h <= 0) h = 50;
-      }
-      // Override with absolute positioning if explicitly styled.
-      const std::string& style_override = rl->element->styleCssText;
-      {
-         auto decls2 = css::parse_inline(style_override);
-         auto get_px2 = [&](const char* prop, int defv) {
-            auto it = decls2.kv.find(prop);
-            if (it == decls2.kv.end())
-               return defv;
-            float v = -1.f;
-            std::string unit;
-            if (css::parse_number_unit(it->second, v, unit) && v >= 0 && (unit.empty() || unit == "px"))
-               return (int)std::lround(v);
-            return defv;
-         };
-         int lx = get_px2("left", -1);
-         int ty = get_px2("top", -1);
-         if (lx >= 0) x = lx;
-         if (ty >= 0) y = ty;
-      }
-      // Draw background color if present even without canvas surface
-      const std::string& st = rl->element->styleCssText;
-      SkColor bg = 0;
-      auto d3 = css::parse_inline(st);
-      auto itBg = d3.kv.find("background-color");
-      if (itBg == d3.kv.end()) itBg = d3.kv.find("background");
-      if (itBg != d3.kv.end()) {
-         int rr = 0, gg = 0, bb = 0;
-         if (css::parse_rgb_color(itBg->second, rr, gg, bb)) {
-            bg = SkColorSetARGB(255, (uint8_t)rr, (uint8_t)gg, (uint8_t)bb);
-         }
-      }
-      if (bg) {
-         SkPaint p;
-         p.setStyle(SkPaint::kFill_Style);
-         p.setColor(bg);
-         canvas->drawRect(SkRect::MakeXYWH((SkScalar)(x * deviceScale), (SkScalar)(y * deviceScale),
-                                           (SkScalar)(w * deviceScale), (SkScalar)(h * deviceScale)),
-                          p);
-      }
-      if (id) {
-         auto img = gfx_snapshot(gs, id);
-         if (img) {
-            // Draw snapshot at device pixel position; image size already matches device pixels of the canvas.
-            canvas->drawImage(img.get(), (SkScalar)(x * deviceScale), (SkScalar)(y * deviceScale));
-            if (getenv("DEBUG_DRAW_BORDER")) {
-               SkPaint border;
-               border.setStyle(SkPaint::kStroke_Style);
-               border.setColor(SK_ColorWHITE);
-               border.setStrokeWidth(1);
-               canvas->drawRect(SkRect::MakeXYWH((SkScalar)(x * deviceScale), (SkScalar)(y * deviceScale),
-                                                 (SkScalar)(w * deviceScale), (SkScalar)(h * deviceScale)),
-                                border);
-            }
-         }
-      }
+   }
+   SkRegion damage = collect_damage(*renderer, deviceScale, [&](dom::Element* el) -> sk_sp<SkImage> {
+      int id = st_for_canvas ? dom_element_canvas_id(st_for_canvas, el, false) : 0;
+      return id ? gfx_snapshot(gs, id) : nullptr;
    });
+   // A surface keeps its pixels between composites, so only the damaged region is cleared and repainted. A new
+   // surface (first frame, resize, each GPU drawable) is painted whole.
+   static uint32_t lastSurfaceId = 0;
+   const SkIRect full = SkIRect::MakeWH(surface->width(), surface->height());
+   if (surface->uniqueID() != lastSurfaceId)
+      damage.setRect(full);
+   lastSurfaceId = surface->uniqueID();
+   damage.op(full, SkRegion::kIntersect_Op);
+   if (damage.isEmpty())
+      return;
+   canvas->save();
+   canvas->clipRegion(damage);
+   canvas->clear(background);
+   composite_layers(canvas, *renderer, &damage);
+   canvas->restore();
+   g_presentDamage.op(damage, SkRegion::kUnion_Op);
 }
 
 static void present_surface(NSImageView* iv, sk_sp<SkSurface> surface, int W, int H)
@@ -460,22 +401,50 @@ static void present_surface(NSImageView* iv, sk_sp<SkSurface> surface, int W, in
    SkPixmap pixmap;
    if (!surface->peekPixels(&pixmap))
       return;
-   CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
-   CGBitmapInfo bitmapInfo = (CGBitmapInfo)kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big;
-   CGDataProviderRef provider =
-       CGDataProviderCreateWithData(NULL, pixmap.addr(), pixmap.rowBytes() * pixmap.height(), NULL);
-   CGImageRef cgImage = CGImageCreate(pixmap.width(), pixmap.height(), 8, 32, pixmap.rowBytes(), colorSpace, bitmapInfo,
-                                      provider, NULL, false, kCGRenderingIntentDefault);
-   if (cgImage) {
-   NSImage* img = [[NSImage alloc] initWithCGImage:cgImage size:NSMakeSize(W, H)];
-   [iv setImage:img];
+   // The view shows one persistent bitmap; only rows of the rectangles damaged since the last present are copied
+   // into it and redisplayed. A new bitmap (first present, resize) is filled whole.
+   SkRegion damage;
+   damage.swap(g_presentDamage);
+   const bool fresh = !g_presentRep || g_presentRep.pixelsWide != pixmap.width() ||
+                      g_presentRep.pixelsHigh != pixmap.height();
+   if (fresh) {
 #if !__has_feature(objc_arc)
-   [img release];
+      [g_presentRep release];
+#endif
+      g_presentRep = [[NSBitmapImageRep alloc] initWithBitmapDataPlanes:NULL
+                                                             pixelsWide:pixmap.width()
+                                                             pixelsHigh:pixmap.height()
+                                                          bitsPerSample:8
+                                                        samplesPerPixel:4
+                                                               hasAlpha:YES
+                                                               isPlanar:NO
+                                                         colorSpaceName:NSDeviceRGBColorSpace
+                                                            bytesPerRow:0
+                                                           bitsPerPixel:32];
+      damage.setRect(SkIRect::MakeWH(pixmap.width(), pixmap.height()));
+   }
+   if (damage.isEmpty() || !g_presentRep)
+      return;
+   unsigned char* dst = [g_presentRep bitmapData];
+   const size_t dstRowBytes = (size_t)[g_presentRep bytesPerRow];
+   const double toViewX = (double)W / pixmap.width(), toViewY = (double)H / pixmap.height();
+   for (SkRegion::Iterator it(damage); !it.done(); it.next()) {
+      const SkIRect& r = it.rect();
+      for (int y = r.fTop; y < r.fBottom; ++y)
+         memcpy(dst + y * dstRowBytes + r.fLeft * 4, pixmap.addr(r.fLeft, y), (size_t)r.width() * 4);
+      if (!fresh) // view coordinates are bottom-up
+         [iv setNeedsDisplayInRect:NSMakeRect(r.fLeft * toViewX, (pixmap.height() - r.fBottom) * toViewY,
+                                              r.width() * toViewX, r.height() * toViewY)];
+   }
+   if (fresh) {
+      NSImage* img = [[NSImage alloc] initWithSize:NSMakeSize(W, H)];
+      [img addRepresentation:g_presentRep];
+      [img setCacheMode:NSImageCacheNever]; // draws read the bitmap as updated in place
+      [iv setImage:img];
+#if !__has_feature(objc_arc)
+      [img release];
 #endif
-   CGImageRelease(cgImage);
    }
-   CGDataProviderRelease(provider);
-   CGColorSpaceRelease(colorSpace);
 }
 
 static JSValue js_requestComposite(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv)
@@ -514,6 +483,61 @@ void native_request_composite(JSContext* ctx)
    }
 }
 
+// Frame clock for transitions and animations: while any is running, layout_maybe_run asks for the next frame here.
+// Coalesced to one pending frame; each one ticks animations, lays out if needed and composites, without entering JS.
+void native_request_animation_frame(JSContext* ctx)
+{
+   (void)ctx;
+   static bool pending = false;
+   if (pending)
+      return;
+   pending = true;
+   dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(NSEC_PER_SEC / 60)), dispatch_get_main_queue(), ^{
+      pending = false;
+      if (g_deferred_ctx)
+         layout_maybe_run(g_deferred_ctx);
+   });
+}
+
+void viewport_resize(int w, int h, float scale)
+{
+   if (w <= 0 || h <= 0)
+      return;
+   if (scale <= 0.f)
+      scale = 1.f;
+   const bool scaleChanged = g_deferred_ctx && dom_get_display_scale(g_deferred_ctx) != scale;
+   if (w == g_winW && h == g_winH && !scaleChanged)
+      return;
+   g_winW = w;
+   g_winH = h;
+   if (scaleChanged)
+      dom_set_display_scale(g_deferred_ctx, scale); // canvases reallocate on their next draw or snapshot
+#ifdef __APPLE__
+   if (g_use_gpu && g_metalLayer) {
+      g_metalLayer.contentsScale = scale;
+      g_metalLayer.drawableSize = CGSizeMake(w * scale, h * scale);
+   }
+#endif
+   if (!g_use_gpu && g_windowSurface) {
+      SkImageInfo info = SkImageInfo::Make((int)llround(w * scale), (int)llround(h * scale), kN32_SkColorType,
+                                           kPremul_SkAlphaType);
+      if (auto surface = SkSurfaces::Raster(info))
+         g_windowSurface = std::move(surface);
+   }
+   if (g_deferred_ctx) {
+      // Keep the JS-side viewport (mouse dispatch bounds) in step
+      JSValue global = JS_GetGlobalObject(g_deferred_ctx);
+      JSValue vp = JS_GetPropertyStr(g_deferred_ctx, global, "__viewport");
+      if (JS_IsObject(vp)) {
+         JS_SetPropertyStr(g_deferred_ctx, vp, "w", JS_NewInt32(g_deferred_ctx, w));
+         JS_SetPropertyStr(g_deferred_ctx, vp, "h", JS_NewInt32(g_deferred_ctx, h));
+      }
+      JS_FreeValue(g_deferred_ctx, vp);
+      JS_FreeValue(g_deferred_ctx, global);
+   }
+   layout_mark_dirty();
+}
+
 // Minimal native->JS mouse event bridge: calls global onNativeMouseEvent(evt)
 @implementation CanvasImageView
 @end
@@ -950,7 +974,8 @@ int main(int argc, char** argv)
       id appDel = [NSObject new];
       NSRect frame = NSMakeRect(0, 0, g_winW, g_winH);
       NSWindow* window = [[NSWindow alloc] initWithContentRect:frame
-                                                     styleMask:(NSWindowStyleMaskTitled | NSWindowStyleMaskClosable)
+                                                     styleMask:(NSWindowStyleMaskTitled | NSWindowStyleMaskClosable |
+                                                                NSWindowStyleMaskResizable)
                                                        backing:NSBackingStoreBuffered
                                                          defer:NO];
       [window setTitle:@"Renderer Layers"];
@@ -1051,6 +1076,22 @@ int main(int argc, char** argv)
             [window setContentView:g_canvasImageView];
          }
       }
+      // Live resize and display changes: one incremental layout and one composite per notification
+      [[window contentView] setAutoresizingMask:(NSViewWidthSizable | NSViewHeightSizable)];
+      void (^onViewportChange)(NSNotification*) = ^(NSNotification*) {
+         NSSize sz = [[window contentView] bounds].size;
+         CGFloat s = [window backingScaleFactor];
+         viewport_resize((int)sz.width, (int)sz.height, s > 0 ? (float)s : 1.f);
+         if (g_deferred_ctx)
+            layout_maybe_run(g_deferred_ctx);
+      };
+      for (NSNotificationName name in @[ NSWindowDidResizeNotification,
+                                          NSWindowDidChangeBackingPropertiesNotification ]) {
+         [[NSNotificationCenter defaultCenter] addObserverForName:name
+                                                           object:window
+                                                            queue:nil
+                                                       usingBlock:onViewportChange];
+      }
       // Expose requestComposite() to JS for drag updates
       if (g_deferred_ctx) {
          JSValue global = JS_GetGlobalObject(g_deferred_ctx);
@@ -1065,35 +1106,12 @@ int main(int argc, char** argv)
              "  globalThis.__dispatchNativeMouseInstalled=true;\n"
              "  globalThis.__dispatchNativeMouse=function(ev){\n"
              "    if(!ev||!ev.type)return; const t=ev.type; const x=ev.clientX|0; const y=ev.clientY|0;\n"
-             "    var target=null; var captured=globalThis.__dragTarget||null;\n"
-             "    var nodes=document.getElementsByTagName?Array.from(document.getElementsByTagName('canvas')):[];\n"
-             "    if(captured){ target=captured; } else {\n"
-             "      for(var i=nodes.length-1;i>=0;i--){\n"
-             "        var n=nodes[i]; var st=n.getAttribute? (n.getAttribute('style')||''):'';\n"
-             "        var mW=st.match(/width:(\\d+)/); var mH=st.match(/height:(\\d+)/);\n"
-             "        var mL=st.match(/left:(\\d+)/); var mT=st.match(/top:(\\d+)/);\n"
-             "        var w=mW?+mW[1]:64; var h=mH?+mH[1]:64; var lx=mL?+mL[1]:0; var ty=mT?+mT[1]:0;\n"
-             "        if(x>=lx&&x<=lx+w&&y>=ty&&y<=ty+h){ target=n; break; }\n"
-             "      }\n"
-             "    }\n"
+             "    // ev.target is the native hit test (InputManager::dragTarget/canvasAt), the same element it drags\n"
+             "    var target=globalThis.__dragTarget||ev.target||null;\n"
              "    if(!target && t!=='mousemove' && t!=='mouseup') return;\n"
-             "    if(t==='mousedown' && target){\n"
-             "      var st=target.getAttribute('style')||'';\n"
-             "      var mL=/left:(\\d+)/.exec(st); var mT=/top:(\\d+)/.exec(st);\n"
-             "      target.__draggingOffset=[x-(mL?+mL[1]:0), y-(mT?+mT[1]:0)];\n"
-             "      globalThis.__dragTarget=target; globalThis.__dragActive=true;\n"
-             "    }\n"
-             "    if(t==='mousemove' && globalThis.__dragTarget){\n"
-             "      var target=globalThis.__dragTarget; var off=target.__draggingOffset; var st=target.getAttribute('style')||'';\n"
-             "      var mW=st.match(/width:(\\d+)/); var mH=st.match(/height:(\\d+)/);"
-             " var w=mW?+mW[1]:64; var h=mH?+mH[1]:64;\n"
-             "      var nx=Math.max(0,Math.min(globalThis.__viewport.w-w,x-off[0]));\n"
-             "      var ny=Math.max(0,Math.min(globalThis.__viewport.h-h,y-off[1]));\n"
-             "      target.setAttribute('style', st.replace(/left:\\d+/, 'left:'+nx)"
-             ".replace(/top:\\d+/, 'top:'+ny));\n"
-             "      if(typeof requestComposite==='function') requestComposite();\n"
-             "    }\n"
-             "    if(t==='mouseup'){ if(globalThis.__dragTarget){ delete globalThis.__dragTarget.__draggingOffset; } globalThis.__dragTarget=null; globalThis.__dragActive=false; }\n"
+             "    // The move itself is native (InputManager::dragTo); listeners keep receiving the captured target\n"
+             "    if(t==='mousedown' && target){ globalThis.__dragTarget=target; globalThis.__dragActive=true; }\n"
+             "    if(t==='mouseup'){ globalThis.__dragTarget=null; globalThis.__dragActive=false; }\n"
              "    var dispatchEl = globalThis.__dragTarget || target;\n"
              "    var arr = dispatchEl? dispatchEl['__listeners_'+t] : null;\n"
              "    if (Array.isArray(arr)) { for (var i=0;i<arr.length;i++){ try { arr[i].call(dispatchEl, ev); } catch(e) "
@@ -0,0 +1,674 @@
+#include "animation.h"
+#include "renderer/element_data.h"
+#include "renderer/layout_yoga.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+using css::Prop;
+
+constexpr uint64_t bit(Prop p)
+{
+   return uint64_t(1) << (unsigned)p;
+}
+
+// What transitions and keyframes can interpolate; anything else in a keyframe is ignored
+constexpr Prop kAnimatable[] = {Prop::Opacity, Prop::BackgroundColor, Prop::Transform, Prop::Left, Prop::Top};
+constexpr uint64_t kAnimatableMask =
+    bit(Prop::Opacity) | bit(Prop::BackgroundColor) | bit(Prop::Transform) | bit(Prop::Left) | bit(Prop::Top);
+constexpr uint64_t kLayoutProps = bit(Prop::Left) | bit(Prop::Top);
+
+// One property's value in whichever field its type uses
+struct Value {
+   float number = 1.f; // opacity
+   SkColor4f color = {0, 0, 0, 0};
+   css::Transform transform;
+   css::Length length;
+   bool set = false; // declared; an undeclared value is the property's initial one
+};
+
+Value read(Prop p, const css::ComputedStyle& s)
+{
+   Value v;
+   v.set = s.has(p);
+   switch (p) {
+   case Prop::Opacity:
+      v.number = s.opacity;
+      break;
+   case Prop::BackgroundColor:
+      if (v.set)
+         v.color = s.backgroundColor;
+      break;
+   case Prop::Transform:
+      v.transform = s.transform;
+      break;
+   case Prop::Left:
+      v.length = s.left;
+      break;
+   case Prop::Top:
+      v.length = s.top;
+      break;
+   default:
+      break;
+   }
+   return v;
+}
+
+void write(Prop p, const Value& v, css::ComputedStyle& s)
+{
+   switch (p) {
+   case Prop::Opacity:
+      s.opacity = v.number;
+      break;
+   case Prop::BackgroundColor:
+      s.backgroundColor = v.color;
+      break;
+   case Prop::Transform:
+      s.transform = v.transform;
+      break;
+   case Prop::Left:
+      s.left = v.length;
+      break;
+   case Prop::Top:
+      s.top = v.length;
+      break;
+   default:
+      return;
+   }
+   if (v.set)
+      s.mark(p);
+   else
+      s.setMask &= ~bit(p);
+}
+
+bool same(Prop p, const Value& a, const Value& b)
+{
+   switch (p) {
+   case Prop::Opacity:
+      return a.number == b.number;
+   case Prop::BackgroundColor:
+      return a.color == b.color;
+   case Prop::Transform:
+      return a.transform == b.transform;
+   default:
+      return a.length.unit == b.length.unit && a.length.value == b.length.value;
+   }
+}
+
+// Insets only interpolate between two lengths of the same unit; auto and unset flip at the midpoint
+bool interpolable(Prop p, const Value& a, const Value& b)
+{
+   if (p != Prop::Left && p != Prop::Top)
+      return true;
+   return a.length.unit == b.length.unit && (a.length.unit == css::Unit::Px || a.length.unit == css::Unit::Percent);
+}
+
+float lerp(float a, float b, float t)
+{
+   return a + (b - a) * t;
+}
+
+Value interpolate(Prop p, const Value& a, const Value& b, float t)
+{
+   if (!interpolable(p, a, b))
+      return t < 0.5f ? a : b;
+   Value v = b;
+   v.set = a.set || b.set;
+   switch (p) {
+   case Prop::Opacity:
+      v.number = std::clamp(lerp(a.number, b.number, t), 0.f, 1.f);
+      break;
+   case Prop::BackgroundColor: {
+      // Premultiplied, so fading from transparent does not pass through black
+      float alpha = std::clamp(lerp(a.color.fA, b.color.fA, t), 0.f, 1.f);
+      v.color.fA = alpha;
+      float* out[3] = {&v.color.fR, &v.color.fG, &v.color.fB};
+      const float ca[3] = {a.color.fR, a.color.fG, a.color.fB}, cb[3] = {b.color.fR, b.color.fG, b.color.fB};
+      for (int i = 0; i < 3; ++i)
+         *out[i] = alpha > 0.f ? std::clamp(lerp(ca[i] * a.color.fA, cb[i] * b.color.fA, t) / alpha, 0.f, 1.f) : 0.f;
+      break;
+   }
+   case Prop::Transform:
+      v.transform.translateX = lerp(a.transform.translateX, b.transform.translateX, t);
+      v.transform.translateY = lerp(a.transform.translateY, b.transform.translateY, t);
+      v.transform.rotate = lerp(a.transform.rotate, b.transform.rotate, t);
+      v.transform.scaleX = lerp(a.transform.scaleX, b.transform.scaleX, t);
+      v.transform.scaleY = lerp(a.transform.scaleY, b.transform.scaleY, t);
+      break;
+   default:
+      v.length.value = lerp(a.length.value, b.length.value, t);
+      break;
+   }
+   return v;
+}
+
+float cubic(float p1, float p2, float u)
+{
+   // Bezier through (0, p1, p2, 1)
+   float v = 1.f - u;
+   return 3.f * v * v * u * p1 + 3.f * v * u * u * p2 + u * u * u;
+}
+
+float ease(const css::Easing& e, float t)
+{
+   switch (e.kind) {
+   case css::Easing::Kind::Linear:
+      return t;
+   case css::Easing::Kind::Steps: {
+      float n = (float)e.steps;
+      float step = std::floor(t * n) + (e.jumpStart ? 1.f : 0.f);
+      return std::clamp(step, 0.f, n) / n;
+   }
+   case css::Easing::Kind::CubicBezier:
+      break;
+   }
+   // Solve x(u) = t: Newton from u = t, bisection when the slope is too flat
+   float u = t;
+   for (int i = 0; i < 8; ++i) {
+      float x = cubic(e.x1, e.x2, u) - t;
+      if (std::fabs(x) < 1e-5f)
+         return cubic(e.y1, e.y2, u);
+      float v = 1.f - u;
+      float dx = 3.f * v * v * e.x1 + 6.f * v * u * (e.x2 - e.x1) + 3.f * u * u * (1.f - e.x2);
+      if (std::fabs(dx) < 1e-6f)
+         break;
+      u -= x / dx;
+   }
+   float lo = 0.f, hi = 1.f;
+   u = t;
+   for (int i = 0; i < 32 && hi - lo > 1e-5f; ++i) {
+      if (cubic(e.x1, e.x2, u) < t)
+         lo = u;
+      else
+         hi = u;
+      u = (lo + hi) * 0.5f;
+   }
+   return cubic(e.y1, e.y2, u);
+}
+
+// Directed progress through the current iteration at `local` ms after the start. `done` is set once the active
+// interval is over; returns false when the animation has no effect then (before its delay or after its end without
+// the matching fill).
+bool iteration_progress(const css::AnimationTiming& tm, double local, float& progress, bool& done)
+{
+   const double duration = std::max(tm.duration, 0.f);
+   const double iterations = std::max(tm.iterations, 0.f);
+   const double activeDuration = duration > 0.0 && iterations > 0.0 ? duration * iterations : 0.0;
+   const double active = local - tm.delay;
+   done = active >= activeDuration;
+   double iteration, p;
+   if (active < 0.0) {
+      if (tm.fill != css::FillMode::Backwards && tm.fill != css::FillMode::Both)
+         return false;
+      iteration = 0.0;
+      p = 0.0;
+   }
+   else if (done) {
+      if (tm.fill != css::FillMode::Forwards && tm.fill != css::FillMode::Both)
+         return false;
+      // End of the last (possibly partial) iteration
+      double whole = std::floor(iterations);
+      iteration = whole == iterations && iterations > 0.0 ? iterations - 1.0 : whole;
+      p = whole == iterations ? (iterations > 0.0 ? 1.0 : 0.0) : iterations - whole;
+   }
+   else {
+      double r = active / duration;
+      iteration = std::floor(r);
+      p = r - iteration;
+   }
+   const bool odd = std::fmod(iteration, 2.0) >= 1.0;
+   bool reverse = false;
+   switch (tm.direction) {
+   case css::PlaybackDirection::Normal:
+      break;
+   case css::PlaybackDirection::Reverse:
+      reverse = true;
+      break;
+   case css::PlaybackDirection::Alternate:
+      reverse = odd;
+      break;
+   case css::PlaybackDirection::AlternateReverse:
+      reverse = !odd;
+      break;
+   }
+   progress = (float)(reverse ? 1.0 - p : p);
+   return true;
+}
+
+enum class Kind : uint8_t { Transition, Css, Script }; // also the composite order: later kinds win
+
+struct Animation {
+   uint64_t id = 0;
+   Kind kind = Kind::Transition;
+   css::AnimationTiming timing;
+   double startTime = -1.0; // frame clock ms; < 0 until the first tick after it was created
+   bool finished = false;   // active interval over; kept while it fills forwards (CSS animations: until renamed)
+   // Transition
+   Prop prop = Prop::Count;
+   Value from, to;
+   // CSS and script animations
+   std::shared_ptr<const css::KeyframesRule> keyframes;
+   uint64_t props = 0; // animatable properties some keyframe sets
+   std::string name;   // CSS: the `animation` entry it plays
+};
+
+struct ElementAnimations {
+   std::shared_ptr<const css::ComputedStyle> base; // cascade result; nullptr = initial style
+   std::shared_ptr<css::ComputedStyle> animated;   // base with the animated values; rd->style while this exists
+   std::vector<Animation> list;                    // composite order (Kind), then start order
+   uint64_t written = 0;          // properties the last update wrote
+   uint64_t keyframeWritten = 0;  // the subset written by CSS or script animations
+   bool settled = false;          // nothing running: values are final until the style or the list changes
+};
+
+std::unordered_map<dom::Element*, ElementAnimations> g_elements;
+std::unordered_map<uint64_t, dom::Element*> g_scriptAnimations; // element.animate() ids
+uint64_t g_nextId = 1;
+double g_now = 0.0;       // time of the last tick
+bool g_running = false;   // some animation had not finished at the last tick (or started since)
+
+const css::ComputedStyle& base_of(const ElementAnimations& ea)
+{
+   return ea.base ? *ea.base : css::initial_style();
+}
+
+ElementAnimations& entry_for(dom::Element* el, DomElementRenderData* rd)
+{
+   ElementAnimations& ea = g_elements[el];
+   if (!rd->animated) {
+      rd->animated = true;
+      ea.base = rd->style;
+      ea.animated = std::make_shared<css::ComputedStyle>(base_of(ea));
+   }
+   return ea;
+}
+
+void insert_ordered(std::vector<Animation>& list, Animation a)
+{
+   auto at = std::find_if(list.begin(), list.end(), [&a](const Animation& b) { return b.kind > a.kind; });
+   list.insert(at, std::move(a));
+}
+
+// Value of `p` at iteration progress `t` along keyframes; missing 0%/100% frames take the base value
+Value keyframe_value(const Animation& a, Prop p, const Value& base, float t)
+{
+   Value fromV = base, toV = base;
+   float fromOffset = 0.f, toOffset = 1.f;
+   for (const css::Keyframe& f : a.keyframes->frames) {
+      if (!f.style.has(p))
+         continue;
+      if (f.offset <= t) {
+         fromV = read(p, f.style);
+         fromOffset = f.offset;
+      }
+      else {
+         toV = read(p, f.style);
+         toOffset = f.offset;
+         break;
+      }
+   }
+   if (toOffset <= fromOffset)
+      return fromV;
+   float local = (t - fromOffset) / (toOffset - fromOffset);
+   if (a.kind == Kind::Css)
+      local = ease(a.timing.easing, local); // animation-timing-function applies per keyframe interval
+   return interpolate(p, fromV, toV, local);
+}
+
+// Layer every animation's value at `now` over the base style. Finished animations that do not fill are dropped
+// (CSS ones stay, so an unchanged `animation` does not restart). Returns false when nothing is left, after
+// restoring the base style; the caller then drops the entry.
+bool update(dom::Element* el, DomElementRenderData* rd, ElementAnimations& ea, double now, bool inResolve)
+{
+   const css::ComputedStyle& base = base_of(ea);
+   css::ComputedStyle& out = *ea.animated;
+   uint64_t written = 0, keyframeWritten = 0;
+   bool running = false;
+   for (auto it = ea.list.begin(); it != ea.list.end();) {
+      Animation& a = *it;
+      float progress;
+      bool done;
+      const bool effect = iteration_progress(a.timing, a.startTime < 0.0 ? 0.0 : now - a.startTime, progress, done);
+      a.finished = done;
+      if (done && !effect && a.kind != Kind::Css) {
+         if (a.kind == Kind::Script)
+            g_scriptAnimations.erase(a.id);
+         it = ea.list.erase(it);
+         continue;
+      }
+      running = running || !done;
+      if (effect && a.kind == Kind::Transition) {
+         write(a.prop, interpolate(a.prop, a.from, a.to, ease(a.timing.easing, progress)), out);
+         written |= bit(a.prop);
+      }
+      else if (effect) {
+         if (a.kind == Kind::Script)
+            progress = ease(a.timing.easing, progress); // element.animate() eases the whole iteration
+         for (Prop p : kAnimatable) {
+            if (a.props & bit(p))
+               write(p, keyframe_value(a, p, read(p, base), progress), out);
+         }
+         keyframeWritten |= a.props;
+      }
+      ++it;
+   }
+   written |= keyframeWritten;
+   // Properties no longer animated go back to their base value
+   for (Prop p : kAnimatable) {
+      if (ea.written & ~written & bit(p))
+         write(p, read(p, base), out);
+   }
+   const css::PropGroup group = (written | ea.written) & kLayoutProps ? css::PropGroup::Layout : css::PropGroup::Paint;
+   ea.written = written;
+   ea.keyframeWritten = keyframeWritten;
+   ea.settled = !running;
+   g_running = g_running || running;
+   const bool keep = !ea.list.empty();
+   if (keep) {
+      out.serial = css::next_style_serial();
+      rd->style = ea.animated;
+   }
+   else {
+      rd->style = ea.base;
+      rd->animated = false;
+   }
+   if (!inResolve)
+      style_written(el, rd, group);
+   return keep;
+}
+
+const css::TransitionSpec* transition_for(const css::ComputedStyle& s, Prop p)
+{
+   const css::TransitionSpec* found = nullptr;
+   if (!s.transitions)
+      return nullptr;
+   for (const css::TransitionSpec& t : *s.transitions) {
+      if (t.prop == p || t.prop == Prop::Count)
+         found = &t; // the last matching entry wins
+   }
+   return found;
+}
+
+Animation* find_transition(ElementAnimations& ea, Prop p)
+{
+   for (Animation& a : ea.list) {
+      if (a.kind == Kind::Transition && a.prop == p)
+         return &a;
+   }
+   return nullptr;
+}
+
+void remove_transition(ElementAnimations& ea, Prop p)
+{
+   ea.list.erase(std::remove_if(ea.list.begin(), ea.list.end(),
+                                [p](const Animation& a) { return a.kind == Kind::Transition && a.prop == p; }),
+                 ea.list.end());
+}
+
+uint64_t animated_props(const css::KeyframesRule& kf)
+{
+   uint64_t mask = 0;
+   for (const css::Keyframe& f : kf.frames)
+      mask |= f.style.setMask;
+   return mask & kAnimatableMask;
+}
+
+// Make the CSS animations match the style's `animation` list: entries keep their animation (and start time) when the
+// name at their position is unchanged, new names start, dropped names stop
+void sync_css_animations(dom::Element* el, DomElementRenderData* rd, ElementAnimations*& ea,
+                         const css::ComputedStyle& style)
+{
+   std::vector<Animation> kept;
+   if (ea) {
+      for (Animation& a : ea->list) {
+         if (a.kind == Kind::Css)
+            kept.push_back(std::move(a));
+      }
+      ea->list.erase(std::remove_if(ea->list.begin(), ea->list.end(),
+                                    [](const Animation& a) { return a.kind == Kind::Css; }),
+                     ea->list.end());
+   }
+   if (!style.animations && kept.empty())
+      return;
+   DocumentRenderData* docData = document_render_data_for(el);
+   std::vector<Animation> next;
+   static const std::vector<css::AnimationSpec> kNone;
+   for (const css::AnimationSpec& spec : style.animations ? *style.animations : kNone) {
+      auto it = std::find_if(kept.begin(), kept.end(), [&spec](const Animation& a) { return a.name == spec.name; });
+      if (it != kept.end()) {
+         it->timing = spec.timing;
+         next.push_back(std::move(*it));
+         kept.erase(it);
+         continue;
+      }
+      auto kf = docData ? docData->rules.keyframes(spec.name) : nullptr;
+      if (!kf)
+         continue; // no such @keyframes: nothing to play
+      Animation a;
+      a.id = g_nextId++;
+      a.kind = Kind::Css;
+      a.timing = spec.timing;
+      a.props = animated_props(*kf);
+      a.keyframes = std::move(kf);
+      a.name = spec.name;
+      next.push_back(std::move(a));
+   }
+   if (next.empty())
+      return;
+   if (!ea)
+      ea = &entry_for(el, rd);
+   auto at = std::find_if(ea->list.begin(), ea->list.end(), [](const Animation& a) { return a.kind > Kind::Css; });
+   ea->list.insert(at, std::make_move_iterator(next.begin()), std::make_move_iterator(next.end()));
+}
+
+void drop_entry(dom::Element* el)
+{
+   auto it = g_elements.find(el);
+   if (it == g_elements.end())
+      return;
+   for (const Animation& a : it->second.list) {
+      if (a.kind == Kind::Script)
+         g_scriptAnimations.erase(a.id);
+   }
+   g_elements.erase(it);
+}
+
+// Re-layer after the list of one element changed outside a resolve
+void refresh(dom::Element* el)
+{
+   DomElementRenderData* rd = get_render_data(el);
+   auto it = g_elements.find(el);
+   if (!rd || it == g_elements.end())
+      return;
+   if (rd->dirtyFlags() & kDirtyStyle) {
+      paint_mark_dirty(); // the pending resolve layers the values
+      return;
+   }
+   if (!update(el, rd, it->second, g_now, false))
+      g_elements.erase(it);
+}
+
+Animation* find_script_animation(uint64_t id, dom::Element*& el)
+{
+   auto it = g_scriptAnimations.find(id);
+   if (it == g_scriptAnimations.end())
+      return nullptr;
+   el = it->second;
+   auto e = g_elements.find(el);
+   if (e == g_elements.end())
+      return nullptr;
+   for (Animation& a : e->second.list) {
+      if (a.id == id)
+         return &a;
+   }
+   return nullptr;
+}
+} // namespace
+
+double animation_clock_ms()
+{
+   using clock = std::chrono::steady_clock;
+   static const clock::time_point origin = clock::now();
+   return std::chrono::duration<double, std::milli>(clock::now() - origin).count();
+}
+
+void animations_style_resolved(dom::Element* el, DomElementRenderData* rd, const css::ComputedStyle* before)
+{
+   const css::ComputedStyle& style = rd->computed();
+   auto found = rd->animated ? g_elements.find(el) : g_elements.end();
+   ElementAnimations* ea = found != g_elements.end() ? &found->second : nullptr;
+   std::shared_ptr<const css::ComputedStyle> base = rd->style;
+   // Transitions: an animatable property changed between the previous style (animated values included) and this one
+   if (before && (ea || style.transitions)) {
+      for (Prop p : kAnimatable) {
+         if (ea && (ea->keyframeWritten & bit(p)))
+            continue; // driven by keyframes; a transition underneath would never show
+         const Value after = read(p, style);
+         Animation* running = ea ? find_transition(*ea, p) : nullptr;
+         if (running && same(p, running->to, after))
+            continue; // already heading there
+         const Value from = read(p, *before);
+         const css::TransitionSpec* spec = transition_for(style, p);
+         if (!spec || std::max(spec->duration, 0.f) + spec->delay <= 0.f || same(p, from, after) ||
+             !interpolable(p, from, after)) {
+            if (running)
+               remove_transition(*ea, p); // the property jumps to its new value
+            continue;
+         }
+         Animation t;
+         t.id = g_nextId++;
+         t.kind = Kind::Transition;
+         t.prop = p;
+         t.from = from;
+         t.to = after;
+         t.timing.duration = spec->duration;
+         t.timing.delay = spec->delay;
+         t.timing.fill = css::FillMode::Backwards; // the old value holds during the delay
+         t.timing.easing = spec->easing;
+         if (!ea)
+            ea = &entry_for(el, rd);
+         if (running)
+            *find_transition(*ea, p) = std::move(t);
+         else
+            insert_ordered(ea->list, std::move(t));
+      }
+   }
+   sync_css_animations(el, rd, ea, style);
+   if (!ea)
+      return;
+   ea->base = std::move(base);
+   *ea->animated = base_of(*ea);
+   ea->written = 0;
+   ea->settled = false;
+   if (!update(el, rd, *ea, g_now, true))
+      g_elements.erase(el);
+}
+
+uint64_t animation_play(dom::Element* el, std::shared_ptr<const css::KeyframesRule> keyframes,
+                        const css::AnimationTiming& timing)
+{
+   DomElementRenderData* rd = ensure_render_data(el);
+   if (!rd || !keyframes)
+      return 0;
+   Animation a;
+   a.id = g_nextId++;
+   a.kind = Kind::Script;
+   a.timing = timing;
+   a.props = animated_props(*keyframes);
+   a.keyframes = std::move(keyframes);
+   ElementAnimations& ea = entry_for(el, rd);
+   ea.list.push_back(std::move(a)); // script animations composite last, in call order
+   ea.settled = false;
+   g_scriptAnimations[ea.list.back().id] = el;
+   const uint64_t id = ea.list.back().id;
+   g_running = true;
+   refresh(el);
+   return id;
+}
+
+void animation_cancel(uint64_t id)
+{
+   dom::Element* el = nullptr;
+   if (!find_script_animation(id, el))
+      return;
+   auto& list = g_elements[el].list;
+   list.erase(std::remove_if(list.begin(), list.end(), [id](const Animation& a) { return a.id == id; }), list.end());
+   g_scriptAnimations.erase(id);
+   refresh(el);
+}
+
+void animation_finish(uint64_t id)
+{
+   dom::Element* el = nullptr;
+   Animation* a = find_script_animation(id, el);
+   if (!a)
+      return;
+   const double end = a->timing.delay + std::max(a->timing.duration, 0.f) * std::max(a->timing.iterations, 0.f);
+   if (!std::isfinite(end))
+      return; // an infinite animation has no end to jump to
+   a->startTime = g_now - end;
+   refresh(el);
+}
+
+const char* animation_play_state(uint64_t id)
+{
+   dom::Element* el = nullptr;
+   const Animation* a = find_script_animation(id, el);
+   return !a ? "idle" : a->finished ? "finished" : "running";
+}
+
+bool animations_tick(double nowMs)
+{
+   g_now = nowMs;
+   g_running = false;
+   for (auto it = g_elements.begin(); it != g_elements.end();) {
+      dom::Element* el = it->first;
+      ElementAnimations& ea = it->second;
+      DomElementRenderData* rd = get_render_data(el);
+      if (!rd) {
+         ++it;
+         continue; // released without notice; dropped by animations_element_removed
+      }
+      bool started = false;
+      for (Animation& a : ea.list) {
+         if (a.startTime < 0.0) {
+            a.startTime = nowMs; // the frame an animation first shows on is its start
+            started = true;
+         }
+      }
+      if (ea.settled && !started) {
+         ++it;
+         continue; // filled or finished values do not change
+      }
+      if (rd->dirtyFlags() & kDirtyStyle) {
+         g_running = true; // the pending resolve layers this frame's values
+         ++it;
+         continue;
+      }
+      if (update(el, rd, ea, nowMs, false))
+         ++it;
+      else
+         it = g_elements.erase(it);
+   }
+   return g_running;
+}
+
+bool animations_active()
+{
+   return g_running;
+}
+
+void animations_element_removed(dom::Element* el)
+{
+   drop_entry(el);
+}
+
+void animations_clear()
+{
+   g_elements.clear();
+   g_scriptAnimations.clear();
+   g_running = false;
+}
@@ -0,0 +1,41 @@
+// animation.h - CSS transitions, @keyframes animations and element.animate() on the renderer's frame clock.
+// Animated values are written into a per-element copy of the computed style and from there into the paint record;
+// opacity, background-color and transform only repaint, left and top also relayout. No script runs per frame.
+#pragma once
+#include "renderer/computed_style.h"
+#include "renderer/style_sheet.h"
+#include <cstdint>
+#include <memory>
+
+namespace dom {
+class Element;
+}
+struct DomElementRenderData;
+
+// Milliseconds on the monotonic frame clock
+double animation_clock_ms();
+
+// Called by resolve_style after rd->style was replaced by a fresh cascade result: starts transitions for animatable
+// properties that changed from `before` (the style the element had, animated values included; nullptr on its first
+// resolve), starts or stops CSS animations as the `animation` list changed, and layers the running animations'
+// current values over the new style (rd->style then points at the animated copy).
+void animations_style_resolved(dom::Element* el, DomElementRenderData* rd, const css::ComputedStyle* before);
+
+// element.animate(): play `keyframes` on `el`. Returns an id for animation_cancel/animation_finish (never 0).
+uint64_t animation_play(dom::Element* el, std::shared_ptr<const css::KeyframesRule> keyframes,
+                        const css::AnimationTiming& timing);
+void animation_cancel(uint64_t id);
+// Jump to the end: the final value stays when the animation fills forwards, otherwise it is removed
+void animation_finish(uint64_t id);
+// "idle" (cancelled or unknown), "running" or "finished"
+const char* animation_play_state(uint64_t id);
+
+// Advance every animation to `nowMs` and write the values into styles and paint records, marking paint (or, for
+// left/top, layout) dirty. Returns true while an animation is still running and needs further frames.
+bool animations_tick(double nowMs);
+// Some animation has not finished yet
+bool animations_active();
+
+// `el`'s render data is being freed / all render data is being released
+void animations_element_removed(dom::Element* el);
+void animations_clear();
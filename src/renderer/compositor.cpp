@@ -0,0 +1,346 @@
+#include "compositor.h"
+#include "renderer/element_data.h"
+#include "renderer/renderer.h"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include <include/core/SkCanvas.h>
+#include <include/core/SkMatrix.h>
+#include <include/core/SkPaint.h>
+#include <include/core/SkPictureRecorder.h>
+#include <include/core/SkSamplingOptions.h>
+#include <include/core/SkSurface.h>
+#include <include/core/SkTextBlob.h>
+
+// The element's CSS transform in device px, applied around its box centre, plus its native drag offset; false when
+// it has neither
+static bool own_transform(dom::Element* el, float deviceScale, SkMatrix& out)
+{
+   bool any = false;
+   out.reset();
+   const PaintProps& pp = paint_props(el);
+   if (pp.hasTransform) {
+      int x, y, w, h;
+      paint_rect(el, x, y, w, h);
+      const css::Transform& t = pp.transform;
+      const float cx = (x + w * 0.5f) * deviceScale, cy = (y + h * 0.5f) * deviceScale;
+      out = SkMatrix::Translate(cx + t.translateX * deviceScale, cy + t.translateY * deviceScale);
+      out.preRotate(t.rotate);
+      out.preScale(t.scaleX, t.scaleY);
+      out.preTranslate(-cx, -cy);
+      any = true;
+   }
+   const DomElementRenderData* rd = get_render_data(el);
+   if (rd && rd->dragged) {
+      out.postTranslate(rd->dragX * deviceScale, rd->dragY * deviceScale);
+      any = true;
+   }
+   return any;
+}
+
+// RenderLayer::transform: the layer's own transform, then its parent's accumulated one (ancestors apply after their
+// descendants), which stops at the compositor layer for members. Layers are drawn flat, so a transformed container
+// carries its descendants this way. Cached until Renderer::transformChanged invalidates it, so each layer costs one
+// matrix concat however deep it is.
+static void update_transform(RenderLayer* rl, float deviceScale)
+{
+   if (!rl->transformDirty)
+      return;
+   rl->transformed = own_transform(rl->element, deviceScale, rl->transform);
+   RenderLayer* parent = rl->parent;
+   if (parent && parent->element && parent != rl->composited) {
+      update_transform(parent, deviceScale);
+      if (parent->transformed) {
+         rl->transform.postConcat(parent->transform);
+         rl->transformed = true;
+      }
+   }
+   rl->transformDirty = false;
+}
+
+// The layer's own draws in device px, opaque: opacity applies to whole stacking contexts when compositing (see
+// opacity_group). `blob` is the element's text blob (nullptr for other elements).
+static void draw_layer(SkCanvas* canvas, const LayerPaintKey& k, const SkImage* img, const SkTextBlob* blob)
+{
+   const SkRect box = SkRect::MakeXYWH((SkScalar)(k.x * k.deviceScale), (SkScalar)(k.y * k.deviceScale),
+                                       (SkScalar)(k.w * k.deviceScale), (SkScalar)(k.h * k.deviceScale));
+   if (k.background.fA > 0.f) {
+      SkPaint p(k.background);
+      p.setStyle(SkPaint::kFill_Style);
+      canvas->drawRect(box, p);
+   }
+   if (img) {
+      // Draw snapshot at device pixel position; image size already matches device pixels of the canvas.
+      canvas->drawImage(img, box.x(), box.y(), SkSamplingOptions());
+      if (k.debugBorders) {
+         SkPaint border;
+         border.setStyle(SkPaint::kStroke_Style);
+         border.setColor(SK_ColorWHITE);
+         border.setStrokeWidth(1);
+         canvas->drawRect(box, border);
+      }
+   }
+   // Text leaves draw their cached glyph runs; the blob is only rebuilt when text, font or wrap width change.
+   if (blob) {
+      SkPaint textPaint;
+      textPaint.setColor4f(k.textColor);
+      canvas->save();
+      canvas->scale(k.deviceScale, k.deviceScale);
+      canvas->drawTextBlob(blob, (SkScalar)k.x + k.textInsetX, (SkScalar)k.y + k.textInsetY, textPaint);
+      canvas->restore();
+   }
+}
+
+// Device-px bounds of draw_layer's output: the box, plus glyphs that overflow it
+static SkRect layer_bounds(const LayerPaintKey& k, const SkTextBlob* blob)
+{
+   SkRect r = SkRect::MakeXYWH(k.x * k.deviceScale, k.y * k.deviceScale, k.w * k.deviceScale, k.h * k.deviceScale);
+   if (blob) {
+      const SkRect& b = blob->bounds();
+      const float bx = k.x + k.textInsetX, by = k.y + k.textInsetY;
+      r.join(SkRect::MakeLTRB((bx + b.fLeft) * k.deviceScale, (by + b.fTop) * k.deviceScale,
+                              (bx + b.fRight) * k.deviceScale, (by + b.fBottom) * k.deviceScale));
+   }
+   return r;
+}
+
+// Stacking contexts below full opacity are composited as one group (saveLayerAlpha around themselves, their z lists
+// and their flow): on screen (raster == nullptr) those outside any compositor layer, inside `raster` its members. A
+// compositor layer's own opacity is applied to its raster instead (rasterOpacity).
+static bool opacity_group(const RenderLayer* rl, const RenderLayer* raster)
+{
+   return rl->stackingContext && rl->groupOpacity < 1.f && rl->composited == raster && !(rl->promoted && !raster);
+}
+
+// Replay a layer's picture where collect_damage placed it
+static void replay_layer(SkCanvas* canvas, const RenderLayer* rl)
+{
+   const int saved = canvas->save();
+   if (rl->clipped)
+      canvas->clipRect(rl->clip);
+   if (rl->transformed)
+      canvas->concat(rl->transform);
+   canvas->drawPicture(rl->picture.get());
+   canvas->restoreToCount(saved);
+}
+
+// Place a compositor layer's raster, re-rastering it first from itself and its members in paint order when one of
+// them was redrawn, added, removed or moved inside it (rasterDirty). A drag, transform or opacity change only
+// re-places it, damaging its old and new screen bounds.
+static void finish_raster(Renderer& renderer, RenderLayer* p, SkRegion& damage)
+{
+   const bool rerender = p->rasterDirty;
+   if (rerender) {
+      SkIRect rb = SkIRect::MakeEmpty();
+      renderer.forEachLayerIn(p, [p, &rb](RenderLayer* m) {
+         if (m != p)
+            rb.join(m->bounds);
+         else if (m->picture)
+            rb.join(m->picture->cullRect().roundOut());
+      });
+      p->raster.reset();
+      sk_sp<SkSurface> surface =
+         rb.isEmpty() ? nullptr : SkSurfaces::Raster(SkImageInfo::MakeN32Premul(rb.width(), rb.height()));
+      if (surface) {
+         SkCanvas* canvas = surface->getCanvas();
+         canvas->clear(SK_ColorTRANSPARENT);
+         canvas->translate((SkScalar)-rb.fLeft, (SkScalar)-rb.fTop);
+         renderer.forEachLayerIn(
+            p,
+            [canvas, p](RenderLayer* m) {
+               if (opacity_group(m, p))
+                  canvas->saveLayerAlphaf(nullptr, m->groupOpacity);
+               if (m == p && m->picture)
+                  canvas->drawPicture(m->picture.get());
+               else if (m != p && m->picture && !m->bounds.isEmpty())
+                  replay_layer(canvas, m);
+            },
+            [canvas, p](RenderLayer* m) {
+               if (opacity_group(m, p))
+                  canvas->restore();
+            });
+         p->raster = surface->makeImageSnapshot();
+      }
+      p->rasterBounds = rb;
+      p->rasterDirty = false;
+   }
+   SkIRect bounds = SkIRect::MakeEmpty();
+   if (p->raster) {
+      SkRect r = SkRect::Make(p->rasterBounds);
+      if (p->transformed)
+         r = p->transform.mapRect(r);
+      if (!p->clipped || r.intersect(p->clip)) {
+         bounds = r.roundOut();
+         bounds.outset(1, 1);
+      }
+   }
+   const float opacity = paint_props(p->element).opacity;
+   if (rerender || bounds != p->bounds || opacity != p->rasterOpacity) {
+      damage.op(p->bounds, SkRegion::kUnion_Op);
+      damage.op(bounds, SkRegion::kUnion_Op);
+   }
+   p->bounds = bounds;
+   p->rasterOpacity = opacity;
+}
+
+static SkRect device_clip(const LayoutBox& c, float deviceScale)
+{
+   return SkRect::MakeXYWH(c.x * deviceScale, c.y * deviceScale, c.w * deviceScale, c.h * deviceScale);
+}
+
+SkRegion collect_damage(Renderer& renderer, float deviceScale, const CanvasSnapshotFn& canvasSnapshot)
+{
+   const bool debugBorders = std::getenv("DEBUG_DRAW_BORDER") != nullptr;
+   // UI_NO_PICTURE_CACHE=1 re-records every layer on every frame (for comparing against the retained path)
+   static const bool noPictureCache = std::getenv("UI_NO_PICTURE_CACHE") != nullptr;
+   static SkPictureRecorder recorder;
+   // This frame's paint-dirty layers, the compositor layers to place, and opacity groups outside compositor layers
+   // whose opacity changed; the vectors keep their capacity across frames
+   static std::vector<RenderLayer*> dirty, rasters, regrouped;
+   rasters.clear();
+   regrouped.clear();
+   renderer.updateTree(); // restacks and removals damage what they uncovered
+   if (noPictureCache || deviceScale != renderer.paintScale()) {
+      renderer.allPaintChanged();
+      renderer.setPaintScale(deviceScale);
+   }
+   SkRegion damage = renderer.takeDamage();
+   renderer.takePaintChanged(dirty);
+   for (RenderLayer* rl : dirty) {
+      // Outermost compositor layer holding this one (itself when promoted), whose raster is re-placed below
+      RenderLayer* raster = rl->composited ? rl->composited : rl->promoted ? rl : nullptr;
+      const DomElementRenderData* layerRd = get_render_data(rl->element);
+      SkIRect bounds = SkIRect::MakeEmpty();
+      // Geometry and colours come from the precomputed paint record; no CSS parsing per frame.
+      const PaintProps& pp = paint_props(rl->element);
+      if (rl->stackingContext && rl != raster && pp.opacity != rl->groupOpacity) {
+         rl->groupOpacity = pp.opacity;
+         if (raster)
+            raster->rasterDirty = true; // a group inside the raster: re-raster it
+         else
+            regrouped.push_back(rl);
+      }
+      LayerPaintKey key;
+      key.background = pp.background;
+      paint_rect(rl->element, key.x, key.y, key.w, key.h);
+      key.deviceScale = deviceScale;
+      sk_sp<SkImage> img = canvasSnapshot ? canvasSnapshot(rl->element) : nullptr;
+      key.imageId = img ? img->uniqueID() : 0;
+      key.debugBorders = img && debugBorders;
+      renderer.setShowsCanvas(rl, (bool)img); // revisited every frame while it shows one
+      const SkTextBlob* blob = text_blob(rl->element);
+      if (blob) {
+         key.blobId = blob->uniqueID();
+         key.textColor = layerRd->textColor;
+         key.textInsetX = layerRd->textInsetX;
+         key.textInsetY = layerRd->textInsetY;
+      }
+      // Re-record only when something the picture was drawn from changed; clip and transform stay outside it
+      const bool changed = !rl->recorded || !(rl->paintKey == key);
+      if (changed || noPictureCache) {
+         draw_layer(recorder.beginRecording(layer_bounds(key, blob)), key, img.get(), blob);
+         rl->picture = recorder.finishRecordingAsPicture();
+         if (rl->picture && rl->picture->approximateOpCount() == 0)
+            rl->picture.reset();
+         rl->paintKey = key;
+         rl->recorded = true;
+      }
+      // Inside overflow containers: clip to the visible region computed by layout
+      rl->clipped = layerRd && layerRd->hasClip;
+      if (rl->clipped)
+         rl->clip = device_clip(layerRd->clip, deviceScale);
+      // Members are placed in their compositor layer's raster: transforms below it, and clips from inside it
+      if (rl->composited && rl->clipped) {
+         const DomElementRenderData* rasterRd = get_render_data(rl->composited->element);
+         if (rasterRd && rasterRd->hasClip && device_clip(rasterRd->clip, deviceScale) == rl->clip)
+            rl->clipped = false;
+      }
+      update_transform(rl, deviceScale);
+      if (rl->picture) {
+         SkRect r = rl->picture->cullRect();
+         if (rl->transformed)
+            r = rl->transform.mapRect(r);
+         if (!rl->clipped || r.intersect(rl->clip)) {
+            bounds = r.roundOut();
+            bounds.outset(1, 1); // antialiased edges of transformed content
+         }
+      }
+      // Inside a compositor layer only its raster as a whole is damaged, when it is placed
+      if (raster) {
+         if (rl != raster && (changed || bounds != rl->bounds))
+            raster->rasterDirty = true;
+         else if (rl == raster && changed)
+            raster->rasterDirty = true;
+         if (rl != raster)
+            rl->bounds = bounds;
+         rasters.push_back(raster);
+         continue;
+      }
+      // Old and new bounds: covers moves, restyles, redrawn canvases, and layers appearing or disappearing
+      if (changed || bounds != rl->bounds) {
+         damage.op(rl->bounds, SkRegion::kUnion_Op);
+         damage.op(bounds, SkRegion::kUnion_Op);
+      }
+      rl->bounds = bounds;
+   }
+   // Members first, so each raster is drawn from up-to-date bounds
+   std::sort(rasters.begin(), rasters.end());
+   rasters.erase(std::unique(rasters.begin(), rasters.end()), rasters.end());
+   for (RenderLayer* p : rasters)
+      finish_raster(renderer, p, damage);
+   for (RenderLayer* g : regrouped) {
+      renderer.forEachLayerIn(g, [&damage](RenderLayer* rl) {
+         if (!rl->composited) // members' bounds are relative to their raster, which is damaged as a whole
+            damage.op(rl->bounds, SkRegion::kUnion_Op);
+      });
+   }
+   return damage;
+}
+
+// Whether the layer draws anything to the screen itself; members draw only into their compositor layer's raster
+static bool composites(const RenderLayer* rl)
+{
+   if (!rl || rl->composited || rl->bounds.isEmpty())
+      return false;
+   return rl->promoted ? (bool)rl->raster : (bool)rl->picture;
+}
+
+// Draw a layer where collect_damage placed it: a compositor layer's raster with its group opacity, or the picture
+static void composite_layer(SkCanvas* canvas, const RenderLayer* rl)
+{
+   if (!rl->promoted) {
+      replay_layer(canvas, rl);
+      return;
+   }
+   const int saved = canvas->save();
+   if (rl->clipped)
+      canvas->clipRect(rl->clip);
+   if (rl->transformed)
+      canvas->concat(rl->transform);
+   SkPaint paint;
+   paint.setAlphaf(rl->rasterOpacity);
+   canvas->drawImage(rl->raster.get(), (SkScalar)rl->rasterBounds.fLeft, (SkScalar)rl->rasterBounds.fTop,
+                     SkSamplingOptions(SkFilterMode::kLinear), rl->rasterOpacity < 1.f ? &paint : nullptr);
+   canvas->restoreToCount(saved);
+}
+
+void composite_layers(SkCanvas* canvas, Renderer& renderer, const SkRegion* damage)
+{
+   if (!canvas)
+      return;
+   renderer.forEachLayer(
+      [&](RenderLayer* rl) {
+         if (opacity_group(rl, nullptr))
+            canvas->saveLayerAlphaf(nullptr, rl->groupOpacity);
+         if (!composites(rl))
+            return;
+         if (damage && !damage->intersects(rl->bounds))
+            return;
+         composite_layer(canvas, rl);
+      },
+      [canvas](RenderLayer* rl) {
+         if (opacity_group(rl, nullptr))
+            canvas->restore();
+      });
+}
+
@@ -0,0 +1,27 @@
+// compositor.h - paint a document's render layers into an SkCanvas (window and headless runs share this)
+#pragma once
+#include <functional>
+#include <include/core/SkImage.h>
+#include <include/core/SkRefCnt.h>
+#include <include/core/SkRegion.h>
+
+class Renderer;
+class SkCanvas;
+namespace dom {
+class Element;
+}
+
+// Device-pixel snapshot of an element's canvas backing surface; nullptr when the element has none
+using CanvasSnapshotFn = std::function<sk_sp<SkImage>(dom::Element*)>;
+
+// Bring every layer's recorded picture (RenderLayer::picture) and painted device bounds up to date at `deviceScale`
+// device px per CSS px. Reads only precomputed paint records, layout boxes and cached text blobs; the caller brings
+// layout up to date first. A layer is re-recorded only when its paint inputs changed. Returns the device-px region
+// whose pixels may differ from the previous call: old and new bounds of every layer that was added, removed, moved,
+// restyled or redrawn, or whose transform or clip changed.
+SkRegion collect_damage(Renderer& renderer, float deviceScale, const CanvasSnapshotFn& canvasSnapshot);
+
+// Replay the layers' pictures in paint order, skipping those outside `damage` (nullptr = all). Call after
+// collect_damage; the caller clears and clips the canvas to the damaged region first.
+void composite_layers(SkCanvas* canvas, Renderer& renderer, const SkRegion* damage);
+
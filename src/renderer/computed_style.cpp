@@ -0,0 +1,1082 @@
+#include "computed_style.h"
+#include "css_color.h"
+#include "css_parser.h"
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <mutex>
+
+namespace css {
+
+namespace {
+// Indexed by Prop
+constexpr std::string_view kPropNames[] = {
+   "display",          "flex-direction",     "flex",          "width",
+   "height",           "left",               "top",           "background-color",
+   "opacity",          "right",              "bottom",        "position",
+   "margin",           "margin-top",         "margin-right",  "margin-bottom",
+   "margin-left",      "padding",            "padding-top",   "padding-right",
+   "padding-bottom",   "padding-left",       "border",        "border-width",
+   "border-top-width", "border-right-width", "border-bottom-width", "border-left-width",
+   "font-size",        "font-weight",        "font-style",    "font-family",
+   "line-height",      "color",              "overflow",      "transform",
+   "transition",       "animation",          "z-index",       "will-change"};
+static_assert(sizeof(kPropNames) / sizeof(kPropNames[0]) == (size_t)Prop::Count);
+
+constexpr uint32_t kBackgroundShorthand = prop_hash("background");
+
+bool equals_lower(std::string_view a, std::string_view lowerB)
+{
+   if (a.size() != lowerB.size())
+      return false;
+   for (size_t i = 0; i < a.size(); ++i) {
+      char c = a[i];
+      if (c >= 'A' && c <= 'Z')
+         c = (char)(c - 'A' + 'a');
+      if (c != lowerB[i])
+         return false;
+   }
+   return true;
+}
+
+bool parse_length(std::string_view v, Length& out, bool allowNegative = false)
+{
+   if (equals_lower(v, "auto")) {
+      out = {0.f, Unit::Auto};
+      return true;
+   }
+   float num;
+   std::string_view unit;
+   if (!parse_dimension(v, num, unit) || (num < 0 && !allowNegative))
+      return false;
+   if (unit.empty() || unit == "px")
+      out = {num, Unit::Px};
+   else if (unit == "%")
+      out = {num, Unit::Percent};
+   else
+      return false;
+   return true;
+}
+
+// Split a space-separated value list (parentheses kept intact); returns the count, 0 if more than `max`.
+int split_values(std::string_view v, std::string_view* parts, int max)
+{
+   int n = 0;
+   size_t i = 0;
+   while (i < v.size()) {
+      while (i < v.size() && (v[i] == ' ' || v[i] == '\t' || v[i] == '\n'))
+         ++i;
+      if (i >= v.size())
+         break;
+      size_t start = i;
+      int depth = 0;
+      while (i < v.size() && (depth > 0 || !(v[i] == ' ' || v[i] == '\t' || v[i] == '\n'))) {
+         if (v[i] == '(')
+            ++depth;
+         else if (v[i] == ')' && depth > 0)
+            --depth;
+         ++i;
+      }
+      if (n == max)
+         return 0;
+      parts[n++] = v.substr(start, i - start);
+   }
+   return n;
+}
+
+// 1-4 value box shorthand (margin, padding) expanded to top/right/bottom/left
+bool parse_box_lengths(std::string_view v, Length (&out)[(int)Edge::Count], bool allowNegative)
+{
+   std::string_view parts[4];
+   int n = split_values(v, parts, 4);
+   if (n == 0)
+      return false;
+   Length l[4];
+   for (int i = 0; i < n; ++i) {
+      if (!parse_length(parts[i], l[i], allowNegative))
+         return false;
+   }
+   out[0] = l[0];
+   out[1] = n > 1 ? l[1] : l[0];
+   out[2] = n > 2 ? l[2] : l[0];
+   out[3] = n > 3 ? l[3] : out[1];
+   return true;
+}
+
+bool parse_border_width(std::string_view v, float& out)
+{
+   if (equals_lower(v, "thin"))
+      out = 1.f;
+   else if (equals_lower(v, "medium"))
+      out = 3.f;
+   else if (equals_lower(v, "thick"))
+      out = 5.f;
+   else {
+      // Must start like a number, so colours such as rgb(1,2,3) in the shorthand are not taken as widths
+      if (v.empty() || !((v[0] >= '0' && v[0] <= '9') || v[0] == '.'))
+         return false;
+      float num;
+      std::string_view unit;
+      if (!parse_number_unit(v, num, unit) || !(unit.empty() || unit == "px"))
+         return false;
+      out = num;
+   }
+   return true;
+}
+
+bool parse_border_widths(std::string_view v, float (&out)[(int)Edge::Count])
+{
+   std::string_view parts[4];
+   int n = split_values(v, parts, 4);
+   if (n == 0)
+      return false;
+   float w[4];
+   for (int i = 0; i < n; ++i) {
+      if (!parse_border_width(parts[i], w[i]))
+         return false;
+   }
+   out[0] = w[0];
+   out[1] = n > 1 ? w[1] : w[0];
+   out[2] = n > 2 ? w[2] : w[0];
+   out[3] = n > 3 ? w[3] : out[1];
+   return true;
+}
+
+bool is_border_style(std::string_view v)
+{
+   for (std::string_view kw : {"solid", "dashed", "dotted", "double", "groove", "ridge", "inset", "outset"}) {
+      if (equals_lower(v, kw))
+         return true;
+   }
+   return false;
+}
+
+// `border: <width> || <style> || <color>`; only the width matters for layout.
+bool parse_border_shorthand(std::string_view v, float& out)
+{
+   std::string_view parts[3];
+   int n = split_values(v, parts, 3);
+   if (n == 0)
+      return false;
+   bool haveWidth = false;
+   bool visible = false;
+   for (int i = 0; i < n; ++i) {
+      if (!haveWidth && parse_border_width(parts[i], out))
+         haveWidth = true;
+      else if (is_border_style(parts[i]))
+         visible = true;
+   }
+   if (!visible)
+      out = 0.f; // border-style none: no border whatever the width
+   else if (!haveWidth)
+      out = 3.f; // medium
+   return true;
+}
+
+Position parse_position(std::string_view v)
+{
+   if (equals_lower(v, "absolute") || equals_lower(v, "fixed"))
+      return Position::Absolute; // fixed is treated as absolute (no separate viewport containing block)
+   if (equals_lower(v, "relative") || equals_lower(v, "sticky"))
+      return Position::Relative;
+   return Position::Static;
+}
+
+bool parse_overflow(std::string_view v, Overflow& out)
+{
+   if (equals_lower(v, "visible"))
+      out = Overflow::Visible;
+   else if (equals_lower(v, "hidden") || equals_lower(v, "clip"))
+      out = Overflow::Hidden;
+   else if (equals_lower(v, "auto") || equals_lower(v, "overlay"))
+      out = Overflow::Auto;
+   else if (equals_lower(v, "scroll"))
+      out = Overflow::Scroll;
+   else
+      return false; // two-value syntax (overflow-x/overflow-y) not supported
+   return true;
+}
+
+bool parse_font_size(std::string_view v, Length& out)
+{
+   static constexpr struct {
+      std::string_view name;
+      float px;
+   } kKeywords[] = {{"xx-small", 9}, {"x-small", 10}, {"small", 13}, {"medium", 16},
+                    {"large", 18},   {"x-large", 24}, {"xx-large", 32}};
+   for (const auto& k : kKeywords) {
+      if (equals_lower(v, k.name)) {
+         out = {k.px, Unit::Px};
+         return true;
+      }
+   }
+   if (equals_lower(v, "smaller")) {
+      out = {83.f, Unit::Percent};
+      return true;
+   }
+   if (equals_lower(v, "larger")) {
+      out = {120.f, Unit::Percent};
+      return true;
+   }
+   float num;
+   std::string_view unit;
+   if (!parse_number_unit(v, num, unit))
+      return false;
+   if (unit == "px")
+      out = {num, Unit::Px};
+   else if (unit == "%")
+      out = {num, Unit::Percent};
+   else if (equals_lower(unit, "em"))
+      out = {num * 100.f, Unit::Percent};
+   else if (equals_lower(unit, "rem"))
+      out = {num * 16.f, Unit::Px}; // root size is fixed at the initial 16px
+   else if (equals_lower(unit, "pt"))
+      out = {num * 4.f / 3.f, Unit::Px};
+   else
+      return false;
+   return true;
+}
+
+bool parse_font_weight(std::string_view v, uint16_t& out)
+{
+   if (equals_lower(v, "normal"))
+      out = 400;
+   else if (equals_lower(v, "bold") || equals_lower(v, "bolder"))
+      out = 700;
+   else if (equals_lower(v, "lighter"))
+      out = 300;
+   else {
+      float num;
+      std::string_view unit;
+      if (!parse_number_unit(v, num, unit) || !unit.empty() || num < 1 || num > 1000)
+         return false;
+      out = (uint16_t)num;
+   }
+   return true;
+}
+
+// auto | <integer>
+bool parse_z_index(std::string_view v, int32_t& z, bool& isAuto)
+{
+   if (equals_lower(v, "auto")) {
+      z = 0;
+      isAuto = true;
+      return true;
+   }
+   float num;
+   std::string_view unit;
+   if (!parse_number_unit(v, num, unit) || !unit.empty() || num != (float)(int32_t)num)
+      return false;
+   z = (int32_t)num;
+   isAuto = false;
+   return true;
+}
+
+// First entry of a family list, without quotes
+std::string_view parse_font_family(std::string_view v)
+{
+   size_t comma = v.find(',');
+   std::string_view first = v.substr(0, comma);
+   while (!first.empty() && (first.back() == ' ' || first.back() == '\t'))
+      first.remove_suffix(1);
+   if (first.size() >= 2 && (first.front() == '"' || first.front() == '\'') && first.back() == first.front())
+      first = first.substr(1, first.size() - 2);
+   return first;
+}
+
+bool parse_line_height(std::string_view v, Length& out)
+{
+   if (equals_lower(v, "normal")) {
+      out = {};
+      return true;
+   }
+   float num;
+   std::string_view unit;
+   if (!parse_number_unit(v, num, unit))
+      return false;
+   if (unit.empty())
+      out = {num * 100.f, Unit::Percent};
+   else if (unit == "%")
+      out = {num, Unit::Percent};
+   else if (unit == "px")
+      out = {num, Unit::Px};
+   else if (equals_lower(unit, "em"))
+      out = {num * 100.f, Unit::Percent};
+   else
+      return false;
+   return true;
+}
+
+Display parse_display(std::string_view v)
+{
+   if (equals_lower(v, "flex"))
+      return Display::Flex;
+   if (equals_lower(v, "none"))
+      return Display::None;
+   return Display::Block;
+}
+
+// <number> or <percentage>, clamped to 0..1
+bool parse_opacity(std::string_view v, float& out)
+{
+   float num;
+   std::string_view unit;
+   if (!parse_number_unit(v, num, unit))
+      return false;
+   if (unit == "%")
+      num /= 100.f;
+   else if (!unit.empty())
+      return false;
+   out = num > 1.f ? 1.f : num;
+   return true;
+}
+
+FlexDirection parse_flex_direction(std::string_view v)
+{
+   if (equals_lower(v, "row"))
+      return FlexDirection::Row;
+   if (equals_lower(v, "row-reverse"))
+      return FlexDirection::RowReverse;
+   if (equals_lower(v, "column-reverse"))
+      return FlexDirection::ColumnReverse;
+   return FlexDirection::Column;
+}
+
+// Visit the comma-separated items of a list value (commas inside parentheses do not split), trimmed
+template <typename Fn> bool for_each_list_item(std::string_view v, Fn&& fn)
+{
+   size_t start = 0;
+   int depth = 0;
+   for (size_t i = 0; i <= v.size(); ++i) {
+      if (i < v.size() && v[i] != ',') {
+         depth += v[i] == '(' ? 1 : v[i] == ')' ? -1 : 0;
+         continue;
+      }
+      if (i < v.size() && depth > 0)
+         continue;
+      std::string_view item = v.substr(start, i - start);
+      while (!item.empty() && (item.front() == ' ' || item.front() == '\t' || item.front() == '\n'))
+         item.remove_prefix(1);
+      while (!item.empty() && (item.back() == ' ' || item.back() == '\t' || item.back() == '\n'))
+         item.remove_suffix(1);
+      if (item.empty() || !fn(item))
+         return false;
+      start = i + 1;
+   }
+   return true;
+}
+
+// auto | <custom-ident>#; only transform and opacity have compositor support, other names are accepted and ignored
+bool parse_will_change(std::string_view v, bool& compositor)
+{
+   if (equals_lower(v, "auto")) {
+      compositor = false;
+      return true;
+   }
+   bool any = false;
+   if (!for_each_list_item(v, [&](std::string_view item) {
+      any = any || equals_lower(item, "transform") || equals_lower(item, "opacity");
+      return true;
+   }))
+      return false;
+   compositor = any;
+   return true;
+}
+
+// Arguments of `name(...)`: returns the count (0 if more than `max` or not a function of that name)
+int function_args(std::string_view v, std::string_view name, std::string_view* args, int max)
+{
+   if (v.size() < name.size() + 2 || !equals_lower(v.substr(0, name.size()), name) || v[name.size()] != '(' ||
+       v.back() != ')')
+      return 0;
+   int n = 0;
+   bool ok = for_each_list_item(v.substr(name.size() + 1, v.size() - name.size() - 2), [&](std::string_view a) {
+      if (n == max)
+         return false;
+      args[n++] = a;
+      return true;
+   });
+   return ok ? n : 0;
+}
+
+bool parse_number(std::string_view v, float& out)
+{
+   std::string_view unit;
+   return parse_dimension(v, out, unit) && unit.empty();
+}
+
+// <time> in ms: 1.5s, 200ms, or a bare 0
+bool parse_time(std::string_view v, float& ms)
+{
+   float num;
+   std::string_view unit;
+   if (v.empty() || !((v[0] >= '0' && v[0] <= '9') || v[0] == '.' || v[0] == '-') || !parse_dimension(v, num, unit))
+      return false;
+   if (equals_lower(unit, "ms"))
+      ms = num;
+   else if (equals_lower(unit, "s"))
+      ms = num * 1000.f;
+   else if (unit.empty() && num == 0.f)
+      ms = 0.f;
+   else
+      return false;
+   return true;
+}
+
+// <angle> in degrees
+bool parse_angle(std::string_view v, float& deg)
+{
+   float num;
+   std::string_view unit;
+   if (!parse_dimension(v, num, unit))
+      return false;
+   if (equals_lower(unit, "deg"))
+      deg = num;
+   else if (equals_lower(unit, "rad"))
+      deg = num * 180.f / 3.14159265f;
+   else if (equals_lower(unit, "turn"))
+      deg = num * 360.f;
+   else if (equals_lower(unit, "grad"))
+      deg = num * 0.9f;
+   else if (unit.empty() && num == 0.f)
+      deg = 0.f;
+   else
+      return false;
+   return true;
+}
+
+bool parse_translate(std::string_view v, float& px)
+{
+   float num;
+   std::string_view unit;
+   if (!parse_dimension(v, num, unit) || !(unit == "px" || (unit.empty() && num == 0.f)))
+      return false; // percentages would need the box size at paint time
+   px = num;
+   return true;
+}
+
+bool parse_scale(std::string_view v, float& s)
+{
+   float num;
+   std::string_view unit;
+   if (!parse_dimension(v, num, unit) || !(unit.empty() || unit == "%"))
+      return false;
+   s = unit == "%" ? num / 100.f : num;
+   return true;
+}
+
+// `none` or a space-separated list of translate*/rotate/scale* functions (matrix() and 3D are not supported)
+bool parse_transform(std::string_view v, Transform& result)
+{
+   Transform out;
+   if (equals_lower(v, "none")) {
+      result = out;
+      return true;
+   }
+   std::string_view fns[16];
+   int n = split_values(v, fns, 16);
+   if (n == 0)
+      return false;
+   for (int i = 0; i < n; ++i) {
+      std::string_view f = fns[i], a[2];
+      float x = 0.f, y = 0.f;
+      int c;
+      if ((c = function_args(f, "translate", a, 2))) {
+         if (!parse_translate(a[0], x) || (c == 2 && !parse_translate(a[1], y)))
+            return false;
+         out.translateX += x;
+         out.translateY += y;
+      }
+      else if (function_args(f, "translatex", a, 1)) {
+         if (!parse_translate(a[0], x))
+            return false;
+         out.translateX += x;
+      }
+      else if (function_args(f, "translatey", a, 1)) {
+         if (!parse_translate(a[0], y))
+            return false;
+         out.translateY += y;
+      }
+      else if (function_args(f, "rotate", a, 1)) {
+         if (!parse_angle(a[0], x))
+            return false;
+         out.rotate += x;
+      }
+      else if ((c = function_args(f, "scale", a, 2))) {
+         if (!parse_scale(a[0], x) || (c == 2 && !parse_scale(a[1], y)))
+            return false;
+         out.scaleX *= x;
+         out.scaleY *= c == 2 ? y : x;
+      }
+      else if (function_args(f, "scalex", a, 1)) {
+         if (!parse_scale(a[0], x))
+            return false;
+         out.scaleX *= x;
+      }
+      else if (function_args(f, "scaley", a, 1)) {
+         if (!parse_scale(a[0], y))
+            return false;
+         out.scaleY *= y;
+      }
+      else {
+         return false;
+      }
+   }
+   result = out;
+   return true;
+}
+
+bool parse_direction(std::string_view v, PlaybackDirection& out)
+{
+   if (equals_lower(v, "normal"))
+      out = PlaybackDirection::Normal;
+   else if (equals_lower(v, "reverse"))
+      out = PlaybackDirection::Reverse;
+   else if (equals_lower(v, "alternate"))
+      out = PlaybackDirection::Alternate;
+   else if (equals_lower(v, "alternate-reverse"))
+      out = PlaybackDirection::AlternateReverse;
+   else
+      return false;
+   return true;
+}
+
+bool parse_fill_mode(std::string_view v, FillMode& out)
+{
+   if (equals_lower(v, "forwards"))
+      out = FillMode::Forwards;
+   else if (equals_lower(v, "backwards"))
+      out = FillMode::Backwards;
+   else if (equals_lower(v, "both"))
+      out = FillMode::Both;
+   else
+      return false; // `none` is handled with the name, which it also spells
+   return true;
+}
+
+// `transition: [<property> || <duration> || <easing> || <delay>]#`; entries naming unsupported properties are
+// dropped, as they cannot animate anything here
+bool parse_transition(std::string_view v, TransitionList& result)
+{
+   std::vector<TransitionSpec> out;
+   if (!equals_lower(v, "none") && !for_each_list_item(v, [&](std::string_view item) {
+      std::string_view parts[4];
+      int n = split_values(item, parts, 4);
+      if (n == 0)
+         return false;
+      TransitionSpec spec;
+      bool haveProp = false, haveDuration = false, haveDelay = false, haveEasing = false, known = true;
+      for (int i = 0; i < n; ++i) {
+         float ms;
+         if (parse_time(parts[i], ms) && !haveDelay) {
+            (haveDuration ? spec.delay : spec.duration) = ms;
+            (haveDuration ? haveDelay : haveDuration) = true;
+         }
+         else if (!haveEasing && parse_easing(parts[i], spec.easing)) {
+            haveEasing = true;
+         }
+         else if (!haveProp) {
+            haveProp = true;
+            spec.prop = equals_lower(parts[i], "all") ? Prop::Count : prop_from_name(parts[i]);
+            known = spec.prop != Prop::Count || equals_lower(parts[i], "all");
+         }
+         else {
+            return false;
+         }
+      }
+      if (known && spec.duration >= 0.f)
+         out.push_back(spec);
+      return spec.duration >= 0.f;
+   }))
+      return false;
+   result = out.empty() ? nullptr : std::make_shared<const std::vector<TransitionSpec>>(std::move(out));
+   return true;
+}
+
+// `animation: [<duration> || <easing> || <delay> || <iteration-count> || <direction> || <fill-mode> ||
+// <play-state> || <name>]#`; entries without a name (or named `none`) are dropped
+bool parse_animation(std::string_view v, AnimationList& result)
+{
+   std::vector<AnimationSpec> out;
+   if (!for_each_list_item(v, [&](std::string_view item) {
+      std::string_view parts[8];
+      int n = split_values(item, parts, 8);
+      if (n == 0)
+         return false;
+      AnimationSpec spec;
+      AnimationTiming& t = spec.timing;
+      bool haveName = false, haveDuration = false, haveDelay = false, haveEasing = false, haveCount = false,
+           haveDirection = false, haveFill = false;
+      for (int i = 0; i < n; ++i) {
+         std::string_view p = parts[i];
+         float num;
+         if (parse_time(p, num) && !haveDelay) {
+            (haveDuration ? t.delay : t.duration) = num;
+            (haveDuration ? haveDelay : haveDuration) = true;
+         }
+         else if (!haveCount && equals_lower(p, "infinite")) {
+            t.iterations = INFINITY;
+            haveCount = true;
+         }
+         else if (!haveCount && parse_number(p, num) && num >= 0.f) {
+            t.iterations = num;
+            haveCount = true;
+         }
+         else if (!haveEasing && parse_easing(p, t.easing)) {
+            haveEasing = true;
+         }
+         else if (!haveDirection && parse_direction(p, t.direction)) {
+            haveDirection = true;
+         }
+         else if (!haveFill && parse_fill_mode(p, t.fill)) {
+            haveFill = true;
+         }
+         else if (equals_lower(p, "running") || equals_lower(p, "paused")) {
+            continue; // play state is not modelled
+         }
+         else if (!haveName) {
+            haveName = true;
+            if (!equals_lower(p, "none"))
+               spec.name.assign(p.data(), p.size());
+         }
+         else {
+            return false;
+         }
+      }
+      if (t.duration < 0.f)
+         return false;
+      if (!spec.name.empty())
+         out.push_back(std::move(spec));
+      return true;
+   }))
+      return false;
+   result = out.empty() ? nullptr : std::make_shared<const std::vector<AnimationSpec>>(std::move(out));
+   return true;
+}
+} // namespace
+
+Prop prop_from_name(std::string_view name)
+{
+   Prop p;
+   switch (prop_hash(name)) {
+   case prop_hash("display"):
+      p = Prop::Display;
+      break;
+   case prop_hash("flex-direction"):
+      p = Prop::FlexDirection;
+      break;
+   case prop_hash("flex"):
+      p = Prop::Flex;
+      break;
+   case prop_hash("width"):
+      p = Prop::Width;
+      break;
+   case prop_hash("height"):
+      p = Prop::Height;
+      break;
+   case prop_hash("left"):
+      p = Prop::Left;
+      break;
+   case prop_hash("top"):
+      p = Prop::Top;
+      break;
+   case prop_hash("background-color"):
+      p = Prop::BackgroundColor;
+      break;
+   case prop_hash("opacity"):
+      p = Prop::Opacity;
+      break;
+   case prop_hash("right"):
+      p = Prop::Right;
+      break;
+   case prop_hash("bottom"):
+      p = Prop::Bottom;
+      break;
+   case prop_hash("position"):
+      p = Prop::Position;
+      break;
+   case prop_hash("margin"):
+      p = Prop::Margin;
+      break;
+   case prop_hash("margin-top"):
+      p = Prop::MarginTop;
+      break;
+   case prop_hash("margin-right"):
+      p = Prop::MarginRight;
+      break;
+   case prop_hash("margin-bottom"):
+      p = Prop::MarginBottom;
+      break;
+   case prop_hash("margin-left"):
+      p = Prop::MarginLeft;
+      break;
+   case prop_hash("padding"):
+      p = Prop::Padding;
+      break;
+   case prop_hash("padding-top"):
+      p = Prop::PaddingTop;
+      break;
+   case prop_hash("padding-right"):
+      p = Prop::PaddingRight;
+      break;
+   case prop_hash("padding-bottom"):
+      p = Prop::PaddingBottom;
+      break;
+   case prop_hash("padding-left"):
+      p = Prop::PaddingLeft;
+      break;
+   case prop_hash("border"):
+      p = Prop::Border;
+      break;
+   case prop_hash("border-width"):
+      p = Prop::BorderWidth;
+      break;
+   case prop_hash("border-top-width"):
+      p = Prop::BorderTopWidth;
+      break;
+   case prop_hash("border-right-width"):
+      p = Prop::BorderRightWidth;
+      break;
+   case prop_hash("border-bottom-width"):
+      p = Prop::BorderBottomWidth;
+      break;
+   case prop_hash("border-left-width"):
+      p = Prop::BorderLeftWidth;
+      break;
+   case prop_hash("font-size"):
+      p = Prop::FontSize;
+      break;
+   case prop_hash("font-weight"):
+      p = Prop::FontWeight;
+      break;
+   case prop_hash("font-style"):
+      p = Prop::FontStyle;
+      break;
+   case prop_hash("font-family"):
+      p = Prop::FontFamily;
+      break;
+   case prop_hash("line-height"):
+      p = Prop::LineHeight;
+      break;
+   case prop_hash("color"):
+      p = Prop::Color;
+      break;
+   case prop_hash("overflow"):
+      p = Prop::Overflow;
+      break;
+   case prop_hash("transform"):
+      p = Prop::Transform;
+      break;
+   case prop_hash("transition"):
+      p = Prop::Transition;
+      break;
+   case prop_hash("animation"):
+      p = Prop::Animation;
+      break;
+   case prop_hash("z-index"):
+      p = Prop::ZIndex;
+      break;
+   case prop_hash("will-change"):
+      p = Prop::WillChange;
+      break;
+   default:
+      return Prop::Count;
+   }
+   // The hash is only perfect over the known set; reject unknown names that happen to collide.
+   return equals_lower(name, kPropNames[(unsigned)p]) ? p : Prop::Count;
+}
+
+std::string_view prop_name(Prop p)
+{
+   return p < Prop::Count ? kPropNames[(unsigned)p] : std::string_view();
+}
+
+PropGroup prop_group(Prop p)
+{
+   switch (p) {
+   case Prop::BackgroundColor:
+   case Prop::Opacity:
+   case Prop::Transform:  // applied by the compositor around the laid-out box
+   case Prop::Transition: // only decide how later changes are animated
+   case Prop::Animation:
+   case Prop::ZIndex:     // paint order only
+   case Prop::WillChange: // compositor layer promotion
+      return PropGroup::Paint;
+   case Prop::FontSize:
+   case Prop::FontWeight:
+   case Prop::FontStyle:
+   case Prop::FontFamily:
+   case Prop::LineHeight:
+   case Prop::Color: // text leaves pick their colour up while syncing
+      return PropGroup::Inherited;
+   default:
+      return PropGroup::Layout;
+   }
+}
+
+namespace {
+std::mutex g_familiesMutex;
+std::deque<std::string> g_families{std::string()}; // id -> name; a deque never moves its elements
+} // namespace
+
+FontFamilyId intern_font_family(std::string_view name)
+{
+   std::lock_guard<std::mutex> lock(g_familiesMutex);
+   for (size_t i = 1; i < g_families.size(); ++i) {
+      if (g_families[i] == name)
+         return (FontFamilyId)i;
+   }
+   if (g_families.size() > UINT16_MAX)
+      return 0; // out of ids: fall back to the default family
+   g_families.emplace_back(name);
+   return (FontFamilyId)(g_families.size() - 1);
+}
+
+const std::string& font_family_name(FontFamilyId id)
+{
+   std::lock_guard<std::mutex> lock(g_familiesMutex);
+   return id < g_families.size() ? g_families[id] : g_families[0];
+}
+
+uint64_t next_style_serial()
+{
+   static std::atomic<uint64_t> serial{0};
+   return ++serial;
+}
+
+bool parse_easing(std::string_view v, Easing& out)
+{
+   static constexpr struct {
+      std::string_view name;
+      float x1, y1, x2, y2;
+   } kBeziers[] = {{"ease", 0.25f, 0.1f, 0.25f, 1.f},
+                   {"ease-in", 0.42f, 0.f, 1.f, 1.f},
+                   {"ease-out", 0.f, 0.f, 0.58f, 1.f},
+                   {"ease-in-out", 0.42f, 0.f, 0.58f, 1.f}};
+   for (const auto& b : kBeziers) {
+      if (equals_lower(v, b.name)) {
+         out = Easing{Easing::Kind::CubicBezier, b.x1, b.y1, b.x2, b.y2};
+         return true;
+      }
+   }
+   if (equals_lower(v, "linear")) {
+      out = Easing{Easing::Kind::Linear};
+      return true;
+   }
+   if (equals_lower(v, "step-start") || equals_lower(v, "step-end")) {
+      out = Easing{Easing::Kind::Steps};
+      out.jumpStart = equals_lower(v, "step-start");
+      return true;
+   }
+   std::string_view a[4];
+   if (function_args(v, "cubic-bezier", a, 4) == 4) {
+      Easing e{Easing::Kind::CubicBezier};
+      if (!parse_number(a[0], e.x1) || !parse_number(a[1], e.y1) || !parse_number(a[2], e.x2) ||
+          !parse_number(a[3], e.y2) || e.x1 < 0.f || e.x1 > 1.f || e.x2 < 0.f || e.x2 > 1.f)
+         return false;
+      out = e;
+      return true;
+   }
+   if (int n = function_args(v, "steps", a, 2)) {
+      float count;
+      if (!parse_number(a[0], count) || count < 1.f || count > 65535.f)
+         return false;
+      Easing e{Easing::Kind::Steps};
+      e.steps = (uint16_t)count;
+      if (n == 2) {
+         if (equals_lower(a[1], "start") || equals_lower(a[1], "jump-start"))
+            e.jumpStart = true;
+         else if (!equals_lower(a[1], "end") && !equals_lower(a[1], "jump-end"))
+            return false;
+      }
+      out = e;
+      return true;
+   }
+   return false;
+}
+
+const ComputedStyle& initial_style()
+{
+   static const ComputedStyle kInitial{};
+   return kInitial;
+}
+
+bool apply_declaration(Prop p, std::string_view v, ComputedStyle& out)
+{
+   switch (p) {
+   case Prop::Display:
+      out.display = parse_display(v);
+      break;
+   case Prop::FlexDirection:
+      out.flexDirection = parse_flex_direction(v);
+      break;
+   case Prop::Flex: {
+      FlexShorthand fp = parse_flex(v);
+      out.flexGrow = fp.haveGrow ? fp.grow : 0.f;
+      out.flexShrink = fp.haveShrink ? fp.shrink : 0.f;
+      if (fp.basisPercent)
+         out.flexBasis = {fp.basisValue, Unit::Percent};
+      else if (fp.basisPoint)
+         out.flexBasis = {fp.basisValue, Unit::Px};
+      else
+         out.flexBasis = {0.f, Unit::Auto};
+      break;
+   }
+   case Prop::Width:
+      if (!parse_length(v, out.width))
+         return false;
+      break;
+   case Prop::Height:
+      if (!parse_length(v, out.height))
+         return false;
+      break;
+   case Prop::Left:
+      if (!parse_length(v, out.left, true))
+         return false;
+      break;
+   case Prop::Top:
+      if (!parse_length(v, out.top, true))
+         return false;
+      break;
+   case Prop::Right:
+      if (!parse_length(v, out.right, true))
+         return false;
+      break;
+   case Prop::Bottom:
+      if (!parse_length(v, out.bottom, true))
+         return false;
+      break;
+   case Prop::Position:
+      out.position = parse_position(v);
+      break;
+   case Prop::Overflow:
+      if (!parse_overflow(v, out.overflow))
+         return false;
+      break;
+   case Prop::Margin:
+      if (!parse_box_lengths(v, out.margin, true))
+         return false;
+      break;
+   case Prop::MarginTop:
+   case Prop::MarginRight:
+   case Prop::MarginBottom:
+   case Prop::MarginLeft:
+      if (!parse_length(v, out.margin[(int)p - (int)Prop::MarginTop], true))
+         return false;
+      break;
+   case Prop::Padding:
+      if (!parse_box_lengths(v, out.padding, false))
+         return false;
+      break;
+   case Prop::PaddingTop:
+   case Prop::PaddingRight:
+   case Prop::PaddingBottom:
+   case Prop::PaddingLeft:
+      if (!parse_length(v, out.padding[(int)p - (int)Prop::PaddingTop]))
+         return false;
+      break;
+   case Prop::Border: {
+      float w;
+      if (!parse_border_shorthand(v, w))
+         return false;
+      for (float& bw : out.borderWidth)
+         bw = w;
+      break;
+   }
+   case Prop::BorderWidth:
+      if (!parse_border_widths(v, out.borderWidth))
+         return false;
+      break;
+   case Prop::BorderTopWidth:
+   case Prop::BorderRightWidth:
+   case Prop::BorderBottomWidth:
+   case Prop::BorderLeftWidth:
+      if (!parse_border_width(v, out.borderWidth[(int)p - (int)Prop::BorderTopWidth]))
+         return false;
+      break;
+   case Prop::BackgroundColor:
+      if (!parse_color(v, out.backgroundColor))
+         return false;
+      break;
+   case Prop::Opacity:
+      if (!parse_opacity(v, out.opacity))
+         return false;
+      break;
+   case Prop::FontSize:
+      if (!parse_font_size(v, out.fontSize))
+         return false;
+      break;
+   case Prop::FontWeight:
+      if (!parse_font_weight(v, out.fontWeight))
+         return false;
+      break;
+   case Prop::FontStyle:
+      out.fontStyle = (equals_lower(v, "italic") || equals_lower(v, "oblique")) ? FontStyle::Italic : FontStyle::Normal;
+      break;
+   case Prop::FontFamily: {
+      std::string_view family = parse_font_family(v);
+      if (family.empty())
+         return false;
+      out.fontFamily = intern_font_family(family);
+      break;
+   }
+   case Prop::LineHeight:
+      if (!parse_line_height(v, out.lineHeight))
+         return false;
+      break;
+   case Prop::Color:
+      if (!parse_color(v, out.color))
+         return false;
+      break;
+   case Prop::Transform:
+      if (!parse_transform(v, out.transform))
+         return false;
+      break;
+   case Prop::Transition:
+      if (!parse_transition(v, out.transitions))
+         return false;
+      break;
+   case Prop::Animation:
+      if (!parse_animation(v, out.animations))
+         return false;
+      break;
+   case Prop::ZIndex:
+      if (!parse_z_index(v, out.zIndex, out.zIndexAuto))
+         return false;
+      break;
+   case Prop::WillChange:
+      if (!parse_will_change(v, out.willChange))
+         return false;
+      break;
+   default:
+      return false;
+   }
+   out.mark(p);
+   return true;
+}
+
+void compute_style(std::string_view cssText, ComputedStyle& out)
+{
+   out = ComputedStyle{};
+   if (cssText.empty())
+      return;
+   // Declarations are visited in source order, so a later duplicate overrides an earlier one.
+   DeclScanner scanner(cssText);
+   Decl d;
+   std::string_view bgShorthand;
+   while (scanner.next(d)) {
+      std::string_view v = d.value;
+      Prop p = prop_from_name(d.name);
+      if (p == Prop::Count) {
+         if (prop_hash(d.name) == kBackgroundShorthand && equals_lower(d.name, "background"))
+            bgShorthand = v;
+         continue;
+      }
+      apply_declaration(p, v, out);
+   }
+   // `background` only contributes a colour when `background-color` is absent.
+   if (!bgShorthand.empty() && !out.has(Prop::BackgroundColor) && find_color(bgShorthand, out.backgroundColor))
+      out.mark(Prop::BackgroundColor);
+}
+
+} // namespace css
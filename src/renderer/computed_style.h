@@ -0,0 +1,234 @@
+// computed_style.h - typed inline style resolved once per style change (layout/paint read fields directly)
+#pragma once
+#include <cstdint>
+#include <include/core/SkColor.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace css {
+
+enum class Unit : uint8_t { None, Px, Percent, Auto };
+
+struct Length {
+   float value = 0.f;
+   Unit unit = Unit::None; // None = not specified
+
+   bool isSet() const
+   {
+      return unit != Unit::None;
+   }
+};
+
+enum class Display : uint8_t { Unset, Flex, Block, None };
+enum class FlexDirection : uint8_t { Unset, Row, RowReverse, Column, ColumnReverse };
+enum class Position : uint8_t { Unset, Static, Relative, Absolute };
+enum class FontStyle : uint8_t { Unset, Normal, Italic };
+enum class Overflow : uint8_t { Unset, Visible, Hidden, Auto, Scroll };
+
+// Index into the per-edge arrays of ComputedStyle (CSS shorthand order)
+enum class Edge : uint8_t { Top, Right, Bottom, Left, Count };
+
+// Supported properties. Bit positions in ComputedStyle::setMask.
+enum class Prop : uint8_t {
+   Display,
+   FlexDirection,
+   Flex,
+   Width,
+   Height,
+   Left,
+   Top,
+   BackgroundColor,
+   Opacity,
+   Right,
+   Bottom,
+   Position,
+   Margin,
+   MarginTop,
+   MarginRight,
+   MarginBottom,
+   MarginLeft,
+   Padding,
+   PaddingTop,
+   PaddingRight,
+   PaddingBottom,
+   PaddingLeft,
+   Border,
+   BorderWidth,
+   BorderTopWidth,
+   BorderRightWidth,
+   BorderBottomWidth,
+   BorderLeftWidth,
+   FontSize,
+   FontWeight,
+   FontStyle,
+   FontFamily,
+   LineHeight,
+   Color,
+   Overflow,
+   Transform,
+   Transition,
+   Animation,
+   ZIndex,
+   WillChange,
+   Count
+};
+
+// transform: translate/rotate/scale functions folded into components applied in that order (as the individual
+// translate, rotate and scale properties are), so animations interpolate each component on its own
+struct Transform {
+   float translateX = 0.f, translateY = 0.f; // px
+   float rotate = 0.f;                       // degrees, clockwise
+   float scaleX = 1.f, scaleY = 1.f;
+
+   bool isIdentity() const
+   {
+      return translateX == 0.f && translateY == 0.f && rotate == 0.f && scaleX == 1.f && scaleY == 1.f;
+   }
+
+   bool operator==(const Transform&) const = default;
+};
+
+// <easing-function>: the ease keywords are cubic-bezier() presets
+struct Easing {
+   enum class Kind : uint8_t { Linear, CubicBezier, Steps };
+   Kind kind = Kind::CubicBezier;
+   float x1 = 0.25f, y1 = 0.1f, x2 = 0.25f, y2 = 1.f; // `ease`
+   uint16_t steps = 1;
+   bool jumpStart = false; // steps(n, start)
+};
+
+enum class FillMode : uint8_t { None, Forwards, Backwards, Both };
+enum class PlaybackDirection : uint8_t { Normal, Reverse, Alternate, AlternateReverse };
+
+// Timing of one animation (a running transition builds one from its TransitionSpec)
+struct AnimationTiming {
+   float duration = 0.f;   // ms, one iteration
+   float delay = 0.f;      // ms, may be negative
+   float iterations = 1.f; // INFINITY for `infinite`
+   PlaybackDirection direction = PlaybackDirection::Normal;
+   FillMode fill = FillMode::None;
+   Easing easing;
+};
+
+// One entry of the `transition` list; prop is Prop::Count for `all`
+struct TransitionSpec {
+   Prop prop = Prop::Count;
+   float duration = 0.f; // ms
+   float delay = 0.f;    // ms, may be negative
+   Easing easing;
+};
+
+// One entry of the `animation` list, naming an @keyframes rule
+struct AnimationSpec {
+   std::string name;
+   AnimationTiming timing;
+};
+
+// Lists are immutable once parsed and shared between copies of a style, so copying one never allocates
+using TransitionList = std::shared_ptr<const std::vector<TransitionSpec>>;
+using AnimationList = std::shared_ptr<const std::vector<AnimationSpec>>;
+
+// Font families are interned: styles hold a small id (0 = none) instead of a string
+using FontFamilyId = uint16_t;
+FontFamilyId intern_font_family(std::string_view name);
+const std::string& font_family_name(FontFamilyId id); // safe from any thread
+
+struct ComputedStyle {
+   Length width;
+   Length height;
+   Length left; // insets, applied by layout according to `position`
+   Length top;
+   Length right;
+   Length bottom;
+   Length margin[(int)Edge::Count];  // unset = 0
+   Length padding[(int)Edge::Count]; // unset = 0
+   float borderWidth[(int)Edge::Count] = {0.f, 0.f, 0.f, 0.f};
+   float flexGrow = 0.f;
+   float flexShrink = 0.f;
+   Length flexBasis;
+   SkColor4f backgroundColor = {0, 0, 0, 0}; // unpremultiplied
+   float opacity = 1.f;                      // 0..1
+   // Inherited text properties; only meaningful when has(Prop::...) (resolved against ancestors by layout)
+   Length fontSize;   // Px, or Percent of the inherited size (em units are stored as percent)
+   Length lineHeight; // Px, or Percent of the font size (unitless numbers are stored as percent); unset = normal
+   FontFamilyId fontFamily = 0; // first family of the list, unquoted
+   uint16_t fontWeight = 400;
+   SkColor4f color = {0, 0, 0, 1}; // text colour, unpremultiplied
+   Transform transform;
+   int32_t zIndex = 0;     // only meaningful when !zIndexAuto
+   TransitionList transitions; // null = no transitions
+   AnimationList animations;   // null = none; `none` entries dropped
+   uint64_t setMask = 0; // 1 << Prop for each declaration present
+   uint64_t serial = 0;  // stamped by whoever fills the style (next_style_serial): equal serials, equal contents
+   Display display = Display::Unset;
+   FlexDirection flexDirection = FlexDirection::Unset;
+   Position position = Position::Unset;
+   FontStyle fontStyle = FontStyle::Unset;
+   Overflow overflow = Overflow::Unset;
+   bool zIndexAuto = true; // z-index: auto (also when not declared)
+   bool willChange = false; // will-change names transform or opacity: the element gets its own compositor layer
+
+   // overflow: auto | scroll (the element is a scroll container)
+   bool scrolls() const
+   {
+      return overflow == Overflow::Auto || overflow == Overflow::Scroll;
+   }
+
+   bool has(Prop p) const
+   {
+      return (setMask >> (unsigned)p) & 1u;
+   }
+
+   void mark(Prop p)
+   {
+      setMask |= uint64_t(1) << (unsigned)p;
+   }
+};
+static_assert((unsigned)Prop::Count <= 64, "setMask holds one bit per Prop");
+// Styles are copied per element (cascade, animation, CSSOM writes): keep them flat and within this budget
+static_assert(sizeof(ComputedStyle) <= 280, "ComputedStyle grew past its size budget");
+
+// FNV-1a over an ASCII-lowercased property name; usable in constant expressions so property
+// dispatch compiles to a switch (duplicate case labels would make a collision a compile error).
+constexpr uint32_t prop_hash(std::string_view name)
+{
+   uint32_t h = 2166136261u;
+   for (char c : name) {
+      if (c >= 'A' && c <= 'Z')
+         c = (char)(c - 'A' + 'a');
+      h ^= (uint8_t)c;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+// Resolve a property name to its id; returns Prop::Count for unsupported names.
+Prop prop_from_name(std::string_view name);
+
+// CSS name of a property ("background-color")
+std::string_view prop_name(Prop p);
+
+// What a change to one property invalidates: the paint record only, the element's box, or (inherited text
+// properties) the box and every text leaf below it
+enum class PropGroup : uint8_t { Paint, Layout, Inherited };
+PropGroup prop_group(Prop p);
+
+// Process-unique, never 0 (0 is the initial style)
+uint64_t next_style_serial();
+
+// Default-initialised style, used for elements without an inline style.
+const ComputedStyle& initial_style();
+
+// Single pass over cssText filling every supported field of `out` (previous contents are discarded).
+void compute_style(std::string_view cssText, ComputedStyle& out);
+
+// <easing-function> value; false for anything else
+bool parse_easing(std::string_view value, Easing& out);
+
+// Apply one declaration on top of `out` and mark it set, as compute_style does for each declaration in turn; false
+// when the value does not parse. Lets a CSSOM property write update a style without re-reading its cssText.
+bool apply_declaration(Prop p, std::string_view value, ComputedStyle& out);
+
+} // namespace css
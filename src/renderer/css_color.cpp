@@ -0,0 +1,540 @@
+#include "css_color.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+
+namespace css {
+namespace {
+
+struct NamedColor {
+   std::string_view name;
+   uint32_t argb;
+};
+
+// CSS Color 4 named colours, plus transparent
+constexpr NamedColor kNamedColors[] = {
+    {"aliceblue", 0xFFF0F8FF},
+    {"antiquewhite", 0xFFFAEBD7},
+    {"aqua", 0xFF00FFFF},
+    {"aquamarine", 0xFF7FFFD4},
+    {"azure", 0xFFF0FFFF},
+    {"beige", 0xFFF5F5DC},
+    {"bisque", 0xFFFFE4C4},
+    {"black", 0xFF000000},
+    {"blanchedalmond", 0xFFFFEBCD},
+    {"blue", 0xFF0000FF},
+    {"blueviolet", 0xFF8A2BE2},
+    {"brown", 0xFFA52A2A},
+    {"burlywood", 0xFFDEB887},
+    {"cadetblue", 0xFF5F9EA0},
+    {"chartreuse", 0xFF7FFF00},
+    {"chocolate", 0xFFD2691E},
+    {"coral", 0xFFFF7F50},
+    {"cornflowerblue", 0xFF6495ED},
+    {"cornsilk", 0xFFFFF8DC},
+    {"crimson", 0xFFDC143C},
+    {"cyan", 0xFF00FFFF},
+    {"darkblue", 0xFF00008B},
+    {"darkcyan", 0xFF008B8B},
+    {"darkgoldenrod", 0xFFB8860B},
+    {"darkgray", 0xFFA9A9A9},
+    {"darkgreen", 0xFF006400},
+    {"darkgrey", 0xFFA9A9A9},
+    {"darkkhaki", 0xFFBDB76B},
+    {"darkmagenta", 0xFF8B008B},
+    {"darkolivegreen", 0xFF556B2F},
+    {"darkorange", 0xFFFF8C00},
+    {"darkorchid", 0xFF9932CC},
+    {"darkred", 0xFF8B0000},
+    {"darksalmon", 0xFFE9967A},
+    {"darkseagreen", 0xFF8FBC8F},
+    {"darkslateblue", 0xFF483D8B},
+    {"darkslategray", 0xFF2F4F4F},
+    {"darkslategrey", 0xFF2F4F4F},
+    {"darkturquoise", 0xFF00CED1},
+    {"darkviolet", 0xFF9400D3},
+    {"deeppink", 0xFFFF1493},
+    {"deepskyblue", 0xFF00BFFF},
+    {"dimgray", 0xFF696969},
+    {"dimgrey", 0xFF696969},
+    {"dodgerblue", 0xFF1E90FF},
+    {"firebrick", 0xFFB22222},
+    {"floralwhite", 0xFFFFFAF0},
+    {"forestgreen", 0xFF228B22},
+    {"fuchsia", 0xFFFF00FF},
+    {"gainsboro", 0xFFDCDCDC},
+    {"ghostwhite", 0xFFF8F8FF},
+    {"gold", 0xFFFFD700},
+    {"goldenrod", 0xFFDAA520},
+    {"gray", 0xFF808080},
+    {"green", 0xFF008000},
+    {"greenyellow", 0xFFADFF2F},
+    {"grey", 0xFF808080},
+    {"honeydew", 0xFFF0FFF0},
+    {"hotpink", 0xFFFF69B4},
+    {"indianred", 0xFFCD5C5C},
+    {"indigo", 0xFF4B0082},
+    {"ivory", 0xFFFFFFF0},
+    {"khaki", 0xFFF0E68C},
+    {"lavender", 0xFFE6E6FA},
+    {"lavenderblush", 0xFFFFF0F5},
+    {"lawngreen", 0xFF7CFC00},
+    {"lemonchiffon", 0xFFFFFACD},
+    {"lightblue", 0xFFADD8E6},
+    {"lightcoral", 0xFFF08080},
+    {"lightcyan", 0xFFE0FFFF},
+    {"lightgoldenrodyellow", 0xFFFAFAD2},
+    {"lightgray", 0xFFD3D3D3},
+    {"lightgreen", 0xFF90EE90},
+    {"lightgrey", 0xFFD3D3D3},
+    {"lightpink", 0xFFFFB6C1},
+    {"lightsalmon", 0xFFFFA07A},
+    {"lightseagreen", 0xFF20B2AA},
+    {"lightskyblue", 0xFF87CEFA},
+    {"lightslategray", 0xFF778899},
+    {"lightslategrey", 0xFF778899},
+    {"lightsteelblue", 0xFFB0C4DE},
+    {"lightyellow", 0xFFFFFFE0},
+    {"lime", 0xFF00FF00},
+    {"limegreen", 0xFF32CD32},
+    {"linen", 0xFFFAF0E6},
+    {"magenta", 0xFFFF00FF},
+    {"maroon", 0xFF800000},
+    {"mediumaquamarine", 0xFF66CDAA},
+    {"mediumblue", 0xFF0000CD},
+    {"mediumorchid", 0xFFBA55D3},
+    {"mediumpurple", 0xFF9370DB},
+    {"mediumseagreen", 0xFF3CB371},
+    {"mediumslateblue", 0xFF7B68EE},
+    {"mediumspringgreen", 0xFF00FA9A},
+    {"mediumturquoise", 0xFF48D1CC},
+    {"mediumvioletred", 0xFFC71585},
+    {"midnightblue", 0xFF191970},
+    {"mintcream", 0xFFF5FFFA},
+    {"mistyrose", 0xFFFFE4E1},
+    {"moccasin", 0xFFFFE4B5},
+    {"navajowhite", 0xFFFFDEAD},
+    {"navy", 0xFF000080},
+    {"oldlace", 0xFFFDF5E6},
+    {"olive", 0xFF808000},
+    {"olivedrab", 0xFF6B8E23},
+    {"orange", 0xFFFFA500},
+    {"orangered", 0xFFFF4500},
+    {"orchid", 0xFFDA70D6},
+    {"palegoldenrod", 0xFFEEE8AA},
+    {"palegreen", 0xFF98FB98},
+    {"paleturquoise", 0xFFAFEEEE},
+    {"palevioletred", 0xFFDB7093},
+    {"papayawhip", 0xFFFFEFD5},
+    {"peachpuff", 0xFFFFDAB9},
+    {"peru", 0xFFCD853F},
+    {"pink", 0xFFFFC0CB},
+    {"plum", 0xFFDDA0DD},
+    {"powderblue", 0xFFB0E0E6},
+    {"purple", 0xFF800080},
+    {"rebeccapurple", 0xFF663399},
+    {"red", 0xFFFF0000},
+    {"rosybrown", 0xFFBC8F8F},
+    {"royalblue", 0xFF4169E1},
+    {"saddlebrown", 0xFF8B4513},
+    {"salmon", 0xFFFA8072},
+    {"sandybrown", 0xFFF4A460},
+    {"seagreen", 0xFF2E8B57},
+    {"seashell", 0xFFFFF5EE},
+    {"sienna", 0xFFA0522D},
+    {"silver", 0xFFC0C0C0},
+    {"skyblue", 0xFF87CEEB},
+    {"slateblue", 0xFF6A5ACD},
+    {"slategray", 0xFF708090},
+    {"slategrey", 0xFF708090},
+    {"snow", 0xFFFFFAFA},
+    {"springgreen", 0xFF00FF7F},
+    {"steelblue", 0xFF4682B4},
+    {"tan", 0xFFD2B48C},
+    {"teal", 0xFF008080},
+    {"thistle", 0xFFD8BFD8},
+    {"tomato", 0xFFFF6347},
+    {"transparent", 0x00000000},
+    {"turquoise", 0xFF40E0D0},
+    {"violet", 0xFFEE82EE},
+    {"wheat", 0xFFF5DEB3},
+    {"white", 0xFFFFFFFF},
+    {"whitesmoke", 0xFFF5F5F5},
+    {"yellow", 0xFFFFFF00},
+    {"yellowgreen", 0xFF9ACD32},
+};
+
+constexpr size_t kNamedCount = std::size(kNamedColors);
+constexpr uint32_t kSlotBits = 12;
+constexpr uint32_t kSlotCount = 1u << kSlotBits;
+constexpr uint8_t kEmptySlot = 0xFF;
+static_assert(kNamedCount < kEmptySlot, "slot indices are bytes");
+
+// FNV-1a over ASCII-lowercased bytes, finalized and reduced to a slot. Non-letters hash to something; the name
+// comparison after the lookup rejects them.
+constexpr uint32_t name_slot(std::string_view s, uint32_t seed)
+{
+   uint32_t h = 2166136261u ^ seed;
+   for (char c : s) {
+      h ^= (uint8_t)c | 0x20u;
+      h *= 16777619u;
+   }
+   h ^= h >> 15;
+   h *= 0x2c1b3c6du;
+   h ^= h >> 12;
+   return h & (kSlotCount - 1);
+}
+
+constexpr bool seed_is_perfect(uint32_t seed)
+{
+   uint64_t used[kSlotCount / 64] = {};
+   for (const NamedColor& c : kNamedColors) {
+      uint32_t slot = name_slot(c.name, seed);
+      if (used[slot / 64] & (uint64_t(1) << (slot % 64)))
+         return false;
+      used[slot / 64] |= uint64_t(1) << (slot % 64);
+   }
+   return true;
+}
+
+constexpr uint32_t find_seed()
+{
+   uint32_t seed = 0;
+   while (!seed_is_perfect(seed))
+      ++seed;
+   return seed;
+}
+
+// Chosen at compile time so every name lands in its own slot: one hash and one compare per lookup
+constexpr uint32_t kSeed = find_seed();
+
+struct SlotTable {
+   uint8_t index[kSlotCount];
+};
+
+constexpr SlotTable build_slots()
+{
+   SlotTable t{};
+   for (uint8_t& i : t.index)
+      i = kEmptySlot;
+   for (size_t i = 0; i < kNamedCount; ++i)
+      t.index[name_slot(kNamedColors[i].name, kSeed)] = (uint8_t)i;
+   return t;
+}
+
+constexpr SlotTable kSlots = build_slots();
+
+constexpr bool equals_lower(std::string_view s, std::string_view lowerWord)
+{
+   if (s.size() != lowerWord.size())
+      return false;
+   for (size_t i = 0; i < s.size(); ++i) {
+      char c = s[i];
+      if (c >= 'A' && c <= 'Z')
+         c = (char)(c + ('a' - 'A'));
+      if (c != lowerWord[i])
+         return false;
+   }
+   return true;
+}
+
+bool is_space(char c)
+{
+   return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+std::string_view trim(std::string_view s)
+{
+   while (!s.empty() && is_space(s.front()))
+      s.remove_prefix(1);
+   while (!s.empty() && is_space(s.back()))
+      s.remove_suffix(1);
+   return s;
+}
+
+SkColor4f from_argb(uint32_t argb)
+{
+   return {((argb >> 16) & 0xFF) / 255.f, ((argb >> 8) & 0xFF) / 255.f, (argb & 0xFF) / 255.f,
+           (argb >> 24) / 255.f};
+}
+
+bool parse_named(std::string_view name, SkColor4f& out)
+{
+   if (name.size() < 3 || name.size() > 20) // "red" .. "lightgoldenrodyellow"
+      return false;
+   uint8_t i = kSlots.index[name_slot(name, kSeed)];
+   if (i == kEmptySlot || !equals_lower(name, kNamedColors[i].name))
+      return false;
+   out = from_argb(kNamedColors[i].argb);
+   return true;
+}
+
+int hex_digit(char c)
+{
+   if (c >= '0' && c <= '9')
+      return c - '0';
+   if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+   if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+   return -1;
+}
+
+// Digits after '#': rgb, rgba, rrggbb or rrggbbaa
+bool parse_hex(std::string_view digits, SkColor4f& out)
+{
+   const size_t n = digits.size();
+   if (n != 3 && n != 4 && n != 6 && n != 8)
+      return false;
+   int v[8];
+   for (size_t i = 0; i < n; ++i) {
+      if ((v[i] = hex_digit(digits[i])) < 0)
+         return false;
+   }
+   const bool shortForm = n <= 4;
+   auto channel = [&](size_t k) { return shortForm ? v[k] * 17 : v[2 * k] * 16 + v[2 * k + 1]; };
+   const bool hasAlpha = n == 4 || n == 8;
+   out = {channel(0) / 255.f, channel(1) / 255.f, channel(2) / 255.f, hasAlpha ? channel(3) / 255.f : 1.f};
+   return true;
+}
+
+// One argument of rgb()/hsl(): a number, percentage, dimension (hue angles) or `none`
+struct Component {
+   enum Kind { Number, Percent, Dimension, None } kind = Number;
+   float value = 0.f;
+   std::string_view unit;
+};
+
+class ArgReader {
+ public:
+   explicit ArgReader(std::string_view s) : s_(s)
+   {
+   }
+
+   bool atEnd()
+   {
+      skipSpace();
+      return i_ >= s_.size();
+   }
+
+   bool eat(char c)
+   {
+      skipSpace();
+      if (i_ < s_.size() && s_[i_] == c) {
+         ++i_;
+         return true;
+      }
+      return false;
+   }
+
+   bool read(Component& out)
+   {
+      skipSpace();
+      if (equals_lower(s_.substr(i_, 4), "none")) {
+         i_ += 4;
+         out = {Component::None, 0.f, {}};
+         return true;
+      }
+      double v;
+      if (!readNumber(v))
+         return false;
+      out.value = (float)v;
+      out.unit = {};
+      if (i_ < s_.size() && s_[i_] == '%') {
+         ++i_;
+         out.kind = Component::Percent;
+         return true;
+      }
+      size_t start = i_;
+      while (i_ < s_.size() && ((s_[i_] | 0x20) >= 'a' && (s_[i_] | 0x20) <= 'z'))
+         ++i_;
+      out.kind = i_ > start ? Component::Dimension : Component::Number;
+      out.unit = s_.substr(start, i_ - start);
+      return true;
+   }
+
+ private:
+   void skipSpace()
+   {
+      while (i_ < s_.size() && is_space(s_[i_]))
+         ++i_;
+   }
+
+   // [+-]? digits [. digits] [e [+-] digits], at least one digit in the mantissa
+   bool readNumber(double& out)
+   {
+      size_t i = i_;
+      const size_t n = s_.size();
+      double sign = 1.0;
+      if (i < n && (s_[i] == '+' || s_[i] == '-'))
+         sign = s_[i++] == '-' ? -1.0 : 1.0;
+      double mant = 0.0;
+      int digits = 0, fracDigits = 0;
+      for (; i < n && s_[i] >= '0' && s_[i] <= '9'; ++i, ++digits)
+         mant = mant * 10.0 + (s_[i] - '0');
+      if (i + 1 < n && s_[i] == '.' && s_[i + 1] >= '0' && s_[i + 1] <= '9') {
+         for (++i; i < n && s_[i] >= '0' && s_[i] <= '9'; ++i, ++digits, ++fracDigits)
+            mant = mant * 10.0 + (s_[i] - '0');
+      }
+      if (digits == 0)
+         return false;
+      int exp = -fracDigits;
+      // An exponent only if digits follow; otherwise the 'e' starts a unit
+      if (i + 1 < n && (s_[i] | 0x20) == 'e') {
+         size_t j = i + 1;
+         int expSign = 1;
+         if (s_[j] == '+' || s_[j] == '-')
+            expSign = s_[j++] == '-' ? -1 : 1;
+         if (j < n && s_[j] >= '0' && s_[j] <= '9') {
+            int e = 0;
+            for (; j < n && s_[j] >= '0' && s_[j] <= '9'; ++j)
+               e = std::min(e * 10 + (s_[j] - '0'), 400);
+            exp += expSign * e;
+            i = j;
+         }
+      }
+      out = sign * mant * std::pow(10.0, exp);
+      i_ = i;
+      return true;
+   }
+
+   std::string_view s_;
+   size_t i_ = 0;
+};
+
+float clamp01(float v)
+{
+   return std::min(1.f, std::max(0.f, v));
+}
+
+// Three components then an optional alpha, in either the legacy comma form (a, b, c[, alpha]) or the modern
+// space form (a b c[ / alpha]). Alpha defaults to 1.
+bool read_arguments(std::string_view args, Component (&c)[3], float& alpha)
+{
+   ArgReader r(args);
+   if (!r.read(c[0]))
+      return false;
+   const bool legacy = r.eat(',');
+   if (!r.read(c[1]) || (legacy && !r.eat(',')) || !r.read(c[2]))
+      return false;
+   alpha = 1.f;
+   if (legacy ? r.eat(',') : r.eat('/')) {
+      Component a;
+      if (!r.read(a) || a.kind == Component::Dimension)
+         return false;
+      alpha = a.kind == Component::Percent ? a.value / 100.f : a.kind == Component::None ? 0.f : a.value;
+   }
+   alpha = clamp01(alpha);
+   return r.atEnd();
+}
+
+bool parse_rgb(std::string_view args, SkColor4f& out)
+{
+   Component c[3];
+   float alpha;
+   if (!read_arguments(args, c, alpha))
+      return false;
+   float rgb[3];
+   for (int i = 0; i < 3; ++i) {
+      if (c[i].kind == Component::Dimension)
+         return false;
+      rgb[i] = c[i].kind == Component::Percent ? c[i].value / 100.f
+               : c[i].kind == Component::None  ? 0.f
+                                               : c[i].value / 255.f;
+      rgb[i] = clamp01(rgb[i]);
+   }
+   out = {rgb[0], rgb[1], rgb[2], alpha};
+   return true;
+}
+
+bool parse_hsl(std::string_view args, SkColor4f& out)
+{
+   Component c[3];
+   float alpha;
+   if (!read_arguments(args, c, alpha))
+      return false;
+   float hue = c[0].value; // degrees
+   if (c[0].kind == Component::Dimension) {
+      if (equals_lower(c[0].unit, "rad"))
+         hue = hue * 180.f / 3.14159265358979f;
+      else if (equals_lower(c[0].unit, "grad"))
+         hue = hue * 0.9f;
+      else if (equals_lower(c[0].unit, "turn"))
+         hue = hue * 360.f;
+      else if (!equals_lower(c[0].unit, "deg"))
+         return false;
+   }
+   else if (c[0].kind == Component::Percent) {
+      return false;
+   }
+   else if (c[0].kind == Component::None) {
+      hue = 0.f;
+   }
+   // Saturation and lightness: percentages, or plain numbers on the same 0..100 scale
+   if (c[1].kind == Component::Dimension || c[2].kind == Component::Dimension)
+      return false;
+   const float s = clamp01(c[1].kind == Component::None ? 0.f : c[1].value / 100.f);
+   const float l = clamp01(c[2].kind == Component::None ? 0.f : c[2].value / 100.f);
+   hue = std::fmod(hue, 360.f);
+   if (hue < 0.f)
+      hue += 360.f;
+   // CSS Color 4, section 7.1
+   auto f = [&](float n) {
+      float k = std::fmod(n + hue / 30.f, 12.f);
+      float a = s * std::min(l, 1.f - l);
+      return l - a * std::max(-1.f, std::min({k - 3.f, 9.f - k, 1.f}));
+   };
+   out = {f(0.f), f(8.f), f(4.f), alpha};
+   return true;
+}
+
+} // namespace
+
+bool parse_color(std::string_view value, SkColor4f& out)
+{
+   value = trim(value);
+   if (value.empty())
+      return false;
+   if (value.front() == '#')
+      return parse_hex(value.substr(1), out);
+   size_t open = value.find('(');
+   if (open == std::string_view::npos)
+      return parse_named(value, out);
+   if (value.back() != ')')
+      return false;
+   std::string_view fn = value.substr(0, open);
+   std::string_view args = value.substr(open + 1, value.size() - open - 2);
+   if (equals_lower(fn, "rgb") || equals_lower(fn, "rgba"))
+      return parse_rgb(args, out);
+   if (equals_lower(fn, "hsl") || equals_lower(fn, "hsla"))
+      return parse_hsl(args, out);
+   return false;
+}
+
+bool find_color(std::string_view value, SkColor4f& out)
+{
+   size_t i = 0;
+   const size_t n = value.size();
+   while (i < n) {
+      while (i < n && is_space(value[i]))
+         ++i;
+      size_t start = i;
+      int depth = 0;
+      for (; i < n && (depth > 0 || !is_space(value[i])); ++i) {
+         if (value[i] == '(')
+            ++depth;
+         else if (value[i] == ')' && depth > 0)
+            --depth;
+      }
+      // A trailing comma ends a background layer: "url(a.png), red"
+      std::string_view part = value.substr(start, i - start);
+      if (!part.empty() && part.back() == ',')
+         part.remove_suffix(1);
+      if (!part.empty() && parse_color(part, out))
+         return true;
+   }
+   return false;
+}
+
+} // namespace css
@@ -0,0 +1,15 @@
+// css_color.h - CSS <color> values: #hex, named colours, rgb()/rgba(), hsl()/hsla(). No allocation, no tokenizer.
+#pragma once
+#include <include/core/SkColor.h>
+#include <string_view>
+
+namespace css {
+
+// Parse one colour value (surrounding whitespace allowed). Fills an unpremultiplied colour with every component
+// in 0..1. Returns false for anything else, including currentcolor, which has no fixed value.
+bool parse_color(std::string_view value, SkColor4f& out);
+
+// First space-separated component of `value` that is a colour (the `background` shorthand).
+bool find_color(std::string_view value, SkColor4f& out);
+
+} // namespace css
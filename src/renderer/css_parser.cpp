@@ -1,218 +1,461 @@
 #include "css_parser.h"
+#include <algorithm>
 #include <cctype>
-#include <cmath>
 #include <lexbor/css/syntax/tokenizer.h>
 
 namespace css {
-Decls parse_inline(const std::string& cssText)
+namespace {
+// Initialised tokenizers are kept per thread and cleaned between uses instead of being
+// created/initialised/destroyed for every parse call.
+struct TokenizerPool {
+   std::vector<lxb_css_syntax_tokenizer_t*> free;
+
+   ~TokenizerPool()
+   {
+      for (auto* t : free)
+         lxb_css_syntax_tokenizer_destroy(t);
+   }
+};
+
+thread_local TokenizerPool t_pool;
+
+lxb_css_syntax_tokenizer_t* acquire_tokenizer(std::string_view src)
+{
+   lxb_css_syntax_tokenizer_t* tkz = nullptr;
+   if (!t_pool.free.empty()) {
+      tkz = t_pool.free.back();
+      t_pool.free.pop_back();
+   }
+   else {
+      tkz = lxb_css_syntax_tokenizer_create();
+      if (!tkz)
+         return nullptr;
+      if (lxb_css_syntax_tokenizer_init(tkz) != LXB_STATUS_OK) {
+         lxb_css_syntax_tokenizer_destroy(tkz);
+         return nullptr;
+      }
+   }
+   lxb_css_syntax_tokenizer_buffer_set(tkz, (const lxb_char_t*)src.data(), src.size());
+   return tkz;
+}
+
+void release_tokenizer(lxb_css_syntax_tokenizer_t* tkz)
 {
-   Decls out;
-   if (cssText.empty())
-      return out;
-   lxb_css_syntax_tokenizer_t* tkz = lxb_css_syntax_tokenizer_create();
    if (!tkz)
-      return out;
-   if (lxb_css_syntax_tokenizer_init(tkz) != LXB_STATUS_OK) {
-      lxb_css_syntax_tokenizer_destroy(tkz);
-      return out;
+      return;
+   lxb_css_syntax_tokenizer_clean(tkz);
+   t_pool.free.push_back(tkz);
+}
+
+// Scoped borrow for the single-value parsers below
+struct TokenizerLease {
+   explicit TokenizerLease(std::string_view src) : tkz(acquire_tokenizer(src))
+   {
    }
-   lxb_css_syntax_tokenizer_buffer_set(tkz, (const lxb_char_t*)cssText.data(), cssText.size());
-   std::string name, value;
-   bool inName = true;
+
+   ~TokenizerLease()
+   {
+      release_tokenizer(tkz);
+   }
+
+   TokenizerLease(const TokenizerLease&) = delete;
+   TokenizerLease& operator=(const TokenizerLease&) = delete;
+
+   lxb_css_syntax_tokenizer_t* tkz;
+};
+
+// Source slice covered by a token (tokens reference the buffer passed to buffer_set)
+inline std::string_view token_text(const lxb_css_syntax_token_t* tok)
+{
+   return {(const char*)tok->types.base.begin, tok->types.base.length};
+}
+} // namespace
+
+DeclScanner::DeclScanner(std::string_view cssText) : src_(cssText)
+{
+   if (!cssText.empty())
+      tkz_ = acquire_tokenizer(cssText);
+   done_ = (tkz_ == nullptr);
+}
+
+DeclScanner::~DeclScanner()
+{
+   release_tokenizer(tkz_);
+}
+
+bool DeclScanner::next(Decl& out)
+{
+   // Whitespace is never part of a range, so [begin, end) spans are already trimmed.
+   const char* nameBegin = nullptr;
+   const char* nameEnd = nullptr;
+   const char* valueBegin = nullptr;
+   const char* valueEnd = nullptr;
    bool seenColon = false;
-   auto trim = [](std::string s) {
-      size_t a = s.find_first_not_of(" \t\n\r");
-      size_t b = s.find_last_not_of(" \t\n\r");
-      if (a == std::string::npos)
-         return std::string();
-      return s.substr(a, b - a + 1);
+   auto complete = [&]() {
+      if (!nameBegin || !valueBegin)
+         return false;
+      out.name = std::string_view(nameBegin, (size_t)(nameEnd - nameBegin));
+      out.value = std::string_view(valueBegin, (size_t)(valueEnd - valueBegin));
+      return true;
    };
-   auto flush = [&]() {
-      if (!name.empty() && !value.empty()) {
-         auto n = trim(name);
-         auto v = trim(value);
-         if (!n.empty() && !v.empty())
-            out.kv[n] = v;
-      }
-      name.clear();
-      value.clear();
-      inName = true;
-      seenColon = false;
-   };
-   while (true) {
-      lxb_css_syntax_token_t* tok = lxb_css_syntax_token(tkz);
-      if (!tok)
-         break;
-      if (tok->type == LXB_CSS_SYNTAX_TOKEN__EOF) {
-         flush();
-         break;
+   while (!done_) {
+      lxb_css_syntax_token_t* tok = lxb_css_syntax_token(tkz_);
+      if (!tok || tok->type == LXB_CSS_SYNTAX_TOKEN__EOF) {
+         done_ = true;
+         return complete();
       }
       switch (tok->type) {
       case LXB_CSS_SYNTAX_TOKEN_SEMICOLON:
-         flush();
-         break;
-      case LXB_CSS_SYNTAX_TOKEN_COLON:
-         inName = false;
-         seenColon = true;
-         break;
+         lxb_css_syntax_token_consume(tkz_);
+         if (complete())
+            return true;
+         nameBegin = nameEnd = valueBegin = valueEnd = nullptr;
+         seenColon = false;
+         continue;
       case LXB_CSS_SYNTAX_TOKEN_WHITESPACE:
-         if (!inName && seenColon && !value.empty() && value.back() != ' ')
-            value.push_back(' ');
          break;
+      case LXB_CSS_SYNTAX_TOKEN_COLON:
+         if (!seenColon) {
+            seenColon = true;
+            break;
+         }
+         [[fallthrough]];
       default: {
-         const char* d = (const char*)tok->types.base.begin;
-         size_t len = tok->types.base.length;
-         if (len) {
-            if (inName)
-               name.append(d, len);
-            else if (seenColon)
-               value.append(d, len);
+         std::string_view t = token_text(tok);
+         if (t.empty())
+            break;
+         if (!seenColon) {
+            if (!nameBegin)
+               nameBegin = t.data();
+            nameEnd = t.data() + t.size();
+         }
+         else {
+            if (!valueBegin)
+               valueBegin = t.data();
+            valueEnd = t.data() + t.size();
          }
       } break;
       }
-      lxb_css_syntax_token_consume(tkz);
+      lxb_css_syntax_token_consume(tkz_);
    }
-   lxb_css_syntax_tokenizer_destroy(tkz);
+   return false;
+}
+
+Decls parse_inline(std::string_view cssText)
+{
+   Decls out;
+   DeclScanner scanner(cssText);
+   Decl d;
+   while (scanner.next(d))
+      out.kv[std::string(d.name)] = std::string(d.value);
    return out;
 }
 
-bool parse_number_unit(const std::string& value, float& out, std::string& unit)
+namespace {
+std::string_view trim_ascii(std::string_view s)
 {
-   out = -1.f;
-   unit.clear();
-   if (value.empty())
-      return false;
-   lxb_css_syntax_tokenizer_t* tkz = lxb_css_syntax_tokenizer_create();
-   if (!tkz)
-      return false;
-   if (lxb_css_syntax_tokenizer_init(tkz) != LXB_STATUS_OK) {
-      lxb_css_syntax_tokenizer_destroy(tkz);
-      return false;
-   }
-   lxb_css_syntax_tokenizer_buffer_set(tkz, (const lxb_char_t*)value.data(), value.size());
-   while (true) {
-      lxb_css_syntax_token_t* tok = lxb_css_syntax_token(tkz);
-      if (!tok)
+   while (!s.empty() && std::isspace((unsigned char)s.front()))
+      s.remove_prefix(1);
+   while (!s.empty() && std::isspace((unsigned char)s.back()))
+      s.remove_suffix(1);
+   return s;
+}
+
+std::string lower_ascii(std::string_view s)
+{
+   std::string out(s);
+   for (char& c : out)
+      c = (char)std::tolower((unsigned char)c);
+   return out;
+}
+} // namespace
+
+RuleScanner::RuleScanner(std::string_view sheetText)
+{
+   if (!sheetText.empty())
+      tkz_ = acquire_tokenizer(sheetText);
+   done_ = (tkz_ == nullptr);
+}
+
+RuleScanner::~RuleScanner()
+{
+   release_tokenizer(tkz_);
+}
+
+bool RuleScanner::next(RuleText& out)
+{
+   const char* preludeBegin = nullptr;
+   const char* preludeEnd = nullptr;
+   bool atRule = false;
+   while (!done_) {
+      lxb_css_syntax_token_t* tok = lxb_css_syntax_token(tkz_);
+      if (!tok || tok->type == LXB_CSS_SYNTAX_TOKEN__EOF) {
+         done_ = true;
+         return false;
+      }
+      switch (tok->type) {
+      case LXB_CSS_SYNTAX_TOKEN_WHITESPACE:
+      case LXB_CSS_SYNTAX_TOKEN_COMMENT:
+      case LXB_CSS_SYNTAX_TOKEN_CDO:
+      case LXB_CSS_SYNTAX_TOKEN_CDC:
          break;
-      if (tok->type == LXB_CSS_SYNTAX_TOKEN__EOF)
+      case LXB_CSS_SYNTAX_TOKEN_SEMICOLON:
+      case LXB_CSS_SYNTAX_TOKEN_RC_BRACKET:
+         // End of a statement at-rule (@import ...;) or stray input: start over
+         preludeBegin = preludeEnd = nullptr;
+         atRule = false;
          break;
-      if (tok->type == LXB_CSS_SYNTAX_TOKEN_NUMBER || tok->type == LXB_CSS_SYNTAX_TOKEN_DIMENSION ||
-          tok->type == LXB_CSS_SYNTAX_TOKEN_PERCENTAGE) {
-         const char* d = (const char*)tok->types.base.begin;
-         size_t len = tok->types.base.length;
-         if (len) {
-            std::string txt(d, len);
-            try {
-               out = std::stof(txt);
+      case LXB_CSS_SYNTAX_TOKEN_LC_BRACKET: {
+         std::string_view open = token_text(tok);
+         const char* blockBegin = open.data() + open.size();
+         const char* blockEnd = blockBegin;
+         lxb_css_syntax_token_consume(tkz_);
+         // Skip to the matching brace; nested blocks only occur inside at-rules, which are returned whole
+         for (int depth = 0; !done_;) {
+            tok = lxb_css_syntax_token(tkz_);
+            if (!tok || tok->type == LXB_CSS_SYNTAX_TOKEN__EOF) {
+               done_ = true; // unterminated block: it runs to the end of the sheet
+               break;
             }
-            catch (...) {
-               out = -1.f;
+            std::string_view t = token_text(tok);
+            if (tok->type == LXB_CSS_SYNTAX_TOKEN_RC_BRACKET && depth-- == 0) {
+               blockEnd = t.data();
+               lxb_css_syntax_token_consume(tkz_);
+               break;
             }
-            if (tok->type == LXB_CSS_SYNTAX_TOKEN_DIMENSION) {
-               size_t i = 0;
-               while (i < txt.size() &&
-                      (std::isdigit((unsigned char)txt[i]) || txt[i] == '+' || txt[i] == '-' || txt[i] == '.'))
-                  ++i;
-               unit = txt.substr(i);
-            }
-            else if (tok->type == LXB_CSS_SYNTAX_TOKEN_PERCENTAGE) {
-               unit = "%";
-            }
-            lxb_css_syntax_tokenizer_destroy(tkz);
-            return out >= 0;
+            if (tok->type == LXB_CSS_SYNTAX_TOKEN_LC_BRACKET)
+               ++depth;
+            if (!t.empty())
+               blockEnd = t.data() + t.size();
+            lxb_css_syntax_token_consume(tkz_);
+         }
+         if (preludeBegin) {
+            out.prelude = std::string_view(preludeBegin, (size_t)(preludeEnd - preludeBegin));
+            out.block = trim_ascii(std::string_view(blockBegin, (size_t)(blockEnd - blockBegin)));
+            out.atRule = atRule;
+            return true;
          }
+         preludeBegin = preludeEnd = nullptr;
+         atRule = false;
+         continue;
       }
-      lxb_css_syntax_token_consume(tkz);
+      default: {
+         std::string_view t = token_text(tok);
+         if (t.empty())
+            break;
+         if (!preludeBegin) {
+            preludeBegin = t.data();
+            atRule = tok->type == LXB_CSS_SYNTAX_TOKEN_AT_KEYWORD;
+         }
+         preludeEnd = t.data() + t.size();
+      } break;
+      }
+      lxb_css_syntax_token_consume(tkz_);
    }
-   lxb_css_syntax_tokenizer_destroy(tkz);
    return false;
 }
 
-bool parse_rgb_color(const std::string& value, int& r, int& g, int& b)
+namespace {
+struct SelectorToken {
+   lxb_css_syntax_token_type_t type;
+   std::string_view text;
+   char delim; // DELIM tokens only
+};
+
+uint32_t selector_specificity(const Selector& sel)
 {
-   r = g = b = 0;
-   if (value.empty())
-      return false;
-   lxb_css_syntax_tokenizer_t* tkz = lxb_css_syntax_tokenizer_create();
-   if (!tkz)
-      return false;
-   if (lxb_css_syntax_tokenizer_init(tkz) != LXB_STATUS_OK) {
-      lxb_css_syntax_tokenizer_destroy(tkz);
-      return false;
+   uint32_t ids = 0, classes = 0, types = 0;
+   for (const Compound& c : sel.compounds) {
+      ids += c.id.empty() ? 0 : 1;
+      classes += (uint32_t)(c.classes.size() + c.attrs.size());
+      types += c.tag.empty() ? 0 : 1;
    }
-   lxb_css_syntax_tokenizer_buffer_set(tkz, (const lxb_char_t*)value.data(), value.size());
-   auto is_name = [](const lxb_css_syntax_token_string_t& s, const char* want) {
-      size_t n = 0;
-      while (want[n] != '\0')
-         ++n;
-      if (s.length != n)
+   return std::min(ids, 255u) << 16 | std::min(classes, 255u) << 8 | std::min(types, 255u);
+}
+} // namespace
+
+bool parse_selector_list(std::string_view text, std::vector<Selector>& out)
+{
+   std::vector<SelectorToken> toks;
+   {
+      TokenizerLease lease(text);
+      if (!lease.tkz)
          return false;
-      for (size_t i = 0; i < n; ++i) {
-         if (std::tolower((unsigned char)s.data[i]) != std::tolower((unsigned char)want[i]))
-            return false;
+      while (true) {
+         lxb_css_syntax_token_t* tok = lxb_css_syntax_token(lease.tkz);
+         if (!tok || tok->type == LXB_CSS_SYNTAX_TOKEN__EOF)
+            break;
+         if (tok->type != LXB_CSS_SYNTAX_TOKEN_COMMENT) {
+            std::string_view t = token_text(tok);
+            toks.push_back({tok->type, t, tok->type == LXB_CSS_SYNTAX_TOKEN_DELIM && !t.empty() ? t[0] : '\0'});
+         }
+         lxb_css_syntax_token_consume(lease.tkz);
+      }
+   }
+   std::vector<Selector> parsed;
+   Selector sel; // compounds left to right while parsing
+   Compound cur;
+   bool curEmpty = true;
+   Combinator pending = Combinator::None;
+   auto begin_compound = [&]() {
+      if (curEmpty) {
+         cur.combinator = sel.compounds.empty() ? Combinator::None : pending;
+         pending = Combinator::None;
+         curEmpty = false;
       }
+   };
+   auto end_compound = [&]() {
+      if (!curEmpty) {
+         sel.compounds.push_back(std::move(cur));
+         cur = Compound{};
+         curEmpty = true;
+      }
+   };
+   auto end_selector = [&]() {
+      end_compound();
+      if (sel.compounds.empty() || pending == Combinator::Child)
+         return false; // empty selector or dangling '>'
+      // Each compound's combinator links it to its left neighbour, so reversing keeps the relations intact
+      std::reverse(sel.compounds.begin(), sel.compounds.end());
+      sel.specificity = selector_specificity(sel);
+      parsed.push_back(std::move(sel));
+      sel = Selector{};
+      pending = Combinator::None;
       return true;
    };
-   int nums[3] = {0, 0, 0};
-   int idx = 0;
-   bool ok = false;
-   bool in_func = false;
-   while (true) {
-      lxb_css_syntax_token_t* tok = lxb_css_syntax_token(tkz);
-      if (!tok)
+   size_t n = toks.size();
+   auto skip_ws = [&](size_t& i) {
+      while (i < n && toks[i].type == LXB_CSS_SYNTAX_TOKEN_WHITESPACE)
+         ++i;
+   };
+   for (size_t i = 0; i < n; ++i) {
+      const SelectorToken& t = toks[i];
+      switch (t.type) {
+      case LXB_CSS_SYNTAX_TOKEN_WHITESPACE:
+         if (!curEmpty) {
+            end_compound();
+            pending = Combinator::Descendant;
+         }
          break;
-      if (tok->type == LXB_CSS_SYNTAX_TOKEN__EOF)
+      case LXB_CSS_SYNTAX_TOKEN_COMMA:
+         if (!end_selector())
+            return false;
+         break;
+      case LXB_CSS_SYNTAX_TOKEN_IDENT:
+         if (!curEmpty)
+            return false; // a type selector only starts a compound
+         begin_compound();
+         cur.tag = lower_ascii(t.text);
+         break;
+      case LXB_CSS_SYNTAX_TOKEN_HASH:
+         begin_compound();
+         cur.id = std::string(t.text.substr(t.text.empty() || t.text[0] != '#' ? 0 : 1));
+         if (cur.id.empty())
+            return false;
          break;
-      if (!in_func && tok->type == LXB_CSS_SYNTAX_TOKEN_FUNCTION) {
-         if (is_name(tok->types.function, "rgb") || is_name(tok->types.function, "rgba")) {
-            in_func = true;
+      case LXB_CSS_SYNTAX_TOKEN_LS_BRACKET: {
+         begin_compound();
+         AttrSelector attr;
+         skip_ws(++i);
+         if (i >= n || toks[i].type != LXB_CSS_SYNTAX_TOKEN_IDENT)
+            return false;
+         attr.name = lower_ascii(toks[i].text);
+         skip_ws(++i);
+         if (i < n && toks[i].type == LXB_CSS_SYNTAX_TOKEN_DELIM && toks[i].delim == '=') {
+            skip_ws(++i);
+            if (i >= n || (toks[i].type != LXB_CSS_SYNTAX_TOKEN_IDENT && toks[i].type != LXB_CSS_SYNTAX_TOKEN_STRING))
+               return false;
+            std::string_view v = toks[i].text;
+            if (toks[i].type == LXB_CSS_SYNTAX_TOKEN_STRING && v.size() >= 2)
+               v = v.substr(1, v.size() - 2); // strip the quotes
+            attr.value = std::string(v);
+            attr.hasValue = true;
+            skip_ws(++i);
          }
-         lxb_css_syntax_token_consume(tkz);
-         continue;
+         if (i >= n || toks[i].type != LXB_CSS_SYNTAX_TOKEN_RS_BRACKET)
+            return false; // also rejects ~= |= ^= $= *=
+         cur.attrs.push_back(std::move(attr));
+         break;
       }
-      if (in_func) {
-         if (tok->type == LXB_CSS_SYNTAX_TOKEN_R_PARENTHESIS || tok->type == LXB_CSS_SYNTAX_TOKEN__EOF) {
-            ok = (idx == 3);
-            lxb_css_syntax_token_consume(tkz);
-            break;
+      case LXB_CSS_SYNTAX_TOKEN_DELIM:
+         if (t.delim == '*') {
+            if (!curEmpty)
+               return false;
+            begin_compound();
+         }
+         else if (t.delim == '.') {
+            if (i + 1 >= n || toks[i + 1].type != LXB_CSS_SYNTAX_TOKEN_IDENT)
+               return false;
+            begin_compound();
+            cur.classes.emplace_back(toks[++i].text);
          }
-         if (tok->type == LXB_CSS_SYNTAX_TOKEN_COMMA || tok->type == LXB_CSS_SYNTAX_TOKEN_WHITESPACE ||
-             tok->type == LXB_CSS_SYNTAX_TOKEN_L_PARENTHESIS) {
-            lxb_css_syntax_token_consume(tkz);
-            continue;
+         else if (t.delim == '>') {
+            end_compound();
+            if (sel.compounds.empty())
+               return false;
+            pending = Combinator::Child;
          }
-         if ((tok->type == LXB_CSS_SYNTAX_TOKEN_NUMBER || tok->type == LXB_CSS_SYNTAX_TOKEN_PERCENTAGE) && idx < 3) {
-            double v = tok->types.number.num;
-            if (tok->type == LXB_CSS_SYNTAX_TOKEN_PERCENTAGE)
-               v = v * 255.0 / 100.0;
-            v = std::max(0.0, std::min(255.0, v));
-            nums[idx++] = (int)std::lround(v);
-            lxb_css_syntax_token_consume(tkz);
-            continue;
+         else {
+            return false; // '+', '~' and anything else
          }
+         break;
+      default:
+         return false; // pseudo-classes, pseudo-elements, functions
       }
-      lxb_css_syntax_token_consume(tkz);
    }
-   r = nums[0];
-   g = nums[1];
-   b = nums[2];
-   lxb_css_syntax_tokenizer_destroy(tkz);
-   return ok;
+   if (!end_selector())
+      return false;
+   for (Selector& s : parsed)
+      out.push_back(std::move(s));
+   return true;
 }
 
-FlexShorthand parse_flex(const std::string& flexValue)
+bool parse_number_unit(std::string_view value, float& out, std::string_view& unit)
+{
+   return parse_dimension(value, out, unit) && out >= 0;
+}
+
+bool parse_dimension(std::string_view value, float& out, std::string_view& unit)
+{
+   out = -1.f;
+   unit = {};
+   if (value.empty())
+      return false;
+   TokenizerLease lease(value);
+   if (!lease.tkz)
+      return false;
+   while (true) {
+      lxb_css_syntax_token_t* tok = lxb_css_syntax_token(lease.tkz);
+      if (!tok || tok->type == LXB_CSS_SYNTAX_TOKEN__EOF)
+         break;
+      if (tok->type == LXB_CSS_SYNTAX_TOKEN_NUMBER || tok->type == LXB_CSS_SYNTAX_TOKEN_DIMENSION ||
+          tok->type == LXB_CSS_SYNTAX_TOKEN_PERCENTAGE) {
+         // The tokenizer has already converted the number; no text round-trip needed.
+         out = (float)tok->types.number.num;
+         if (tok->type == LXB_CSS_SYNTAX_TOKEN_DIMENSION) {
+            std::string_view t = token_text(tok);
+            size_t unitLen = std::min(t.size(), tok->types.dimension.str.length);
+            unit = t.substr(t.size() - unitLen);
+         }
+         else if (tok->type == LXB_CSS_SYNTAX_TOKEN_PERCENTAGE) {
+            unit = "%";
+         }
+         return true;
+      }
+      lxb_css_syntax_token_consume(lease.tkz);
+   }
+   return false;
+}
+
+FlexShorthand parse_flex(std::string_view flexValue)
 {
    FlexShorthand fp;
    if (flexValue.empty())
       return fp;
-   lxb_css_syntax_tokenizer_t* tkz = lxb_css_syntax_tokenizer_create();
-   if (!tkz)
-      return fp;
-   if (lxb_css_syntax_tokenizer_init(tkz) != LXB_STATUS_OK) {
-      lxb_css_syntax_tokenizer_destroy(tkz);
+   TokenizerLease lease(flexValue);
+   if (!lease.tkz)
       return fp;
-   }
-   lxb_css_syntax_tokenizer_buffer_set(tkz, (const lxb_char_t*)flexValue.data(), flexValue.size());
+   lxb_css_syntax_tokenizer_t* tkz = lease.tkz;
    int stage = 0;
    while (true) {
       lxb_css_syntax_token_t* tok = lxb_css_syntax_token(tkz);
@@ -224,46 +467,28 @@ FlexShorthand parse_flex(const std::string& flexValue)
          lxb_css_syntax_token_consume(tkz);
          continue;
       }
-      std::string txt;
-      const char* d = (const char*)tok->types.base.begin;
-      size_t len = tok->types.base.length;
-      if (len)
-         txt.assign(d, len);
+      const float num = (float)tok->types.number.num; // valid for NUMBER/PERCENTAGE/DIMENSION only
       switch (tok->type) {
       case LXB_CSS_SYNTAX_TOKEN_NUMBER: {
          if (stage == 0 && !fp.haveGrow) {
-            try {
-               fp.grow = std::stof(txt);
-               if (fp.grow < 0)
-                  fp.grow = 0;
-               fp.haveGrow = true;
-               stage = 1;
-            }
-            catch (...) {
-            }
+            fp.grow = num < 0 ? 0 : num;
+            fp.haveGrow = true;
+            stage = 1;
          }
          else if (stage <= 1 && !fp.haveShrink) {
-            try {
-               fp.shrink = std::stof(txt);
-               fp.haveShrink = true;
-               stage = 2;
-            }
-            catch (...) {
-            }
+            fp.shrink = num;
+            fp.haveShrink = true;
+            stage = 2;
          }
          else if (stage >= 1 && !fp.basisAuto && !fp.basisPercent && !fp.basisPoint) {
-            try {
-               fp.basisValue = std::stof(txt);
-               fp.basisPoint = true;
-               stage = 3;
-            }
-            catch (...) {
-            }
+            fp.basisValue = num;
+            fp.basisPoint = true;
+            stage = 3;
          }
          break;
       }
       case LXB_CSS_SYNTAX_TOKEN_IDENT: {
-         if (stage <= 2 && txt == "auto") {
+         if (stage <= 2 && token_text(tok) == "auto") {
             fp.basisAuto = true;
             stage = 3;
          }
@@ -271,30 +496,17 @@ FlexShorthand parse_flex(const std::string& flexValue)
       }
       case LXB_CSS_SYNTAX_TOKEN_PERCENTAGE: {
          if (stage <= 2 && !fp.basisPercent && !fp.basisPoint && !fp.basisAuto) {
-            try {
-               fp.basisValue = std::stof(txt);
-               fp.basisPercent = true;
-               stage = 3;
-            }
-            catch (...) {
-            }
+            fp.basisValue = num;
+            fp.basisPercent = true;
+            stage = 3;
          }
          break;
       }
       case LXB_CSS_SYNTAX_TOKEN_DIMENSION: {
          if (stage <= 2 && !fp.basisPoint && !fp.basisPercent && !fp.basisAuto) {
-            size_t i = 0;
-            while (i < txt.size() &&
-                   (std::isdigit((unsigned char)txt[i]) || txt[i] == '+' || txt[i] == '-' || txt[i] == '.'))
-               ++i;
-            std::string num = txt.substr(0, i);
-            try {
-               fp.basisValue = std::stof(num);
-               fp.basisPoint = true;
-               stage = 3;
-            }
-            catch (...) {
-            }
+            fp.basisValue = num;
+            fp.basisPoint = true;
+            stage = 3;
          }
          break;
       }
@@ -303,7 +515,6 @@ FlexShorthand parse_flex(const std::string& flexValue)
       }
       lxb_css_syntax_token_consume(tkz);
    }
-   lxb_css_syntax_tokenizer_destroy(tkz);
    if (fp.haveGrow && !fp.haveShrink && !fp.basisAuto && !fp.basisPercent && !fp.basisPoint)
       fp.basisAuto = true;
    return fp;
@@ -1,14 +1,93 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
+struct lxb_css_syntax_tokenizer; // lexbor (pooled per thread, see css_parser.cpp)
+
 namespace css {
+// One `name: value` declaration; both views slice the source text (trimmed, no copies).
+struct Decl {
+   std::string_view name;
+   std::string_view value;
+};
+
+// Streams declarations of an inline style. Borrows a tokenizer from the calling thread's pool for
+// its lifetime; the source text must outlive the scanner and every Decl it produced.
+class DeclScanner {
+ public:
+   explicit DeclScanner(std::string_view cssText);
+   ~DeclScanner();
+   DeclScanner(const DeclScanner&) = delete;
+   DeclScanner& operator=(const DeclScanner&) = delete;
+
+   bool next(Decl& out);
+
+ private:
+   lxb_css_syntax_tokenizer* tkz_ = nullptr;
+   std::string_view src_;
+   bool done_ = false;
+};
+
+// One rule of a style sheet; both views slice the sheet text (trimmed).
+struct RuleText {
+   std::string_view prelude; // selector list, or the at-keyword and its prelude ("@keyframes spin")
+   std::string_view block;   // declarations between the braces; an at-rule's raw contents (nested rules included)
+   bool atRule = false;
+};
+
+// Streams the rules of a style sheet (or of an at-rule's block, e.g. the keyframes of @keyframes). At-rules with a
+// block come back whole for the caller to interpret or drop; statement at-rules (@import ...;) are skipped. Same
+// tokenizer pooling and lifetime rules as DeclScanner.
+class RuleScanner {
+ public:
+   explicit RuleScanner(std::string_view sheetText);
+   ~RuleScanner();
+   RuleScanner(const RuleScanner&) = delete;
+   RuleScanner& operator=(const RuleScanner&) = delete;
+
+   bool next(RuleText& out);
+
+ private:
+   lxb_css_syntax_tokenizer* tkz_ = nullptr;
+   bool done_ = false;
+};
+
+// Selector subset: type, universal, #id, .class, [attr] and [attr=value] compounds joined by descendant or child
+// combinators. Pseudo-classes, pseudo-elements and sibling combinators are not supported.
+enum class Combinator : uint8_t { None, Descendant, Child };
+
+struct AttrSelector {
+   std::string name;
+   std::string value;
+   bool hasValue = false;
+};
+
+struct Compound {
+   std::string tag; // lowercase; empty matches any element
+   std::string id;
+   std::vector<std::string> classes;
+   std::vector<AttrSelector> attrs;
+   Combinator combinator = Combinator::None; // relation to the next compound to the left
+};
+
+struct Selector {
+   std::vector<Compound> compounds; // subject (rightmost) first
+   uint32_t specificity = 0;        // ids << 16 | (classes + attributes) << 8 | types
+};
+
+// Parse a comma-separated selector list; false (and nothing appended) when any selector in it is unsupported or
+// malformed, which drops the whole rule as CSS does for invalid selectors.
+bool parse_selector_list(std::string_view text, std::vector<Selector>& out);
+
+// Owning map form (allocates; prefer DeclScanner on hot paths).
 struct Decls {
    std::unordered_map<std::string, std::string> kv;
 };
 
-Decls parse_inline(const std::string& cssText);
+Decls parse_inline(std::string_view cssText);
 
 struct FlexShorthand {
    bool haveGrow = false;
@@ -21,8 +100,9 @@ struct FlexShorthand {
    float basisValue = 0;
 };
 
-FlexShorthand parse_flex(const std::string& flexValue);
-bool parse_number_unit(const std::string& value, float& outValue, std::string& outUnit);
-// Parse an rgb(R,G,B) color; returns true on success and fills 0..255 ints.
-bool parse_rgb_color(const std::string& value, int& r, int& g, int& b);
+FlexShorthand parse_flex(std::string_view flexValue);
+// First non-negative numeric token of `value`; `outUnit` slices the source ("px", "%", or empty for plain numbers).
+bool parse_number_unit(std::string_view value, float& outValue, std::string_view& outUnit);
+// Same as parse_number_unit but also accepts negative values (margins, insets).
+bool parse_dimension(std::string_view value, float& outValue, std::string_view& outUnit);
 } // namespace css
@@ -1,87 +1,624 @@
 #include "element_data.h"
+#include "renderer/animation.h"
+#include "renderer/renderer.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <strings.h>
 #include <yoga/Yoga.h>
 
-static std::unordered_map<dom::Element*, std::unique_ptr<DomElementRenderData>> g_renderData;
+static std::unordered_map<dom::Document*, std::unique_ptr<DocumentRenderData>> g_documentData;
+static RenderStore g_detachedStore; // elements created outside any document
+
+DomElementRenderData* RenderStore::allocate(dom::Element* el)
+{
+   uint32_t slot;
+   if (!freeSlots.empty()) {
+      slot = freeSlots.back();
+      freeSlots.pop_back();
+      boxes[slot] = LayoutBox{};
+      dirtyFlags[slot] = 0;
+      styleVersions[slot] = 0;
+      elements[slot] = el;
+      records[slot] = DomElementRenderData{};
+   }
+   else {
+      slot = (uint32_t)elements.size();
+      boxes.emplace_back();
+      dirtyFlags.push_back(0);
+      styleVersions.push_back(0);
+      elements.push_back(el);
+      records.emplace_back();
+   }
+   DomElementRenderData* rd = &records[slot];
+   rd->store = this;
+   rd->slot = slot;
+   return rd;
+}
+
+static YGConfigRef g_yogaConfig = nullptr;
+static float g_yogaPointScale = 1.f;
+
+void* yoga_shared_config()
+{
+   if (!g_yogaConfig) {
+      g_yogaConfig = YGConfigNew();
+      YGConfigSetPointScaleFactor(g_yogaConfig, g_yogaPointScale);
+   }
+   return g_yogaConfig;
+}
+
+bool yoga_set_point_scale(float scale)
+{
+   if (scale <= 0.f || scale == g_yogaPointScale)
+      return false;
+   g_yogaPointScale = scale;
+   YGConfigSetPointScaleFactor((YGConfigRef)yoga_shared_config(), scale);
+   return true;
+}
+
+// Keep at most this many idle nodes per pool; beyond it released nodes are freed
+static constexpr size_t kMaxPooledYogaNodes = 4096;
+
+YogaNodePool::YogaNodePool(YogaNodePool&& other) noexcept
+    : free(std::move(other.free)), created(other.created), reused(other.reused)
+{
+   other.free.clear();
+}
+
+YogaNodePool& YogaNodePool::operator=(YogaNodePool&& other) noexcept
+{
+   if (this != &other) {
+      for (void* n : free)
+         YGNodeFree((YGNodeRef)n);
+      free = std::move(other.free);
+      other.free.clear();
+      created = other.created;
+      reused = other.reused;
+   }
+   return *this;
+}
+
+YogaNodePool::~YogaNodePool()
+{
+   for (void* n : free)
+      YGNodeFree((YGNodeRef)n);
+}
+
+void* YogaNodePool::acquire()
+{
+   if (!free.empty()) {
+      void* n = free.back();
+      free.pop_back();
+      reused++;
+      return n;
+   }
+   created++;
+   return YGNodeNewWithConfig((YGConfigConstRef)yoga_shared_config());
+}
+
+void YogaNodePool::release(void* node)
+{
+   if (!node)
+      return;
+   YGNodeRef n = (YGNodeRef)node;
+   // Children belong to their own render-data records and are released through them.
+   if (YGNodeRef owner = YGNodeGetOwner(n))
+      YGNodeRemoveChild(owner, n);
+   YGNodeRemoveAllChildren(n);
+   if (free.size() >= kMaxPooledYogaNodes) {
+      YGNodeFree(n);
+      return;
+   }
+   YGNodeReset(n); // back to default style/layout; keeps the shared config
+   free.push_back(n);
+}
+
+void RenderStore::release(uint32_t slot)
+{
+   if (slot >= elements.size() || !elements[slot])
+      return;
+   yogaPool.release(records[slot].yogaNode);
+   yogaPool.release(records[slot].layoutProxy);
+   records[slot].yogaNode = nullptr;
+   records[slot].layoutProxy = nullptr;
+   if (ScrollState* ss = records[slot].scroll.get()) {
+      yogaPool.release(ss->spacerBefore);
+      yogaPool.release(ss->spacerAfter);
+      records[slot].scroll.reset();
+   }
+   records[slot].text.clear();
+   records[slot].textBlob.reset();
+   records[slot].style.reset();
+   elements[slot] = nullptr;
+   freeSlots.push_back(slot);
+}
+
+// Visit every store (documents first, then the detached store)
+template <typename Fn> static void for_each_store(Fn&& fn)
+{
+   for (auto& kv : g_documentData)
+      fn(kv.second->store);
+   fn(g_detachedStore);
+}
 
 DomElementRenderData* ensure_render_data(dom::Element* el)
 {
    if (!el)
       return nullptr;
-   auto it = g_renderData.find(el);
-   if (it == g_renderData.end()) {
-      auto ptr = std::make_unique<DomElementRenderData>();
-      auto raw = ptr.get();
-      // New attachments start with style dirty so first layout parses style into cache
-      raw->dirtyFlags |= 1; // style dirty
-      g_renderData[el] = std::move(ptr);
-      el->data = raw; // store opaque pointer
-      return raw;
+   if (el->data)
+      return static_cast<DomElementRenderData*>(el->data);
+   DocumentRenderData* docData = document_render_data_for(el);
+   RenderStore& store = docData ? docData->store : g_detachedStore;
+   DomElementRenderData* rd = store.allocate(el);
+   // New attachments start with style dirty so first layout parses style into cache
+   rd->dirtyFlags() |= kDirtyStyle;
+   // A virtualized scroll container allocates its children's data only when its window takes them in, so anything
+   // allocated earlier (by paint or a query) starts culled under it, as do descendants of culled elements
+   auto parent = el->parentNode.lock();
+   if (parent && parent->nodeType == dom::NodeType::ELEMENT) {
+      if (const DomElementRenderData* prd = get_render_data(static_cast<dom::Element*>(parent.get())))
+         rd->culled = prd->culled || (prd->scroll && prd->scroll->virtualize);
    }
-   el->data = it->second.get();
-   return it->second.get();
+   el->data = rd; // store opaque pointer
+   return rd;
 }
 
 DomElementRenderData* get_render_data(dom::Element* el)
 {
-   if (!el)
-      return nullptr;
-   auto it = g_renderData.find(el);
-   if (it == g_renderData.end())
-      return nullptr;
-   return it->second.get();
+   return el ? static_cast<DomElementRenderData*>(el->data) : nullptr;
 }
 
 void free_render_data(dom::Element* el)
 {
-   if (!el)
+   if (!el || !el->data)
       return;
-   auto it = g_renderData.find(el);
-   if (it != g_renderData.end()) {
-      if (it->second->yogaNode) {
-         YGNodeRef n = (YGNodeRef)it->second->yogaNode;
-         YGNodeFreeRecursive(n);
-         it->second->yogaNode = nullptr;
-      }
-      g_renderData.erase(it);
-   }
+   auto* rd = static_cast<DomElementRenderData*>(el->data);
+   if (rd->animated)
+      animations_element_removed(el);
+   rd->store->release(rd->slot);
    el->data = nullptr;
 }
 
 void release_all_render_data()
 {
-   for (auto& kv : g_renderData) {
-      if (kv.second->yogaNode) {
-         YGNodeRef n = (YGNodeRef)kv.second->yogaNode;
-         YGNodeFreeRecursive(n);
-         kv.second->yogaNode = nullptr;
+   animations_clear();
+   for_each_store([](RenderStore& store) {
+      for (size_t i = 0; i < store.elements.size(); ++i) {
+         if (dom::Element* el = store.elements[i]) {
+            // YGNodeFree detaches from owner and children, so per-node frees are safe in any order
+            if (store.records[i].yogaNode)
+               YGNodeFree((YGNodeRef)store.records[i].yogaNode);
+            if (store.records[i].layoutProxy)
+               YGNodeFree((YGNodeRef)store.records[i].layoutProxy);
+            if (ScrollState* ss = store.records[i].scroll.get()) {
+               if (ss->spacerBefore)
+                  YGNodeFree((YGNodeRef)ss->spacerBefore);
+               if (ss->spacerAfter)
+                  YGNodeFree((YGNodeRef)ss->spacerAfter);
+               store.records[i].scroll.reset();
+            }
+            store.records[i].yogaNode = nullptr;
+            store.records[i].layoutProxy = nullptr;
+            el->data = nullptr;
+         }
       }
-   }
-   g_renderData.clear();
+   });
+   g_detachedStore = RenderStore{};
+   g_documentData.clear();
+}
+
+DocumentRenderData* document_render_data(dom::Document* doc)
+{
+   if (!doc)
+      return nullptr;
+   auto& slot = g_documentData[doc];
+   if (!slot)
+      slot = std::make_unique<DocumentRenderData>();
+   return slot.get();
+}
+
+DocumentRenderData* document_render_data_for(dom::Element* el)
+{
+   if (!el)
+      return nullptr;
+   auto owner = el->ownerDocument.lock();
+   if (!owner || owner->nodeType != dom::NodeType::DOCUMENT)
+      return nullptr;
+   return document_render_data(static_cast<dom::Document*>(owner.get()));
+}
+
+StyleCacheStats style_cache_stats(dom::Document* doc)
+{
+   auto it = g_documentData.find(doc);
+   return it == g_documentData.end() ? StyleCacheStats{} : it->second->styleCache.stats();
 }
 
 extern void layout_mark_dirty();
+extern void paint_mark_dirty();
+
+// Flag ancestors so the layout sync can descend to `el` while skipping clean siblings
+static void mark_ancestors_dirty(dom::Element* el)
+{
+   auto parent = el->parentNode.lock();
+   while (parent && parent->nodeType == dom::NodeType::ELEMENT) {
+      auto* pe = static_cast<dom::Element*>(parent.get());
+      if (auto* prd = get_render_data(pe)) {
+         unsigned& flags = prd->dirtyFlags();
+         if (flags & kDirtyDescendant)
+            break; // rest of the chain is already flagged
+         flags |= kDirtyDescendant;
+      }
+      parent = pe->parentNode.lock();
+   }
+}
 
 void mark_style_dirty(dom::Element* el)
 {
    if (auto* rd = ensure_render_data(el)) {
-      rd->dirtyFlags |= 1;
-      rd->dirtyFlags |= 2;
-      rd->styleVersion++;
+      rd->dirtyFlags() |= kDirtyStyle | kDirtyLayout;
+      rd->styleVersion()++;
+      mark_ancestors_dirty(el);
+      layout_mark_dirty();
+      renderer_paint_changed(el); // resolved by layout, or when the compositor reads the paint record
+   }
+}
+
+bool is_style_element(const dom::Element* el)
+{
+   return el && strcasecmp(el->tagName.c_str(), "style") == 0;
+}
+
+void style_elements_changed(dom::Document* doc)
+{
+   if (auto* docData = document_render_data(doc)) {
+      docData->styleElementsDirty = true;
+      layout_mark_dirty();
+   }
+}
+
+void set_adopted_style_sheets(dom::Document* doc, std::vector<std::shared_ptr<css::StyleSheet>> sheets)
+{
+   if (auto* docData = document_render_data(doc)) {
+      docData->adoptedSheets = std::move(sheets);
       layout_mark_dirty();
    }
 }
 
+// Collect <style> elements in tree order, reusing the parsed sheet of any whose text is unchanged
+static void rescan_style_elements(dom::Node* node, const std::vector<StyleElementSheet>& previous,
+                                  std::vector<StyleElementSheet>& out)
+{
+   for (auto& c : node->childNodes) {
+      if (!c || c->nodeType != dom::NodeType::ELEMENT)
+         continue;
+      auto* el = static_cast<dom::Element*>(c.get());
+      if (is_style_element(el)) {
+         std::string text = el->textContent();
+         auto it = std::find_if(previous.begin(), previous.end(), [&](const StyleElementSheet& s) {
+            return s.element == el && s.sheet->text() == text;
+         });
+         out.push_back({el, it != previous.end() ? it->sheet : std::make_shared<css::StyleSheet>(text)});
+         continue; // style content is text only
+      }
+      rescan_style_elements(el, previous, out);
+   }
+}
+
+bool refresh_style_sheets(dom::Document* doc)
+{
+   auto found = g_documentData.find(doc);
+   if (found == g_documentData.end())
+      return false;
+   DocumentRenderData& dd = *found->second;
+   if (dd.styleElementsDirty) {
+      std::vector<StyleElementSheet> scanned;
+      rescan_style_elements(doc, dd.styleElements, scanned);
+      dd.styleElements = std::move(scanned);
+      dd.styleElementsDirty = false;
+   }
+   // Adopted sheets can be replaced in place (replaceSync), so compare versions as well as identities
+   const size_t nElements = dd.styleElements.size();
+   const size_t n = nElements + dd.adoptedSheets.size();
+   auto sheet_at = [&](size_t i) -> const css::StyleSheet* {
+      return i < nElements ? dd.styleElements[i].sheet.get() : dd.adoptedSheets[i - nElements].get();
+   };
+   bool same = n == dd.rulesBuiltFrom.size();
+   for (size_t i = 0; same && i < n; ++i) {
+      const css::StyleSheet* sheet = sheet_at(i);
+      same = dd.rulesBuiltFrom[i].first == sheet && dd.rulesBuiltFrom[i].second == (sheet ? sheet->version() : 0);
+   }
+   if (same)
+      return false;
+   std::vector<const css::StyleSheet*> sheets;
+   dd.rulesBuiltFrom.clear();
+   for (size_t i = 0; i < n; ++i) {
+      const css::StyleSheet* sheet = sheet_at(i);
+      sheets.push_back(sheet);
+      dd.rulesBuiltFrom.push_back({sheet, sheet ? sheet->version() : 0});
+   }
+   dd.rules.build(sheets);
+   // Any element may match differently now: restyle everything (the caller is about to lay out)
+   RenderStore& store = dd.store;
+   for (size_t i = 0; i < store.elements.size(); ++i) {
+      if (store.elements[i]) {
+         store.dirtyFlags[i] |= kDirtyStyle | kDirtyLayout | kDirtyDescendant;
+         store.styleVersions[i]++;
+      }
+   }
+   return true;
+}
+
+void invalidate_attribute_style(dom::Element* el, const std::string& name, const std::string& oldValue,
+                                const std::string& newValue)
+{
+   DocumentRenderData* docData = document_render_data_for(el);
+   if (!docData || docData->rules.empty())
+      return;
+   docData->rules.invalidate(el, name, oldValue, newValue, [](dom::Element* e) { mark_style_dirty(e); });
+}
+
+static void mark_subtree_style_dirty(dom::Element* el)
+{
+   mark_style_dirty(el);
+   for (auto& c : el->childNodes) {
+      if (c && c->nodeType == dom::NodeType::ELEMENT)
+         mark_subtree_style_dirty(static_cast<dom::Element*>(c.get()));
+   }
+}
+
+void invalidate_inserted_style(dom::Element* el)
+{
+   // Never-styled elements are dirty already; only a subtree that was styled elsewhere can go stale
+   DocumentRenderData* docData = document_render_data_for(el);
+   if (!docData || !docData->rules.hasAncestorRules() || !get_render_data(el))
+      return;
+   mark_subtree_style_dirty(el);
+}
+
 void mark_layout_dirty(dom::Element* el)
 {
    if (auto* rd = ensure_render_data(el)) {
-      rd->dirtyFlags |= 2;
+      rd->dirtyFlags() |= kDirtyLayout;
+      mark_ancestors_dirty(el);
       layout_mark_dirty();
    }
 }
 
+// Returns true when the element's place in paint order changed (see Renderer::restack). `moving`: animated or
+// dragged, which promotes the element to a compositor layer.
+static bool build_paint_props(const css::ComputedStyle& cs, bool moving, PaintProps& p)
+{
+   const bool wasPositioned = p.positioned, wasContext = p.stackingContext, wasRendered = p.rendered;
+   const bool wasPromoted = p.promoted;
+   const int32_t wasZ = p.zIndex;
+   p.background = cs.has(css::Prop::BackgroundColor) ? cs.backgroundColor : SkColor4f{0, 0, 0, 0};
+   p.opacity = cs.opacity;
+   p.hasLeft = cs.left.unit == css::Unit::Px;
+   p.left = p.hasLeft ? cs.left.value : 0;
+   p.hasTop = cs.top.unit == css::Unit::Px;
+   p.top = p.hasTop ? cs.top.value : 0;
+   p.hasWidth = cs.width.unit == css::Unit::Px && cs.width.value > 0;
+   p.width = p.hasWidth ? cs.width.value : 0;
+   p.hasHeight = cs.height.unit == css::Unit::Px && cs.height.value > 0;
+   p.height = p.hasHeight ? cs.height.value : 0;
+   p.transform = cs.transform;
+   p.hasTransform = !cs.transform.isIdentity();
+   p.positioned = cs.position == css::Position::Relative || cs.position == css::Position::Absolute;
+   const bool zSet = p.positioned && !cs.zIndexAuto;
+   p.zIndex = zSet ? cs.zIndex : 0;
+   p.promoted = cs.willChange || moving;
+   p.stackingContext = zSet || cs.opacity < 1.f || p.hasTransform || p.promoted;
+   p.rendered = cs.display != css::Display::None;
+   return p.positioned != wasPositioned || p.stackingContext != wasContext || p.zIndex != wasZ ||
+          p.rendered != wasRendered || p.promoted != wasPromoted;
+}
+
+// Rebuild the paint record and tell the Renderer what changed: the element's place in paint order, its transform
+// (which places its descendants too), or only what it draws
+static void update_paint_props(dom::Element* el, DomElementRenderData* rd)
+{
+   const css::Transform transform = rd->paint.transform;
+   if (build_paint_props(rd->computed(), rd->animated || rd->dragged, rd->paint))
+      renderer_restack(el); // promoted on the first move, back in its stacking context when dropped
+   if (!(rd->paint.transform == transform))
+      renderer_transform_changed(el);
+   else
+      renderer_paint_changed(el);
+}
+
+void set_drag_offset(dom::Element* el, bool dragging, float dx, float dy)
+{
+   DomElementRenderData* rd = ensure_render_data(el);
+   if (!rd)
+      return;
+   if (!dragging)
+      dx = dy = 0;
+   if (rd->dragged == dragging && rd->dragX == dx && rd->dragY == dy)
+      return;
+   rd->dragged = dragging;
+   rd->dragX = dx;
+   rd->dragY = dy;
+   update_paint_props(el, rd);
+   renderer_transform_changed(el); // the offset is part of its transform
+   paint_mark_dirty();
+}
+
+// Compare the properties descendants inherit (text measurement and painting depend on them)
+static bool same_inherited(const css::ComputedStyle& a, const css::ComputedStyle& b)
+{
+   constexpr uint64_t kInheritedMask =
+       (uint64_t(1) << (unsigned)css::Prop::FontSize) | (uint64_t(1) << (unsigned)css::Prop::FontWeight) |
+       (uint64_t(1) << (unsigned)css::Prop::FontStyle) | (uint64_t(1) << (unsigned)css::Prop::FontFamily) |
+       (uint64_t(1) << (unsigned)css::Prop::LineHeight) | (uint64_t(1) << (unsigned)css::Prop::Color);
+   if ((a.setMask & kInheritedMask) != (b.setMask & kInheritedMask))
+      return false;
+   if ((a.setMask & kInheritedMask) == 0)
+      return true;
+   return a.fontSize.value == b.fontSize.value && a.fontSize.unit == b.fontSize.unit &&
+          a.lineHeight.value == b.lineHeight.value && a.lineHeight.unit == b.lineHeight.unit &&
+          a.fontWeight == b.fontWeight && a.fontStyle == b.fontStyle && a.color == b.color &&
+          a.fontFamily == b.fontFamily;
+}
+
+bool resolve_style(dom::Element* el, DomElementRenderData* rd)
+{
+   if (!el || !rd)
+      return false;
+   if (!(rd->dirtyFlags() & kDirtyStyle) && rd->paint.styleVersion == rd->styleVersion())
+      return false;
+   std::shared_ptr<const css::ComputedStyle> previous = std::move(rd->style);
+   DocumentRenderData* docData = document_render_data_for(el);
+   // Matching sheet rules first and the inline style last, so it wins; the combined text keys the style cache, which
+   // makes every element with the same classes and inline style share one ComputedStyle.
+   const std::string* cssText = &el->getStyleCssText();
+   thread_local std::string cascaded;
+   if (docData && (!docData->rules.empty() || is_style_element(el))) {
+      cascaded.clear();
+      if (is_style_element(el))
+         cascaded = "display:none;"; // user-agent default
+      docData->rules.cascade(el, cascaded);
+      if (!cascaded.empty()) {
+         cascaded += *cssText;
+         cssText = &cascaded;
+      }
+   }
+   if (cssText->empty()) {
+      rd->style.reset(); // initial style, nothing to share
+   }
+   else if (docData) {
+      rd->style = docData->styleCache.resolve(*cssText);
+   }
+   else {
+      auto cs = std::make_shared<css::ComputedStyle>();
+      css::compute_style(*cssText, *cs);
+      cs->serial = css::next_style_serial();
+      rd->style = std::move(cs);
+   }
+   // Running transitions and animations layer their values over the fresh cascade result
+   const css::ComputedStyle& fresh = rd->computed();
+   if (rd->animated || fresh.transitions || fresh.animations)
+      animations_style_resolved(el, rd, previous.get());
+   update_paint_props(el, rd);
+   rd->paint.styleVersion = rd->styleVersion();
+   unsigned& flags = rd->dirtyFlags();
+   flags = (flags & ~kDirtyStyle) | kDirtyYogaStyle | kDirtyPaint;
+   if (!same_inherited(previous ? *previous : css::initial_style(), rd->computed()))
+      flags |= kDirtyInherited;
+   return true;
+}
+
+void apply_style_property(dom::Element* el, const std::string& name, const std::string& value)
+{
+   auto* rd = get_render_data(el);
+   if (!rd)
+      return; // never resolved; the first resolve reads the serialized text
+   const css::Prop p = css::prop_from_name(name);
+   // Removal (a sheet rule may apply again), shorthands the typed style does not model, elements already waiting
+   // for a full resolve, and anything that can start or retarget a transition or animation go through the cascade
+   const css::ComputedStyle& current = rd->computed();
+   if (p == css::Prop::Count || value.empty() || (rd->dirtyFlags() & kDirtyStyle) || rd->animated ||
+       current.transitions || current.animations || p == css::Prop::Transition ||
+       p == css::Prop::Animation) {
+      mark_style_dirty(el);
+      return;
+   }
+   // Copy on write: the current style is usually shared with every element of the same cascade. A style only this
+   // element holds (an earlier write made it) is updated in place, so repeated writes do not allocate.
+   css::ComputedStyle* cs;
+   if (rd->style && rd->style.use_count() == 1) {
+      cs = const_cast<css::ComputedStyle*>(rd->style.get());
+   }
+   else {
+      auto copy = std::make_shared<css::ComputedStyle>(rd->computed());
+      cs = copy.get();
+      rd->style = std::move(copy);
+   }
+   if (!css::apply_declaration(p, value, *cs)) {
+      mark_style_dirty(el); // invalid: the property falls back to whatever else declares it
+      return;
+   }
+   cs->serial = css::next_style_serial();
+   style_written(el, rd, css::prop_group(p));
+}
+
+void style_written(dom::Element* el, DomElementRenderData* rd, css::PropGroup group)
+{
+   update_paint_props(el, rd);
+   rd->paint.styleVersion = ++rd->styleVersion();
+   unsigned& flags = rd->dirtyFlags();
+   switch (group) {
+   case css::PropGroup::Paint:
+      flags |= kDirtyPaint;
+      paint_mark_dirty();
+      return;
+   case css::PropGroup::Inherited:
+      flags |= kDirtyInherited;
+      [[fallthrough]];
+   case css::PropGroup::Layout:
+      flags |= kDirtyYogaStyle | kDirtyLayout | kDirtyPaint;
+      mark_ancestors_dirty(el);
+      layout_mark_dirty();
+      return;
+   }
+}
+
+const PaintProps& paint_props(dom::Element* el)
+{
+   static const PaintProps kNone{};
+   auto* rd = ensure_render_data(el);
+   if (!rd)
+      return kNone;
+   resolve_style(el, rd);
+   return rd->paint;
+}
+
+void paint_rect(dom::Element* el, int& x, int& y, int& w, int& h)
+{
+   x = y = w = h = 0;
+   auto* rd = ensure_render_data(el);
+   if (!rd)
+      return;
+   const PaintProps& p = paint_props(el);
+   if (rd->hasLayoutBox) {
+      // Layout already applied position/insets/box model; it is the single source of truth.
+      const LayoutBox& b = rd->box();
+      x = (int)b.x;
+      y = (int)b.y;
+      w = (int)b.w;
+      h = (int)b.h;
+      return;
+   }
+   // Outside the layout tree: px size and offsets from style, defaulting like an unstyled placeholder
+   w = p.hasWidth ? (int)std::lround(p.width) : 50;
+   h = p.hasHeight ? (int)std::lround(p.height) : 50;
+   if (p.hasLeft)
+      x = (int)std::lround(p.left);
+   if (p.hasTop)
+      y = (int)std::lround(p.top);
+}
+
+const SkTextBlob* text_blob(dom::Element* el)
+{
+   auto* rd = get_render_data(el);
+   if (!rd || !rd->isTextLeaf || !rd->font || !rd->hasLayoutBox)
+      return nullptr;
+   // Text and font changes drop the blob (layout); only a new wrap width rebuilds it here, so moving or
+   // recompositing an unchanged leaf reuses the same glyph runs.
+   if (!rd->textBlob || rd->blobWidth != rd->textWidth) {
+      const text::TextLayout& tl = text::layout_text(rd->text, rd->font, rd->lineHeight, rd->textWidth);
+      rd->textBlob = text::make_text_blob(rd->text, rd->font, tl);
+      rd->blobWidth = rd->textWidth;
+   }
+   return rd->textBlob.get();
+}
+
 void for_each_render_data(const std::function<void(dom::Element*, DomElementRenderData*)>& fn)
 {
-   for (auto& kv : g_renderData)
-      fn(kv.first, kv.second.get());
+   for_each_store([&](RenderStore& store) {
+      for (size_t i = 0; i < store.elements.size(); ++i) {
+         if (dom::Element* el = store.elements[i])
+            fn(el, &store.records[i]);
+      }
+   });
 }
@@ -1,30 +1,258 @@
 // element_data.h - per-element rendering metadata (opaque to DOM)
 #pragma once
+#include "renderer/computed_style.h"
+#include "renderer/style_cache.h"
+#include "renderer/style_sheet.h"
+#include "renderer/text_layout.h"
 #include "wapis/dom.hpp"
+#include <deque>
+#include <include/core/SkTextBlob.h>
 #include <functional>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
+// DomElementRenderData::dirtyFlags() bits
+constexpr unsigned kDirtyStyle = 1;     // cssText changed; computed style + paint record stale
+constexpr unsigned kDirtyLayout = 2;    // box needs a layout pass
+constexpr unsigned kDirtyPaint = 4;     // needs repaint
+constexpr unsigned kDirtyYogaStyle = 8; // computed style not yet mapped onto the Yoga node
+constexpr unsigned kDirtyDescendant = 16; // some descendant needs a layout sync (lets clean subtrees be skipped)
+constexpr unsigned kDirtyText = 32;       // text children changed; re-measure
+constexpr unsigned kDirtyInherited = 64;  // inherited (font) properties changed; descendants must re-resolve
+
+// Paint-time values derived from the computed style, so compositing and hit testing never parse CSS.
+struct PaintProps {
+   SkColor4f background = {0, 0, 0, 0}; // unpremultiplied; alpha 0 = no background
+   float opacity = 1.f;
+   float left = 0, top = 0;     // px offsets, used only when the element has no layout box
+   float width = 0, height = 0; // px size, same
+   bool hasLeft = false, hasTop = false;
+   bool hasWidth = false, hasHeight = false;
+   css::Transform transform; // applied around the box centre by the compositor
+   bool hasTransform = false;
+   // Paint order (Renderer): positioned boxes and stacking contexts are painted from their stacking context's
+   // z-ordered lists instead of in tree order with their parent
+   bool positioned = false;      // position: relative | absolute
+   bool stackingContext = false; // positioned with a z-index, opacity < 1 or a transform
+   bool rendered = true;         // display is not none: the element (and its subtree) is in the render tree
+   bool promoted = false;        // compositor layer (will-change, animated or dragged); also a stacking context
+   int32_t zIndex = 0;           // 0 unless positioned with a z-index
+   uint32_t styleVersion = ~0u; // DomElementRenderData::styleVersion() this record was built from
+};
+
+struct LayoutBox {
+   float x = 0, y = 0, w = 0, h = 0;
+};
+
+struct RenderStore;
+struct RenderLayer;
+
+// ScrollState::extents entries that are not a measured extent
+constexpr float kExtentUnmeasured = -1.f; // element child never laid out: the running average is assumed
+constexpr float kExtentNotElement = -2.f; // text or comment child: takes no space
+
+// Scroll container state (overflow: auto | scroll), allocated on first use
+struct ScrollState {
+   float x = 0, y = 0;                 // scroll offset, CSS px
+   float clientW = 0, clientH = 0;     // padding box from the last layout
+   float contentW = 0, contentH = 0;   // scrollable extent from the last layout
+   bool offsetChanged = false;         // offset moved since children were last positioned
+   // Virtualization (data-virtualize): only children inside the visible window plus overscan are synced, laid out
+   // and painted. Runs outside it collapse into two spacer nodes sized from measured (or average) child extents.
+   // Children are indexed by child node, so the window is found and walked without scanning the child list.
+   bool virtualize = false;
+   std::vector<float> extents;         // per child node along the main axis incl. margins; see kExtent* below
+   float measuredSum = 0;              // over measured element children
+   size_t measuredCount = 0;
+   size_t elementCount = 0;
+   size_t first = 0, last = 0;         // windowed child nodes [first, last)
+   float beforeSum = 0;                // measuredSum restricted to [0, first)
+   size_t beforeMeasured = 0, beforeElements = 0;
+   bool childrenChanged = false;       // child list mutated since the extents were indexed
+   void* spacerBefore = nullptr;       // YGNodeRef
+   void* spacerAfter = nullptr;
+};
+
+// Why an element's subtree is laid out as its own Yoga tree
+enum class SubtreeRoot : uint8_t {
+   None,
+   Memo,      // data-layout-memo: layout shared between identical subtrees
+   Contained, // fixed px size: layout cannot affect or depend on the rest of the tree; computed in parallel
+};
+
+// Cold per-element record. Hot fields (box, dirty flags, style version) live in the owning RenderStore's
+// parallel arrays at `slot`; use the accessors below. Dom `Element::data` points at this record.
 struct DomElementRenderData {
-   std::unordered_map<std::string, std::string> parsedStyle;
+   std::shared_ptr<const css::ComputedStyle> style; // shared via the document StyleCache; refreshed when style dirty
+   PaintProps paint;
    void* yogaNode = nullptr;
-   float layoutX = 0, layoutY = 0, layoutW = 0, layoutH = 0;
+   RenderStore* store = nullptr;
+   uint32_t slot = 0;
    int surfaceId = 0;
-   unsigned dirtyFlags = 0; // 1=style,2=layout,4=paint
-   uint32_t styleVersion = 0;
-   bool isFlex = false;
-   float flexGrow = 0.f;
-   float flexShrink = 1.f;
-   float flexBasis = 0.f;
-   bool flexBasisPercent = false;
-   bool flexBasisAuto = false;
-   int flexDirection = 0; // YGFlexDirection* enum value stored as int to avoid header include
+   bool hasLayoutBox = false; // box() was assigned by a layout pass
+   // Text leaf (element whose children are all text): collapsed text and resolved font used by its measure func
+   bool isTextLeaf = false;
+   std::string text;
+   text::FontFace* font = nullptr;
+   float lineHeight = 0;
+   SkColor4f textColor = {0, 0, 0, 1};   // inherited `color`, unpremultiplied
+   float textInsetX = 0, textInsetY = 0; // content box origin relative to box(), from the last layout
+   float textWidth = 0;                  // content box width from the last layout
+   sk_sp<SkTextBlob> textBlob;           // glyph runs laid out at blobWidth; reset when text or font changes
+   float blobWidth = -1.f;
+   // Separate Yoga root (memo or containment boundary): the parent lays out layoutProxy, a leaf carrying this
+   // element's outer box, in place of yogaNode
+   bool layoutMemo = false; // data-layout-memo present
+   SubtreeRoot subtreeRoot = SubtreeRoot::None;
+   void* layoutProxy = nullptr;
+   uint64_t memoFingerprint = 0; // SubtreeRoot::Memo only
+   float memoW = 0, memoH = 0;   // constraints of the last memo lookup, reused by the copy-back at the same size
+   uint8_t memoWMode = 0, memoHMode = 0;
+   // SubtreeRoot::Contained only: the proxy's size and the containing block's content size it was last computed at
+   float containedW = -1.f, containedH = -1.f, containedOwnerW = -1.f, containedOwnerH = -1.f;
+   bool virtualize = false;         // data-virtualize present
+   bool culled = false;             // outside a virtualized scroll window: not laid out, painted or hit
+   bool animated = false;           // transitions or animations layer values over `style` (see animation.h)
+   bool hasClip = false;            // clipped by an overflow ancestor
+   LayoutBox clip;                  // visible region from overflow ancestors, absolute CSS px
+   std::unique_ptr<ScrollState> scroll;
+   RenderLayer* layer = nullptr; // render object owned by the document's Renderer; nullptr when not in its tree
+   bool dragged = false;         // moved by a native drag: promoted, and offset by (dragX, dragY) CSS px at composite
+   float dragX = 0, dragY = 0;
+
+   const css::ComputedStyle& computed() const
+   {
+      return style ? *style : css::initial_style();
+   }
+
+   // References stay valid until the next slot allocation in the same store
+   LayoutBox& box();
+   unsigned& dirtyFlags();
+   uint32_t& styleVersion();
+};
+
+// Recycles Yoga nodes (YGNodeRef, kept opaque here) for one store. All nodes share yoga_shared_config().
+struct YogaNodePool {
+   std::vector<void*> free;
+   size_t created = 0;
+   size_t reused = 0;
+
+   YogaNodePool() = default;
+   YogaNodePool(const YogaNodePool&) = delete;
+   YogaNodePool& operator=(const YogaNodePool&) = delete;
+   YogaNodePool(YogaNodePool&& other) noexcept;
+   YogaNodePool& operator=(YogaNodePool&& other) noexcept;
+   ~YogaNodePool();
+
+   void* acquire();
+   // Detach from owner and children, reset to defaults and keep for reuse. Never frees other nodes.
+   void release(void* node);
+};
+
+// Dense per-document storage indexed by a stable slot id; freed slots are reused.
+struct RenderStore {
+   std::vector<LayoutBox> boxes;
+   std::vector<unsigned> dirtyFlags; // kDirty* bits
+   std::vector<uint32_t> styleVersions;
+   std::vector<dom::Element*> elements;      // nullptr marks a free slot
+   std::deque<DomElementRenderData> records; // deque: record addresses survive growth
+   std::vector<uint32_t> freeSlots;
+   YogaNodePool yogaPool;
+
+   DomElementRenderData* allocate(dom::Element* el);
+   void release(uint32_t slot);
+   size_t live() const
+   {
+      return elements.size() - freeSlots.size();
+   }
+
+   // Linear sweep over the flag array
+   void clearFlags(unsigned mask)
+   {
+      unsigned keep = ~mask;
+      unsigned* f = dirtyFlags.data();
+      for (size_t i = 0, n = dirtyFlags.size(); i < n; ++i)
+         f[i] &= keep;
+   }
+};
+
+inline LayoutBox& DomElementRenderData::box()
+{
+   return store->boxes[slot];
+}
+
+inline unsigned& DomElementRenderData::dirtyFlags()
+{
+   return store->dirtyFlags[slot];
+}
+
+inline uint32_t& DomElementRenderData::styleVersion()
+{
+   return store->styleVersions[slot];
+}
+
+// A <style> element's sheet, kept while its text is unchanged
+struct StyleElementSheet {
+   dom::Element* element = nullptr;
+   std::shared_ptr<css::StyleSheet> sheet;
+};
+
+// Per-document rendering state shared by all elements of that document
+struct DocumentRenderData {
+   StyleCache styleCache;
+   RenderStore store;
+   // Author styles: <style> elements in tree order, then document.adoptedStyleSheets
+   css::RuleSet rules;
+   bool styleElementsDirty = false; // a <style> element was inserted, removed or edited; rescan on refresh
+   std::vector<StyleElementSheet> styleElements;
+   std::vector<std::shared_ptr<css::StyleSheet>> adoptedSheets;
+   std::vector<std::pair<const css::StyleSheet*, uint64_t>> rulesBuiltFrom; // sheet and version `rules` holds
 };
 
 DomElementRenderData* ensure_render_data(dom::Element* el);
 DomElementRenderData* get_render_data(dom::Element* el);
 void free_render_data(dom::Element* el);
 void release_all_render_data();
+DocumentRenderData* document_render_data(dom::Document* doc);
+// Resolve the owning document's data for an element (nullptr when detached from any document)
+DocumentRenderData* document_render_data_for(dom::Element* el);
+StyleCacheStats style_cache_stats(dom::Document* doc);
 void mark_style_dirty(dom::Element* el);
+// <style> (any case): holds sheet text and never renders
+bool is_style_element(const dom::Element* el);
+// A <style> element of `doc` was inserted, removed or had its text changed
+void style_elements_changed(dom::Document* doc);
+void set_adopted_style_sheets(dom::Document* doc, std::vector<std::shared_ptr<css::StyleSheet>> sheets);
+// Recompile the rule set when any sheet changed since the last call and restyle the whole document; cheap when
+// nothing changed. Returns true when the rules were rebuilt.
+bool refresh_style_sheets(dom::Document* doc);
+// Restyle only what a class/id/attribute change can affect under the document's rule set (invalidation sets)
+void invalidate_attribute_style(dom::Element* el, const std::string& name, const std::string& oldValue,
+                                const std::string& newValue);
+// `el` was inserted or moved: rules with ancestor compounds may now match differently in its subtree
+void invalidate_inserted_style(dom::Element* el);
+// One inline property written through CSSOM: updates the typed style and paint record directly and invalidates by
+// property group (colours and opacity repaint without layout). Anything it cannot apply falls back to a full resolve.
+void apply_style_property(dom::Element* el, const std::string& name, const std::string& value);
+// rd->style was replaced or edited outside resolve_style (a CSSOM write, an animation frame): rebuild the paint record
+// and invalidate by what the changed properties affect
+void style_written(dom::Element* el, DomElementRenderData* rd, css::PropGroup group);
+// Refresh computed style and paint record if stale (no-op otherwise); returns true when the style was recomputed.
+bool resolve_style(dom::Element* el, DomElementRenderData* rd);
+// Up-to-date paint record for an element (resolves lazily, e.g. for elements outside the layout tree)
+const PaintProps& paint_props(dom::Element* el);
+// Rectangle the compositor paints for `el`, in CSS px: the layout box, or a style-derived box outside the layout tree
+void paint_rect(dom::Element* el, int& x, int& y, int& w, int& h);
 void mark_layout_dirty(dom::Element* el);
-// Iterate all element -> render data pairs (diagnostics / bulk operations)
+// Start, move or end a native drag of `el`: a compositor-only offset in CSS px from its laid-out place. Style and
+// layout are untouched; the next composite moves its cached layer.
+void set_drag_offset(dom::Element* el, bool dragging, float dx, float dy);
+// Cached glyph runs of a laid-out text leaf at its content width (built on first use); nullptr for other elements
+const SkTextBlob* text_blob(dom::Element* el);
+// Iterate all element -> render data pairs in slot order (diagnostics / bulk operations)
 void for_each_render_data(const std::function<void(dom::Element*, DomElementRenderData*)>& fn);
+// Process-wide Yoga config (YGConfigRef) used by every pooled node
+void* yoga_shared_config();
+// Round layout to device pixels; returns true when the factor changed
+bool yoga_set_point_scale(float scale);
@@ -1,11 +1,18 @@
 // Yoga layout integration
 #include "layout_yoga.h"
-#include "renderer/css_parser.h"
+#include "renderer/animation.h"
+#include "renderer/computed_style.h"
 #include "renderer/element_data.h"
+#include "renderer/renderer.h"
+#include "renderer/text_layout.h"
+#include "renderer/worker_pool.h"
 #include "wapis/dom.hpp"
 #include "wapis/dom_adapter.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <functional>
-#include <lexbor/css/syntax/tokenizer.h>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -16,12 +23,26 @@
 extern "C" void* dom_get_cpp_node_opaque(JSContext* ctx, JSValueConst v);
 
 static bool g_layout_dirty = true;
+static bool g_paint_dirty = false;
+// Window size in CSS px (main.mm)
+extern int g_winW;
+extern int g_winH;
+
+// Opt-in attribute for the subtree layout memo (see "Layout memo" below)
+static constexpr const char* kLayoutMemoAttr = "data-layout-memo";
+// Opt-in attribute for virtualized scroll containers (see "Virtualized scroll containers" below)
+static constexpr const char* kVirtualizeAttr = "data-virtualize";
 
 void layout_mark_dirty()
 {
    g_layout_dirty = true;
 }
 
+void paint_mark_dirty()
+{
+   g_paint_dirty = true;
+}
+
 namespace dom {
 void layout_mark_dirty()
 {
@@ -29,27 +50,115 @@ void layout_mark_dirty()
 }
 } // namespace dom
 
+static dom::Document* owner_document(dom::Node* node)
+{
+   if (node && node->nodeType == dom::NodeType::DOCUMENT) {
+      return static_cast<dom::Document*>(node);
+   }
+   auto owner = node ? node->ownerDocument.lock() : nullptr;
+   return owner && owner->nodeType == dom::NodeType::DOCUMENT ? static_cast<dom::Document*>(owner.get()) : nullptr;
+}
+
+static bool contains_style_element(dom::Node* node)
+{
+   if (!node || node->nodeType != dom::NodeType::ELEMENT) {
+      return false;
+   }
+   if (is_style_element(static_cast<dom::Element*>(node))) {
+      return true;
+   }
+   for (auto& c : node->childNodes) {
+      if (contains_style_element(c.get())) {
+         return true;
+      }
+   }
+   return false;
+}
+
+// Mutation of `target` (children or character data) involving `related` adds, removes or edits a <style> element
+static bool touches_style_element(dom::Node* target, dom::Node* related)
+{
+   if (contains_style_element(related)) {
+      return true;
+   }
+   if (target && target->nodeType == dom::NodeType::TEXT) {
+      auto parent = target->parentNode.lock();
+      return parent && parent->nodeType == dom::NodeType::ELEMENT &&
+             is_style_element(static_cast<dom::Element*>(parent.get()));
+   }
+   return target && target->nodeType == dom::NodeType::ELEMENT && is_style_element(static_cast<dom::Element*>(target));
+}
+
 // Ensure per-document hooks are installed (idempotent)
 static void ensure_layout_hooks(dom::Document* doc)
 {
    if (!doc)
       return;
+   if (!doc->getStyleHook()) {
+      doc->setStyleHook(+[](dom::Element* el, const std::string& name, const std::string& value) {
+         apply_style_property(el, name, value);
+      });
+   }
    if (!doc->getAttributeHook()) {
-      doc->setAttributeHook(+[](dom::Element* el, const std::string& name, const std::string& value) {
-         (void)value;
+      doc->setAttributeHook(+[](dom::Element* el, const std::string& name, const std::string& oldValue,
+                                const std::string& value) {
          if (name == "style") {
             mark_style_dirty(el);
          }
+         else if (name == kLayoutMemoAttr) {
+            if (auto* rd = ensure_render_data(el)) {
+               rd->layoutMemo = el->attributes.count(kLayoutMemoAttr) != 0;
+            }
+            // The parent re-syncs its child list and swaps the proxy in or out
+            mark_layout_dirty(el);
+         }
+         else if (name == kVirtualizeAttr) {
+            if (auto* rd = ensure_render_data(el)) {
+               rd->virtualize = el->attributes.count(kVirtualizeAttr) != 0;
+               rd->dirtyFlags() |= kDirtyYogaStyle; // re-evaluates the scroll state
+            }
+            mark_layout_dirty(el);
+         }
+         // Class, id and attribute selectors: restyle only what the document's invalidation sets name
+         if (name != "style") {
+            invalidate_attribute_style(el, name, oldValue, value);
+         }
       });
    }
    if (!doc->getMutationHook()) {
       doc->setMutationHook(+[](dom::Node* target, const char* op, dom::Node* related) {
          // Any structural change marks layout dirty.
          if (target && target->nodeType == dom::NodeType::ELEMENT) {
-            mark_layout_dirty(static_cast<dom::Element*>(target));
+            auto* te = static_cast<dom::Element*>(target);
+            mark_layout_dirty(te);
+            if (auto* trd = get_render_data(te); trd && trd->scroll) {
+               trd->scroll->childrenChanged = true; // a virtualized window re-indexes its extents
+            }
          }
-         if (op && std::string(op) == "remove") {
-            // If an element subtree is being removed, free attachments recursively.
+         // Character data changed: the owning element re-measures its text.
+         if (target && target->nodeType == dom::NodeType::TEXT) {
+            auto parent = target->parentNode.lock();
+            if (parent && parent->nodeType == dom::NodeType::ELEMENT) {
+               auto* pe = static_cast<dom::Element*>(parent.get());
+               mark_layout_dirty(pe);
+               get_render_data(pe)->dirtyFlags() |= kDirtyText;
+            }
+         }
+         // A <style> element's text or its place in the tree changed: the sheets are recompiled before next layout
+         if (touches_style_element(target, related)) {
+            style_elements_changed(owner_document(target));
+         }
+         if (related && related->nodeType == dom::NodeType::ELEMENT && op &&
+             (std::strcmp(op, "append") == 0 || std::strcmp(op, "insert") == 0)) {
+            invalidate_inserted_style(static_cast<dom::Element*>(related));
+            renderer_child_inserted(static_cast<dom::Element*>(related));
+         }
+         if (related && related->nodeType == dom::NodeType::ELEMENT && op &&
+             (std::strcmp(op, "remove") == 0 || std::strcmp(op, "replace") == 0)) {
+            renderer_child_removed(static_cast<dom::Element*>(related)); // unlinked from paint order while attached
+         }
+         if (op && (std::strcmp(op, "remove") == 0 || std::strcmp(op, "replace") == 0)) {
+            // If an element subtree is being removed or replaced, free attachments recursively.
             std::function<void(dom::Node*)> recurse = [&](dom::Node* n) {
                if (!n) {
                   return;
@@ -74,22 +183,110 @@ static void ensure_layout_hooks(dom::Document* doc)
 bool layout_get_box(dom::Element* el, int& x, int& y, int& w, int& h)
 {
    if (auto* rd = get_render_data(el)) {
-      x = (int)rd->layoutX;
-      y = (int)rd->layoutY;
-      w = (int)rd->layoutW;
-      h = (int)rd->layoutH;
+      const LayoutBox& b = rd->box();
+      x = (int)b.x;
+      y = (int)b.y;
+      w = (int)b.w;
+      h = (int)b.h;
       return true;
    }
    return false;
 }
 
-struct Box {
-   float layoutX, layoutY, layoutW, layoutH;
-};
+bool layout_scroll_by(dom::Element* el, float dx, float dy)
+{
+   auto* rd = get_render_data(el);
+   if (!rd || !rd->scroll) {
+      return false;
+   }
+   ScrollState& ss = *rd->scroll;
+   float x = std::clamp(ss.x + dx, 0.f, std::max(0.f, ss.contentW - ss.clientW));
+   float y = std::clamp(ss.y + dy, 0.f, std::max(0.f, ss.contentH - ss.clientH));
+   if (x == ss.x && y == ss.y) {
+      return false;
+   }
+   ss.x = x;
+   ss.y = y;
+   ss.offsetChanged = true;
+   mark_layout_dirty(el); // repositions the children; a virtualized container also moves its window
+   return true;
+}
 
 // TempFlexStore removed (flex meta persisted in attachment)
 
-// Ensure style parsed & cached in attachment; apply style to Yoga node; store flex meta back into attachment
+// Style recalc counters (STYLE_STATS=1 prints them after each layout pass)
+static size_t g_styleRecalcCount = 0;
+static double g_styleRecalcMs = 0;
+
+static const char* flex_direction_name(css::FlexDirection d)
+{
+   switch (d) {
+   case css::FlexDirection::Row:
+      return "row";
+   case css::FlexDirection::RowReverse:
+      return "row-reverse";
+   case css::FlexDirection::ColumnReverse:
+      return "column-reverse";
+   default:
+      return "column";
+   }
+}
+
+static void set_yoga_width(YGNodeRef node, const css::Length& l)
+{
+   if (l.unit == css::Unit::Px)
+      YGNodeStyleSetWidth(node, l.value);
+   else if (l.unit == css::Unit::Percent)
+      YGNodeStyleSetWidthPercent(node, l.value);
+   else
+      YGNodeStyleSetWidthAuto(node);
+}
+
+static void set_yoga_height(YGNodeRef node, const css::Length& l)
+{
+   if (l.unit == css::Unit::Px)
+      YGNodeStyleSetHeight(node, l.value);
+   else if (l.unit == css::Unit::Percent)
+      YGNodeStyleSetHeightPercent(node, l.value);
+   else
+      YGNodeStyleSetHeightAuto(node);
+}
+
+static constexpr YGEdge kYogaEdges[(int)css::Edge::Count] = {YGEdgeTop, YGEdgeRight, YGEdgeBottom, YGEdgeLeft};
+
+static void set_yoga_inset(YGNodeRef node, YGEdge edge, const css::Length& l)
+{
+   if (l.unit == css::Unit::Px)
+      YGNodeStyleSetPosition(node, edge, l.value);
+   else if (l.unit == css::Unit::Percent)
+      YGNodeStyleSetPositionPercent(node, edge, l.value);
+   else
+      YGNodeStyleSetPosition(node, edge, YGUndefined); // auto / unset
+}
+
+static void set_yoga_margin(YGNodeRef node, YGEdge edge, const css::Length& l)
+{
+   if (l.unit == css::Unit::Px)
+      YGNodeStyleSetMargin(node, edge, l.value);
+   else if (l.unit == css::Unit::Percent)
+      YGNodeStyleSetMarginPercent(node, edge, l.value);
+   else if (l.unit == css::Unit::Auto)
+      YGNodeStyleSetMarginAuto(node, edge);
+   else
+      YGNodeStyleSetMargin(node, edge, 0);
+}
+
+static void set_yoga_padding(YGNodeRef node, YGEdge edge, const css::Length& l)
+{
+   if (l.unit == css::Unit::Px)
+      YGNodeStyleSetPadding(node, edge, l.value);
+   else if (l.unit == css::Unit::Percent)
+      YGNodeStyleSetPaddingPercent(node, edge, l.value);
+   else
+      YGNodeStyleSetPadding(node, edge, 0);
+}
+
+// Refresh the typed style in the attachment if dirty, then map its fields onto the Yoga node
 static void apply_node_style(dom::Element* el, YGNodeRef node)
 {
    if (!el) {
@@ -99,125 +296,767 @@ static void apply_node_style(dom::Element* el, YGNodeRef node)
    if (!rd) {
       return;
    }
-   if (rd->dirtyFlags & 1) { // style dirty
-      rd->parsedStyle.clear();
-      auto pd = css::parse_inline(el->styleCssText);
-      rd->parsedStyle = pd.kv;
-      rd->dirtyFlags &= ~1u; // clear style dirty
+   if (rd->dirtyFlags() & kDirtyStyle) {
+      auto t0 = std::chrono::steady_clock::now();
+      resolve_style(el, rd);
+      g_styleRecalcMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+      g_styleRecalcCount++;
    }
-   auto find = [&](const char* k) -> std::string {
-      auto it = rd->parsedStyle.find(k);
-      return it == rd->parsedStyle.end() ? std::string() : it->second;
-   };
-   if (std::getenv("LAYOUT_DEBUG") && !el->styleCssText.empty()) {
-      fprintf(stderr, "[layout] raw style: '%s'\n", el->styleCssText.c_str());
-      for (auto& kv : rd->parsedStyle) {
-         fprintf(stderr, "[layout]   decl %s = %s\n", kv.first.c_str(), kv.second.c_str());
+   rd->dirtyFlags() &= ~kDirtyYogaStyle;
+   const css::ComputedStyle& cs = rd->computed();
+   if (std::getenv("LAYOUT_DEBUG") && !el->getStyleCssText().empty()) {
+      fprintf(stderr, "[layout] raw style: '%s' (mask=0x%llx)\n", el->getStyleCssText().c_str(),
+              (unsigned long long)cs.setMask);
+   }
+   YGNodeStyleSetDisplay(node, cs.display == css::Display::None ? YGDisplayNone : YGDisplayFlex);
+   switch (cs.flexDirection) {
+   case css::FlexDirection::Row:
+      YGNodeStyleSetFlexDirection(node, YGFlexDirectionRow);
+      break;
+   case css::FlexDirection::RowReverse:
+      YGNodeStyleSetFlexDirection(node, YGFlexDirectionRowReverse);
+      break;
+   case css::FlexDirection::ColumnReverse:
+      YGNodeStyleSetFlexDirection(node, YGFlexDirectionColumnReverse);
+      break;
+   default:
+      YGNodeStyleSetFlexDirection(node, YGFlexDirectionColumn); // default
+      break;
+   }
+   if (std::getenv("LAYOUT_DEBUG")) {
+      if (cs.has(css::Prop::FlexDirection) && cs.display != css::Display::Flex) {
+         fprintf(stderr, "[layout][warn] flex-direction specified without display:flex raw='%s'\n",
+                 el->getStyleCssText().c_str());
+      }
+      if (cs.display == css::Display::Flex) {
+         fprintf(stderr, "[layout] apply_node_style display:flex dir=%s\n", flex_direction_name(cs.flexDirection));
       }
    }
-   std::string display = find("display");
-   if (display == "flex") {
-      YGNodeStyleSetDisplay(node, YGDisplayFlex);
+   YGNodeStyleSetFlexGrow(node, cs.flexGrow);
+   YGNodeStyleSetFlexShrink(node, cs.flexShrink);
+   if (cs.flexBasis.unit == css::Unit::Percent) {
+      YGNodeStyleSetFlexBasisPercent(node, cs.flexBasis.value);
+   }
+   else if (cs.flexBasis.unit == css::Unit::Px) {
+      YGNodeStyleSetFlexBasis(node, cs.flexBasis.value);
+   }
+   else {
+      YGNodeStyleSetFlexBasisAuto(node);
+   }
+   set_yoga_width(node, cs.width);
+   set_yoga_height(node, cs.height);
+   // CSS default: insets apply only to elements that declare position relative or absolute
+   YGNodeStyleSetPositionType(node, cs.position == css::Position::Absolute ? YGPositionTypeAbsolute
+                                    : cs.position == css::Position::Relative ? YGPositionTypeRelative
+                                                                              : YGPositionTypeStatic);
+   set_yoga_inset(node, YGEdgeLeft, cs.left);
+   set_yoga_inset(node, YGEdgeTop, cs.top);
+   set_yoga_inset(node, YGEdgeRight, cs.right);
+   set_yoga_inset(node, YGEdgeBottom, cs.bottom);
+   for (int i = 0; i < (int)css::Edge::Count; ++i) {
+      set_yoga_margin(node, kYogaEdges[i], cs.margin[i]);
+      set_yoga_padding(node, kYogaEdges[i], cs.padding[i]);
+      YGNodeStyleSetBorder(node, kYogaEdges[i], cs.borderWidth[i]);
+   }
+   YGNodeStyleSetOverflow(node, cs.overflow == css::Overflow::Hidden ? YGOverflowHidden
+                                : cs.scrolls()                         ? YGOverflowScroll
+                                                                       : YGOverflowVisible);
+}
+
+static YGNodeRef ensure_yoga_node(dom::Element* el)
+{
+   auto* rd = ensure_render_data(el);
+   if (!rd) {
+      return nullptr;
+   }
+   if (!rd->yogaNode) {
+      rd->yogaNode = rd->store->yogaPool.acquire();
+      rd->dirtyFlags() |= kDirtyYogaStyle;
+      // Attributes set before the layout hooks were installed; later changes arrive through the attribute hook
+      rd->layoutMemo = el->attributes.count(kLayoutMemoAttr) != 0;
+      rd->virtualize = el->attributes.count(kVirtualizeAttr) != 0;
+   }
+   return (YGNodeRef)rd->yogaNode;
+}
+
+// Font and colour inherited down the element chain (defaults: 16px, normal weight and line height, black)
+static void resolve_inherited_text(dom::Element* el, text::FontDesc& desc, css::Length& lineHeight, SkColor4f& color)
+{
+   auto parent = el->parentNode.lock();
+   if (parent && parent->nodeType == dom::NodeType::ELEMENT) {
+      resolve_inherited_text(static_cast<dom::Element*>(parent.get()), desc, lineHeight, color);
+   }
+   auto* rd = ensure_render_data(el);
+   resolve_style(el, rd);
+   const css::ComputedStyle& cs = rd->computed();
+   if (cs.has(css::Prop::FontSize)) {
+      desc.size = cs.fontSize.unit == css::Unit::Percent ? desc.size * cs.fontSize.value / 100.f : cs.fontSize.value;
+   }
+   if (cs.has(css::Prop::FontWeight)) {
+      desc.weight = cs.fontWeight;
+   }
+   if (cs.has(css::Prop::FontStyle)) {
+      desc.italic = cs.fontStyle == css::FontStyle::Italic;
+   }
+   if (cs.has(css::Prop::FontFamily)) {
+      desc.family = css::font_family_name(cs.fontFamily);
+   }
+   if (cs.has(css::Prop::LineHeight)) {
+      lineHeight = cs.lineHeight;
+   }
+   if (cs.has(css::Prop::Color)) {
+      color = cs.color;
+   }
+}
+
+static YGSize measure_text_leaf(YGNodeConstRef node, float width, YGMeasureMode widthMode, float height,
+                                YGMeasureMode heightMode)
+{
+   YGSize size{0, 0};
+   auto* rd = static_cast<DomElementRenderData*>(YGNodeGetContext(node));
+   if (!rd || !rd->font) {
+      return size;
+   }
+   float maxWidth = widthMode == YGMeasureModeUndefined ? -1.f : width;
+   // Copying variant: contained subtrees are measured on worker threads
+   text::measure_text(rd->text, rd->font, rd->lineHeight, maxWidth, size.width, size.height);
+   size.width = std::ceil(size.width); // never round below the measured width, or the line would wrap on re-measure
+   if (widthMode == YGMeasureModeExactly) {
+      size.width = width;
+   }
+   else if (widthMode == YGMeasureModeAtMost) {
+      size.width = std::min(size.width, width);
+   }
+   if (heightMode == YGMeasureModeExactly) {
+      size.height = height;
+   }
+   else if (heightMode == YGMeasureModeAtMost) {
+      size.height = std::min(size.height, height);
+   }
+   return size;
+}
+
+// What a laid-out element paints or where changed: the Renderer revisits its layer on the next collect_damage. A
+// transformed element turns around its box centre, so a new box places its descendants again too.
+static void layout_paint_changed(dom::Element* el, DomElementRenderData* rd, bool boxChanged)
+{
+   if (!rd->layer) {
+      return; // not in the render tree; linking it visits it anyway
+   }
+   if (boxChanged && rd->paint.hasTransform) {
+      renderer_transform_changed(el);
+   }
+   else {
+      renderer_paint_changed(el);
+   }
+}
+
+// Refresh a text leaf's text and font; marks the Yoga node dirty only when the measurement inputs changed.
+static void update_text_leaf(dom::Element* el, DomElementRenderData* rd, YGNodeRef node, std::string&& collapsed)
+{
+   text::FontDesc desc;
+   css::Length lh;
+   SkColor4f color = {0, 0, 0, 1};
+   resolve_inherited_text(el, desc, lh, color);
+   if (!(rd->textColor == color)) {
+      rd->textColor = color; // paint-only; never affects measurement
+      layout_paint_changed(el, rd, false);
+   }
+   text::FontFace* face = text::font_face(desc);
+   float lineHeight = lh.unit == css::Unit::Px        ? lh.value
+                      : lh.unit == css::Unit::Percent ? desc.size * lh.value / 100.f
+                                                      : text::normal_line_height(face);
+   if (face == rd->font && lineHeight == rd->lineHeight && collapsed == rd->text) {
+      return;
+   }
+   rd->text = std::move(collapsed);
+   rd->font = face;
+   rd->lineHeight = lineHeight;
+   rd->textBlob.reset();
+   layout_paint_changed(el, rd, false);
+   YGNodeMarkDirty(node);
+}
+
+static void sync_subtree(dom::Element* el, bool inheritedChanged, bool insideSplit);
+
+// --- Layout memo ---------------------------------------------------------------------------------------------
+// A subtree root marked with data-layout-memo is laid out as its own Yoga tree. Its parent holds a leaf proxy node
+// whose measure func looks the subtree up by (fingerprint, constraints); identical rows (same tags, inline styles,
+// text and fonts) then share one computed layout, and a hit copies the cached relative boxes instead of running
+// Yoga. Memo roots nested inside another memo root are laid out normally.
+
+struct MemoBox {
+   LayoutBox box; // relative to the memo root's border box
+   float insetX, insetY, contentW;
+};
+
+struct MemoEntry {
+   float w = 0, h = 0;
+   std::vector<MemoBox> boxes; // element descendants in pre-order
+};
+
+struct MemoKey {
+   uint64_t fingerprint;
+   float w, h; // 0 when the mode is undefined
+   uint8_t wMode, hMode;
+
+   bool operator==(const MemoKey& o) const
+   {
+      return fingerprint == o.fingerprint && w == o.w && h == o.h && wMode == o.wMode && hMode == o.hMode;
    }
-   std::string flexdir = find("flex-direction");
-   if (!flexdir.empty()) {
-      if (flexdir == "row") {
-         YGNodeStyleSetFlexDirection(node, YGFlexDirectionRow);
+};
+
+struct MemoKeyHash {
+   size_t operator()(const MemoKey& k) const
+   {
+      size_t h = std::hash<uint64_t>()(k.fingerprint);
+      h ^= std::hash<float>()(k.w) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+      h ^= std::hash<float>()(k.h) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+      return h ^ ((size_t)k.wMode << 8 | k.hMode);
+   }
+};
+
+// Dropped wholesale when full, like the text layout cache
+static constexpr size_t kMaxMemoEntries = 4096;
+static std::unordered_map<MemoKey, MemoEntry, MemoKeyHash> g_layoutMemo;
+static size_t g_memoHits = 0;
+static size_t g_memoMisses = 0;
+
+static inline uint64_t fp_mix(uint64_t h, uint64_t v)
+{
+   return (h ^ v) * 1099511628211ull; // FNV-1a step over whole words
+}
+
+// Everything that feeds layout inside the subtree: structure, tags, resolved styles, text and resolved fonts.
+static uint64_t subtree_fingerprint(dom::Element* el)
+{
+   uint64_t h = fp_mix(14695981039346656037ull, std::hash<std::string>()(el->tagName));
+   auto* rd = get_render_data(el);
+   // Inline style plus matched sheet rules, by serial: shared styles hash equal, and a freed style's address being
+   // reused can never alias it
+   h = fp_mix(h, rd ? rd->computed().serial : 0);
+   if (rd && rd->isTextLeaf) {
+      uint32_t lh;
+      std::memcpy(&lh, &rd->lineHeight, sizeof lh);
+      h = fp_mix(h, std::hash<std::string>()(rd->text));
+      // The font by what it describes, like the style: no key in the fingerprint is an address
+      if (rd->font) {
+         const text::FontDesc& fd = text::font_desc(rd->font);
+         uint32_t size;
+         std::memcpy(&size, &fd.size, sizeof size);
+         h = fp_mix(h, std::hash<std::string>()(fd.family));
+         h = fp_mix(h, (uint64_t)size << 32 | (uint64_t)fd.weight << 1 | (fd.italic ? 1 : 0));
       }
-      else if (flexdir == "row-reverse") {
-         YGNodeStyleSetFlexDirection(node, YGFlexDirectionRowReverse);
+      h = fp_mix(h, lh);
+   }
+   uint64_t children = 0;
+   for (auto& c : el->childNodes) {
+      if (c && c->nodeType == dom::NodeType::ELEMENT) {
+         h = fp_mix(h, subtree_fingerprint(static_cast<dom::Element*>(c.get())));
+         children++;
       }
-      else if (flexdir == "column-reverse") {
-         YGNodeStyleSetFlexDirection(node, YGFlexDirectionColumnReverse);
+   }
+   return fp_mix(h, children); // closes the level, so moving a node up or down changes the hash
+}
+
+static void content_box(YGNodeRef node, float w, MemoBox& out)
+{
+   out.insetX = YGNodeLayoutGetBorder(node, YGEdgeLeft) + YGNodeLayoutGetPadding(node, YGEdgeLeft);
+   out.insetY = YGNodeLayoutGetBorder(node, YGEdgeTop) + YGNodeLayoutGetPadding(node, YGEdgeTop);
+   out.contentW =
+       w - out.insetX - YGNodeLayoutGetBorder(node, YGEdgeRight) - YGNodeLayoutGetPadding(node, YGEdgeRight);
+}
+
+static void capture_memo_boxes(dom::Element* el, YGNodeRef node, float offX, float offY, std::vector<MemoBox>& out)
+{
+   uint32_t childIdx = 0;
+   for (auto& c : el->childNodes) {
+      if (!c || c->nodeType != dom::NodeType::ELEMENT) {
+         continue;
       }
-      else {
-         YGNodeStyleSetFlexDirection(node, YGFlexDirectionColumn);
+      YGNodeRef cn = YGNodeGetChild(node, childIdx++);
+      if (!cn) {
+         return;
       }
-      if (display != "flex" && std::getenv("LAYOUT_DEBUG")) {
-         fprintf(stderr,
-                 "[layout][warn] flex-direction specified without display:flex (parsed display='%s') raw='%s'\n",
-                 display.c_str(), el->styleCssText.c_str());
+      MemoBox mb;
+      mb.box = LayoutBox{offX + YGNodeLayoutGetLeft(cn), offY + YGNodeLayoutGetTop(cn), YGNodeLayoutGetWidth(cn),
+                         YGNodeLayoutGetHeight(cn)};
+      content_box(cn, mb.box.w, mb);
+      out.push_back(mb);
+      capture_memo_boxes(static_cast<dom::Element*>(c.get()), cn, mb.box.x, mb.box.y, out);
+   }
+}
+
+static MemoKey memo_key(const DomElementRenderData* rd, float w, YGMeasureMode wMode, float h, YGMeasureMode hMode)
+{
+   return MemoKey{rd->memoFingerprint, wMode == YGMeasureModeUndefined ? 0.f : w,
+                  hMode == YGMeasureModeUndefined ? 0.f : h, (uint8_t)wMode, (uint8_t)hMode};
+}
+
+static const MemoEntry& memo_lookup(dom::Element* el, DomElementRenderData* rd, float w, YGMeasureMode wMode,
+                                    float h, YGMeasureMode hMode)
+{
+   MemoKey key = memo_key(rd, w, wMode, h, hMode);
+   // Remembered so the copy-back reuses this entry instead of looking the final size up under another key
+   rd->memoW = key.w;
+   rd->memoH = key.h;
+   rd->memoWMode = key.wMode;
+   rd->memoHMode = key.hMode;
+   auto it = g_layoutMemo.find(key);
+   if (it != g_layoutMemo.end()) {
+      g_memoHits++;
+      return it->second;
+   }
+   g_memoMisses++;
+   if (g_layoutMemo.size() >= kMaxMemoEntries) {
+      g_layoutMemo.clear();
+   }
+   // Root of its own tree: Yoga sizes an auto-sized root exactly to a defined owner size, which is only right for
+   // Exactly. AtMost is shrink-to-fit, so the root is laid out at its natural size first and fitted to the available
+   // size only on an axis where its content is larger.
+   YGNodeRef root = (YGNodeRef)rd->yogaNode;
+   float ownerW = wMode == YGMeasureModeExactly ? w : YGUndefined;
+   float ownerH = hMode == YGMeasureModeExactly ? h : YGUndefined;
+   YGNodeCalculateLayout(root, ownerW, ownerH, YGDirectionLTR);
+   bool refit = false;
+   if (wMode == YGMeasureModeAtMost && YGNodeLayoutGetWidth(root) > w) {
+      ownerW = w;
+      refit = true;
+   }
+   if (hMode == YGMeasureModeAtMost && YGNodeLayoutGetHeight(root) > h) {
+      ownerH = h;
+      refit = true;
+   }
+   if (refit) {
+      YGNodeCalculateLayout(root, ownerW, ownerH, YGDirectionLTR);
+   }
+   MemoEntry entry;
+   entry.w = YGNodeLayoutGetWidth(root);
+   entry.h = YGNodeLayoutGetHeight(root);
+   capture_memo_boxes(el, root, 0, 0, entry.boxes);
+   return g_layoutMemo.emplace(key, std::move(entry)).first->second;
+}
+
+// Runs a nested YGNodeCalculateLayout on the memo root from inside the parent tree's calculate. That is safe: the
+// root is a separate tree (the parent only holds the leaf proxy), and Yoga keeps a calculate's state per call and per
+// node, never in globals the outer pass reads back; contained roots already rely on this by calculating
+// concurrently. Memo roots are never created inside contained subtrees, so this only runs on the main thread, which
+// owns g_layoutMemo.
+static YGSize measure_memo_root(YGNodeConstRef node, float width, YGMeasureMode widthMode, float height,
+                                YGMeasureMode heightMode)
+{
+   auto* rd = static_cast<DomElementRenderData*>(YGNodeGetContext(node));
+   if (!rd || !rd->yogaNode) {
+      return YGSize{0, 0};
+   }
+   const MemoEntry& e = memo_lookup(rd->store->elements[rd->slot], rd, width, widthMode, height, heightMode);
+   return YGSize{e.w, e.h};
+}
+
+// The proxy carries the root's outer box (size, flex, margins, position); the root keeps padding and border.
+static void apply_proxy_style(dom::Element* el, DomElementRenderData* rd)
+{
+   YGNodeRef proxy = (YGNodeRef)rd->layoutProxy;
+   YGNodeRef root = (YGNodeRef)rd->yogaNode;
+   apply_node_style(el, proxy);
+   for (YGEdge e : kYogaEdges) {
+      YGNodeStyleSetPadding(proxy, e, 0);
+      YGNodeStyleSetBorder(proxy, e, 0);
+      YGNodeStyleSetMargin(root, e, 0);
+      YGNodeStyleSetPosition(root, e, YGUndefined);
+   }
+   YGNodeStyleSetPositionType(root, YGPositionTypeRelative);
+}
+
+static void drop_layout_proxy(DomElementRenderData* rd)
+{
+   rd->store->yogaPool.release(rd->layoutProxy);
+   rd->layoutProxy = nullptr;
+   rd->subtreeRoot = SubtreeRoot::None;
+   rd->dirtyFlags() |= kDirtyYogaStyle; // margins and insets go back onto the real node
+}
+
+// Containment boundary: a px width and height, so the subtree's contents cannot affect anything outside it. Flexing
+// may still resize the box; the subtree is then computed at the size the parent gave it (layout_contained_roots).
+// Leaves gain nothing from a separate root.
+static bool is_contained(dom::Element* el, DomElementRenderData* rd)
+{
+   resolve_style(el, rd);
+   const css::ComputedStyle& cs = rd->computed();
+   if (cs.width.unit != css::Unit::Px || cs.height.unit != css::Unit::Px || cs.display == css::Display::None) {
+      return false;
+   }
+   for (auto& c : el->childNodes) {
+      if (c && c->nodeType == dom::NodeType::ELEMENT) {
+         return true;
       }
    }
-   else {
-      YGNodeStyleSetFlexDirection(node, YGFlexDirectionColumn); // default
+   return false;
+}
+
+// Node the parent inserts for `el`: a proxy for subtrees laid out as their own root (memo or containment
+// boundary), the element's own node otherwise. Subtrees inside a separate root are never split further.
+static YGNodeRef layout_child_node(dom::Element* el, bool insideSplit)
+{
+   YGNodeRef node = ensure_yoga_node(el);
+   auto* rd = get_render_data(el);
+   if (!node || !rd) {
+      return node;
    }
-   if (std::getenv("LAYOUT_DEBUG") && display == "flex") {
-      YGFlexDirection dir = YGNodeStyleGetFlexDirection(node);
-      const char* dirStr = dir == YGFlexDirectionRow          ? "row"
-                           : dir == YGFlexDirectionRowReverse ? "row-reverse"
-                           : dir == YGFlexDirectionColumn     ? "column"
-                                                              : "column-reverse";
-      fprintf(stderr, "[layout] apply_node_style display:flex dir=%s raw='%s'\n", dirStr, flexdir.c_str());
+   SubtreeRoot kind = SubtreeRoot::None;
+   if (!insideSplit) {
+      // A memo entry holds boxes for one scroll offset, so scroll containers are never memo roots
+      kind = rd->layoutMemo && !rd->scroll ? SubtreeRoot::Memo
+             : is_contained(el, rd)         ? SubtreeRoot::Contained
+                                            : SubtreeRoot::None;
    }
-   std::string flexv = find("flex");
-   if (!flexv.empty()) {
-      css::FlexShorthand fp = css::parse_flex(flexv);
-      if (fp.haveGrow) {
-         YGNodeStyleSetFlexGrow(node, fp.grow);
+   if (kind == SubtreeRoot::None) {
+      if (rd->layoutProxy) {
+         drop_layout_proxy(rd);
       }
-      if (fp.haveShrink) {
-         YGNodeStyleSetFlexShrink(node, fp.shrink);
+      return node;
+   }
+   if (!rd->layoutProxy) {
+      YGNodeRef proxy = (YGNodeRef)rd->store->yogaPool.acquire();
+      YGNodeSetContext(proxy, rd);
+      rd->layoutProxy = proxy;
+   }
+   if (rd->subtreeRoot != kind) {
+      // Contained proxies are sized by their style alone; only memo proxies measure
+      YGNodeSetMeasureFunc((YGNodeRef)rd->layoutProxy, kind == SubtreeRoot::Memo ? measure_memo_root : nullptr);
+      rd->subtreeRoot = kind;
+      rd->memoFingerprint = 0;
+      rd->dirtyFlags() |= kDirtyYogaStyle | kDirtyLayout;
+   }
+   return (YGNodeRef)rd->layoutProxy;
+}
+
+// Contained roots whose Yoga tree is dirty, collected by the sync and laid out before the main tree
+static std::vector<DomElementRenderData*> g_pendingContained;
+
+// Scroll containers whose offset moved, collected by the sync; their children are repositioned after the main apply
+// even when Yoga produced no new layout for them.
+static std::vector<DomElementRenderData*> g_scrolled;
+// Viewport of the last pass: the visible extent assumed for scroll containers not laid out yet
+static float g_viewportW = 0;
+static float g_viewportH = 0;
+static float g_viewportScale = 0;
+// Geometry queries by how they were answered (see layout_flush_for)
+static size_t g_queryCached = 0;
+static size_t g_queryScoped = 0;
+static size_t g_queryFull = 0;
+
+// ---- Virtualized scroll containers ----
+// A scroll container with data-virtualize only syncs, lays out and paints the element children inside its visible
+// window plus an overscan margin. The children before and after the window are replaced in the Yoga tree by two
+// spacer nodes sized from the children's measured extents (the running average for those never laid out). The window
+// is moved from where it was and sums over the children before it are kept, so a pass or a scroll only visits the
+// window and the children it crossed; only a change to the child list rescans them all. Children outside the window
+// are culled: they keep their last box but are unlinked from the Renderer, so painting, damage and hit testing never
+// visit them. Children never in the window get no render data from layout.
+static constexpr float kVirtualOverscan = 200.f;       // px laid out beyond each edge of the visible window
+static constexpr float kDefaultVirtualExtent = 24.f;   // extent assumed before any child has been measured
+static size_t g_virtualWindowed = 0;
+static size_t g_virtualCulled = 0;
+
+static bool main_axis_horizontal(const css::ComputedStyle& cs)
+{
+   return cs.flexDirection == css::FlexDirection::Row || cs.flexDirection == css::FlexDirection::RowReverse;
+}
+
+// Elements without render data inherit the flag when it is allocated (ensure_render_data)
+static void set_subtree_culled(dom::Element* el, bool culled)
+{
+   if (auto* rd = get_render_data(el)) {
+      rd->culled = culled;
+   }
+   for (auto& c : el->childNodes) {
+      if (c && c->nodeType == dom::NodeType::ELEMENT) {
+         set_subtree_culled(static_cast<dom::Element*>(c.get()), culled);
       }
-      if (fp.basisPercent) {
-         YGNodeStyleSetFlexBasisPercent(node, fp.basisValue);
+   }
+}
+
+static void release_spacers(DomElementRenderData* rd, ScrollState& ss)
+{
+   rd->store->yogaPool.release(ss.spacerBefore);
+   rd->store->yogaPool.release(ss.spacerAfter);
+   ss.spacerBefore = nullptr;
+   ss.spacerAfter = nullptr;
+}
+
+// Allocate or drop the scroll state to match overflow and data-virtualize (after a style or attribute change)
+static void update_scroll_state(dom::Element* el, DomElementRenderData* rd)
+{
+   if (!rd->computed().scrolls()) {
+      if (rd->scroll) {
+         release_spacers(rd, *rd->scroll);
+         rd->scroll.reset();
+      }
+      return;
+   }
+   if (!rd->scroll) {
+      rd->scroll = std::make_unique<ScrollState>();
+   }
+   ScrollState& ss = *rd->scroll;
+   if (ss.virtualize != rd->virtualize) {
+      ss.virtualize = rd->virtualize;
+      ss.extents.clear();
+      ss.measuredSum = 0;
+      ss.measuredCount = 0;
+      ss.elementCount = 0;
+      ss.first = ss.last = 0;
+      ss.beforeSum = 0;
+      ss.beforeMeasured = ss.beforeElements = 0;
+      if (!ss.virtualize) {
+         release_spacers(rd, ss);
+      }
+      mark_layout_dirty(el); // child list changes shape either way
+   }
+}
+
+static YGNodeRef virtual_spacer(DomElementRenderData* rd, void*& slot, float extent, bool horizontal)
+{
+   if (!slot) {
+      slot = rd->store->yogaPool.acquire();
+      YGNodeStyleSetFlexShrink((YGNodeRef)slot, 0);
+   }
+   YGNodeRef spacer = (YGNodeRef)slot;
+   if (horizontal) {
+      YGNodeStyleSetWidth(spacer, extent);
+      YGNodeStyleSetHeightAuto(spacer);
+   }
+   else {
+      YGNodeStyleSetHeight(spacer, extent);
+      YGNodeStyleSetWidthAuto(spacer);
+   }
+   return spacer;
+}
+
+// Replace the node's children with `want` unless they already match
+static void set_yoga_children(YGNodeRef node, const std::vector<YGNodeRef>& want)
+{
+   uint32_t existing = YGNodeGetChildCount(node);
+   bool mismatch = existing != want.size();
+   for (uint32_t i = 0; i < existing && !mismatch; i++) {
+      mismatch = YGNodeGetChild(node, i) != want[i];
+   }
+   if (!mismatch) {
+      return;
+   }
+   for (int i = (int)existing - 1; i >= 0; --i) {
+      YGNodeRemoveChild(node, YGNodeGetChild(node, (uint32_t)i));
+   }
+   for (YGNodeRef c : want) {
+      YGNodeInsertChild(node, c, YGNodeGetChildCount(node));
+   }
+}
+
+// Child list changed shape: keep measured extents by position, newcomers start unmeasured, and restart the window
+// walk from the top
+static void reset_virtual_extents(dom::Element* el, ScrollState& ss)
+{
+   const size_t n = el->childNodes.size();
+   ss.extents.resize(n, kExtentUnmeasured);
+   ss.measuredSum = 0;
+   ss.measuredCount = 0;
+   ss.elementCount = 0;
+   for (size_t i = 0; i < n; ++i) {
+      const auto& c = el->childNodes[i];
+      float& e = ss.extents[i];
+      if (!c || c->nodeType != dom::NodeType::ELEMENT) {
+         e = kExtentNotElement;
+         continue;
       }
-      else if (fp.basisPoint) {
-         YGNodeStyleSetFlexBasis(node, fp.basisValue);
+      if (e == kExtentNotElement) {
+         e = kExtentUnmeasured;
       }
-      else if (fp.basisAuto) {
-         YGNodeStyleSetFlexBasisAuto(node);
+      ss.elementCount++;
+      if (e >= 0) {
+         ss.measuredSum += e;
+         ss.measuredCount++;
       }
    }
-   auto widthv = find("width");
-   if (!widthv.empty()) {
-      float num;
-      std::string unit;
-      if (css::parse_number_unit(widthv, num, unit) && (unit == "px" || unit.empty())) {
-         if (num >= 0) {
-            YGNodeStyleSetWidth(node, num);
+   ss.first = ss.last = 0;
+   ss.beforeSum = 0;
+   ss.beforeMeasured = ss.beforeElements = 0;
+   ss.childrenChanged = false;
+}
+
+static void sync_virtual_children(dom::Element* el, DomElementRenderData* rd, YGNodeRef node, bool inheritedChanged,
+                                  bool insideSplit)
+{
+   ScrollState& ss = *rd->scroll;
+   const bool horizontal = main_axis_horizontal(rd->computed());
+   const size_t n = el->childNodes.size();
+   size_t oldFirst = std::min(ss.first, n), oldLast = std::min(ss.last, n);
+   if (ss.extents.size() != n || ss.childrenChanged) {
+      reset_virtual_extents(el, ss);
+      oldFirst = 0; // children moved between positions: any of them may have left the window
+      oldLast = n;
+   }
+   const float estimate = ss.measuredCount ? ss.measuredSum / (float)ss.measuredCount : kDefaultVirtualExtent;
+   auto extent = [&](size_t i) {
+      float e = ss.extents[i];
+      return e >= 0 ? e : e == kExtentNotElement ? 0.f : estimate;
+   };
+   // Sums over [0, first) move with `first`, one child at a time
+   auto step = [&](size_t i, bool forward) {
+      const float e = ss.extents[i];
+      if (e == kExtentNotElement) {
+         return;
+      }
+      if (forward) {
+         ss.beforeElements++;
+         if (e >= 0) {
+            ss.beforeSum += e;
+            ss.beforeMeasured++;
          }
       }
-   }
-   auto heightv = find("height");
-   if (!heightv.empty()) {
-      float num;
-      std::string unit;
-      if (css::parse_number_unit(heightv, num, unit) && (unit == "px" || unit.empty())) {
-         if (num >= 0) {
-            YGNodeStyleSetHeight(node, num);
+      else {
+         ss.beforeElements--;
+         if (e >= 0) {
+            ss.beforeSum -= e;
+            ss.beforeMeasured--;
          }
       }
+   };
+   auto beforeFirst = [&]() {
+      return ss.beforeSum + (float)(ss.beforeElements - ss.beforeMeasured) * estimate;
+   };
+   float client = horizontal ? ss.clientW : ss.clientH;
+   if (client <= 0) {
+      client = horizontal ? g_viewportW : g_viewportH;
+   }
+   const float offset = horizontal ? ss.x : ss.y;
+   const float windowStart = offset - kVirtualOverscan;
+   const float windowEnd = offset + client + kVirtualOverscan;
+   // First child ending past windowStart, searched from the previous window
+   size_t first = std::min(ss.first, n);
+   while (first > 0 && beforeFirst() > windowStart) {
+      step(--first, false);
    }
-   rd->isFlex = (display == "flex");
-   rd->flexGrow = YGNodeStyleGetFlexGrow(node);
-   rd->flexShrink = YGNodeStyleGetFlexShrink(node);
-   YGValue basis = YGNodeStyleGetFlexBasis(node);
-   rd->flexBasisPercent = (basis.unit == YGUnitPercent);
-   rd->flexBasisAuto = (basis.unit == YGUnitAuto);
-   if (basis.unit == YGUnitPercent || basis.unit == YGUnitPoint) {
-      rd->flexBasis = basis.value;
+   while (first < n && beforeFirst() + extent(first) <= windowStart) {
+      step(first++, true);
    }
-   else if (basis.unit == YGUnitAuto) {
-      rd->flexBasis = 0;
+   const float before = beforeFirst();
+   size_t last = first;
+   float pos = before;
+   while (last < n && pos < windowEnd) {
+      pos += extent(last++);
    }
-   rd->flexDirection = YGNodeStyleGetFlexDirection(node);
+   const float total = ss.measuredSum + (float)(ss.elementCount - ss.measuredCount) * estimate;
+   std::vector<YGNodeRef> want;
+   want.reserve(last - first + 2);
+   want.push_back(virtual_spacer(rd, ss.spacerBefore, before, horizontal));
+   for (size_t i = first; i < last; ++i) {
+      const auto& c = el->childNodes[i];
+      if (c && c->nodeType == dom::NodeType::ELEMENT) {
+         want.push_back(layout_child_node(static_cast<dom::Element*>(c.get()), insideSplit));
+      }
+   }
+   want.push_back(virtual_spacer(rd, ss.spacerAfter, std::max(0.f, total - pos), horizontal));
+   set_yoga_children(node, want);
+   ss.first = first;
+   ss.last = last;
+   // Children that left the window (any child after a child list change); the rest are still in it
+   for (size_t i = oldFirst; i < oldLast; ++i) {
+      const auto& c = el->childNodes[i];
+      if ((i < first || i >= last) && c && c->nodeType == dom::NodeType::ELEMENT) {
+         auto* ce = static_cast<dom::Element*>(c.get());
+         auto* crd = get_render_data(ce);
+         if (crd && !crd->culled) {
+            set_subtree_culled(ce, true);
+            renderer_child_removed(ce); // out of paint order, damage and hit testing until it comes back
+         }
+      }
+   }
+   size_t windowed = 0;
+   for (size_t i = first; i < last; ++i) {
+      const auto& c = el->childNodes[i];
+      if (!c || c->nodeType != dom::NodeType::ELEMENT) {
+         continue;
+      }
+      auto* ce = static_cast<dom::Element*>(c.get());
+      auto* crd = ensure_render_data(ce); // data starts culled under this container (ensure_render_data)
+      // Entering the window: resync the whole subtree, it missed every change while culled
+      bool entering = crd->culled;
+      if (entering) {
+         set_subtree_culled(ce, false);
+         renderer_child_inserted(ce); // linked into the render tree on the next frame
+      }
+      sync_subtree(ce, inheritedChanged || entering, insideSplit);
+      windowed++;
+   }
+   g_virtualWindowed += windowed;
+   g_virtualCulled += ss.elementCount - windowed;
 }
 
-static YGNodeRef ensure_yoga_node(dom::Element* el)
+static void sync_children(dom::Element* el, DomElementRenderData* rd, YGNodeRef node, bool inheritedChanged,
+                          bool insideSplit)
 {
-   auto* rd = ensure_render_data(el);
-   if (!rd) {
-      return nullptr;
+   if (rd->scroll && rd->scroll->virtualize) {
+      // Windowed rows, never a text leaf; the child list is not scanned
+      if (rd->isTextLeaf) {
+         YGNodeSetMeasureFunc(node, nullptr);
+         YGNodeSetContext(node, nullptr);
+         rd->isTextLeaf = false;
+         rd->text.clear();
+         rd->font = nullptr;
+      }
+      sync_virtual_children(el, rd, node, inheritedChanged, insideSplit);
+      return;
    }
-   if (!rd->yogaNode) {
-      rd->yogaNode = YGNodeNew();
-      rd->dirtyFlags |= 1;
+   std::vector<dom::Element*> desired;
+   desired.reserve(el->childNodes.size());
+   bool hasText = false;
+   for (auto& c : el->childNodes) {
+      if (c && c->nodeType == dom::NodeType::ELEMENT) {
+         desired.push_back(static_cast<dom::Element*>(c.get()));
+      }
+      else if (c && c->nodeType == dom::NodeType::TEXT) {
+         hasText = true;
+      }
+   }
+   // Elements holding only text become measured Yoga leaves. Text mixed with element children is not laid out.
+   std::string collapsed = desired.empty() && hasText ? text::collapse_whitespace(el->textContent()) : std::string();
+   if (!collapsed.empty()) {
+      if (!rd->isTextLeaf) {
+         YGNodeRemoveAllChildren(node);
+         YGNodeSetContext(node, rd);
+         YGNodeSetMeasureFunc(node, measure_text_leaf);
+         rd->isTextLeaf = true;
+         rd->font = nullptr; // force the first measurement
+      }
+      update_text_leaf(el, rd, node, std::move(collapsed));
+      return;
+   }
+   if (rd->isTextLeaf) {
+      YGNodeSetMeasureFunc(node, nullptr);
+      YGNodeSetContext(node, nullptr);
+      rd->isTextLeaf = false;
+      rd->text.clear();
+      rd->font = nullptr;
+   }
+   std::vector<YGNodeRef> want;
+   want.reserve(desired.size());
+   for (auto* ce : desired) {
+      want.push_back(layout_child_node(ce, insideSplit));
+   }
+   set_yoga_children(node, want);
+   for (auto* ce : desired) {
+      // Left culled by a container that stopped virtualizing
+      auto* crd = get_render_data(ce);
+      bool wasCulled = crd && crd->culled;
+      if (wasCulled) {
+         set_subtree_culled(ce, false);
+         renderer_child_inserted(ce);
+      }
+      sync_subtree(ce, inheritedChanged || wasCulled, insideSplit);
    }
-   return (YGNodeRef)rd->yogaNode;
 }
 
-static void sync_subtree(dom::Element* el)
+static void sync_subtree(dom::Element* el, bool inheritedChanged, bool insideSplit)
 {
    if (!el) {
       return;
@@ -227,106 +1066,412 @@ static void sync_subtree(dom::Element* el)
       return;
    }
    auto* rd = get_render_data(el);
-   if (rd && (rd->dirtyFlags & 1)) {
-      apply_node_style(el, node); // style update
+   // Nothing changed at or below this element since the last pass: keep its Yoga subtree as is.
+   constexpr unsigned kNeedsSync = kDirtyStyle | kDirtyYogaStyle | kDirtyLayout | kDirtyDescendant | kDirtyText;
+   if (!rd || (!inheritedChanged && !(rd->dirtyFlags() & kNeedsSync))) {
+      return;
    }
-   std::vector<dom::Element*> desired;
-   desired.reserve(el->childNodes.size());
-   for (auto& c : el->childNodes) {
-      if (c && c->nodeType == dom::NodeType::ELEMENT) {
-         desired.push_back(static_cast<dom::Element*>(c.get()));
+   if (rd->dirtyFlags() & (kDirtyStyle | kDirtyYogaStyle)) {
+      apply_node_style(el, node); // style update
+      if (rd->layoutProxy) {
+         apply_proxy_style(el, rd);
       }
+      update_scroll_state(el, rd);
    }
-   bool mismatch = false;
-   uint32_t existing = YGNodeGetChildCount(node);
-   uint32_t common = std::min<uint32_t>(existing, desired.size());
-   for (uint32_t i = 0; i < common && !mismatch; i++) {
-      if (YGNodeGetChild(node, i) != (YGNodeRef)ensure_yoga_node(desired[i])) {
-         mismatch = true;
+   if (rd->scroll && rd->scroll->offsetChanged) {
+      g_scrolled.push_back(rd);
+   }
+   inheritedChanged = inheritedChanged || (rd->dirtyFlags() & kDirtyInherited);
+   sync_children(el, rd, node, inheritedChanged, insideSplit || rd->layoutProxy);
+   // Any change at or below a memo root lands here (dirty bits propagate up), so the fingerprint never goes stale.
+   if (rd->subtreeRoot == SubtreeRoot::Memo) {
+      uint64_t fp = subtree_fingerprint(el);
+      if (fp != rd->memoFingerprint) {
+         rd->memoFingerprint = fp;
+         YGNodeMarkDirty((YGNodeRef)rd->layoutProxy);
       }
    }
-   if (existing != desired.size()) {
-      mismatch = true;
+   else if (rd->subtreeRoot == SubtreeRoot::Contained && YGNodeIsDirty(node)) {
+      g_pendingContained.push_back(rd);
+   }
+}
+
+// The setters below return whether the value changed, which makes the Renderer revisit the element's layer
+// (layout_paint_changed); an unchanged layout paints nothing.
+static bool set_text_content_box(DomElementRenderData* rd, const MemoBox& cb)
+{
+   const bool changed = rd->textInsetX != cb.insetX || rd->textInsetY != cb.insetY || rd->textWidth != cb.contentW;
+   rd->textInsetX = cb.insetX;
+   rd->textInsetY = cb.insetY;
+   rd->textWidth = cb.contentW;
+   return changed;
+}
+
+static bool set_clip(DomElementRenderData* rd, const LayoutBox* clip)
+{
+   const bool changed = rd->hasClip != (clip != nullptr) ||
+                        (clip && (rd->clip.x != clip->x || rd->clip.y != clip->y || rd->clip.w != clip->w ||
+                                  rd->clip.h != clip->h));
+   rd->hasClip = clip != nullptr;
+   if (clip) {
+      rd->clip = *clip;
    }
-   if (mismatch) {
-      for (int i = (int)existing - 1; i >= 0; --i) {
-         YGNodeRemoveChild(node, YGNodeGetChild(node, (uint32_t)i));
+   return changed;
+}
+
+static bool set_box(DomElementRenderData* rd, const LayoutBox& box)
+{
+   LayoutBox& b = rd->box();
+   const bool changed = !rd->hasLayoutBox || b.x != box.x || b.y != box.y || b.w != box.w || b.h != box.h;
+   b = box;
+   rd->hasLayoutBox = true;
+   return changed;
+}
+
+static void copy_memo_boxes(dom::Element* el, const MemoEntry& entry, size_t& idx, float absL, float absT,
+                            const LayoutBox* clip)
+{
+   for (auto& c : el->childNodes) {
+      if (!c || c->nodeType != dom::NodeType::ELEMENT) {
+         continue;
       }
-      for (auto* ce : desired) {
-         YGNodeInsertChild(node, ensure_yoga_node(ce), YGNodeGetChildCount(node));
+      if (idx >= entry.boxes.size()) {
+         return;
       }
+      const MemoBox& mb = entry.boxes[idx++];
+      auto* ce = static_cast<dom::Element*>(c.get());
+      if (auto* rd = ensure_render_data(ce)) {
+         const bool boxChanged = set_box(rd, LayoutBox{absL + mb.box.x, absT + mb.box.y, mb.box.w, mb.box.h});
+         bool changed = set_clip(rd, clip);
+         if (rd->isTextLeaf) {
+            changed = set_text_content_box(rd, mb) || changed;
+         }
+         if (boxChanged || changed) {
+            layout_paint_changed(ce, rd, boxChanged);
+         }
+      }
+      copy_memo_boxes(ce, entry, idx, absL, absT, clip);
    }
-   for (auto* ce : desired) {
-      sync_subtree(ce);
+}
+
+// Memo root: place it from its proxy, then fill descendants from the entry for its final size. A subtree already
+// laid out at that size is a hit and never runs Yoga.
+static void apply_memo_layout(dom::Element* el, DomElementRenderData* rd, YGNodeRef proxy, float accL, float accT,
+                              const LayoutBox* clip)
+{
+   float absL = accL + YGNodeLayoutGetLeft(proxy);
+   float absT = accT + YGNodeLayoutGetTop(proxy);
+   float w = YGNodeLayoutGetWidth(proxy);
+   float h = YGNodeLayoutGetHeight(proxy);
+   const bool boxChanged = set_box(rd, LayoutBox{absL, absT, w, h});
+   if (set_clip(rd, clip) || boxChanged) {
+      layout_paint_changed(el, rd, boxChanged);
+   }
+   // The entry the proxy was last measured from holds this layout whenever it has the final size; only a proxy that
+   // flexing or min/max resized afterwards needs the subtree at exactly that size
+   const MemoEntry* entry = nullptr;
+   auto it = g_layoutMemo.find(
+       memo_key(rd, rd->memoW, (YGMeasureMode)rd->memoWMode, rd->memoH, (YGMeasureMode)rd->memoHMode));
+   if (it != g_layoutMemo.end() && it->second.w == w && it->second.h == h) {
+      entry = &it->second;
+   }
+   else {
+      entry = &memo_lookup(el, rd, w, YGMeasureModeExactly, h, YGMeasureModeExactly);
+   }
+   if (rd->isTextLeaf) {
+      MemoBox cb;
+      content_box((YGNodeRef)rd->yogaNode, w, cb); // the root keeps padding and border
+      set_text_content_box(rd, cb);
    }
+   size_t idx = 0;
+   copy_memo_boxes(el, *entry, idx, absL, absT, clip);
 }
 
-static void apply_layout_recursive(dom::Element* el, YGNodeRef node, float accL = 0, float accT = 0)
+// Copy Yoga results into the attachments. Only nodes Yoga laid out in this pass (HasNewLayout) or whose
+// ancestor moved are visited, so moving one absolutely positioned element touches just that subtree.
+// Contained subtrees are independent Yoga trees whose contents cannot change their size, so they are computed
+// concurrently on the worker pool after the main tree (which only sees their proxies) has sized them.
+static size_t g_containedLaidOut = 0;
+// Contained roots the main tree resized or moved into a containing block of another size while their own tree
+// stayed clean; found by the copy-back, computed together once it finishes, then copied back
+static std::vector<DomElementRenderData*> g_resizedContained;
+
+// The proxy's laid-out size, and its parent's content box: the containing block that percentage padding on the
+// root resolves against, exactly as it would with the root laid out inside the main tree
+static void contained_frame(DomElementRenderData* rd, float& w, float& h, float& ownerW, float& ownerH)
+{
+   YGNodeRef proxy = (YGNodeRef)rd->layoutProxy;
+   w = YGNodeLayoutGetWidth(proxy);
+   h = YGNodeLayoutGetHeight(proxy);
+   ownerW = w;
+   ownerH = h;
+   if (YGNodeRef parent = YGNodeGetOwner(proxy)) {
+      ownerW = YGNodeLayoutGetWidth(parent) - YGNodeLayoutGetPadding(parent, YGEdgeLeft) -
+               YGNodeLayoutGetPadding(parent, YGEdgeRight) - YGNodeLayoutGetBorder(parent, YGEdgeLeft) -
+               YGNodeLayoutGetBorder(parent, YGEdgeRight);
+      ownerH = YGNodeLayoutGetHeight(parent) - YGNodeLayoutGetPadding(parent, YGEdgeTop) -
+               YGNodeLayoutGetPadding(parent, YGEdgeBottom) - YGNodeLayoutGetBorder(parent, YGEdgeTop) -
+               YGNodeLayoutGetBorder(parent, YGEdgeBottom);
+   }
+}
+
+static bool contained_frame_changed(DomElementRenderData* rd)
+{
+   float w, h, ownerW, ownerH;
+   contained_frame(rd, w, h, ownerW, ownerH);
+   return w != rd->containedW || h != rd->containedH || ownerW != rd->containedOwnerW || ownerH != rd->containedOwnerH;
+}
+
+// Safe on a worker: writes only the root's own tree and reads the main tree, which is not being calculated
+static void layout_contained_root(DomElementRenderData* rd)
+{
+   float w, h, ownerW, ownerH;
+   contained_frame(rd, w, h, ownerW, ownerH);
+   YGNodeRef root = (YGNodeRef)rd->yogaNode;
+   YGNodeStyleSetWidth(root, w); // unchanged values leave the tree clean
+   YGNodeStyleSetHeight(root, h);
+   YGNodeCalculateLayout(root, ownerW, ownerH, YGDirectionLTR);
+   rd->containedW = w;
+   rd->containedH = h;
+   rd->containedOwnerW = ownerW;
+   rd->containedOwnerH = ownerH;
+}
+
+static void layout_contained_list(std::vector<DomElementRenderData*>& list)
+{
+   worker_parallel_for(list.size(), [&list](size_t i) { layout_contained_root(list[i]); });
+   g_containedLaidOut += list.size();
+}
+
+// Call with the main tree calculated: contained roots are sized by their proxies
+static void layout_contained_roots(bool all)
+{
+   if (all) {
+      // Rounding is baked in per calculate, so a new point scale needs every contained tree recomputed
+      g_pendingContained.clear();
+      for_each_render_data([](dom::Element*, DomElementRenderData* rd) {
+         if (rd->subtreeRoot == SubtreeRoot::Contained && rd->layoutProxy) {
+            g_pendingContained.push_back(rd);
+         }
+      });
+   }
+   if (g_pendingContained.empty()) {
+      return;
+   }
+   layout_contained_list(g_pendingContained);
+   g_pendingContained.clear();
+}
+
+static void apply_layout_recursive(dom::Element* el, YGNodeRef node, float accL, float accT, bool parentMoved,
+                                   const LayoutBox* clip);
+
+// Children of an overflow container are clipped to its padding box (within any outer clip)
+static LayoutBox child_clip(YGNodeRef inner, const LayoutBox& b, const LayoutBox* outer)
+{
+   float l = b.x + YGNodeLayoutGetBorder(inner, YGEdgeLeft);
+   float t = b.y + YGNodeLayoutGetBorder(inner, YGEdgeTop);
+   float r = b.x + b.w - YGNodeLayoutGetBorder(inner, YGEdgeRight);
+   float btm = b.y + b.h - YGNodeLayoutGetBorder(inner, YGEdgeBottom);
+   if (outer) {
+      l = std::max(l, outer->x);
+      t = std::max(t, outer->y);
+      r = std::min(r, outer->x + outer->w);
+      btm = std::min(btm, outer->y + outer->h);
+   }
+   return LayoutBox{l, t, std::max(0.f, r - l), std::max(0.f, btm - t)};
+}
+
+// Client and content size of a scroll container from its laid-out children; clamps an offset the content no
+// longer reaches
+static void update_scroll_extent(DomElementRenderData* rd, ScrollState& ss, YGNodeRef inner)
+{
+   const LayoutBox& b = rd->box();
+   float bl = YGNodeLayoutGetBorder(inner, YGEdgeLeft);
+   float bt = YGNodeLayoutGetBorder(inner, YGEdgeTop);
+   ss.clientW = std::max(0.f, b.w - bl - YGNodeLayoutGetBorder(inner, YGEdgeRight));
+   ss.clientH = std::max(0.f, b.h - bt - YGNodeLayoutGetBorder(inner, YGEdgeBottom));
+   float right = 0, bottom = 0;
+   for (uint32_t i = 0, n = YGNodeGetChildCount(inner); i < n; ++i) {
+      YGNodeRef c = YGNodeGetChild(inner, i);
+      right = std::max(right, YGNodeLayoutGetLeft(c) + YGNodeLayoutGetWidth(c) + YGNodeLayoutGetMargin(c, YGEdgeRight));
+      bottom =
+          std::max(bottom, YGNodeLayoutGetTop(c) + YGNodeLayoutGetHeight(c) + YGNodeLayoutGetMargin(c, YGEdgeBottom));
+   }
+   ss.contentW = std::max(ss.clientW, right - bl + YGNodeLayoutGetPadding(inner, YGEdgeRight));
+   ss.contentH = std::max(ss.clientH, bottom - bt + YGNodeLayoutGetPadding(inner, YGEdgeBottom));
+   float maxX = ss.contentW - ss.clientW;
+   float maxY = ss.contentH - ss.clientH;
+   if (ss.x > maxX || ss.y > maxY) {
+      ss.x = std::min(ss.x, maxX);
+      ss.y = std::min(ss.y, maxY);
+      ss.offsetChanged = true;
+   }
+}
+
+static void record_extent(ScrollState& ss, size_t i, YGNodeRef child, bool horizontal)
+{
+   if (i >= ss.extents.size() || ss.extents[i] == kExtentNotElement) {
+      return;
+   }
+   float e = horizontal ? YGNodeLayoutGetWidth(child) + YGNodeLayoutGetMargin(child, YGEdgeLeft) +
+                              YGNodeLayoutGetMargin(child, YGEdgeRight)
+                        : YGNodeLayoutGetHeight(child) + YGNodeLayoutGetMargin(child, YGEdgeTop) +
+                              YGNodeLayoutGetMargin(child, YGEdgeBottom);
+   float& slot = ss.extents[i];
+   if (slot >= 0) {
+      ss.measuredSum -= slot;
+   }
+   else {
+      ss.measuredCount++;
+   }
+   slot = e;
+   ss.measuredSum += e;
+}
+
+// Place the element children of `el` (laid out under `inner`) relative to its box at (absL, absT): shifted by the
+// scroll offset and clipped for overflow containers; only the windowed run for virtualized ones.
+static void apply_children(dom::Element* el, DomElementRenderData* rd, YGNodeRef inner, float absL, float absT,
+                           bool moved, const LayoutBox* clip)
+{
+   ScrollState* ss = rd ? rd->scroll.get() : nullptr;
+   LayoutBox ownClip;
+   if (rd && (ss || rd->computed().overflow == css::Overflow::Hidden)) {
+      ownClip = child_clip(inner, rd->box(), clip);
+      clip = &ownClip;
+   }
+   if (ss) {
+      update_scroll_extent(rd, *ss, inner);
+      absL -= ss->x;
+      absT -= ss->y;
+      moved = moved || ss->offsetChanged;
+      ss->offsetChanged = false;
+   }
+   if (ss && ss->virtualize) {
+      // Only the windowed run, after the leading spacer
+      const bool horizontal = main_axis_horizontal(rd->computed());
+      uint32_t childIdx = 1;
+      for (size_t i = ss->first, end = std::min(ss->last, el->childNodes.size()); i < end; ++i) {
+         const auto& c = el->childNodes[i];
+         if (!c || c->nodeType != dom::NodeType::ELEMENT) {
+            continue;
+         }
+         YGNodeRef cn = YGNodeGetChild(inner, childIdx++);
+         record_extent(*ss, i, cn, horizontal);
+         apply_layout_recursive(static_cast<dom::Element*>(c.get()), cn, absL, absT, moved, clip);
+      }
+      return;
+   }
+   uint32_t childIdx = 0;
+   for (auto& c : el->childNodes) {
+      if (!c || c->nodeType != dom::NodeType::ELEMENT) {
+         continue;
+      }
+      apply_layout_recursive(static_cast<dom::Element*>(c.get()), YGNodeGetChild(inner, childIdx++), absL, absT, moved,
+                             clip);
+   }
+}
+
+static void apply_layout_recursive(dom::Element* el, YGNodeRef node, float accL, float accT, bool parentMoved,
+                                   const LayoutBox* clip)
 {
    if (!el || !node) {
       return;
    }
+   auto* proxyRd = get_render_data(el);
+   bool isProxy = proxyRd && proxyRd->layoutProxy && proxyRd->layoutProxy == node;
+   if (isProxy && proxyRd->subtreeRoot == SubtreeRoot::Memo) {
+      if (!YGNodeGetHasNewLayout(node) && !parentMoved) {
+         return;
+      }
+      YGNodeSetHasNewLayout(node, false);
+      apply_memo_layout(el, proxyRd, node, accL, accT, clip);
+      return;
+   }
+   // Contained root: placed by its proxy in the parent's tree, contents from its own separately computed tree
+   YGNodeRef inner = isProxy ? (YGNodeRef)proxyRd->yogaNode : node;
+   if (!YGNodeGetHasNewLayout(node) && !YGNodeGetHasNewLayout(inner) && !parentMoved) {
+      return;
+   }
+   // A proxy laid out again may have a new size or containing block; its tree is then computed and copied back after
+   // this pass (apply_resized_contained)
+   const bool deferred = isProxy && YGNodeGetHasNewLayout(node) && contained_frame_changed(proxyRd);
+   YGNodeSetHasNewLayout(node, false);
+   YGNodeSetHasNewLayout(inner, false);
    float relL = YGNodeLayoutGetLeft(node);
    float relT = YGNodeLayoutGetTop(node);
    float absL = accL + relL;
    float absT = accT + relT;
    float w = YGNodeLayoutGetWidth(node);
    float h = YGNodeLayoutGetHeight(node);
-   if (auto* rd = ensure_render_data(el)) {
-      rd->layoutX = absL;
-      rd->layoutY = absT;
-      rd->layoutW = w;
-      rd->layoutH = h;
+   bool moved = parentMoved;
+   auto* rd = ensure_render_data(el);
+   if (rd) {
+      const LayoutBox& b = rd->box();
+      moved = moved || !rd->hasLayoutBox || b.x != absL || b.y != absT;
+      const bool boxChanged = set_box(rd, LayoutBox{absL, absT, w, h});
+      bool changed = set_clip(rd, clip);
+      if (rd->isTextLeaf) {
+         MemoBox cb;
+         content_box(inner, w, cb);
+         changed = set_text_content_box(rd, cb) || changed;
+      }
+      if (boxChanged || changed) {
+         layout_paint_changed(el, rd, boxChanged);
+      }
    }
    if (std::getenv("LAYOUT_DEBUG")) {
       fprintf(stderr, "[layout] el=%p tag=%s box=(%.0f,%.0f %.0fx%.0f) rel=(%.0f,%.0f) acc=(%.0f,%.0f)\n", (void*)el,
               el->tagName.c_str(), absL, absT, w, h, relL, relT, accL, accT);
    }
-   // recurse with updated accumulated offset
-   uint32_t childIdx = 0;
-   for (auto& c : el->childNodes) {
-      if (c && c->nodeType == dom::NodeType::ELEMENT) {
-         apply_layout_recursive(static_cast<dom::Element*>(c.get()), YGNodeGetChild(node, childIdx++), absL, absT);
-      }
+   if (deferred) {
+      g_resizedContained.push_back(proxyRd);
+      return;
    }
+   // recurse with updated accumulated offset
+   apply_children(el, rd, inner, absL, absT, moved, clip);
 }
 
-void layout_maybe_run(JSContext* ctx)
+static void apply_resized_contained()
 {
-   if (!ctx) {
+   if (g_resizedContained.empty()) {
       return;
    }
-   static bool in_layout = false;
-   if (in_layout) {
-      return; // avoid reentrant invocation
+   layout_contained_list(g_resizedContained);
+   for (DomElementRenderData* rd : g_resizedContained) {
+      YGNodeRef inner = (YGNodeRef)rd->yogaNode;
+      const LayoutBox& b = rd->box();
+      YGNodeSetHasNewLayout(inner, false);
+      apply_children(rd->store->elements[rd->slot], rd, inner, b.x, b.y, true, rd->hasClip ? &rd->clip : nullptr);
    }
-   in_layout = true;
-   if (!g_layout_dirty) {
-      in_layout = false;
+   g_resizedContained.clear();
+}
+
+// Scrolled containers Yoga did not lay out again this pass: only their children's positions change
+static void apply_scrolled()
+{
+   for (DomElementRenderData* rd : g_scrolled) {
+      if (!rd->scroll || !rd->scroll->offsetChanged || !rd->hasLayoutBox || rd->culled) {
+         continue;
+      }
+      const LayoutBox& b = rd->box();
+      apply_children(rd->store->elements[rd->slot], rd, (YGNodeRef)rd->yogaNode, b.x, b.y, false,
+                     rd->hasClip ? &rd->clip : nullptr);
+   }
+   g_scrolled.clear();
+}
+
+void layout_run(dom::Element* bodyEl, float viewportW, float viewportH, float scale)
+{
+   if (!bodyEl) {
       return;
    }
-   g_layout_dirty = false;
-   // flex meta now persisted in attachments, nothing transient to clear
-   // Get body element
-   JSValue global = JS_GetGlobalObject(ctx);
-   JSValue document = JS_GetPropertyStr(ctx, global, "document");
-   JSValue body = JS_GetPropertyStr(ctx, document, "body");
-   auto bodyNode = reinterpret_cast<dom::Node*>(dom_get_cpp_node_opaque(ctx, (JSValueConst)body));
    // Install hooks on the owning document the first time we see it
-   if (bodyNode) {
-      if (auto docSP = bodyNode->ownerDocument.lock()) {
-         if (auto d = std::dynamic_pointer_cast<dom::Document>(docSP)) {
-            ensure_layout_hooks(d.get());
-         }
+   if (auto docSP = bodyEl->ownerDocument.lock()) {
+      if (auto d = std::dynamic_pointer_cast<dom::Document>(docSP)) {
+         ensure_layout_hooks(d.get());
+         refresh_style_sheets(d.get()); // a changed sheet restyles the whole document
       }
    }
-   if (!bodyNode || bodyNode->nodeType != dom::NodeType::ELEMENT) {
-      JS_FreeValue(ctx, body);
-      JS_FreeValue(ctx, document);
-      JS_FreeValue(ctx, global);
-      return;
-   }
-   auto bodyEl = static_cast<dom::Element*>(bodyNode);
    // Treat the first element child of body (if any) as the layout root so its flex styles always map to the viewport.
    dom::Element* layoutRootEl = bodyEl;
    for (auto& c : bodyEl->childNodes) {
@@ -336,33 +1481,40 @@ void layout_maybe_run(JSContext* ctx)
       }
    }
 
+   // Layout is rounded to device pixels by the shared config, and each calculate bakes that rounding into its
+   // results, so a scale change is a full relayout: the new factor bumps the config's version, which makes Yoga
+   // recompute every node of the main tree. Separately computed contained roots are recalculated explicitly, and
+   // every box is copied back.
+   bool scaleChanged = yoga_set_point_scale(scale);
+   if (scaleChanged) {
+      g_layoutMemo.clear(); // entries hold boxes rounded to the old scale
+   }
+   g_viewportW = viewportW;
+   g_viewportH = viewportH;
+   g_viewportScale = scale;
    YGNodeRef root = ensure_yoga_node(layoutRootEl);
-   apply_node_style(layoutRootEl, root);
-   // Force viewport size on root flex container using centralized defaults (will adapt when dynamic resize added)
-   extern int g_winW;
-   extern int g_winH; // from viewport.h / main.mm
-   YGNodeStyleSetWidth(root, (float)g_winW);
-   YGNodeStyleSetHeight(root, (float)g_winH);
    // Sync subtree (structure + styles)
-   sync_subtree(layoutRootEl);
+   sync_subtree(layoutRootEl, false, false);
+   // Force viewport size on the root flex container after its style is mapped. Yoga ignores unchanged values, so
+   // only a resize (or a root style change) dirties the root; subtrees whose size does not depend on the viewport
+   // are then served from Yoga's measurement cache.
+   YGNodeStyleSetWidth(root, viewportW);
+   YGNodeStyleSetHeight(root, viewportH);
    YGNodeCalculateLayout(root, YGUndefined, YGUndefined, YGDirectionLTR);
+   layout_contained_roots(scaleChanged);
    // Apply to layoutRootEl and descendants (single pass). Root is at (0,0).
-   apply_layout_recursive(layoutRootEl, root, 0, 0);
-   for_each_render_data([](dom::Element* e, DomElementRenderData* rd) {
-      (void)e;
-      if (rd) {
-         rd->dirtyFlags &= ~2u;
-      }
-   });
+   apply_layout_recursive(layoutRootEl, root, 0, 0, scaleChanged, nullptr);
+   apply_resized_contained();
+   apply_scrolled();
+   // Sync consumed every pending layout/descendant bit in the tree; sweep this document's flag array once (the
+   // detached store and other documents keep theirs).
+   if (auto* rootRd = get_render_data(layoutRootEl)) {
+      rootRd->store->clearFlags(kDirtyLayout | kDirtyDescendant | kDirtyText | kDirtyInherited);
+   }
    // If layout root isn't body, set body box to viewport for compositor fallback
    if (layoutRootEl != bodyEl) {
-      extern int g_winW;
-      extern int g_winH;
-      if (auto* rd = ensure_render_data(bodyEl)) {
-         rd->layoutX = 0;
-         rd->layoutY = 0;
-         rd->layoutW = g_winW;
-         rd->layoutH = g_winH;
+      if (auto* rd = ensure_render_data(bodyEl); rd && set_box(rd, LayoutBox{0, 0, viewportW, viewportH})) {
+         layout_paint_changed(bodyEl, rd, true);
       }
    }
    // Persist Yoga nodes; no freeing here
@@ -373,33 +1525,28 @@ void layout_maybe_run(JSContext* ctx)
          if (!rd) {
             return;
          }
-         const char* dirStr = "-";
-         if (rd->isFlex) {
-            int d = rd->flexDirection;
-            dirStr = d == YGFlexDirectionRow          ? "row"
-                     : d == YGFlexDirectionRowReverse ? "row-rev"
-                     : d == YGFlexDirectionColumn     ? "col"
-                                                      : "col-rev";
-         }
+         bool isFlex = rd->computed().display == css::Display::Flex;
+         const char* dirStr = isFlex ? flex_direction_name(rd->computed().flexDirection) : "-";
+         const LayoutBox& b = rd->box();
          fprintf(stderr, "[layout] box el=%p pos=(%.0f,%.0f) size=(%.0f x %.0f) flex=%d grow=%.2f dir=%s\n", (void*)el,
-                 rd->layoutX, rd->layoutY, rd->layoutW, rd->layoutH, rd->isFlex ? 1 : 0, rd->flexGrow, dirStr);
+                 b.x, b.y, b.w, b.h, isFlex ? 1 : 0, rd->computed().flexGrow, dirStr);
       });
       // Row groups
       for_each_render_data([](dom::Element* parent, DomElementRenderData* pRD) {
-         if (!pRD || !pRD->isFlex) {
+         if (!pRD || pRD->computed().display != css::Display::Flex) {
             return;
          }
-         if (!(pRD->flexDirection == YGFlexDirectionRow || pRD->flexDirection == YGFlexDirectionRowReverse)) {
+         if (!(pRD->computed().flexDirection == css::FlexDirection::Row ||
+               pRD->computed().flexDirection == css::FlexDirection::RowReverse)) {
             return;
          }
-         float pbw = pRD->layoutW;
-         std::vector<std::pair<dom::Element*, Box>> children;
+         float pbw = pRD->box().w;
+         std::vector<std::pair<dom::Element*, LayoutBox>> children;
          for (auto& c : parent->childNodes) {
             if (c && c->nodeType == dom::NodeType::ELEMENT) {
                auto* ce = static_cast<dom::Element*>(c.get());
                if (auto* crd = get_render_data(ce)) {
-                  Box b{crd->layoutX, crd->layoutY, crd->layoutW, crd->layoutH};
-                  children.push_back({ce, b});
+                  children.push_back({ce, crd->box()});
                }
             }
          }
@@ -410,25 +1557,265 @@ void layout_maybe_run(JSContext* ctx)
          float sumGrow = 0;
          for (auto& ch : children) {
             if (auto* crd = get_render_data(ch.first)) {
-               sumGrow += crd->flexGrow;
+               sumGrow += crd->computed().flexGrow;
             }
          }
          for (auto& ch : children) {
             if (auto* crd = get_render_data(ch.first)) {
-               float gw = crd->flexGrow;
+               float gw = crd->computed().flexGrow;
                fprintf(stderr, "  child=%p w=%.0f grow=%.2f ratio=%.2f%% (expected%%=%.2f)\n", (void*)ch.first,
-                       ch.second.layoutW, gw, pbw > 0 ? (ch.second.layoutW / pbw * 100.f) : 0.f,
+                       ch.second.w, gw, pbw > 0 ? (ch.second.w / pbw * 100.f) : 0.f,
                        (sumGrow > 0 ? (gw / sumGrow * 100.f) : 0.f));
             }
          }
       });
    }
+   if (std::getenv("STYLE_STATS")) {
+      fprintf(stderr, "[style] recalc=%zu elements %.3f ms (%.2f us/el) render-data=%zu+%zu bytes/el (cold+hot)\n",
+              g_styleRecalcCount, g_styleRecalcMs,
+              g_styleRecalcCount ? g_styleRecalcMs * 1000.0 / (double)g_styleRecalcCount : 0.0,
+              sizeof(DomElementRenderData), sizeof(LayoutBox) + sizeof(unsigned) + sizeof(uint32_t) + sizeof(void*));
+      if (auto owner = bodyEl->ownerDocument.lock()) {
+         if (auto* docData = document_render_data(static_cast<dom::Document*>(owner.get()))) {
+            const RenderStore& store = docData->store;
+            fprintf(stderr, "[layout] render-data live=%zu slots=%zu yoga-nodes created=%zu reused=%zu pooled=%zu\n",
+                    store.live(), store.elements.size(), store.yogaPool.created, store.yogaPool.reused,
+                    store.yogaPool.free.size());
+         }
+         text::TextCacheStats tc = text::text_cache_stats();
+         fprintf(stderr, "[text] faces=%zu layouts=%zu lookups=%zu hits=%zu advance-misses=%zu blobs=%zu\n",
+                 tc.faces, tc.layoutEntries, tc.layoutLookups, tc.layoutHits, tc.advanceMisses, tc.blobsBuilt);
+         fprintf(stderr, "[layout] memo hits=%zu misses=%zu entries=%zu contained-roots=%zu workers=%zu\n",
+                 g_memoHits, g_memoMisses, g_layoutMemo.size(), g_containedLaidOut, worker_count());
+         fprintf(stderr, "[layout] virtualized windowed=%zu culled=%zu\n", g_virtualWindowed, g_virtualCulled);
+         fprintf(stderr, "[layout] geometry queries cached=%zu scoped=%zu full=%zu\n", g_queryCached, g_queryScoped,
+                 g_queryFull);
+         StyleCacheStats sc = style_cache_stats(static_cast<dom::Document*>(owner.get()));
+         fprintf(stderr, "[style] cache entries=%zu refs=%zu lookups=%zu hit-rate=%.1f%% saved=%zu bytes\n",
+                 sc.entries, sc.sharedRefs, sc.lookups, sc.hitRate() * 100.0, sc.bytesSaved);
+      }
+   }
+   g_styleRecalcCount = 0;
+   g_styleRecalcMs = 0;
+   g_virtualWindowed = 0;
+   g_virtualCulled = 0;
+}
+
+// Lay out document.body into the window; false when the document has no body
+static bool layout_document(JSContext* ctx)
+{
+   g_layout_dirty = false;
+   // Get body element
+   JSValue global = JS_GetGlobalObject(ctx);
+   JSValue document = JS_GetPropertyStr(ctx, global, "document");
+   JSValue body = JS_GetPropertyStr(ctx, document, "body");
+   auto bodyNode = reinterpret_cast<dom::Node*>(dom_get_cpp_node_opaque(ctx, (JSValueConst)body));
+   bool hasBody = bodyNode && bodyNode->nodeType == dom::NodeType::ELEMENT;
+   if (hasBody) {
+      layout_run(static_cast<dom::Element*>(bodyNode), (float)g_winW, (float)g_winH, dom_get_display_scale(ctx));
+   }
    JS_FreeValue(ctx, body);
    JS_FreeValue(ctx, document);
    JS_FreeValue(ctx, global);
+   return hasBody;
+}
+
+void layout_maybe_run(JSContext* ctx)
+{
+   if (!ctx) {
+      return;
+   }
+   static bool in_layout = false;
+   if (in_layout) {
+      return; // avoid reentrant invocation
+   }
+   in_layout = true;
+   // Transitions and animations advance on the frame clock first; their values go straight into styles and paint
+   // records (layout only for left/top), so this frame shows them without running any script
+   animations_tick(animation_clock_ms());
    extern void native_request_composite(JSContext*);
-   native_request_composite(ctx);
+   extern void native_request_animation_frame(JSContext*);
+   if (!g_layout_dirty) {
+      if (g_paint_dirty) {
+         g_paint_dirty = false;
+         native_request_composite(ctx);
+      }
+   }
+   else {
+      g_paint_dirty = false; // the frame after layout repaints anyway
+      if (layout_document(ctx)) {
+         native_request_composite(ctx);
+      }
+   }
+   // Layout may have started some (a resolved style with `animation` or a new transition)
+   if (animations_active()) {
+      native_request_animation_frame(ctx);
+   }
    in_layout = false;
 }
 
+// ---- Geometry queries ----
+// getBoundingClientRect / offset* / client* need an up-to-date box but no frame. A clean document is read as is.
+// When every pending change lies inside one contained subtree (fixed px size, see layout_contained_roots) and the
+// query targets that subtree, only that subtree is synced and laid out: its size cannot change, so nothing outside
+// it moves. Anything else runs the full document layout. Neither composites; they leave paint dirty so the next
+// frame shows the new boxes.
+
+static constexpr unsigned kLayoutDirtyBits =
+    kDirtyStyle | kDirtyYogaStyle | kDirtyLayout | kDirtyDescendant | kDirtyText | kDirtyInherited;
+
+static dom::Element* parent_element(dom::Element* el)
+{
+   auto p = el->parentNode.lock();
+   return p && p->nodeType == dom::NodeType::ELEMENT ? static_cast<dom::Element*>(p.get()) : nullptr;
+}
+
+static bool layout_dirty_bits(dom::Element* el, unsigned mask)
+{
+   auto* rd = get_render_data(el);
+   return rd && (rd->dirtyFlags() & mask);
+}
+
+static void clear_subtree_flags(dom::Element* el, unsigned mask)
+{
+   if (auto* rd = get_render_data(el)) {
+      rd->dirtyFlags() &= ~mask;
+   }
+   for (auto& c : el->childNodes) {
+      if (c && c->nodeType == dom::NodeType::ELEMENT) {
+         clear_subtree_flags(static_cast<dom::Element*>(c.get()), mask);
+      }
+   }
+}
+
+static bool layout_contained_only(dom::Element* el)
+{
+   dom::Element* root = el;
+   DomElementRenderData* rootRd = nullptr;
+   for (; root; root = parent_element(root)) {
+      rootRd = get_render_data(root);
+      if (!rootRd) {
+         return false; // never laid out
+      }
+      if (rootRd->subtreeRoot == SubtreeRoot::Contained && rootRd->layoutProxy && rootRd->hasLayoutBox) {
+         break;
+      }
+   }
+   // A style change on the root itself may resize it or end the containment
+   if (!root || rootRd->culled || (rootRd->dirtyFlags() & (kDirtyStyle | kDirtyYogaStyle | kDirtyInherited))) {
+      return false;
+   }
+   // Outside the root everything must be clean: its ancestors only flag the way down, their other children nothing
+   dom::Element* child = root;
+   for (dom::Element* a = parent_element(root); a; child = a, a = parent_element(a)) {
+      if (layout_dirty_bits(a, kLayoutDirtyBits & ~kDirtyDescendant)) {
+         return false;
+      }
+      for (auto& c : a->childNodes) {
+         if (c && c.get() != child && c->nodeType == dom::NodeType::ELEMENT &&
+             layout_dirty_bits(static_cast<dom::Element*>(c.get()), kLayoutDirtyBits)) {
+            return false;
+         }
+      }
+   }
+   sync_subtree(root, false, false);
+   layout_contained_roots(false);
+   YGNodeRef inner = (YGNodeRef)rootRd->yogaNode;
+   const LayoutBox& b = rootRd->box();
+   apply_children(root, rootRd, inner, b.x, b.y, false, rootRd->hasClip ? &rootRd->clip : nullptr);
+   YGNodeSetHasNewLayout(inner, false);
+   apply_scrolled();
+   clear_subtree_flags(root, kDirtyLayout | kDirtyDescendant | kDirtyText | kDirtyInherited);
+   for (dom::Element* a = parent_element(root); a; a = parent_element(a)) {
+      if (auto* rd = get_render_data(a)) {
+         rd->dirtyFlags() &= ~kDirtyDescendant;
+      }
+   }
+   g_layout_dirty = false;
+   return true;
+}
+
+bool layout_flush_for(JSContext* ctx, dom::Element* el)
+{
+   if (!ctx || !el) {
+      return false;
+   }
+   // A resize or scale change is not recorded in any element's flags
+   bool sameViewport = g_viewportW == (float)g_winW && g_viewportH == (float)g_winH &&
+                       g_viewportScale == dom_get_display_scale(ctx);
+   // A sheet change restyles every element, which rules out the scoped path below
+   if (g_layout_dirty) {
+      refresh_style_sheets(owner_document(el));
+   }
+   if (!g_layout_dirty && sameViewport) {
+      g_queryCached++;
+   }
+   else if (sameViewport && layout_contained_only(el)) {
+      g_queryScoped++;
+      g_paint_dirty = true; // the layout flag is now clear, so the next layout_maybe_run composites via this one
+   }
+   else {
+      g_queryFull++;
+      if (layout_document(ctx)) {
+         g_paint_dirty = true;
+      }
+   }
+   auto* rd = get_render_data(el);
+   return rd && rd->hasLayoutBox && !rd->culled;
+}
+
+bool layout_containing_block(dom::Element* el, LayoutBox& frame, LayoutBox& visible)
+{
+   auto* rd = get_render_data(el);
+   if (!rd || !rd->hasLayoutBox) {
+      return false;
+   }
+   // Yoga places an absolute box in the padding box of its nearest positioned ancestor (or of its tree's root); any
+   // other box flows in its parent's content box. Scroll containers on the way shift the box but not the insets.
+   const bool absolute = rd->computed().position == css::Position::Absolute;
+   float scrollX = 0, scrollY = 0;
+   dom::Element* cb = parent_element(el);
+   DomElementRenderData* cbRd = nullptr;
+   for (; cb; cb = parent_element(cb)) {
+      cbRd = get_render_data(cb);
+      if (!cbRd || !cbRd->hasLayoutBox) {
+         cb = nullptr;
+         break;
+      }
+      if (cbRd->scroll) {
+         scrollX += cbRd->scroll->x;
+         scrollY += cbRd->scroll->y;
+      }
+      const css::Position pos = cbRd->computed().position;
+      if (!absolute || pos == css::Position::Relative || pos == css::Position::Absolute ||
+          cbRd->subtreeRoot != SubtreeRoot::None || !parent_element(cb)) {
+         break;
+      }
+   }
+   if (!cb) {
+      frame = visible = LayoutBox{0, 0, g_viewportW, g_viewportH};
+      return true;
+   }
+   YGNodeRef node = (YGNodeRef)cbRd->yogaNode;
+   float l = 0, t = 0, r = 0, btm = 0;
+   if (node) {
+      l = YGNodeLayoutGetBorder(node, YGEdgeLeft);
+      t = YGNodeLayoutGetBorder(node, YGEdgeTop);
+      r = YGNodeLayoutGetBorder(node, YGEdgeRight);
+      btm = YGNodeLayoutGetBorder(node, YGEdgeBottom);
+      if (!absolute) {
+         l += YGNodeLayoutGetPadding(node, YGEdgeLeft);
+         t += YGNodeLayoutGetPadding(node, YGEdgeTop);
+         r += YGNodeLayoutGetPadding(node, YGEdgeRight);
+         btm += YGNodeLayoutGetPadding(node, YGEdgeBottom);
+      }
+   }
+   const LayoutBox& b = cbRd->box();
+   visible = LayoutBox{b.x + l, b.y + t, std::max(0.f, b.w - l - r), std::max(0.f, b.h - t - btm)};
+   frame = visible;
+   frame.x -= scrollX;
+   frame.y -= scrollY;
+   return true;
+}
+
 // (Batching removed for simplicity/robustness)
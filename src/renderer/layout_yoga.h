@@ -5,13 +5,38 @@
 namespace dom {
 class Element;
 }
+struct LayoutBox;
 
 // Mark global layout dirty (call on style mutations)
 void layout_mark_dirty();
 
+// Request a frame without a layout pass (paint-only style changes: colours, opacity)
+void paint_mark_dirty();
+
 // Run layout if dirty; builds Yoga tree from DOM starting at document.body
 // Applies computed positions/sizes into Element layout* fields (not modifying inline style)
+// Advances running animations first and, while any is running, asks the host for another frame
+// (native_request_animation_frame), which calls back in here.
 void layout_maybe_run(JSContext* ctx);
 
+// Lay out body (or its first element child) into a viewport of viewportW x viewportH CSS px, rounded to `scale`
+// device px per CSS px. Runs unconditionally; layout_maybe_run is the dirty-gated entry point the app uses.
+void layout_run(dom::Element* body, float viewportW, float viewportH, float scale);
+
 // Query computed layout box; returns true if available (values in CSS px units)
 bool layout_get_box(dom::Element* el, int& x, int& y, int& w, int& h);
+
+// The containing block `el`'s left/top/right/bottom resolve against, from the last layout (CSS px): the padding box
+// of its nearest positioned ancestor for position:absolute, its parent's content box otherwise. `frame` is in the
+// coordinates of el's box, which scrolling in between shifts; `visible` is where the containing block is. The
+// viewport when el has no laid-out ancestor; false when el itself has no box.
+bool layout_containing_block(dom::Element* el, LayoutBox& frame, LayoutBox& visible);
+
+// Scroll an overflow: auto | scroll container by (dx, dy) CSS px, clamped to its content from the last layout.
+// Returns false when `el` does not scroll or is already at that edge; otherwise layout is marked dirty.
+bool layout_scroll_by(dom::Element* el, float dx, float dy);
+
+// Bring `el`'s layout box up to date for a geometry query (getBoundingClientRect, offset*, client*) without
+// compositing: served as is when layout is clean, by laying out only the enclosing contained subtree when all
+// pending changes are inside it, by a full document layout otherwise. Returns true when `el` has a box.
+bool layout_flush_for(JSContext* ctx, dom::Element* el);
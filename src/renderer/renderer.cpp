@@ -1,36 +1,123 @@
 #include "renderer.h"
+#include "renderer/element_data.h"
 #include "scheduler.h"
 #include "wapis/dom.hpp"
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 extern void layout_mark_dirty();
 
-RenderLayer* Renderer::ensureLayer(dom::Element* el)
+static dom::Element* as_element(dom::Node* n)
 {
-   if (!el)
-      return nullptr;
-   auto it = layers_.find(el);
-   if (it != layers_.end())
-      return it->second.get();
-   auto rl = std::make_unique<RenderLayer>();
-   rl->element = el;
-   rl->dirtyStyle = rl->dirtyChildren = true;
-   rl->createOrder = nextCreateOrder_++;
-   auto* ptr = rl.get();
-   layers_[el] = std::move(rl);
-   orderDirty_ = true;
-   return ptr;
+   return n && n->nodeType == dom::NodeType::ELEMENT ? static_cast<dom::Element*>(n) : nullptr;
 }
 
-void Renderer::onElementCreated(dom::Element* el)
+static RenderLayer* layer_of(dom::Element* el)
 {
-   ensureLayer(el); // allocate layer lazily
-   layout_mark_dirty();
+   const DomElementRenderData* rd = get_render_data(el);
+   return rd ? rd->layer : nullptr;
+}
+
+// Outside a virtualized scroll window: no render object until layout takes it into the window (which calls
+// renderer_child_inserted). Elements without render data start culled under such a container (ensure_render_data).
+static bool culled(dom::Element* el)
+{
+   if (const DomElementRenderData* rd = get_render_data(el))
+      return rd->culled;
+   auto parent = el->parentNode.lock();
+   const DomElementRenderData* prd = get_render_data(as_element(parent.get()));
+   return prd && (prd->culled || (prd->scroll && prd->scroll->virtualize));
+}
+
+// Children of `n` that may have render objects: the window of a virtualized scroll container, all of them otherwise.
+// Keeps linking O(window) however many rows the container holds.
+static void linkable_range(dom::Node* n, size_t& begin, size_t& end)
+{
+   begin = 0;
+   end = n->childNodes.size();
+   const DomElementRenderData* rd = get_render_data(as_element(n));
+   if (rd && rd->scroll && rd->scroll->virtualize) {
+      begin = std::min(rd->scroll->first, end);
+      end = std::min(rd->scroll->last, end);
+   }
+}
+
+// `a` comes before `b` in tree order (`a` is not inside `b`). Siblings are searched from the back, so comparing
+// against the last child (an append) stops at once.
+static bool tree_order_before(dom::Node* a, dom::Node* b)
+{
+   std::vector<dom::Node*> pa, pb; // ancestor chains, node first
+   for (dom::Node* n = a; n; n = n->parentNode.lock().get())
+      pa.push_back(n);
+   for (dom::Node* n = b; n; n = n->parentNode.lock().get())
+      pb.push_back(n);
+   size_t i = pa.size(), j = pb.size();
+   while (i > 0 && j > 0 && pa[i - 1] == pb[j - 1]) {
+      --i;
+      --j;
+   }
+   if (i == 0)
+      return true; // a is an ancestor of b
+   if (j == 0 || i == pa.size() || j == pb.size())
+      return false; // b is an ancestor of a, or different trees
+   const auto& kids = pa[i]->childNodes; // children of the common ancestor
+   for (size_t k = kids.size(); k-- > 0;) {
+      if (kids[k].get() == pa[i - 1])
+         return false; // a's branch is later
+      if (kids[k].get() == pb[j - 1])
+         return true;
+   }
+   return false;
+}
+
+// Frees `rl`'s descendants without touching their elements (they may already be gone)
+static void free_layers(RenderLayer* rl)
+{
+   for (RenderLayer* c = rl->firstChild; c;) {
+      RenderLayer* next = c->nextSibling;
+      free_layers(c);
+      delete c;
+      c = next;
+   }
+   rl->firstChild = rl->lastChild = nullptr;
+}
+
+// Pre-order over `rl`'s descendants
+template <typename Fn> static void walk_tree(RenderLayer* rl, Fn&& fn)
+{
+   for (RenderLayer* c = rl->firstChild; c; c = c->nextSibling) {
+      fn(c);
+      walk_tree(c, fn);
+   }
+}
+
+Renderer::Renderer()
+{
+   root_.hoisted = root_.stackingContext = true;
+}
+
+Renderer::~Renderer()
+{
+   free_layers(&root_);
+}
+
+void Renderer::attach(dom::Document* doc)
+{
+   if (!doc)
+      return;
+   document_ = doc;
+   doc->addObserver(this);
+   linkedAll_ = false;
+}
+
+void Renderer::onElementCreated(dom::Element*)
+{
+   layout_mark_dirty(); // the render object is created when the element is linked into the document tree
 }
 
 void Renderer::onElementRemoved(dom::Element* el)
 {
-   layers_.erase(el);
-   orderDirty_ = true;
+   unlinkSubtree(el); // usually already done by the mutation hook
    layout_mark_dirty();
 }
 
@@ -38,7 +125,7 @@ void Renderer::onAttributeChanged(dom::Element* el, const std::string& name, con
                                   const std::string& newValue)
 {
    if (name == "style" && oldValue != newValue) {
-      if (auto* rl = ensureLayer(el))
+      if (RenderLayer* rl = layer_of(el))
          rl->dirtyStyle = true;
       scheduleFrame();
       layout_mark_dirty();
@@ -47,46 +134,223 @@ void Renderer::onAttributeChanged(dom::Element* el, const std::string& name, con
 
 void Renderer::onChildListChanged(dom::Element* el)
 {
-   if (auto* rl = ensureLayer(el)) {
+   if (RenderLayer* rl = layer_of(el)) {
       rl->dirtyChildren = true;
       scheduleFrame();
    }
    layout_mark_dirty();
-   orderDirty_ = true;
 }
 
-void Renderer::frame()
+void Renderer::childInserted(dom::Element* el)
 {
-   // Rebuild ordering if dirty
-   if (orderDirty_) {
-      ordered_.clear();
-      ordered_.reserve(layers_.size());
-      for (auto& kv : layers_)
-         ordered_.push_back(kv.second.get());
-      // Assign depth by walking parent chain (simple heuristic: distance to root)
-      for (auto* rl : ordered_) {
-         int d = 0;
-         auto* n = rl->element;
-         while (n && n->parentNode.lock()) {
-            d++;
-            n = static_cast<dom::Element*>(n->parentNode.lock().get());
-         }
-         rl->depth = d;
+   if (linkedAll_)
+      pending_.insert(el);
+}
+
+void Renderer::childRemoved(dom::Element* el)
+{
+   if (linkedAll_)
+      unlinkSubtree(el);
+}
+
+void Renderer::restack(dom::Element* el)
+{
+   if (linkedAll_)
+      pending_.insert(el);
+}
+
+// Render parent of `el`: the root for children of the document, nullptr when the parent has no render object
+// (display:none, not linked yet, or outside the document)
+RenderLayer* Renderer::parentLayer(dom::Element* el)
+{
+   auto parent = el->parentNode.lock();
+   if (!parent)
+      return nullptr;
+   if (parent->nodeType == dom::NodeType::DOCUMENT)
+      return parent.get() == document_ ? &root_ : nullptr;
+   return layer_of(as_element(parent.get()));
+}
+
+void Renderer::linkAll()
+{
+   walk_tree(&root_, [this](RenderLayer* rl) {
+      damage_.op(rl->bounds, SkRegion::kUnion_Op);
+      if (DomElementRenderData* rd = get_render_data(rl->element))
+         rd->layer = nullptr;
+   });
+   free_layers(&root_);
+   root_.negativeZ.clear();
+   root_.positiveZ.clear();
+   pending_.clear();
+   paintChanged_.clear();
+   canvases_.clear();
+   if (document_) {
+      ++round_;
+      walking_ = true;
+      for (auto& c : document_->childNodes) {
+         if (auto* e = as_element(c.get()))
+            linkSubtree(e, &root_, nullptr);
+      }
+      walking_ = false;
+   }
+   // Only now: restacks raised by styles resolved during the walk are already in the new tree, and queueing them
+   // would relink it on the next frame
+   linkedAll_ = true;
+}
+
+void Renderer::linkPending()
+{
+   ++round_;
+   while (!pending_.empty()) {
+      std::unordered_set<dom::Element*> batch;
+      batch.swap(pending_);
+      for (dom::Element* el : batch) {
+         RenderLayer* rl = layer_of(el);
+         if (rl && rl->linkedRound == round_)
+            continue; // rebuilt with an ancestor in this round
+         // An ancestor in the same batch rebuilds this subtree anyway
+         bool covered = false;
+         for (auto p = el->parentNode.lock(); p && !covered; p = p->parentNode.lock())
+            covered = p->nodeType == dom::NodeType::ELEMENT && batch.count(static_cast<dom::Element*>(p.get()));
+         if (covered)
+            continue;
+         unlinkSubtree(el); // a move or restack: it leaves its old place first
+         if (RenderLayer* parent = parentLayer(el))
+            linkSubtree(el, parent, nextSiblingLayer(el));
+      }
+   }
+}
+
+// Render object of the nearest later sibling of `el` that has one; nullptr when `el` goes last
+RenderLayer* Renderer::nextSiblingLayer(dom::Element* el)
+{
+   auto parent = el->parentNode.lock();
+   if (!parent)
+      return nullptr;
+   RenderLayer* next = nullptr;
+   const auto& kids = parent->childNodes;
+   size_t begin, end;
+   linkable_range(parent.get(), begin, end);
+   for (size_t i = end; i-- > begin && kids[i].get() != el;) {
+      if (RenderLayer* rl = layer_of(as_element(kids[i].get())))
+         next = rl;
+   }
+   return next;
+}
+
+// Build render objects for `el` and its descendants in pre-order, inserting `el`'s before `before` among
+// `parent`'s children (last when nullptr). A display:none or culled element contributes nothing, nor does its
+// subtree; culled rows are not even styled.
+RenderLayer* Renderer::linkSubtree(dom::Element* el, RenderLayer* parent, RenderLayer* before)
+{
+   if (culled(el) || !paint_props(el).rendered)
+      return nullptr;
+   RenderLayer* rl = link(el, parent, before);
+   size_t begin, end;
+   linkable_range(el, begin, end);
+   for (size_t i = begin; i < end; ++i) {
+      if (auto* e = as_element(el->childNodes[i].get()))
+         linkSubtree(e, rl, nullptr);
+   }
+   return rl;
+}
+
+RenderLayer* Renderer::link(dom::Element* el, RenderLayer* parent, RenderLayer* before)
+{
+   const PaintProps& pp = paint_props(el);
+   auto* rl = new RenderLayer();
+   rl->element = el;
+   rl->owner = this;
+   rl->linkedRound = round_;
+   paintChanged_.insert(rl); // starts paint- and transform-dirty
+   ensure_render_data(el)->layer = rl;
+   rl->parent = parent;
+   rl->nextSibling = before;
+   rl->prevSibling = before ? before->prevSibling : parent->lastChild;
+   (rl->prevSibling ? rl->prevSibling->nextSibling : parent->firstChild) = rl;
+   (before ? before->prevSibling : parent->lastChild) = rl;
+   rl->promoted = pp.promoted;
+   rl->composited = parent->composited ? parent->composited : parent->promoted ? parent : nullptr;
+   rl->hoisted = pp.positioned || pp.stackingContext;
+   rl->stackingContext = pp.stackingContext;
+   rl->zIndex = pp.zIndex;
+   if (rl->hoisted) {
+      RenderLayer* sc = parent;
+      while (!sc->stackingContext)
+         sc = sc->parent;
+      rl->context = sc;
+      std::vector<RenderLayer*>& list = rl->zIndex < 0 ? sc->negativeZ : sc->positiveZ;
+      // After every lower z-index, and after equal ones that precede `el` in tree order
+      auto pos = std::upper_bound(list.begin(), list.end(), rl->zIndex,
+                                  [](int32_t z, const RenderLayer* l) { return z < l->zIndex; });
+      if (!walking_) {
+         while (pos != list.begin() && pos[-1]->zIndex == rl->zIndex && tree_order_before(el, pos[-1]->element))
+            --pos;
       }
-      std::sort(ordered_.begin(), ordered_.end(), [](RenderLayer* a, RenderLayer* b) {
-         if (a->depth != b->depth)
-            return a->depth < b->depth;          // parents first
-         return a->createOrder < b->createOrder; // stable
-      });
-      orderDirty_ = false;
-   }
-   for (auto* rl : ordered_) {
+      list.insert(pos, rl);
+   }
+   return rl;
+}
+
+// Free the render objects of `el`'s subtree and forget its pending insertions (the elements may be freed next)
+void Renderer::unlinkSubtree(dom::Element* el)
+{
+   if (!pending_.empty()) {
+      std::function<void(dom::Element*)> forget = [&](dom::Element* e) {
+         pending_.erase(e);
+         for (auto& c : e->childNodes) {
+            if (auto* ce = as_element(c.get()))
+               forget(ce);
+         }
+      };
+      forget(el);
+   }
+   RenderLayer* rl = layer_of(el);
+   if (!rl)
+      return; // no render object, so none in its subtree either
+   RenderLayer* parent = rl->parent;
+   (rl->prevSibling ? rl->prevSibling->nextSibling : parent->firstChild) = rl->nextSibling;
+   (rl->nextSibling ? rl->nextSibling->prevSibling : parent->lastChild) = rl->prevSibling;
+   destroy(rl);
+}
+
+// Post-order, so a stacking context's z lists are emptied by its descendants before it goes
+void Renderer::destroy(RenderLayer* rl)
+{
+   for (RenderLayer* c = rl->firstChild; c;) {
+      RenderLayer* next = c->nextSibling;
+      destroy(c);
+      c = next;
+   }
+   if (rl->hoisted) {
+      std::vector<RenderLayer*>& list = rl->zIndex < 0 ? rl->context->negativeZ : rl->context->positiveZ;
+      auto pos = std::find(list.begin(), list.end(), rl);
+      if (pos != list.end())
+         list.erase(pos);
+   }
+   damage_.op(rl->bounds, SkRegion::kUnion_Op); // whatever it covered is uncovered
+   if (rl->composited) {
+      rl->composited->rasterDirty = true; // redrawn without it (the post-order walk frees a removed layer last)
+      paintChanged(rl->composited);
+   }
+   paintChanged_.erase(rl);
+   canvases_.erase(rl);
+   if (DomElementRenderData* rd = get_render_data(rl->element))
+      rd->layer = nullptr;
+   delete rl;
+}
+
+void Renderer::frame()
+{
+   const bool log = std::getenv("RENDER_DEBUG") != nullptr; // one line per dirty layer: off the hot path by default
+   walk_tree(&root_, [log](RenderLayer* rl) {
       if (rl->dirtyStyle || rl->dirtyChildren) {
-         std::fprintf(stderr, "[Renderer] repaint element=%p depth=%d style=%d children=%d\n", (void*)rl->element,
-                      rl->depth, rl->dirtyStyle, rl->dirtyChildren);
+         if (log)
+            std::fprintf(stderr, "[Renderer] repaint element=%p z=%d style=%d children=%d\n", (void*)rl->element,
+                         rl->zIndex, rl->dirtyStyle, rl->dirtyChildren);
          rl->dirtyStyle = rl->dirtyChildren = false;
       }
-   }
+   });
    framePending_ = false;
 }
 
@@ -98,31 +362,194 @@ void Renderer::scheduleFrame()
    scheduler_request([this] { this->frame(); });
 }
 
-void Renderer::forEachLayer(const std::function<void(RenderLayer*)>& cb)
+void Renderer::paintContext(RenderLayer* sc, const std::function<void(RenderLayer*)>& cb,
+                            const std::function<void(RenderLayer*)>& leave)
 {
-   if (orderDirty_) { // ensure an order before iterating
-      ordered_.clear();
-      ordered_.reserve(layers_.size());
-      for (auto& kv : layers_)
-         ordered_.push_back(kv.second.get());
-      for (auto* rl : ordered_) {
-         int d = 0;
-         auto* n = rl->element;
-         while (n && n->parentNode.lock()) {
-            d++;
-            n = static_cast<dom::Element*>(n->parentNode.lock().get());
-         }
-         rl->depth = d;
+   // Non-hoisted descendants in tree order; hoisted ones and their subtrees paint from their stacking context
+   std::function<void(RenderLayer*)> flow = [&](RenderLayer* rl) {
+      for (RenderLayer* c = rl->firstChild; c; c = c->nextSibling) {
+         if (c->hoisted)
+            continue;
+         cb(c);
+         flow(c);
+      }
+   };
+   auto paintHoisted = [&](RenderLayer* l) {
+      if (l->stackingContext) {
+         paintContext(l, cb, leave);
+         return;
+      }
+      cb(l); // positioned without a z-index: itself and its flow, at its place in the z = 0 list
+      flow(l);
+   };
+   if (sc->element)
+      cb(sc);
+   for (RenderLayer* l : sc->negativeZ)
+      paintHoisted(l);
+   flow(sc);
+   for (RenderLayer* l : sc->positiveZ)
+      paintHoisted(l);
+   if (sc->element && leave)
+      leave(sc);
+}
+
+void Renderer::updateTree()
+{
+   if (!linkedAll_)
+      linkAll();
+   else if (!pending_.empty())
+      linkPending();
+}
+
+void Renderer::forEachLayer(const std::function<void(RenderLayer*)>& cb,
+                            const std::function<void(RenderLayer*)>& leave)
+{
+   updateTree();
+   paintContext(&root_, cb, leave);
+}
+
+void Renderer::forEachLayerIn(RenderLayer* sc, const std::function<void(RenderLayer*)>& cb,
+                              const std::function<void(RenderLayer*)>& leave)
+{
+   paintContext(sc, cb, leave);
+}
+
+dom::Element* Renderer::hitTest(int x, int y)
+{
+   hitOrder_.clear();
+   forEachLayer([this](RenderLayer* rl) { hitOrder_.push_back(rl); });
+   // Reverse paint order: the first match is on top
+   for (auto it = hitOrder_.rbegin(); it != hitOrder_.rend(); ++it) {
+      dom::Element* el = (*it)->element;
+      // Clipped-away parts of scroll containers are not painted, so they cannot be hit either (culled rows have no
+      // render object)
+      const DomElementRenderData* rd = get_render_data(el);
+      if (rd && rd->hasClip &&
+          (x < rd->clip.x || x > rd->clip.x + rd->clip.w || y < rd->clip.y || y > rd->clip.y + rd->clip.h))
+         continue;
+      // Same rectangle the compositor paints, read from the precomputed paint record, moved with a dragged layer
+      int left = 0, top = 0, w = 0, h = 0;
+      paint_rect(el, left, top, w, h);
+      const RenderLayer* moved = (*it)->composited ? (*it)->composited : *it;
+      if (const DomElementRenderData* mrd = moved->promoted ? get_render_data(moved->element) : nullptr) {
+         left += (int)mrd->dragX;
+         top += (int)mrd->dragY;
       }
-      std::sort(ordered_.begin(), ordered_.end(), [](RenderLayer* a, RenderLayer* b) {
-         if (a->depth != b->depth)
-            return a->depth < b->depth;
-         return a->createOrder < b->createOrder;
-      });
-      orderDirty_ = false;
+      if (x >= left && x <= left + w && y >= top && y <= top + h)
+         return el;
+   }
+   return nullptr;
+}
+
+void Renderer::paintChanged(RenderLayer* rl)
+{
+   if (!rl->paintDirty) {
+      rl->paintDirty = true;
+      paintChanged_.insert(rl);
+   }
+}
+
+// Descendants are placed relative to their compositor layer, so the walk marks a promoted layer but not its members
+static void invalidate_transforms(Renderer* r, RenderLayer* rl)
+{
+   rl->transformDirty = true;
+   r->paintChanged(rl);
+   for (RenderLayer* c = rl->firstChild; c; c = c->nextSibling) {
+      if (c->promoted && !c->composited) {
+         c->transformDirty = true;
+         r->paintChanged(c);
+      }
+      else {
+         invalidate_transforms(r, c);
+      }
+   }
+}
+
+void Renderer::transformChanged(RenderLayer* rl)
+{
+   invalidate_transforms(this, rl);
+}
+
+void Renderer::allPaintChanged()
+{
+   walk_tree(&root_, [this](RenderLayer* rl) {
+      rl->transformDirty = true;
+      paintChanged(rl);
+   });
+}
+
+void Renderer::takePaintChanged(std::vector<RenderLayer*>& out)
+{
+   for (RenderLayer* rl : canvases_)
+      paintChanged(rl);
+   out.assign(paintChanged_.begin(), paintChanged_.end());
+   for (RenderLayer* rl : out)
+      rl->paintDirty = false;
+   paintChanged_.clear();
+}
+
+void Renderer::setShowsCanvas(RenderLayer* rl, bool shows)
+{
+   if (shows)
+      canvases_.insert(rl);
+   else
+      canvases_.erase(rl);
+}
+
+SkRegion Renderer::takeDamage()
+{
+   SkRegion taken;
+   taken.swap(damage_);
+   return taken;
+}
+
+Renderer* document_renderer(dom::Document* doc)
+{
+   if (!doc)
+      return nullptr;
+   for (auto* o : doc->observers()) {
+      if (auto* r = dynamic_cast<Renderer*>(o))
+         return r;
    }
-   for (auto* rl : ordered_)
-      cb(rl);
+   return nullptr;
+}
+
+static Renderer* element_renderer(dom::Element* el)
+{
+   auto owner = el ? el->ownerDocument.lock() : nullptr;
+   if (!owner || owner->nodeType != dom::NodeType::DOCUMENT)
+      return nullptr;
+   return document_renderer(static_cast<dom::Document*>(owner.get()));
+}
+
+void renderer_child_inserted(dom::Element* el)
+{
+   if (Renderer* r = element_renderer(el))
+      r->childInserted(el);
+}
+
+void renderer_child_removed(dom::Element* el)
+{
+   if (Renderer* r = element_renderer(el))
+      r->childRemoved(el);
+}
+
+void renderer_restack(dom::Element* el)
+{
+   if (Renderer* r = element_renderer(el))
+      r->restack(el);
+}
+
+void renderer_paint_changed(dom::Element* el)
+{
+   if (RenderLayer* rl = layer_of(el))
+      rl->owner->paintChanged(rl);
+}
+
+void renderer_transform_changed(dom::Element* el)
+{
+   if (RenderLayer* rl = layer_of(el))
+      rl->owner->transformChanged(rl);
 }
 
-// No global functions; the app should own a Renderer instance.
+// No global functions besides the hooks above; the app should own a Renderer instance.
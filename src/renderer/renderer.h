@@ -1,26 +1,103 @@
 #pragma once
 #include "dom_observer.h"
 #include <functional>
-#include <memory>
-#include <unordered_map>
+#include <include/core/SkColor.h>
+#include <include/core/SkImage.h>
+#include <include/core/SkMatrix.h>
+#include <include/core/SkPicture.h>
+#include <include/core/SkRect.h>
+#include <include/core/SkRefCnt.h>
+#include <include/core/SkRegion.h>
+#include <unordered_set>
 #include <vector>
 
 namespace dom {
+class Document;
 class Element;
+class Node;
 }
 
+// Everything a layer's recorded picture was drawn from (device px). The compositor replays the picture while the
+// element's current values still compare equal, so style, layout box, text and canvas changes all re-record it.
+struct LayerPaintKey {
+   SkColor4f background = {0, 0, 0, 0};
+   int x = 0, y = 0, w = 0, h = 0; // CSS px
+   float deviceScale = 0;
+   uint32_t imageId = 0; // canvas snapshot's SkImage::uniqueID(); 0 = none
+   uint32_t blobId = 0;  // text blob's SkTextBlob::uniqueID(); 0 = none
+   SkColor4f textColor = {0, 0, 0, 0};
+   float textInsetX = 0, textInsetY = 0;
+   bool debugBorders = false;
+
+   bool operator==(const LayerPaintKey&) const = default;
+};
+
+// One render object per element that generates a box (display:none subtrees and detached elements have none)
+class Renderer;
+
 struct RenderLayer {
-   dom::Element* element = nullptr; // non-owning
+   dom::Element* element = nullptr; // non-owning; nullptr for the renderer's root
+   Renderer* owner = nullptr;
    bool dirtyStyle = true;
    bool dirtyChildren = true;
-   int depth = 0;
-   uint64_t createOrder = 0; // monotonic for stable ordering among siblings
+   // Render tree: mirrors the element tree of the document, in child order. Parents own their children.
+   RenderLayer* parent = nullptr;
+   RenderLayer* firstChild = nullptr;
+   RenderLayer* lastChild = nullptr;
+   RenderLayer* prevSibling = nullptr;
+   RenderLayer* nextSibling = nullptr;
+   uint32_t linkedRound = 0; // Renderer::round_ it was created in
+   // Paint order (see Renderer)
+   bool hoisted = false;         // positioned or a stacking context: painted from `context`'s z lists
+   bool stackingContext = false; // holds the z lists of its hoisted descendants
+   int32_t zIndex = 0;
+   RenderLayer* context = nullptr;      // hoisted: stacking context whose z list holds this layer
+   std::vector<RenderLayer*> negativeZ; // stacking context: hoisted descendants with z < 0, by z then tree order
+   std::vector<RenderLayer*> positiveZ; // z >= 0 (auto counts as 0)
+   // Retained display list: the layer's own draws (background, canvas image, text), without clip or transform
+   bool recorded = false;
+   LayerPaintKey paintKey;
+   sk_sp<SkPicture> picture; // nullptr when the layer draws nothing
+   // Where the picture landed on the last collect_damage (compositor.h); composite_layers replays it there. Only
+   // layers marked paint-dirty (Renderer::paintChanged) are visited again.
+   bool paintDirty = true;
+   bool clipped = false, transformed = false;
+   SkRect clip = SkRect::MakeEmpty(); // device px
+   // Accumulated transforms of the element and its ancestors (up to its compositor layer, for members), cached until
+   // one of them changes (Renderer::transformChanged)
+   bool transformDirty = true;
+   SkMatrix transform;
+   SkIRect bounds = SkIRect::MakeEmpty(); // device px covered after transform and clip; empty = not painted
+   // Compositor layer (promoted: will-change, animated or dragged). Its subtree is rastered once into `raster`, and
+   // only `raster` is composited: with the layer's transform (drag offset included) and opacity, so moving it
+   // re-rasters nothing. Layers inside the subtree are its members: their clip, transform and bounds above are
+   // relative to the raster, and they are drawn only into it. Nested promoted layers are flattened into the
+   // outermost one.
+   bool promoted = false;
+   RenderLayer* composited = nullptr; // member: outermost promoted ancestor whose raster holds this layer
+   sk_sp<SkImage> raster;             // nullptr when the subtree draws nothing
+   SkIRect rasterBounds = SkIRect::MakeEmpty(); // device px the raster covers, before transform and clip
+   float rasterOpacity = 1.f;                   // group opacity applied when compositing
+   bool rasterDirty = false; // a member was added, removed or placed differently since the raster was drawn
+   // Any other stacking context: the opacity its painting (itself, its z lists and its flow) is composited with as
+   // one group (saveLayerAlpha), as of the last collect_damage
+   float groupOpacity = 1.f;
 };
 
+// Owns the render tree of the observed document and paints it in CSS order: a pre-order walk in which positioned
+// elements and stacking contexts (positioned with a z-index, opacity < 1, transform) are lifted out of the walk into
+// their stacking context. A stacking context paints itself, then its negative z-index descendants, then its
+// non-hoisted descendants in tree order, then its z >= 0 descendants; positioned elements without a z-index paint
+// their own non-hoisted subtree there. The tree is patched on insert, remove and restack: appending one element
+// costs a sibling lookup and a list splice, removing a subtree frees it in one walk. An element finds its render
+// object through DomElementRenderData::layer.
 class Renderer : public dom::DomObserver {
  public:
-   Renderer() = default;
-   ~Renderer() override = default;
+   Renderer();
+   ~Renderer() override;
+
+   // Observe `doc` (adds this renderer to its observers); its tree is built on the first forEachLayer
+   void attach(dom::Document* doc);
 
    void onElementCreated(dom::Element* el) override;
    void onElementRemoved(dom::Element* el) override;
@@ -28,17 +105,84 @@ class Renderer : public dom::DomObserver {
                            const std::string& newValue) override;
    void onChildListChanged(dom::Element* el) override;
 
+   // Tree mutations (see renderer_child_inserted/renderer_child_removed below). Insertions are linked on the next
+   // forEachLayer, when styles are resolved; removals free the subtree's render objects at once.
+   void childInserted(dom::Element* el);
+   void childRemoved(dom::Element* el);
+   // `el`'s display, positioning, z-index or stacking context changed: rebuilt on the next forEachLayer
+   void restack(dom::Element* el);
+
    void frame();                                                   // naive full pass over dirty layers
    void scheduleFrame();                                           // request an async frame (coalesced)
-   void forEachLayer(const std::function<void(RenderLayer*)>& cb); // safe iteration
+   // Paint order. `leave`, when given, is called after each stacking context's painting (itself, its z lists and
+   // its flow) is done, so callers can group it.
+   void forEachLayer(const std::function<void(RenderLayer*)>& cb,
+                     const std::function<void(RenderLayer*)>& leave = nullptr);
+   // The same order restricted to stacking context `sc`'s painting, `sc` first; call after forEachLayer linked the tree
+   void forEachLayerIn(RenderLayer* sc, const std::function<void(RenderLayer*)>& cb,
+                       const std::function<void(RenderLayer*)>& leave = nullptr);
+   // Link pending insertions and restacks (forEachLayer does this first)
+   void updateTree();
+   // What `rl` draws or where changed; collect_damage revisits only such layers. transformChanged: its transform or
+   // drag offset, which also places its descendants (down to compositor layers, whose members are relative to them).
+   void paintChanged(RenderLayer* rl);
+   void transformChanged(RenderLayer* rl);
+   void allPaintChanged(); // device scale changed
+   // Layers marked since the last call, plus every layer showing a canvas (setShowsCanvas), whose pixels change
+   // without the Renderer knowing; each once
+   void takePaintChanged(std::vector<RenderLayer*>& out);
+   void setShowsCanvas(RenderLayer* rl, bool shows);
+   // Device scale the layers were last placed at (collect_damage); 0 before the first frame
+   float paintScale() const
+   {
+      return paintScale_;
+   }
+   void setPaintScale(float scale)
+   {
+      paintScale_ = scale;
+   }
+   // Topmost painted element whose paint rect contains (x, y) CSS px, honouring culling and overflow clips
+   dom::Element* hitTest(int x, int y);
+   // Device-px area uncovered by removed layers since the last call (their last painted bounds)
+   SkRegion takeDamage();
 
  private:
-   RenderLayer* ensureLayer(dom::Element* el);
-   std::unordered_map<dom::Element*, std::unique_ptr<RenderLayer>> layers_; // primary lookup
-   std::vector<RenderLayer*> ordered_;                                      // cached ordered list
-   bool orderDirty_ = true;
-   uint64_t nextCreateOrder_ = 1;
+   RenderLayer* parentLayer(dom::Element* el);
+   void linkAll();
+   void linkPending();
+   RenderLayer* linkSubtree(dom::Element* el, RenderLayer* parent, RenderLayer* before);
+   RenderLayer* link(dom::Element* el, RenderLayer* parent, RenderLayer* before);
+   RenderLayer* nextSiblingLayer(dom::Element* el);
+   void unlinkSubtree(dom::Element* el);
+   void destroy(RenderLayer* rl);
+   void paintContext(RenderLayer* sc, const std::function<void(RenderLayer*)>& cb,
+                     const std::function<void(RenderLayer*)>& leave);
+
+   RenderLayer root_; // root of the render tree and root stacking context of the document
+   dom::Document* document_ = nullptr;
+   bool linkedAll_ = false; // the document tree was built once; afterwards only mutations patch it
+   bool walking_ = false;   // linkAll: every existing layer precedes the one being linked in tree order
+   std::unordered_set<dom::Element*> pending_; // inserted or restacked since the last forEachLayer
+   uint32_t round_ = 0;
+   std::vector<RenderLayer*> hitOrder_; // hitTest scratch
+   std::unordered_set<RenderLayer*> paintChanged_;
+   std::unordered_set<RenderLayer*> canvases_;
+   float paintScale_ = 0;
    bool framePending_ = false;
+   SkRegion damage_;
 };
 
+// The Renderer observing `doc`; nullptr when none is attached
+Renderer* document_renderer(dom::Document* doc);
+
+// Called from the document's mutation hook (layout_yoga.cpp) and style resolution (element_data.cpp); forward to
+// the Renderer observing the element's document.
+void renderer_child_inserted(dom::Element* el); // el was just inserted into its parent
+void renderer_child_removed(dom::Element* el);  // el is about to be removed from its parent
+void renderer_restack(dom::Element* el);
+// What the element paints (renderer_paint_changed) or its transform or drag offset (renderer_transform_changed)
+// changed; no-ops for elements without a render object
+void renderer_paint_changed(dom::Element* el);
+void renderer_transform_changed(dom::Element* el);
+
 // Instantiate and manage a Renderer in the embedding app.
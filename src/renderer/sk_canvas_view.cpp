@@ -2,7 +2,9 @@
 #include <include/core/SkColor.h>
 #include <include/core/SkImageInfo.h>
 #include <include/core/SkPaint.h>
+#include <include/core/SkSamplingOptions.h>
 #include <include/core/SkSurface.h>
+#include <cmath>
 #include <mutex>
 
 struct GfxStateHandle {
@@ -22,11 +24,33 @@ void gfx_state_destroy(GfxStateHandle* g)
    delete g;
 }
 
+// Bring a view's surface to the current device scale, carrying its pixels over resampled until redrawn
+static void rescale_view(GfxStateHandle* gs, SkCanvasView& v)
+{
+   const float s = gs->device_scale;
+   if (v.scale == s || !v.surface)
+      return;
+   SkImageInfo info = SkImageInfo::Make((int)std::lround(v.width * s), (int)std::lround(v.height * s),
+                                        kN32_SkColorType, kPremul_SkAlphaType);
+   sk_sp<SkSurface> surface = SkSurfaces::Raster(info);
+   if (!surface)
+      return;
+   SkCanvas* c = surface->getCanvas();
+   sk_sp<SkImage> old = v.surface->makeImageSnapshot();
+   c->drawImageRect(old.get(), SkRect::MakeWH((SkScalar)info.width(), (SkScalar)info.height()),
+                    SkSamplingOptions(SkFilterMode::kLinear));
+   if (s != 1.f)
+      c->scale(s, s);
+   v.surface = std::move(surface);
+   v.scale = s;
+}
+
 static SkCanvas* canvas_for(GfxStateHandle* gs, int id)
 {
    auto it = gs->views.find(id);
    if (it == gs->views.end())
       return nullptr;
+   rescale_view(gs, it->second);
    return it->second.surface ? it->second.surface->getCanvas() : nullptr;
 }
 
@@ -44,7 +68,7 @@ int gfx_create_canvas(GfxStateHandle* gs, int width, int height)
    if (!surface)
       return -1;
    int id = gs->next_id++;
-   gs->views[id] = {id, width, height, surface};
+   gs->views[id] = {id, width, height, surface, s};
    // Ensure drawing commands use logical coordinates (points)
    if (SkCanvas* c = surface->getCanvas()) {
       if (s != 1.f) c->scale(s, s);
@@ -91,6 +115,7 @@ sk_sp<SkImage> gfx_snapshot(GfxStateHandle* gs, int id)
    auto it = gs->views.find(id);
    if (it == gs->views.end())
       return nullptr;
+   rescale_view(gs, it->second);
    return it->second.surface ? it->second.surface->makeImageSnapshot() : nullptr;
 }
 
@@ -114,24 +139,8 @@ void gfx_set_device_scale(GfxStateHandle* gs, float scale)
    if (!gs)
       return;
    std::lock_guard<std::mutex> lock(gs->mtx);
-   float s = (scale > 0.f) ? scale : 1.f;
-   if (std::abs(gs->device_scale - s) < 1e-6f) {
-      gs->device_scale = s;
-      return;
-   }
-   // Update scale for future draws without discarding existing content.
-   // Existing pixels remain at their previous resolution until redrawn.
-   gs->device_scale = s;
-   for (auto& kv : gs->views) {
-      SkCanvasView& v = kv.second;
-      if (v.surface) {
-         if (SkCanvas* c = v.surface->getCanvas()) {
-            c->resetMatrix();
-            if (s != 1.f)
-               c->scale(s, s);
-         }
-      }
-   }
+   // Surfaces follow lazily (rescale_view), so a scale change costs nothing for canvases that are never shown
+   gs->device_scale = (scale > 0.f) ? scale : 1.f;
 }
 
 float gfx_get_device_scale(GfxStateHandle* gs)
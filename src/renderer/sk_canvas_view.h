@@ -11,6 +11,7 @@ struct SkCanvasView {
    int width;
    int height;
    sk_sp<SkSurface> surface;
+   float scale = 1.f; // device scale the surface was allocated at
 };
 // Per-runtime graphics state handle (opaque to callers)
 struct GfxStateHandle;
@@ -23,7 +24,8 @@ void gfx_fill_circle(GfxStateHandle* gs, int id, int cx, int cy, int radius, uin
 sk_sp<SkImage> gfx_snapshot(GfxStateHandle* gs, int id);
 bool gfx_get_size(GfxStateHandle* gs, int id, int* outW, int* outH);
 
-// Device scale control (logical -> device pixels). Default is 1.0.
+// Device scale control (logical -> device pixels). Default is 1.0. A change is O(1): each canvas reallocates at
+// the new scale on its next draw or snapshot.
 void gfx_set_device_scale(GfxStateHandle* gs, float scale);
 float gfx_get_device_scale(GfxStateHandle* gs);
 
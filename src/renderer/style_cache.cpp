@@ -0,0 +1,54 @@
+#include "style_cache.h"
+#include <algorithm>
+
+std::shared_ptr<const css::ComputedStyle> StyleCache::resolve(const std::string& cssText)
+{
+   ++lookups_;
+   auto it = entries_.find(cssText);
+   if (it != entries_.end()) {
+      ++hits_;
+      return it->second;
+   }
+   if (entries_.size() >= purgeThreshold_)
+      purgeUnused();
+   auto cs = std::make_shared<css::ComputedStyle>();
+   css::compute_style(cssText, *cs);
+   cs->serial = css::next_style_serial();
+   std::shared_ptr<const css::ComputedStyle> shared = std::move(cs);
+   entries_.emplace(cssText, shared);
+   return shared;
+}
+
+void StyleCache::purgeUnused()
+{
+   for (auto it = entries_.begin(); it != entries_.end();) {
+      if (it->second.use_count() == 1)
+         it = entries_.erase(it);
+      else
+         ++it;
+   }
+   // Grow the threshold with the live set so purging stays amortised O(1) per insert.
+   purgeThreshold_ = std::max<size_t>(256, entries_.size() * 2);
+}
+
+StyleCacheStats StyleCache::stats() const
+{
+   StyleCacheStats s;
+   s.lookups = lookups_;
+   s.hits = hits_;
+   s.entries = entries_.size();
+   for (auto& kv : entries_) {
+      size_t refs = (size_t)kv.second.use_count() - 1; // minus the cache's own reference
+      s.sharedRefs += refs;
+      if (refs > 1)
+         s.bytesSaved += (refs - 1) * sizeof(css::ComputedStyle);
+   }
+   return s;
+}
+
+void StyleCache::clear()
+{
+   entries_.clear();
+   purgeThreshold_ = 256;
+   lookups_ = hits_ = 0;
+}
@@ -0,0 +1,37 @@
+// style_cache.h - per-document sharing of resolved inline styles (hash-consed by cssText)
+#pragma once
+#include "renderer/computed_style.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+struct StyleCacheStats {
+   size_t lookups = 0;
+   size_t hits = 0;
+   size_t entries = 0;     // distinct cssText strings currently cached
+   size_t sharedRefs = 0;  // element references to cached styles
+   size_t bytesSaved = 0;  // ComputedStyle copies avoided by sharing
+
+   double hitRate() const
+   {
+      return lookups ? (double)hits / (double)lookups : 0.0;
+   }
+};
+
+// Maps cssText to an immutable, refcounted ComputedStyle. A hit returns the shared object without
+// tokenising; entries no longer referenced by any element are dropped when the table grows.
+class StyleCache {
+ public:
+   std::shared_ptr<const css::ComputedStyle> resolve(const std::string& cssText);
+   StyleCacheStats stats() const;
+   void clear();
+
+ private:
+   void purgeUnused();
+
+   std::unordered_map<std::string, std::shared_ptr<const css::ComputedStyle>> entries_;
+   size_t purgeThreshold_ = 256;
+   size_t lookups_ = 0;
+   size_t hits_ = 0;
+};
@@ -0,0 +1,387 @@
+#include "style_sheet.h"
+#include "wapis/dom.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+
+namespace css {
+namespace {
+std::atomic<uint64_t> g_sheetVersion{0};
+
+// Visit the whitespace-separated tokens of a class list
+template <typename Fn> void for_each_token(std::string_view list, Fn&& fn)
+{
+   size_t i = 0, n = list.size();
+   while (i < n) {
+      while (i < n && std::isspace((unsigned char)list[i]))
+         ++i;
+      size_t start = i;
+      while (i < n && !std::isspace((unsigned char)list[i]))
+         ++i;
+      if (i > start)
+         fn(list.substr(start, i - start));
+   }
+}
+
+bool has_token(std::string_view list, std::string_view token)
+{
+   bool found = false;
+   for_each_token(list, [&](std::string_view t) { found = found || t == token; });
+   return found;
+}
+
+const std::string* attribute(const dom::Element* el, const std::string& name)
+{
+   return el->findAttribute(name); // not the raw slot: [style] must see CSSOM writes
+}
+
+// Selector tags are stored lowercase; DOM tag names usually are too, so the copy is rare
+std::string_view tag_key(const dom::Element* el, std::string& scratch)
+{
+   const std::string& tag = el->tagName;
+   if (std::none_of(tag.begin(), tag.end(), [](char c) { return c >= 'A' && c <= 'Z'; }))
+      return tag;
+   scratch = tag;
+   for (char& c : scratch)
+      c = (char)std::tolower((unsigned char)c);
+   return scratch;
+}
+
+const dom::Element* parent_element(const dom::Element* el)
+{
+   auto p = el->parentNode.lock();
+   return p && p->nodeType == dom::NodeType::ELEMENT ? static_cast<const dom::Element*>(p.get()) : nullptr;
+}
+
+bool compound_matches(const Compound& c, const dom::Element* el)
+{
+   if (!c.tag.empty()) {
+      std::string scratch;
+      if (tag_key(el, scratch) != c.tag)
+         return false;
+   }
+   if (!c.id.empty()) {
+      const std::string* id = attribute(el, "id");
+      if (!id || *id != c.id)
+         return false;
+   }
+   if (!c.classes.empty()) {
+      const std::string* list = attribute(el, "class");
+      if (!list)
+         return false;
+      for (const std::string& cls : c.classes) {
+         if (!has_token(*list, cls))
+            return false;
+      }
+   }
+   for (const AttrSelector& a : c.attrs) {
+      const std::string* v = attribute(el, a.name);
+      if (!v || (a.hasValue && *v != a.value))
+         return false;
+   }
+   return true;
+}
+
+// `el` matches compounds[i]; check the rest of the chain against its ancestors
+bool matches_from(const Selector& sel, size_t i, const dom::Element* el)
+{
+   if (i + 1 == sel.compounds.size())
+      return true;
+   const bool child = sel.compounds[i].combinator == Combinator::Child;
+   for (const dom::Element* a = parent_element(el); a; a = parent_element(a)) {
+      if (compound_matches(sel.compounds[i + 1], a) && matches_from(sel, i + 1, a))
+         return true;
+      if (child)
+         return false;
+   }
+   return false;
+}
+
+bool matches(const Selector& sel, const dom::Element* el)
+{
+   return !sel.compounds.empty() && compound_matches(sel.compounds.front(), el) && matches_from(sel, 0, el);
+}
+
+bool equals_lower(std::string_view a, std::string_view lowerB)
+{
+   return a.size() == lowerB.size() && std::equal(a.begin(), a.end(), lowerB.begin(), [](char x, char y) {
+             return std::tolower((unsigned char)x) == y;
+          });
+}
+
+// Keyframe selector list ("from", "to", "25%", "50%, 75%"); false when any entry is invalid, dropping the block
+bool parse_keyframe_offsets(std::string_view prelude, std::vector<float>& out)
+{
+   out.clear();
+   size_t start = 0;
+   while (start <= prelude.size()) {
+      size_t comma = std::min(prelude.find(',', start), prelude.size());
+      std::string_view s = prelude.substr(start, comma - start);
+      while (!s.empty() && std::isspace((unsigned char)s.front()))
+         s.remove_prefix(1);
+      while (!s.empty() && std::isspace((unsigned char)s.back()))
+         s.remove_suffix(1);
+      float pct;
+      std::string_view unit;
+      if (equals_lower(s, "from"))
+         out.push_back(0.f);
+      else if (equals_lower(s, "to"))
+         out.push_back(1.f);
+      else if (parse_number_unit(s, pct, unit) && unit == "%" && pct <= 100.f)
+         out.push_back(pct / 100.f);
+      else
+         return false;
+      start = comma + 1;
+   }
+   return !out.empty();
+}
+} // namespace
+
+std::shared_ptr<const KeyframesRule> parse_keyframes(std::string_view name, std::string_view block)
+{
+   // Declarations for one offset accumulate across blocks (later ones win), then parse once
+   std::vector<std::pair<float, std::string>> texts;
+   RuleScanner scanner(block);
+   RuleText rt;
+   std::vector<float> offsets;
+   while (scanner.next(rt)) {
+      if (rt.atRule || !parse_keyframe_offsets(rt.prelude, offsets))
+         continue;
+      for (float offset : offsets) {
+         auto it = std::find_if(texts.begin(), texts.end(), [offset](const auto& t) { return t.first == offset; });
+         if (it == texts.end())
+            it = texts.insert(texts.end(), {offset, std::string()});
+         it->second.append(rt.block.data(), rt.block.size());
+         it->second += ';';
+      }
+   }
+   auto rule = std::make_shared<KeyframesRule>();
+   rule->name.assign(name.data(), name.size());
+   std::sort(texts.begin(), texts.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+   rule->frames.resize(texts.size());
+   for (size_t i = 0; i < texts.size(); ++i) {
+      rule->frames[i].offset = texts[i].first;
+      compute_style(texts[i].second, rule->frames[i].style);
+   }
+   return rule;
+}
+
+StyleSheet::StyleSheet(std::string_view text)
+{
+   replace(text);
+}
+
+void StyleSheet::replace(std::string_view text)
+{
+   text_.assign(text.data(), text.size());
+   rules_.clear();
+   blocks_.clear();
+   keyframes_.clear();
+   version_ = ++g_sheetVersion;
+   RuleScanner scanner(text_);
+   RuleText rt;
+   std::vector<Selector> selectors;
+   while (scanner.next(rt)) {
+      if (rt.atRule) {
+         // "@keyframes name" (or the -webkit- alias); other at-rules (@media, @font-face, ...) are dropped
+         std::string_view p = rt.prelude;
+         size_t sp = p.find_first_of(" \t\n");
+         std::string_view keyword = p.substr(0, sp);
+         if (sp == std::string_view::npos || !(equals_lower(keyword, "@keyframes") ||
+                                               equals_lower(keyword, "@-webkit-keyframes")))
+            continue;
+         std::string_view name = p.substr(sp);
+         while (!name.empty() && std::isspace((unsigned char)name.front()))
+            name.remove_prefix(1);
+         if (name.size() >= 2 && (name.front() == '"' || name.front() == '\'') && name.back() == name.front())
+            name = name.substr(1, name.size() - 2);
+         if (!name.empty())
+            keyframes_.push_back(parse_keyframes(name, rt.block));
+         continue;
+      }
+      selectors.clear();
+      if (rt.block.empty() || !parse_selector_list(rt.prelude, selectors))
+         continue;
+      uint32_t block = (uint32_t)blocks_.size();
+      blocks_.emplace_back(rt.block);
+      for (Selector& sel : selectors)
+         rules_.push_back({std::move(sel), block});
+   }
+}
+
+void RuleSet::build(const std::vector<const StyleSheet*>& sheets)
+{
+   *this = RuleSet{};
+   for (const StyleSheet* sheet : sheets) {
+      if (!sheet)
+         continue;
+      uint32_t blockBase = (uint32_t)blocks_.size();
+      blocks_.insert(blocks_.end(), sheet->blocks_.begin(), sheet->blocks_.end());
+      for (const StyleSheet::Rule& r : sheet->rules_) {
+         uint32_t idx = (uint32_t)rules_.size();
+         rules_.push_back({r.selector, blockBase + r.block});
+         // One bucket per rule: an element can only match if it carries the subject's id, its first class or its tag
+         const Compound& subject = r.selector.compounds.front();
+         if (!subject.id.empty())
+            byId_[subject.id].push_back(idx);
+         else if (!subject.classes.empty())
+            byClass_[subject.classes.front()].push_back(idx);
+         else if (!subject.tag.empty())
+            byTag_[subject.tag].push_back(idx);
+         else
+            universal_.push_back(idx);
+         addInvalidation(r.selector);
+      }
+      for (const auto& kf : sheet->keyframes_)
+         keyframes_[kf->name] = kf;
+   }
+}
+
+void RuleSet::addInvalidation(const Selector& sel)
+{
+   const Compound& subject = sel.compounds.front();
+   if (!subject.id.empty())
+      idInvalidation_[subject.id].self = true;
+   for (const std::string& cls : subject.classes)
+      classInvalidation_[cls].self = true;
+   for (const AttrSelector& a : subject.attrs)
+      attrInvalidation_[a.name].self = true;
+   if (sel.compounds.size() == 1)
+      return;
+   hasAncestorRules_ = true;
+   // A feature tested on an ancestor restyles the descendants this rule can select, named by the same key the
+   // rule is bucketed under
+   auto add = [&subject](InvalidationSet& set) {
+      if (!subject.id.empty())
+         set.ids.insert(subject.id);
+      else if (!subject.classes.empty())
+         set.classes.insert(subject.classes.front());
+      else if (!subject.tag.empty())
+         set.tags.insert(subject.tag);
+      else
+         set.wholeSubtree = true;
+   };
+   for (size_t i = 1; i < sel.compounds.size(); ++i) {
+      const Compound& c = sel.compounds[i];
+      if (!c.id.empty())
+         add(idInvalidation_[c.id]);
+      for (const std::string& cls : c.classes)
+         add(classInvalidation_[cls]);
+      for (const AttrSelector& a : c.attrs)
+         add(attrInvalidation_[a.name]);
+   }
+}
+
+std::shared_ptr<const KeyframesRule> RuleSet::keyframes(std::string_view name) const
+{
+   auto it = keyframes_.find(name);
+   return it == keyframes_.end() ? nullptr : it->second;
+}
+
+size_t RuleSet::cascade(const dom::Element* el, std::string& out) const
+{
+   if (rules_.empty())
+      return 0;
+   thread_local std::vector<uint32_t> candidates;
+   thread_local std::string scratch;
+   candidates.clear();
+   auto add_bucket = [](const StringMap<std::vector<uint32_t>>& map, std::string_view key) {
+      auto it = map.find(key);
+      if (it != map.end())
+         candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+   };
+   if (const std::string* id = attribute(el, "id"); id && !id->empty())
+      add_bucket(byId_, *id);
+   if (const std::string* list = attribute(el, "class"))
+      for_each_token(*list, [&](std::string_view cls) { add_bucket(byClass_, cls); });
+   add_bucket(byTag_, tag_key(el, scratch));
+   candidates.insert(candidates.end(), universal_.begin(), universal_.end());
+   size_t kept = 0;
+   for (uint32_t idx : candidates) {
+      if (matches(rules_[idx].selector, el))
+         candidates[kept++] = idx;
+   }
+   candidates.resize(kept);
+   std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+      uint32_t sa = rules_[a].selector.specificity, sb = rules_[b].selector.specificity;
+      return sa != sb ? sa < sb : a < b;
+   });
+   // A class listed twice reaches its bucket twice
+   candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+   for (uint32_t idx : candidates) {
+      out += blocks_[rules_[idx].block];
+      out += ';';
+   }
+   return candidates.size();
+}
+
+size_t RuleSet::invalidate(dom::Element* el, std::string_view name, std::string_view oldValue,
+                           std::string_view newValue, const std::function<void(dom::Element*)>& restyle) const
+{
+   if (rules_.empty())
+      return 0;
+   bool self = false;
+   std::vector<const InvalidationSet*> descendants;
+   auto lookup = [&](const StringMap<InvalidationSet>& map, std::string_view key) {
+      auto it = map.find(key);
+      if (it == map.end())
+         return;
+      const InvalidationSet& set = it->second;
+      self = self || set.self;
+      if (set.wholeSubtree || !set.ids.empty() || !set.classes.empty() || !set.tags.empty())
+         descendants.push_back(&set);
+   };
+   if (name == "class") {
+      // Only tokens added or removed can change a match
+      for_each_token(oldValue, [&](std::string_view cls) {
+         if (!has_token(newValue, cls))
+            lookup(classInvalidation_, cls);
+      });
+      for_each_token(newValue, [&](std::string_view cls) {
+         if (!has_token(oldValue, cls))
+            lookup(classInvalidation_, cls);
+      });
+   }
+   else if (name == "id" && oldValue != newValue) {
+      if (!oldValue.empty())
+         lookup(idInvalidation_, oldValue);
+      if (!newValue.empty())
+         lookup(idInvalidation_, newValue);
+   }
+   lookup(attrInvalidation_, name); // [class], [id] and other attribute selectors
+   size_t count = 0;
+   if (self) {
+      restyle(el);
+      ++count;
+   }
+   if (descendants.empty())
+      return count;
+   std::string scratch;
+   std::function<void(dom::Element*)> walk = [&](dom::Element* parent) {
+      for (auto& c : parent->childNodes) {
+         if (!c || c->nodeType != dom::NodeType::ELEMENT)
+            continue;
+         auto* ce = static_cast<dom::Element*>(c.get());
+         const std::string* id = attribute(ce, "id");
+         const std::string* list = attribute(ce, "class");
+         std::string_view tag = tag_key(ce, scratch);
+         bool hit = false;
+         for (const InvalidationSet* set : descendants) {
+            hit = set->wholeSubtree || (id && set->ids.count(*id)) || set->tags.count(tag);
+            if (!hit && list && !set->classes.empty())
+               for_each_token(*list, [&](std::string_view cls) { hit = hit || set->classes.count(cls); });
+            if (hit)
+               break;
+         }
+         if (hit) {
+            restyle(ce);
+            ++count;
+         }
+         walk(ce);
+      }
+   };
+   walk(el);
+   return count;
+}
+
+} // namespace css
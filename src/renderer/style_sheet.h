@@ -0,0 +1,151 @@
+// style_sheet.h - author style sheets (<style> elements, document.adoptedStyleSheets) and the per-document rule set
+// they compile into: rules bucketed by the rightmost compound's id, class or tag, plus invalidation sets that map a
+// class/id/attribute change to the elements it can restyle. @keyframes rules are collected by name.
+#pragma once
+#include "renderer/computed_style.h"
+#include "renderer/css_parser.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace dom {
+class Element;
+}
+
+namespace css {
+
+// One keyframe: its declarations parsed as a style, so has() tells which properties it sets
+struct Keyframe {
+   float offset = 0.f; // 0..1
+   ComputedStyle style;
+};
+
+// @keyframes (or the keyframes passed to element.animate()); frames sorted by offset, one per distinct offset.
+// Immutable once built and shared by the sheet, the rule sets compiled from it and the animations playing it.
+struct KeyframesRule {
+   std::string name;
+   std::vector<Keyframe> frames;
+};
+
+// Keyframe blocks of an @keyframes rule ("from { ... } 50% { ... } to { ... }"); frames at the same offset merge
+std::shared_ptr<const KeyframesRule> parse_keyframes(std::string_view name, std::string_view block);
+
+// Parsed once per text; replace() reparses (CSSStyleSheet.replaceSync, or a <style> element's text changing)
+class StyleSheet {
+ public:
+   StyleSheet() = default;
+   explicit StyleSheet(std::string_view text);
+
+   void replace(std::string_view text);
+
+   const std::string& text() const
+   {
+      return text_;
+   }
+
+   // Process-unique; changes on every replace(), so (sheet, version) identifies the exact rules
+   uint64_t version() const
+   {
+      return version_;
+   }
+
+   size_t ruleCount() const
+   {
+      return rules_.size();
+   }
+
+ private:
+   friend class RuleSet;
+
+   struct Rule {
+      Selector selector;
+      uint32_t block; // index into blocks_
+   };
+
+   std::string text_;
+   std::vector<Rule> rules_; // one per selector of each rule's list, in source order
+   std::vector<std::string> blocks_;
+   std::vector<std::shared_ptr<const KeyframesRule>> keyframes_; // source order
+   uint64_t version_ = 0;
+};
+
+// Transparent hashing so string_view class tokens look up without allocating
+struct StringHash {
+   using is_transparent = void;
+
+   size_t operator()(std::string_view s) const
+   {
+      return std::hash<std::string_view>()(s);
+   }
+};
+
+template <typename T> using StringMap = std::unordered_map<std::string, T, StringHash, std::equal_to<>>;
+using StringSet = std::unordered_set<std::string, StringHash, std::equal_to<>>;
+
+// Everything the sheets of one document say, indexed for matching. Rules are copied in, so sheets may be replaced
+// or dropped while a rule set built from them is in use.
+class RuleSet {
+ public:
+   // Sheets in cascade order (<style> elements in tree order, then adopted sheets)
+   void build(const std::vector<const StyleSheet*>& sheets);
+
+   bool empty() const
+   {
+      return rules_.empty();
+   }
+
+   size_t size() const
+   {
+      return rules_.size();
+   }
+
+   // Append the declaration blocks of every rule matching `el` in cascade order (specificity, then source order),
+   // each terminated by ';'. Declarations later in `out` win, so the inline style goes after. Returns the number of
+   // rules matched.
+   size_t cascade(const dom::Element* el, std::string& out) const;
+
+   // Attribute `name` of `el` changed from oldValue to newValue: call `restyle` for `el` when a rule tests the
+   // changed class/id/attribute on its subject, and for each descendant whose id, classes or tag select a rule
+   // that tests it on an ancestor. Returns the number of elements passed to `restyle`.
+   size_t invalidate(dom::Element* el, std::string_view name, std::string_view oldValue, std::string_view newValue,
+                     const std::function<void(dom::Element*)>& restyle) const;
+
+   // Some rule relates its subject to an ancestor, so moving an element can change what matches it and its subtree
+   bool hasAncestorRules() const
+   {
+      return hasAncestorRules_;
+   }
+
+   // @keyframes by name (case-sensitive); the last one in cascade order wins. nullptr when none is defined.
+   std::shared_ptr<const KeyframesRule> keyframes(std::string_view name) const;
+
+ private:
+   struct IndexedRule {
+      Selector selector;
+      uint32_t block; // index into blocks_
+   };
+
+   // Elements a change of one feature can restyle
+   struct InvalidationSet {
+      bool self = false;            // the feature appears in some subject compound
+      bool wholeSubtree = false;    // a dependent subject has no id, class or tag: every descendant
+      StringSet ids, classes, tags; // descendants whose subject key is listed
+   };
+
+   void addInvalidation(const Selector& sel);
+
+   std::vector<IndexedRule> rules_; // source order across all sheets
+   std::vector<std::string> blocks_;
+   StringMap<std::vector<uint32_t>> byId_, byClass_, byTag_; // rule indices by the subject's most specific key
+   std::vector<uint32_t> universal_;
+   StringMap<InvalidationSet> idInvalidation_, classInvalidation_, attrInvalidation_;
+   StringMap<std::shared_ptr<const KeyframesRule>> keyframes_;
+   bool hasAncestorRules_ = false;
+};
+
+} // namespace css
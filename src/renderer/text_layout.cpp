@@ -0,0 +1,366 @@
+#include "text_layout.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <include/core/SkFont.h>
+#include <include/core/SkFontMetrics.h>
+#include <include/core/SkFontMgr.h>
+#include <include/core/SkFontStyle.h>
+#include <include/core/SkTextBlob.h>
+#include <include/core/SkTypeface.h>
+#include <unordered_map>
+#if defined(__APPLE__)
+#include <include/ports/SkFontMgr_mac_ct.h>
+#else
+#include <include/ports/SkFontMgr_fontconfig.h>
+#endif
+
+namespace text {
+
+class FontFace {
+ public:
+   FontDesc desc;
+   SkFont font;
+   bool hasTypeface = false;
+   float ascent = 0;  // negative, as in SkFontMetrics
+   float descent = 0; // positive
+   float leading = 0;
+   float ascii[128];                           // advance per ASCII code point, filled when the face is created
+   std::unordered_map<SkUnichar, float> other; // everything else, filled on first use under otherMutex
+   std::shared_mutex otherMutex;
+
+   float advance(SkUnichar c);
+   float lookupAdvance(SkUnichar c) const;
+};
+
+namespace {
+// Layout measures text on worker threads. Faces are read-only once created (except `other`, which has its own
+// reader/writer lock) and each thread keeps its own layout cache, so cache hits take no lock at all.
+struct Counters {
+   std::atomic<size_t> layoutLookups{0}, layoutHits{0}, layoutEntries{0}, advanceMisses{0}, faces{0}, blobsBuilt{0};
+};
+Counters g_stats;
+std::mutex g_facesMutex; // creating faces
+
+sk_sp<SkFontMgr> font_manager()
+{
+#if defined(__APPLE__)
+   static sk_sp<SkFontMgr> mgr = SkFontMgr_New_CoreText(nullptr);
+#else
+   static sk_sp<SkFontMgr> mgr = SkFontMgr_New_FontConfig(nullptr);
+#endif
+   return mgr;
+}
+
+// Faces are never freed, so FontFace* is a stable identity for cache keys.
+std::deque<FontFace>& faces()
+{
+   static std::deque<FontFace> list;
+   return list;
+}
+
+inline size_t hash_mix(size_t h, size_t v)
+{
+   return h ^ (v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2));
+}
+
+struct LayoutKey {
+   std::string text;
+   const FontFace* face;
+   float lineHeight;
+   float maxWidth;
+
+   bool operator==(const LayoutKey& o) const
+   {
+      return face == o.face && lineHeight == o.lineHeight && maxWidth == o.maxWidth && text == o.text;
+   }
+};
+
+struct LayoutKeyHash {
+   size_t operator()(const LayoutKey& k) const
+   {
+      size_t h = std::hash<std::string>()(k.text);
+      h = hash_mix(h, std::hash<const void*>()(k.face));
+      h = hash_mix(h, std::hash<float>()(k.lineHeight));
+      return hash_mix(h, std::hash<float>()(k.maxWidth));
+   }
+};
+
+// Per thread; dropped wholesale when full, entries are cheap to rebuild from the advance caches.
+constexpr size_t kMaxLayoutEntries = 16384;
+struct LayoutCache {
+   std::unordered_map<LayoutKey, TextLayout, LayoutKeyHash> map;
+
+   void clear()
+   {
+      g_stats.layoutEntries -= map.size();
+      map.clear();
+   }
+   ~LayoutCache()
+   {
+      clear();
+   }
+};
+thread_local LayoutCache t_layouts;
+
+// Decode one UTF-8 sequence starting at s[i]; advances i. Invalid bytes decode as U+FFFD.
+SkUnichar next_utf8(const std::string& s, size_t& i)
+{
+   unsigned char c = (unsigned char)s[i++];
+   if (c < 0x80)
+      return c;
+   int extra = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : (c >= 0xC0) ? 1 : -1;
+   if (extra < 0)
+      return 0xFFFD;
+   SkUnichar u = c & (0x3F >> extra);
+   for (int k = 0; k < extra; ++k) {
+      if (i >= s.size() || ((unsigned char)s[i] & 0xC0) != 0x80)
+         return 0xFFFD;
+      u = (u << 6) | ((unsigned char)s[i++] & 0x3F);
+   }
+   return u;
+}
+
+float measure_range(FontFace* face, const std::string& s, size_t begin, size_t end)
+{
+   float w = 0;
+   size_t i = begin;
+   while (i < end)
+      w += face->advance(next_utf8(s, i));
+   return w;
+}
+
+void break_lines(const std::string& s, FontFace* face, float maxWidth, TextLayout& out)
+{
+   const float spaceW = face->advance(' ');
+   size_t lineBegin = 0, lineEnd = 0;
+   float lineW = 0;
+   bool lineOpen = false;
+   size_t i = 0;
+   while (i < s.size()) {
+      size_t wordBegin = i;
+      size_t wordEnd = s.find(' ', i);
+      if (wordEnd == std::string::npos)
+         wordEnd = s.size();
+      float wordW = measure_range(face, s, wordBegin, wordEnd);
+      if (!lineOpen) {
+         lineBegin = wordBegin;
+         lineW = wordW;
+         lineOpen = true;
+      }
+      else if (maxWidth >= 0 && lineW + spaceW + wordW > maxWidth) {
+         out.lines.push_back({(uint32_t)lineBegin, (uint32_t)lineEnd, lineW});
+         lineBegin = wordBegin;
+         lineW = wordW; // an overlong word stays on its own line (no overflow-wrap)
+      }
+      else {
+         lineW += spaceW + wordW;
+      }
+      lineEnd = wordEnd;
+      i = wordEnd + 1;
+   }
+   if (lineOpen)
+      out.lines.push_back({(uint32_t)lineBegin, (uint32_t)lineEnd, lineW});
+   for (const auto& l : out.lines)
+      out.width = std::max(out.width, l.width);
+   out.height = out.lineHeight * (float)out.lines.size();
+}
+
+const TextLayout& cached_layout(const std::string& str, FontFace* face, float lineHeight, float maxWidth)
+{
+   g_stats.layoutLookups.fetch_add(1, std::memory_order_relaxed);
+   LayoutKey key{str, face, lineHeight, maxWidth};
+   auto it = t_layouts.map.find(key);
+   if (it != t_layouts.map.end()) {
+      g_stats.layoutHits.fetch_add(1, std::memory_order_relaxed);
+      return it->second;
+   }
+   if (t_layouts.map.size() >= kMaxLayoutEntries)
+      t_layouts.clear();
+   TextLayout tl;
+   tl.lineHeight = lineHeight;
+   break_lines(str, face, maxWidth, tl);
+   ++g_stats.layoutEntries;
+   return t_layouts.map.emplace(std::move(key), std::move(tl)).first->second;
+}
+// Wrapping only matters when the text does not fit on one line, so all widths >= the natural width share the
+// unwrapped entry.
+const TextLayout& layout_cached(const std::string& str, FontFace* face, float lineHeight, float maxWidth)
+{
+   const TextLayout& natural = cached_layout(str, face, lineHeight, -1.f);
+   if (maxWidth < 0 || natural.width <= maxWidth)
+      return natural;
+   return cached_layout(str, face, lineHeight, maxWidth);
+}
+} // namespace
+
+float FontFace::lookupAdvance(SkUnichar c) const
+{
+   g_stats.advanceMisses.fetch_add(1, std::memory_order_relaxed);
+   float w;
+   if (hasTypeface) {
+      SkGlyphID g = font.unicharToGlyph(c);
+      font.getWidths(&g, 1, &w);
+   }
+   else {
+      w = desc.size * (c == ' ' ? 0.28f : 0.55f); // no font backend: rough monospace-ish estimate
+   }
+   return w;
+}
+
+float FontFace::advance(SkUnichar c)
+{
+   if (c >= 0 && c < 128)
+      return ascii[c];
+   {
+      std::shared_lock<std::shared_mutex> read(otherMutex);
+      auto it = other.find(c);
+      if (it != other.end())
+         return it->second;
+   }
+   float w = lookupAdvance(c);
+   std::unique_lock<std::shared_mutex> write(otherMutex);
+   return other.emplace(c, w).first->second; // another thread may have added it meanwhile; same value
+}
+
+FontFace* font_face(const FontDesc& desc)
+{
+   // Faces this thread has resolved before, checked without the lock. Few distinct fonts per app; a linear scan
+   // beats hashing the family string.
+   thread_local std::vector<FontFace*> seen;
+   for (FontFace* f : seen) {
+      if (f->desc == desc)
+         return f;
+   }
+   std::lock_guard<std::mutex> lock(g_facesMutex);
+   for (auto& f : faces()) {
+      if (f.desc == desc) {
+         seen.push_back(&f);
+         return &f;
+      }
+   }
+   FontFace& f = faces().emplace_back();
+   f.desc = desc;
+   SkFontStyle style(desc.weight, SkFontStyle::kNormal_Width,
+                     desc.italic ? SkFontStyle::kItalic_Slant : SkFontStyle::kUpright_Slant);
+   sk_sp<SkTypeface> tf;
+   if (auto mgr = font_manager()) {
+      tf = mgr->matchFamilyStyle(desc.family.empty() ? nullptr : desc.family.c_str(), style);
+      if (!tf)
+         tf = mgr->legacyMakeTypeface(nullptr, style);
+   }
+   f.hasTypeface = tf.get() != nullptr;
+   f.font = SkFont(std::move(tf), desc.size);
+   f.font.setSubpixel(true);
+   f.font.setLinearMetrics(true); // advances independent of hinting, so measure == draw
+   if (f.hasTypeface) {
+      SkFontMetrics m;
+      f.font.getMetrics(&m);
+      f.ascent = m.fAscent;
+      f.descent = m.fDescent;
+      f.leading = m.fLeading;
+   }
+   else {
+      f.ascent = -0.8f * desc.size;
+      f.descent = 0.2f * desc.size;
+   }
+   // ASCII advances up front, so the common case is a plain array read on any thread
+   for (SkUnichar c = 0; c < 128; ++c)
+      f.ascii[c] = f.lookupAdvance(c);
+   g_stats.faces = faces().size();
+   seen.push_back(&f);
+   return &f;
+}
+
+const FontDesc& font_desc(const FontFace* face)
+{
+   return face->desc;
+}
+
+float normal_line_height(const FontFace* face)
+{
+   return std::ceil(face->descent - face->ascent + face->leading);
+}
+
+float baseline_offset(const FontFace* face, float lineHeight)
+{
+   float content = face->descent - face->ascent;
+   return (lineHeight - content) * 0.5f - face->ascent; // half-leading above, as CSS does
+}
+
+const TextLayout& layout_text(const std::string& str, FontFace* face, float lineHeight, float maxWidth)
+{
+   return layout_cached(str, face, lineHeight, maxWidth);
+}
+
+void measure_text(const std::string& str, FontFace* face, float lineHeight, float maxWidth, float& width,
+                  float& height)
+{
+   const TextLayout& tl = layout_cached(str, face, lineHeight, maxWidth);
+   width = tl.width;
+   height = tl.height;
+}
+
+sk_sp<SkTextBlob> make_text_blob(const std::string& str, FontFace* face, const TextLayout& layout)
+{
+   if (!face->hasTypeface || layout.lines.empty())
+      return nullptr;
+   SkTextBlobBuilder builder;
+   const float baseline = baseline_offset(face, layout.lineHeight);
+   std::vector<SkUnichar> chars;
+   for (size_t li = 0; li < layout.lines.size(); ++li) {
+      const LineBox& line = layout.lines[li];
+      chars.clear();
+      size_t i = line.begin;
+      while (i < line.end)
+         chars.push_back(next_utf8(str, i));
+      if (chars.empty())
+         continue;
+      const auto& run =
+          builder.allocRunPosH(face->font, (int)chars.size(), baseline + (float)li * layout.lineHeight);
+      face->font.unicharsToGlyphs(chars.data(), (int)chars.size(), run.glyphs);
+      // Positions from the same advance cache layout measured with, so drawn lines match their boxes
+      float x = 0;
+      for (size_t k = 0; k < chars.size(); ++k) {
+         run.pos[k] = x;
+         x += face->advance(chars[k]);
+      }
+   }
+   g_stats.blobsBuilt.fetch_add(1, std::memory_order_relaxed);
+   return builder.make();
+}
+
+std::string collapse_whitespace(const std::string& s)
+{
+   std::string out;
+   out.reserve(s.size());
+   bool pendingSpace = false;
+   for (char c : s) {
+      if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f') {
+         pendingSpace = !out.empty();
+         continue;
+      }
+      if (pendingSpace)
+         out.push_back(' ');
+      pendingSpace = false;
+      out.push_back(c);
+   }
+   return out;
+}
+
+TextCacheStats text_cache_stats()
+{
+   TextCacheStats s;
+   s.layoutLookups = g_stats.layoutLookups;
+   s.layoutHits = g_stats.layoutHits;
+   s.layoutEntries = g_stats.layoutEntries;
+   s.advanceMisses = g_stats.advanceMisses;
+   s.faces = g_stats.faces;
+   s.blobsBuilt = g_stats.blobsBuilt;
+   return s;
+}
+
+} // namespace text
@@ -0,0 +1,75 @@
+// text_layout.h - font lookup, cached glyph advances and greedy line breaking for layout (Skia-backed)
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <include/core/SkRefCnt.h>
+#include <string>
+#include <vector>
+
+class SkTextBlob;
+
+namespace text {
+
+struct FontDesc {
+   std::string family; // empty = platform default
+   float size = 16.f;
+   uint16_t weight = 400;
+   bool italic = false;
+
+   bool operator==(const FontDesc& o) const
+   {
+      return size == o.size && weight == o.weight && italic == o.italic && family == o.family;
+   }
+};
+
+// Interned font (typeface + size) with its glyph-advance cache. Opaque outside text_layout.cpp; lives for the
+// whole process, so pointers can be stored and compared.
+class FontFace;
+
+FontFace* font_face(const FontDesc& desc);
+const FontDesc& font_desc(const FontFace* face);
+// Line height for `line-height: normal` (ascent + descent + leading)
+float normal_line_height(const FontFace* face);
+// Distance from a line's top to its baseline
+float baseline_offset(const FontFace* face, float lineHeight);
+
+struct LineBox {
+   uint32_t begin = 0; // byte range into the measured string
+   uint32_t end = 0;
+   float width = 0;
+};
+
+struct TextLayout {
+   float width = 0; // widest line
+   float height = 0;
+   float lineHeight = 0;
+   std::vector<LineBox> lines;
+};
+
+// Lay out already whitespace-collapsed `str` with greedy breaking at spaces; maxWidth < 0 means no wrapping.
+// Results are cached per thread and (string, font, line height, width); the reference stays valid until the cache
+// is trimmed by a later call on the same thread.
+const TextLayout& layout_text(const std::string& str, FontFace* face, float lineHeight, float maxWidth);
+// Size of the same layout; safe to call from layout worker threads (cache hits take no lock).
+void measure_text(const std::string& str, FontFace* face, float lineHeight, float maxWidth, float& width,
+                  float& height);
+
+// Glyph runs for `layout` (from layout_text on the same string and face), one run per line with the first line's
+// top at y = 0. Uses the face's shared SkFont; returns nullptr when there is no typeface or nothing to draw.
+sk_sp<SkTextBlob> make_text_blob(const std::string& str, FontFace* face, const TextLayout& layout);
+
+// Collapse runs of ASCII whitespace to one space and trim both ends (CSS `white-space: normal`).
+std::string collapse_whitespace(const std::string& s);
+
+struct TextCacheStats {
+   size_t layoutLookups = 0;
+   size_t layoutHits = 0;
+   size_t layoutEntries = 0;
+   size_t advanceMisses = 0; // glyph lookups that went to the font
+   size_t faces = 0;
+   size_t blobsBuilt = 0;
+};
+
+TextCacheStats text_cache_stats();
+
+} // namespace text
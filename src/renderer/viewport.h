@@ -4,3 +4,8 @@ constexpr int VIEWPORT_DEFAULT_WIDTH = 800;
 constexpr int VIEWPORT_DEFAULT_HEIGHT = 600;
 extern int g_winW;
 extern int g_winH;
+
+// Resize the window viewport to w x h CSS px at `scale` device px per CSS px (main.mm). Reallocates the window
+// backbuffer once, marks layout dirty (only the root's size constraint changes; Yoga's cache skips subtrees that do
+// not depend on it) and leaves canvas surfaces to rescale on their next use. No-op when nothing changed.
+void viewport_resize(int w, int h, float scale);
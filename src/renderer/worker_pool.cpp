@@ -0,0 +1,127 @@
+#include "worker_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+struct Batch {
+   const std::function<void(size_t)>* fn = nullptr;
+   size_t count = 0;
+   std::atomic<size_t> next{0};
+
+   void work()
+   {
+      for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+         (*fn)(i);
+   }
+};
+
+class WorkerPool {
+ public:
+   explicit WorkerPool(size_t threads)
+   {
+      for (size_t i = 0; i < threads; ++i)
+         threads_.emplace_back([this] { loop(); });
+   }
+
+   ~WorkerPool()
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         stop_ = true;
+      }
+      wake_.notify_all();
+      for (auto& t : threads_)
+         t.join();
+   }
+
+   size_t size() const
+   {
+      return threads_.size();
+   }
+
+   void run(size_t count, const std::function<void(size_t)>& fn)
+   {
+      std::lock_guard<std::mutex> serial(runMutex_); // one batch at a time
+      Batch batch;
+      batch.fn = &fn;
+      batch.count = count;
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         batch_ = &batch;
+         generation_++;
+      }
+      wake_.notify_all();
+      batch.work(); // the caller takes indices too
+      // Indices are exhausted once the caller's loop ends; wait for workers still inside fn, then retire the
+      // batch so late wakers find nothing to do.
+      std::unique_lock<std::mutex> lock(mutex_);
+      idle_.wait(lock, [this] { return busy_ == 0; });
+      batch_ = nullptr;
+   }
+
+ private:
+   void loop()
+   {
+      uint64_t seen = 0;
+      std::unique_lock<std::mutex> lock(mutex_);
+      for (;;) {
+         wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+         if (stop_)
+            return;
+         seen = generation_;
+         Batch* b = batch_;
+         if (!b)
+            continue;
+         busy_++;
+         lock.unlock();
+         b->work();
+         lock.lock();
+         if (--busy_ == 0)
+            idle_.notify_all();
+      }
+   }
+
+   std::vector<std::thread> threads_;
+   std::mutex runMutex_;
+   std::mutex mutex_;
+   std::condition_variable wake_;
+   std::condition_variable idle_;
+   Batch* batch_ = nullptr;
+   uint64_t generation_ = 0;
+   size_t busy_ = 0;
+   bool stop_ = false;
+};
+
+WorkerPool& pool()
+{
+   static WorkerPool instance([] {
+      if (const char* env = std::getenv("UI_WORKER_THREADS"))
+         return (size_t)std::max(0, std::atoi(env));
+      unsigned hw = std::thread::hardware_concurrency();
+      return hw > 1 ? (size_t)hw - 1 : (size_t)0;
+   }());
+   return instance;
+}
+} // namespace
+
+void worker_parallel_for(size_t count, const std::function<void(size_t)>& fn)
+{
+   if (count == 0)
+      return;
+   if (count == 1 || pool().size() == 0) {
+      for (size_t i = 0; i < count; ++i)
+         fn(i);
+      return;
+   }
+   pool().run(count, fn);
+}
+
+size_t worker_count()
+{
+   return pool().size();
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+// Process-wide pool of worker threads for data-parallel renderer work (independent layout subtrees).
+// Threads start on first use; UI_WORKER_THREADS overrides the count (default: hardware threads - 1, 0 = inline).
+
+// Run fn(i) for every i in [0, count) on the workers and the calling thread; returns once all calls finished.
+// fn must be safe to run concurrently for different indices. Small batches run inline.
+void worker_parallel_for(size_t count, const std::function<void(size_t)>& fn);
+// Number of worker threads, not counting the caller
+size_t worker_count();
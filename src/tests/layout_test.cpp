@@ -0,0 +1,241 @@
+// layout_test.cpp - headless layout checks. Build and run with scripts/bench.sh test; exits 1 when a check fails.
+//   contained: a px-sized panel laid out as its own Yoga tree matches the same panel laid out in the main tree,
+//              with percentage padding, flex-grow and a viewport resize
+//   memo:      a memo row restyled hundreds of times, so freed styles' addresses are reused, never hits a stale entry
+//   replace:   replaceChild frees the old subtree's render data, so the store's slots and pooled Yoga nodes are reused
+//   containing block: an absolute box's insets measure from its positioned ancestor's padding box, a flowing box
+//              sits in its parent's content box (what a native drag clamps to and commits against)
+#include "renderer/element_data.h"
+#include "renderer/layout_yoga.h"
+#include "wapis/dom.hpp"
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+// The checks drive layout_run directly; these satisfy layout_maybe_run's app glue, which they never call.
+extern "C" void* dom_get_cpp_node_opaque(JSContext*, JSValueConst)
+{
+   return nullptr;
+}
+float dom_get_display_scale(JSContext*)
+{
+   return 1.f;
+}
+void native_request_composite(JSContext*)
+{
+}
+void native_request_animation_frame(JSContext*)
+{
+}
+int g_winW = 800;
+int g_winH = 600;
+
+namespace {
+int g_failures = 0;
+
+void expect(bool ok, const char* test, const char* what)
+{
+   if (!ok) {
+      std::fprintf(stderr, "FAIL %s: %s\n", test, what);
+      ++g_failures;
+   }
+}
+
+LayoutBox box_of(dom::Element* el)
+{
+   DomElementRenderData* rd = get_render_data(el);
+   return rd && rd->hasLayoutBox ? rd->box() : LayoutBox{-1, -1, -1, -1};
+}
+
+void expect_box(const char* test, dom::Element* el, LayoutBox want)
+{
+   LayoutBox b = box_of(el);
+   char what[160];
+   std::snprintf(what, sizeof(what), "box (%g, %g %gx%g), want (%g, %g %gx%g)", b.x, b.y, b.w, b.h, want.x, want.y,
+                 want.w, want.h);
+   expect(std::fabs(b.x - want.x) < 0.01f && std::fabs(b.y - want.y) < 0.01f && std::fabs(b.w - want.w) < 0.01f &&
+              std::fabs(b.h - want.h) < 0.01f,
+          test, what);
+}
+
+struct Doc {
+   std::shared_ptr<dom::Document> doc;
+   std::shared_ptr<dom::Element> body;
+   std::shared_ptr<dom::Element> root;
+
+   explicit Doc(const std::string& rootStyle)
+   {
+      doc = std::make_shared<dom::Document>();
+      body = doc->createElement("body");
+      doc->appendChild(body);
+      root = add(body.get(), rootStyle);
+   }
+
+   std::shared_ptr<dom::Element> add(dom::Element* parent, const std::string& style)
+   {
+      auto el = doc->createElement("div");
+      el->setAttribute("style", style);
+      parent->appendChild(el);
+      return el;
+   }
+};
+
+// One panel with a child, in a row that fills the viewport. `panelStyle` decides whether the panel is a containment
+// boundary (px width and height) or part of the main tree.
+struct PanelDoc : Doc {
+   std::shared_ptr<dom::Element> panel, child;
+
+   PanelDoc(const std::string& panelStyle, const std::string& childStyle)
+       : Doc("display:flex; flex-direction:row; align-items:flex-start;")
+   {
+      panel = add(root.get(), panelStyle);
+      child = add(panel.get(), childStyle);
+   }
+};
+
+void test_contained()
+{
+   const char* t = "contained";
+   // Percentage padding resolves against the containing block (the row, 400 px), not the panel itself
+   PanelDoc boxed("width:200px; height:100px; padding:10%;", "width:100%; height:20px;");
+   layout_run(boxed.body.get(), 400, 300, 1.f);
+   expect_box(t, boxed.panel.get(), {0, 0, 200, 100});
+   expect_box(t, boxed.child.get(), {40, 40, 120, 20});
+   LayoutBox contained = box_of(boxed.child.get());
+   release_all_render_data();
+
+   PanelDoc flowing("width:50%; height:100px; padding:10%;", "width:100%; height:20px;");
+   layout_run(flowing.body.get(), 400, 300, 1.f);
+   LayoutBox full = box_of(flowing.child.get());
+   expect(contained.x == full.x && contained.y == full.y && contained.w == full.w && contained.h == full.h, t,
+          "contained child differs from the same child laid out in the main tree");
+   release_all_render_data();
+
+   // A wider viewport changes only the containing block: the panel's own tree is clean but must be recomputed
+   PanelDoc resized("width:200px; height:100px; padding:10%;", "width:100%; height:20px;");
+   layout_run(resized.body.get(), 400, 300, 1.f);
+   layout_run(resized.body.get(), 600, 300, 1.f);
+   expect_box(t, resized.child.get(), {60, 60, 80, 20});
+   release_all_render_data();
+
+   // Flexing resizes a px panel; its subtree is laid out at the size the row gave it
+   PanelDoc grown("width:100px; height:100px; flex-grow:1; padding:5%;", "width:100%; height:10px;");
+   layout_run(grown.body.get(), 400, 300, 1.f);
+   expect_box(t, grown.panel.get(), {0, 0, 400, 100});
+   expect_box(t, grown.child.get(), {20, 20, 360, 10});
+   layout_run(grown.body.get(), 600, 300, 1.f);
+   expect_box(t, grown.child.get(), {30, 30, 540, 10});
+   release_all_render_data();
+}
+
+// Each pass gives the row's child a style no earlier pass used. Past the StyleCache purge threshold the earlier
+// styles are freed and new ones land on their addresses; a fingerprint keyed by address would then return the
+// geometry of whatever style lived there before.
+void test_memo()
+{
+   const char* t = "memo";
+   Doc d("display:flex; flex-direction:column;");
+   auto row = d.add(d.root.get(), "display:flex; flex-direction:row; padding:2px;");
+   row->setAttribute("data-layout-memo", "");
+   auto cell = d.add(row.get(), "width:10px; height:10px;");
+   auto label = d.add(row.get(), "flex:1;");
+   label->appendChild(d.doc->createTextNode("Row label"));
+   for (int i = 0; i < 600; ++i) {
+      const int px = 10 + i % 300;
+      cell->setAttribute("style", "width:10px; height:" + std::to_string(px) + "px; margin-top:" +
+                                      std::to_string(i / 300) + "px;");
+      layout_run(d.body.get(), 400, 300, 1.f);
+      LayoutBox b = box_of(cell.get());
+      if (b.h != px || b.y != 2 + i / 300) {
+         char what[120];
+         std::snprintf(what, sizeof(what), "pass %d: cell at y=%g h=%g, want y=%d h=%d", i, b.y, b.h, 2 + i / 300,
+                       px);
+         expect(false, t, what);
+         break;
+      }
+   }
+   release_all_render_data();
+}
+
+std::shared_ptr<dom::Element> add_card(Doc& d, int cells)
+{
+   auto card = d.doc->createElement("div");
+   card->setAttribute("style", "display:flex; flex-direction:column; padding:4px;");
+   for (int i = 0; i < cells; ++i) {
+      auto cell = d.doc->createElement("div");
+      cell->setAttribute("style", "height:10px;");
+      card->appendChild(cell);
+   }
+   return card;
+}
+
+void test_replace()
+{
+   const char* t = "replace";
+   Doc d("display:flex; flex-direction:column;");
+   auto card = add_card(d, 3);
+   d.root->appendChild(card);
+   layout_run(d.body.get(), 400, 300, 1.f);
+   RenderStore& store = document_render_data(d.doc.get())->store;
+   const size_t live = store.live();
+   const size_t created = store.yogaPool.created;
+   for (int i = 0; i < 3; ++i) {
+      auto next = add_card(d, 3);
+      d.root->replaceChild(next, card);
+      expect(!card->data, t, "replaced element kept its render data");
+      card = next;
+      layout_run(d.body.get(), 400, 300, 1.f);
+   }
+   char what[120];
+   std::snprintf(what, sizeof(what), "%zu live slots after replacing, want %zu", store.live(), live);
+   expect(store.live() == live, t, what);
+   std::snprintf(what, sizeof(what), "%zu Yoga nodes created after replacing, want %zu", store.yogaPool.created,
+                 created);
+   expect(store.yogaPool.created == created, t, what);
+   expect_box(t, card.get(), {0, 0, 400, 38});
+   release_all_render_data();
+}
+
+void expect_frame(const char* test, dom::Element* el, LayoutBox want)
+{
+   LayoutBox frame{-1, -1, -1, -1}, visible;
+   expect(layout_containing_block(el, frame, visible), test, "no containing block");
+   char what[160];
+   std::snprintf(what, sizeof(what), "containing block (%g, %g %gx%g), want (%g, %g %gx%g)", frame.x, frame.y,
+                 frame.w, frame.h, want.x, want.y, want.w, want.h);
+   expect(frame.x == want.x && frame.y == want.y && frame.w == want.w && frame.h == want.h, test, what);
+}
+
+void test_containing_block()
+{
+   const char* t = "containing block";
+   Doc d("display:flex; flex-direction:column;");
+   auto panel = d.add(d.root.get(), "position:relative; margin-left:20px; width:200px; height:100px; "
+                                    "border-width:2px; padding:10px;");
+   auto wrapper = d.add(panel.get(), "padding:5px; height:40px;");
+   auto pinned = d.add(wrapper.get(), "position:absolute; left:10px; top:4px; width:20px; height:20px;");
+   auto flowing = d.add(wrapper.get(), "width:20px; height:20px;");
+   layout_run(d.body.get(), 400, 300, 1.f);
+   // The static wrapper in between is skipped; the panel's padding is not
+   expect_frame(t, pinned.get(), {22, 2, 196, 96});
+   expect_box(t, pinned.get(), {32, 6, 20, 20});
+   expect_frame(t, flowing.get(), {37, 17, 166, 30});
+   expect_box(t, flowing.get(), {37, 17, 20, 20});
+   release_all_render_data();
+}
+} // namespace
+
+int main()
+{
+   test_contained();
+   test_memo();
+   test_replace();
+   test_containing_block();
+   if (g_failures) {
+      std::fprintf(stderr, "[layout_test] %d check(s) failed\n", g_failures);
+      return 1;
+   }
+   std::printf("[layout_test] all checks passed\n");
+   return 0;
+}
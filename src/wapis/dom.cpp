@@ -3,6 +3,7 @@
 // Observers are attached per Document; see dom.hpp
 #include <algorithm>
 #include <atomic>
+#include <string_view>
 
 namespace dom {
 
@@ -62,6 +63,10 @@ std::shared_ptr<Node> Node::replaceChild(std::shared_ptr<Node> newChild, std::sh
       newChild->parentNode = shared_from_this();
       (*it)->parentNode.reset();
       *it = newChild;
+      if (auto doc = std::dynamic_pointer_cast<Document>(ownerDocument.lock())) {
+         if (auto hook = doc->getMutationHook())
+            hook(this, "insert", newChild.get());
+      }
       return oldChild;
    }
    return nullptr;
@@ -114,19 +119,24 @@ std::string Node::textContent() const
 
 void Node::setTextContent(const std::string& v)
 {
+   auto doc = std::dynamic_pointer_cast<Document>(ownerDocument.lock());
+   auto hook = doc ? doc->getMutationHook() : nullptr;
    if (nodeType == NodeType::TEXT) {
       nodeValue = v;
+      if (hook)
+         hook(this, "characterData", nullptr);
       return;
    }
-   for (auto& c : childNodes)
-      if (c)
-         c->parentNode.reset();
-   childNodes.clear();
-   if (!v.empty()) {
-      if (auto doc = std::dynamic_pointer_cast<Document>(ownerDocument.lock())) {
-         appendChild(doc->createTextNode(v));
-      }
+   for (auto& c : childNodes) {
+      if (!c)
+         continue;
+      if (hook)
+         hook(this, "remove", c.get());
+      c->parentNode.reset();
    }
+   childNodes.clear();
+   if (!v.empty() && doc)
+      appendChild(doc->createTextNode(v));
 }
 
 // Element implements minimal innerHTML/outerHTML; Node exposes textContent.
@@ -193,26 +203,205 @@ std::shared_ptr<Node> Node::previousSibling() const
 // --- Element --- (kept generic; layout integration via hook)
 void Element::setAttribute(const std::string& name, const std::string& value)
 {
-   attributes[name] = value;
+   auto doc = std::dynamic_pointer_cast<Document>(ownerDocument.lock());
+   AttributeHook hook = doc ? doc->getAttributeHook() : nullptr;
+   std::string& slot = attributes[name];
+   // Only the hook needs the previous value; it is overwritten anyway, so move instead of copying
+   std::string oldValue;
+   if (hook)
+      oldValue = name == "style" && styleTextStale ? getStyleCssText() : std::move(slot);
+   slot = value;
    if (name == "style") {
-      // Keep styleCssText mirror in sync (generic mirror; engine may ignore)
-      const_cast<Element*>(this)->styleCssText = value;
-   }
-   if (auto doc = std::dynamic_pointer_cast<Document>(ownerDocument.lock())) {
-      if (auto hook = doc->getAttributeHook())
-         hook(this, name, value);
+      // The text is authoritative again; drop any CSSOM declaration list
+      styleCssText = value;
+      styleDecls.clear();
+      styleDeclsActive = false;
+      styleTextStale = false;
    }
+   if (hook)
+      hook(this, name, oldValue, value);
 }
 
 std::string Element::getAttribute(const std::string& name) const
 {
    auto it = attributes.find(name);
-   return it != attributes.end() ? it->second : std::string();
+   if (it == attributes.end())
+      return std::string();
+   // After CSSOM writes the attribute slot lags behind; the serialized text is current
+   return name == "style" ? getStyleCssText() : it->second;
+}
+
+const std::string* Element::findAttribute(const std::string& name) const
+{
+   auto it = attributes.find(name);
+   if (it == attributes.end())
+      return nullptr;
+   return name == "style" ? &getStyleCssText() : &it->second;
 }
 
 void Element::removeAttribute(const std::string& name)
 {
-   attributes.erase(name);
+   auto it = attributes.find(name);
+   if (it == attributes.end())
+      return;
+   std::string oldValue = name == "style" && styleTextStale ? getStyleCssText() : std::move(it->second);
+   attributes.erase(it);
+   if (name == "style") {
+      styleCssText.clear();
+      styleDecls.clear();
+      styleDeclsActive = false;
+      styleTextStale = false;
+   }
+   // Hooks see the attribute already gone (empty value)
+   if (auto doc = std::dynamic_pointer_cast<Document>(ownerDocument.lock())) {
+      if (auto hook = doc->getAttributeHook())
+         hook(this, name, oldValue, std::string());
+   }
+}
+
+// --- Inline style declarations ---
+static bool is_css_space(char c)
+{
+   return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+static std::string_view trim_css(std::string_view s)
+{
+   while (!s.empty() && is_css_space(s.front()))
+      s.remove_prefix(1);
+   while (!s.empty() && is_css_space(s.back()))
+      s.remove_suffix(1);
+   return s;
+}
+
+// Visit each `name: value` of a style text in order; ';' inside parentheses or quotes does not split
+template <typename Fn> static void for_each_style_decl(std::string_view text, Fn&& fn)
+{
+   size_t i = 0;
+   while (i < text.size()) {
+      size_t start = i;
+      int depth = 0;
+      char quote = 0;
+      for (; i < text.size(); ++i) {
+         char c = text[i];
+         if (quote) {
+            if (c == quote)
+               quote = 0;
+         }
+         else if (c == '"' || c == '\'')
+            quote = c;
+         else if (c == '(')
+            ++depth;
+         else if (c == ')' && depth > 0)
+            --depth;
+         else if (c == ';' && depth == 0)
+            break;
+      }
+      std::string_view decl = text.substr(start, i - start);
+      ++i; // past ';'
+      size_t colon = decl.find(':');
+      if (colon == std::string_view::npos)
+         continue;
+      std::string_view name = trim_css(decl.substr(0, colon));
+      std::string_view value = trim_css(decl.substr(colon + 1));
+      if (!name.empty() && !value.empty())
+         fn(name, value);
+   }
+}
+
+static std::vector<StyleDeclaration>::iterator find_decl(std::vector<StyleDeclaration>& decls, std::string_view name)
+{
+   return std::find_if(decls.begin(), decls.end(), [&](const StyleDeclaration& d) { return d.name == name; });
+}
+
+// The last declaration of a property wins, in the engine and in the serialized text alike, so a rewritten one
+// moves to the end (e.g. margin-top written after a margin shorthand must not be shadowed by it)
+static void put_decl(std::vector<StyleDeclaration>& decls, std::string_view name, std::string_view value)
+{
+   auto it = find_decl(decls, name);
+   if (it == decls.end()) {
+      decls.push_back({std::string(name), std::string(value)});
+      return;
+   }
+   it->value.assign(value.data(), value.size());
+   std::rotate(it, it + 1, decls.end());
+}
+
+void Element::activateStyleDecls()
+{
+   if (styleDeclsActive)
+      return;
+   for_each_style_decl(styleCssText, [&](std::string_view n, std::string_view v) { put_decl(styleDecls, n, v); });
+   styleDeclsActive = true;
+}
+
+const std::string& Element::getStyleCssText() const
+{
+   if (styleTextStale) {
+      styleCssText.clear();
+      for (const StyleDeclaration& d : styleDecls) {
+         if (!styleCssText.empty())
+            styleCssText += ' ';
+         styleCssText += d.name;
+         styleCssText += ": ";
+         styleCssText += d.value;
+         styleCssText += ';';
+      }
+      styleTextStale = false;
+   }
+   return styleCssText;
+}
+
+std::string Element::getStyleProperty(const std::string& name) const
+{
+   if (styleDeclsActive) {
+      for (const StyleDeclaration& d : styleDecls) {
+         if (d.name == name)
+            return d.value;
+      }
+      return std::string();
+   }
+   std::string_view found;
+   for_each_style_decl(styleCssText, [&](std::string_view n, std::string_view v) {
+      if (n == name)
+         found = v;
+   });
+   return std::string(found);
+}
+
+void Element::setStyleProperty(const std::string& name, const std::string& value)
+{
+   if (value.empty()) {
+      removeStyleProperty(name);
+      return;
+   }
+   activateStyleDecls();
+   auto it = find_decl(styleDecls, name);
+   if (it != styleDecls.end() && it->value == value)
+      return;
+   put_decl(styleDecls, name, value);
+   styleTextStale = true;
+   attributes.try_emplace("style"); // present; its value is read through getStyleCssText
+   if (auto doc = std::dynamic_pointer_cast<Document>(ownerDocument.lock())) {
+      if (auto hook = doc->getStyleHook())
+         hook(this, name, value);
+   }
+}
+
+std::string Element::removeStyleProperty(const std::string& name)
+{
+   activateStyleDecls();
+   auto it = find_decl(styleDecls, name);
+   if (it == styleDecls.end())
+      return std::string();
+   std::string old = std::move(it->value);
+   styleDecls.erase(it);
+   styleTextStale = true;
+   if (auto doc = std::dynamic_pointer_cast<Document>(ownerDocument.lock())) {
+      if (auto hook = doc->getStyleHook())
+         hook(this, name, std::string());
+   }
+   return old;
 }
 
 std::vector<std::shared_ptr<Element>> Element::getElementsByTagName(const std::string& name) const
@@ -270,7 +459,7 @@ std::string Element::serializeOpenTag() const
    std::string s;
    s += "<" + tagName;
    for (auto& kv : attributes) {
-      s += " " + kv.first + "=\"" + kv.second + "\"";
+      s += " " + kv.first + "=\"" + (kv.first == "style" ? getStyleCssText() : kv.second) + "\"";
    }
    s += ">";
    return s;
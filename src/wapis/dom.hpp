@@ -15,8 +15,16 @@ class Element;
 class Node;
 class Document;
 class DomObserver;
-using AttributeHook = void (*)(Element*, const std::string& name, const std::string& value);
+using AttributeHook = void (*)(Element*, const std::string& name, const std::string& oldValue,
+                               const std::string& value);
 using MutationHook = void (*)(Node* target, const char* op, Node* related);
+// One inline style property written through CSSOM (style.setProperty / removeProperty); value is empty on removal
+using StyleHook = void (*)(Element*, const std::string& name, const std::string& value);
+
+struct StyleDeclaration {
+   std::string name;
+   std::string value;
+};
 
 class Node : public std::enable_shared_from_this<Node> {
  public:
@@ -61,10 +69,16 @@ class Node : public std::enable_shared_from_this<Node> {
 
 class Element : public Node {
  public:
+   // Raw attribute slots. After a CSSOM write the "style" slot only marks presence and its text lags; read through
+   // getAttribute or findAttribute, which serialize the declarations when they are dirty.
    std::unordered_map<std::string, std::string> attributes;
    std::string tagName;
-   // Simple style store (cssText only for now)
-   std::string styleCssText;
+   // Inline style. The text is the source of truth until the first CSSOM property write, which splits it into
+   // styleDecls; from then on the list is, and the text is only rebuilt when read (getStyleCssText, getAttribute).
+   mutable std::string styleCssText;
+   std::vector<StyleDeclaration> styleDecls;
+   bool styleDeclsActive = false;
+   mutable bool styleTextStale = false;
 
    // Optional per-node attachment for rendering/layout/state without bloating base Element.
    void* data = nullptr; // opaque engine attachment (allocated/freed by engine subsystems)
@@ -72,6 +86,7 @@ class Element : public Node {
    // --- Element methods ---
    void setAttribute(const std::string& name, const std::string& value);
    std::string getAttribute(const std::string& name) const;
+   const std::string* findAttribute(const std::string& name) const; // no copy; null when absent
    void removeAttribute(const std::string& name);
 
 #ifndef DOM_STRICT
@@ -92,18 +107,19 @@ class Element : public Node {
    std::string outerHTML() const;              // Serialize this element including its tag
 
 #ifndef DOM_EXCLUDE_STYLE_HELPERS
-   const std::string& getStyleCssText() const
-   {
-      return styleCssText;
-   } // NON-STANDARD convenience
+   const std::string& getStyleCssText() const; // NON-STANDARD convenience
 
    void setStyleCssText(const std::string& v)
-   { // NON-STANDARD convenience; syncs style attribute
-      styleCssText = v;
-      attributes["style"] = v;
-      // Opaque: engine layer may hook style changes; DOM stays generic.
+   { // NON-STANDARD convenience; same as setting the style attribute
+      setAttribute("style", v);
    }
 #endif
+   // CSSOM-style per-property access (element.style.setProperty and friends). Writes only touch the one
+   // declaration and notify the document's StyleHook; the serialized cssText is rebuilt lazily.
+   std::string getStyleProperty(const std::string& name) const;
+   void setStyleProperty(const std::string& name, const std::string& value); // empty value removes
+   std::string removeStyleProperty(const std::string& name);                 // returns the previous value
+   void activateStyleDecls(); // INTERNAL: split the text into styleDecls once
    std::string serializeOpenTag() const; // INTERNAL NON-STANDARD helper
 
    // --- Query methods ---
@@ -153,11 +169,22 @@ class Document : public Node {
       return mutHook_;
    }
 
+   void setStyleHook(StyleHook cb)
+   {
+      styleHook_ = cb;
+   }
+
+   StyleHook getStyleHook() const
+   {
+      return styleHook_;
+   }
+
  private:
    std::atomic<uint64_t> idCounter{1};
    std::vector<DomObserver*> observers_;
    AttributeHook attrHook_ = nullptr;
    MutationHook mutHook_ = nullptr;
+   StyleHook styleHook_ = nullptr;
 };
 
 // Factory helpers
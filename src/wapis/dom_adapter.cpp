@@ -1,9 +1,15 @@
 // dom_adapter.cpp - QuickJS <-> C++ DOM bridge using dom.hpp backend
 #include "dom_adapter.h"
 #include "dom.hpp"
+#include "renderer/animation.h"
 #include "renderer/dom_observer.h"
+#include "renderer/element_data.h"
+#include "renderer/layout_yoga.h"
 #include "renderer/renderer.h"
 #include "renderer/sk_canvas_view.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <functional>
@@ -35,6 +41,9 @@ struct DomAdapterState {
    JSClassDef dom_node_class_def{};
    bool dom_class_def_init = false;
    JSClassID canvas_ctx2d_class_id = 0;
+   JSClassID css_sheet_class_id = 0;
+   JSClassID animation_class_id = 0;
+   JSValue style_proto = JS_UNDEFINED; // CSSStyleDeclaration accessors shared by every element.style
    // Per-runtime graphics state (opaque handle)
    GfxStateHandle* gfx_state = nullptr;
    // Renderer owned per runtime/context (avoids globals)
@@ -118,6 +127,141 @@ static inline std::shared_ptr<Node> get_cpp_node(JSContext* ctx, JSValueConst va
    return get_cpp_node(st, ctx, val);
 }
 
+// ---- element.style (CSSStyleDeclaration subset) ----
+static std::shared_ptr<Element> style_element(JSContext* ctx, JSValueConst style)
+{
+   JSValue elv = JS_GetPropertyStr(ctx, style, "__node");
+   auto n = get_cpp_node(ctx, elv);
+   JS_FreeValue(ctx, elv);
+   return n && n->nodeType == dom::NodeType::ELEMENT ? std::static_pointer_cast<Element>(n) : nullptr;
+}
+
+// Property names are ASCII case-insensitive, custom properties (--x) are not
+static std::string css_property_arg(JSContext* ctx, JSValueConst v)
+{
+   const char* str = JS_ToCString(ctx, v);
+   if (!str)
+      return std::string();
+   std::string name(str);
+   JS_FreeCString(ctx, str);
+   if (name.compare(0, 2, "--") != 0)
+      for (char& c : name)
+         c = (char)std::tolower((unsigned char)c);
+   return name;
+}
+
+static std::string string_arg(JSContext* ctx, JSValueConst v)
+{
+   if (JS_IsNull(v) || JS_IsUndefined(v))
+      return std::string();
+   size_t len;
+   const char* str = JS_ToCStringLen(ctx, &len, v);
+   if (!str)
+      return std::string();
+   std::string out(str, len);
+   JS_FreeCString(ctx, str);
+   return out;
+}
+
+static JSValue js_style_get_cssText(JSContext* ctx, JSValueConst this_val, int, JSValueConst*)
+{
+   auto el = style_element(ctx, this_val);
+   return JS_NewString(ctx, el ? el->getStyleCssText().c_str() : "");
+}
+
+static JSValue js_style_set_cssText(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv)
+{
+   if (argc < 1)
+      return JS_UNDEFINED;
+   if (auto el = style_element(ctx, this_val))
+      el->setStyleCssText(string_arg(ctx, argv[0]));
+   return JS_UNDEFINED;
+}
+
+static JSValue js_style_getPropertyValue(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv)
+{
+   auto el = style_element(ctx, this_val);
+   if (!el || argc < 1)
+      return JS_NewString(ctx, "");
+   return JS_NewString(ctx, el->getStyleProperty(css_property_arg(ctx, argv[0])).c_str());
+}
+
+// setProperty(name, value[, priority]); priority is accepted and ignored
+static JSValue js_style_setProperty(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv)
+{
+   auto el = style_element(ctx, this_val);
+   if (!el || argc < 1)
+      return JS_UNDEFINED;
+   el->setStyleProperty(css_property_arg(ctx, argv[0]), argc > 1 ? string_arg(ctx, argv[1]) : std::string());
+   return JS_UNDEFINED;
+}
+
+static JSValue js_style_removeProperty(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv)
+{
+   auto el = style_element(ctx, this_val);
+   if (!el || argc < 1)
+      return JS_NewString(ctx, "");
+   return JS_NewString(ctx, el->removeStyleProperty(css_property_arg(ctx, argv[0])).c_str());
+}
+
+// camelCase accessors (style.backgroundColor): magic is a css::Prop, or Prop::Count for the background shorthand
+static std::string_view style_accessor_name(int magic)
+{
+   return magic < (int)css::Prop::Count ? css::prop_name((css::Prop)magic) : std::string_view("background");
+}
+
+static JSValue js_style_get_prop(JSContext* ctx, JSValueConst this_val, int, JSValueConst*, int magic)
+{
+   auto el = style_element(ctx, this_val);
+   return JS_NewString(ctx, el ? el->getStyleProperty(std::string(style_accessor_name(magic))).c_str() : "");
+}
+
+static JSValue js_style_set_prop(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv, int magic)
+{
+   auto el = style_element(ctx, this_val);
+   if (el && argc > 0)
+      el->setStyleProperty(std::string(style_accessor_name(magic)), string_arg(ctx, argv[0]));
+   return JS_UNDEFINED;
+}
+
+static JSValueConst style_proto(DomAdapterState* st, JSContext* ctx)
+{
+   if (!JS_IsUndefined(st->style_proto))
+      return st->style_proto;
+   JSValue proto = JS_NewObject(ctx);
+   JSAtom cssAt = JS_NewAtom(ctx, "cssText");
+   JS_DefinePropertyGetSet(ctx, proto, cssAt, JS_NewCFunction(ctx, js_style_get_cssText, "cssText", 0),
+                           JS_NewCFunction(ctx, js_style_set_cssText, "cssText", 1), JS_PROP_ENUMERABLE);
+   JS_FreeAtom(ctx, cssAt);
+   JS_SetPropertyStr(ctx, proto, "getPropertyValue",
+                     JS_NewCFunction(ctx, js_style_getPropertyValue, "getPropertyValue", 1));
+   JS_SetPropertyStr(ctx, proto, "setProperty", JS_NewCFunction(ctx, js_style_setProperty, "setProperty", 3));
+   JS_SetPropertyStr(ctx, proto, "removeProperty",
+                     JS_NewCFunction(ctx, js_style_removeProperty, "removeProperty", 1));
+   for (int magic = 0; magic <= (int)css::Prop::Count; ++magic) {
+      // background-color -> backgroundColor
+      std::string camel;
+      bool upper = false;
+      for (char c : style_accessor_name(magic)) {
+         if (c == '-') {
+            upper = true;
+            continue;
+         }
+         camel += upper ? (char)std::toupper((unsigned char)c) : c;
+         upper = false;
+      }
+      JSAtom at = JS_NewAtom(ctx, camel.c_str());
+      JS_DefinePropertyGetSet(
+          ctx, proto, at,
+          JS_NewCFunctionMagic(ctx, js_style_get_prop, camel.c_str(), 0, JS_CFUNC_generic_magic, magic),
+          JS_NewCFunctionMagic(ctx, js_style_set_prop, camel.c_str(), 1, JS_CFUNC_generic_magic, magic),
+          JS_PROP_ENUMERABLE);
+      JS_FreeAtom(ctx, at);
+   }
+   st->style_proto = proto;
+   return proto;
+}
+
 void dom_set_host_state(JSContext* ctx, void* host)
 {
    if (!ctx)
@@ -204,47 +348,9 @@ JSValue wrap_node_js(JSContext* ctx, std::shared_ptr<Node> node)
    // Hidden debug id property
    JS_DefinePropertyValueStr(ctx, obj, "__id", JS_NewInt64(ctx, (int64_t)node->debugId), JS_PROP_WRITABLE);
    if (node->nodeType == dom::NodeType::ELEMENT) {
-      JSValue style = JS_NewObject(ctx);
-      // Back-reference to element wrapper for dynamic getter/setter
+      // Accessors live on one shared prototype; each style object only carries the back-reference
+      JSValue style = JS_NewObjectProto(ctx, style_proto(st, ctx));
       JS_DefinePropertyValueStr(ctx, style, "__node", JS_DupValue(ctx, obj), JS_PROP_CONFIGURABLE);
-      JSAtom cssAt = JS_NewAtom(ctx, "cssText");
-      JS_DefinePropertyGetSet(ctx, style, cssAt,
-                              JS_NewCFunction(
-                                  ctx,
-                                  [](JSContext* c, JSValueConst this_val, int, JSValueConst*) {
-                                     JSValue elv = JS_GetPropertyStr(c, this_val, "__node");
-                                     if (JS_IsUndefined(elv)) {
-                                        JS_FreeValue(c, elv);
-                                        return JS_NewString(c, "");
-                                     }
-                                     auto n = get_cpp_node(c, elv);
-                                     JS_FreeValue(c, elv);
-                                     if (!n || n->nodeType != dom::NodeType::ELEMENT)
-                                        return JS_NewString(c, "");
-                                     return JS_NewString(
-                                         c, std::static_pointer_cast<Element>(n)->getStyleCssText().c_str());
-                                  },
-                                  "cssText", 0),
-                              JS_NewCFunction(
-                                  ctx,
-                                  [](JSContext* c, JSValueConst this_val, int argc, JSValueConst* argv) {
-                                     if (argc < 1)
-                                        return JS_UNDEFINED;
-                                     size_t len;
-                                     const char* str = JS_ToCStringLen(c, &len, argv[0]);
-                                     JSValue elv = JS_GetPropertyStr(c, this_val, "__node");
-                                     auto n = get_cpp_node(c, elv);
-                                     JS_FreeValue(c, elv);
-                                     if (n && n->nodeType == dom::NodeType::ELEMENT && str) {
-                                        std::static_pointer_cast<Element>(n)->setStyleCssText(str);
-                                     }
-                                     if (str)
-                                        JS_FreeCString(c, str);
-                                     return JS_UNDEFINED;
-                                  },
-                                  "cssText", 1),
-                              JS_PROP_ENUMERABLE);
-      JS_FreeAtom(ctx, cssAt);
       JS_SetPropertyStr(ctx, obj, "style", style);
    }
    ++st->wrap_count;
@@ -327,6 +433,23 @@ static JSValue js_get_nodeValue(JSContext* ctx, JSValueConst this_val, int, JSVa
    return JS_NewString(ctx, node->nodeValue.c_str());
 }
 
+// nodeValue / data on Text nodes; routed through setTextContent so the mutation hook sees the change
+static JSValue js_set_nodeValue(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv)
+{
+   if (argc < 1)
+      return JS_UNDEFINED;
+   auto node = get_cpp_node(ctx, this_val);
+   if (!node || node->nodeType != dom::NodeType::TEXT)
+      return JS_UNDEFINED; // null for elements and documents per spec; assignments are ignored
+   size_t len;
+   const char* str = JS_ToCStringLen(ctx, &len, argv[0]);
+   if (str) {
+      node->setTextContent(std::string(str, len));
+      JS_FreeCString(ctx, str);
+   }
+   return JS_UNDEFINED;
+}
+
 static JSValue js_get__nodeName(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv)
 {
    return js_get_nodeName(ctx, this_val, argc, argv);
@@ -734,6 +857,110 @@ static JSValue js_getElementsByTagName(JSContext* ctx, JSValueConst this_val, in
    return arr;
 }
 
+// Layout geometry (CSS px). Each read first brings the element's layout up to date via layout_flush_for, which
+// never composites and is a flag test when nothing changed since the last read.
+static DomElementRenderData* laid_out_data(JSContext* ctx, JSValueConst this_val, Element** out = nullptr)
+{
+   auto node = get_cpp_node(ctx, this_val);
+   if (!node || node->nodeType != dom::NodeType::ELEMENT)
+      return nullptr;
+   auto* el = static_cast<Element*>(node.get());
+   if (!layout_flush_for(ctx, el))
+      return nullptr;
+   if (out)
+      *out = el;
+   return get_render_data(el);
+}
+
+static JSValue js_getBoundingClientRect(JSContext* ctx, JSValueConst this_val, int, JSValueConst*)
+{
+   LayoutBox b;
+   if (auto* rd = laid_out_data(ctx, this_val))
+      b = rd->box();
+   JSValue r = JS_NewObject(ctx);
+   JS_SetPropertyStr(ctx, r, "x", JS_NewFloat64(ctx, b.x));
+   JS_SetPropertyStr(ctx, r, "y", JS_NewFloat64(ctx, b.y));
+   JS_SetPropertyStr(ctx, r, "width", JS_NewFloat64(ctx, b.w));
+   JS_SetPropertyStr(ctx, r, "height", JS_NewFloat64(ctx, b.h));
+   JS_SetPropertyStr(ctx, r, "left", JS_NewFloat64(ctx, b.x));
+   JS_SetPropertyStr(ctx, r, "top", JS_NewFloat64(ctx, b.y));
+   JS_SetPropertyStr(ctx, r, "right", JS_NewFloat64(ctx, b.x + b.w));
+   JS_SetPropertyStr(ctx, r, "bottom", JS_NewFloat64(ctx, b.y + b.h));
+   return r;
+}
+
+static JSValue js_get_offsetWidth(JSContext* ctx, JSValueConst this_val, int, JSValueConst*)
+{
+   auto* rd = laid_out_data(ctx, this_val);
+   return JS_NewInt32(ctx, rd ? (int)std::lround(rd->box().w) : 0);
+}
+
+static JSValue js_get_offsetHeight(JSContext* ctx, JSValueConst this_val, int, JSValueConst*)
+{
+   auto* rd = laid_out_data(ctx, this_val);
+   return JS_NewInt32(ctx, rd ? (int)std::lround(rd->box().h) : 0);
+}
+
+// Offsets are relative to the padding edge of the nearest explicitly positioned ancestor, else the layout origin
+static void offset_origin(Element* el, float& x, float& y)
+{
+   x = y = 0;
+   for (auto p = el->parentNode.lock(); p && p->nodeType == dom::NodeType::ELEMENT; p = p->parentNode.lock()) {
+      auto* prd = get_render_data(static_cast<Element*>(p.get()));
+      if (!prd)
+         continue;
+      const css::ComputedStyle& cs = prd->computed();
+      if (cs.position == css::Position::Relative || cs.position == css::Position::Absolute) {
+         x = prd->box().x + cs.borderWidth[(int)css::Edge::Left];
+         y = prd->box().y + cs.borderWidth[(int)css::Edge::Top];
+         return;
+      }
+   }
+}
+
+static JSValue js_get_offsetLeft(JSContext* ctx, JSValueConst this_val, int, JSValueConst*)
+{
+   Element* el = nullptr;
+   auto* rd = laid_out_data(ctx, this_val, &el);
+   if (!rd)
+      return JS_NewInt32(ctx, 0);
+   float ox, oy;
+   offset_origin(el, ox, oy);
+   return JS_NewInt32(ctx, (int)std::lround(rd->box().x - ox));
+}
+
+static JSValue js_get_offsetTop(JSContext* ctx, JSValueConst this_val, int, JSValueConst*)
+{
+   Element* el = nullptr;
+   auto* rd = laid_out_data(ctx, this_val, &el);
+   if (!rd)
+      return JS_NewInt32(ctx, 0);
+   float ox, oy;
+   offset_origin(el, ox, oy);
+   return JS_NewInt32(ctx, (int)std::lround(rd->box().y - oy));
+}
+
+// Padding box: the border box minus borders (no scrollbars are drawn)
+static JSValue js_get_clientWidth(JSContext* ctx, JSValueConst this_val, int, JSValueConst*)
+{
+   auto* rd = laid_out_data(ctx, this_val);
+   if (!rd)
+      return JS_NewInt32(ctx, 0);
+   const float* bw = rd->computed().borderWidth;
+   return JS_NewInt32(ctx, (int)std::lround(std::max(0.f, rd->box().w - bw[(int)css::Edge::Left] -
+                                                               bw[(int)css::Edge::Right])));
+}
+
+static JSValue js_get_clientHeight(JSContext* ctx, JSValueConst this_val, int, JSValueConst*)
+{
+   auto* rd = laid_out_data(ctx, this_val);
+   if (!rd)
+      return JS_NewInt32(ctx, 0);
+   const float* bw = rd->computed().borderWidth;
+   return JS_NewInt32(ctx, (int)std::lround(std::max(0.f, rd->box().h - bw[(int)css::Edge::Top] -
+                                                               bw[(int)css::Edge::Bottom])));
+}
+
 // Descriptor tables (properties & methods) for prototype definition
 struct PropDesc {
    const char* name;
@@ -744,7 +971,8 @@ struct PropDesc {
 static const PropDesc kPropGetSet[] = {
     {"nodeType", js_get_nodeType, nullptr},
     {"nodeName", js_get_nodeName, nullptr},
-    {"nodeValue", js_get_nodeValue, nullptr},
+    {"nodeValue", js_get_nodeValue, js_set_nodeValue},
+    {"data", js_get_nodeValue, js_set_nodeValue},
     {"childNodes", js_get_childNodes, nullptr},
     {"firstChild", js_get_firstChild, nullptr},
     {"lastChild", js_get_lastChild, nullptr},
@@ -759,6 +987,12 @@ static const PropDesc kPropGetSet[] = {
     {"textContent", js_get_textContent, js_set_textContent},
     {"innerHTML", js_get_innerHTML, js_set_innerHTML},
     {"outerHTML", js_get_outerHTML, nullptr},
+    {"offsetWidth", js_get_offsetWidth, nullptr},
+    {"offsetHeight", js_get_offsetHeight, nullptr},
+    {"offsetLeft", js_get_offsetLeft, nullptr},
+    {"offsetTop", js_get_offsetTop, nullptr},
+    {"clientWidth", js_get_clientWidth, nullptr},
+    {"clientHeight", js_get_clientHeight, nullptr},
 };
 struct MethodDesc {
    const char* name;
@@ -873,6 +1107,7 @@ static JSValue js_element_getContext(JSContext* ctx, JSValueConst this_val, int
    if (it == st->element_canvas_ids.end()) {
       id = gfx_create_canvas(dom_gfx_state(ctx), width, height);
       st->element_canvas_ids[el.get()] = id;
+      renderer_paint_changed(el.get()); // its layer now shows the canvas; the compositor starts watching its pixels
    }
    else {
       id = it->second;
@@ -894,6 +1129,208 @@ static JSValue js_element_getContext(JSContext* ctx, JSValueConst this_val, int
    return ctxObj;
 }
 
+// ---- element.animate() (Web Animations subset) ----
+// Keyframes are an array of objects ({opacity: 0, offset: 0.5}) or one object of per-property arrays
+// ({opacity: [0, 1]}); only the animatable properties are read. They are turned into @keyframes text and parsed like
+// a sheet's. Options are a duration in ms or {duration, delay, iterations, easing, direction, fill}.
+static constexpr struct {
+   const char* js;       // keyframe member
+   const char* property; // CSS name
+} kAnimatedProperties[] = {
+    {"opacity", "opacity"}, {"transform", "transform"}, {"backgroundColor", "background-color"},
+    {"left", "left"},       {"top", "top"},
+};
+
+static void append_keyframe(std::string& text, double offset, const std::string& decls)
+{
+   if (decls.empty())
+      return;
+   char pct[32];
+   std::snprintf(pct, sizeof(pct), "%g%%", offset * 100.0);
+   text += pct;
+   text += " {";
+   text += decls;
+   text += "} ";
+}
+
+static std::string keyframe_decl(JSContext* ctx, JSValueConst v, const char* property)
+{
+   std::string value = string_arg(ctx, v);
+   return value.empty() ? std::string() : std::string(property) + ": " + value + ";";
+}
+
+static std::string keyframes_text(JSContext* ctx, JSValueConst keyframes)
+{
+   std::string text;
+   if (!JS_IsObject(keyframes))
+      return text;
+   if (!JS_IsArray(keyframes)) {
+      // Property-indexed: each property's values are spaced evenly from 0 to 1 (a single value is the end state)
+      for (const auto& ap : kAnimatedProperties) {
+         JSValue v = JS_GetPropertyStr(ctx, keyframes, ap.js);
+         if (JS_IsArray(v)) {
+            uint32_t n = 0;
+            JSValue lenv = JS_GetPropertyStr(ctx, v, "length");
+            JS_ToUint32(ctx, &n, lenv);
+            JS_FreeValue(ctx, lenv);
+            for (uint32_t i = 0; i < n; ++i) {
+               JSValue item = JS_GetPropertyUint32(ctx, v, i);
+               append_keyframe(text, n == 1 ? 1.0 : (double)i / (n - 1), keyframe_decl(ctx, item, ap.property));
+               JS_FreeValue(ctx, item);
+            }
+         }
+         else if (!JS_IsUndefined(v)) {
+            append_keyframe(text, 1.0, keyframe_decl(ctx, v, ap.property));
+         }
+         JS_FreeValue(ctx, v);
+      }
+      return text;
+   }
+   uint32_t n = 0;
+   JSValue lenv = JS_GetPropertyStr(ctx, keyframes, "length");
+   JS_ToUint32(ctx, &n, lenv);
+   JS_FreeValue(ctx, lenv);
+   std::vector<double> offsets(n, NAN);
+   std::vector<std::string> decls(n);
+   for (uint32_t i = 0; i < n; ++i) {
+      JSValue frame = JS_GetPropertyUint32(ctx, keyframes, i);
+      JSValue off = JS_GetPropertyStr(ctx, frame, "offset");
+      if (JS_IsNumber(off))
+         JS_ToFloat64(ctx, &offsets[i], off);
+      JS_FreeValue(ctx, off);
+      for (const auto& ap : kAnimatedProperties) {
+         JSValue v = JS_GetPropertyStr(ctx, frame, ap.js);
+         if (!JS_IsUndefined(v))
+            decls[i] += keyframe_decl(ctx, v, ap.property);
+         JS_FreeValue(ctx, v);
+      }
+      JS_FreeValue(ctx, frame);
+   }
+   // Missing offsets: first 0 and last 1 (a lone keyframe is the end state), the rest spaced evenly between the
+   // nearest given ones
+   if (n > 0 && std::isnan(offsets[n - 1]))
+      offsets[n - 1] = 1.0;
+   if (n > 1 && std::isnan(offsets[0]))
+      offsets[0] = 0.0;
+   for (uint32_t i = 1; i < n; ++i) {
+      if (!std::isnan(offsets[i]))
+         continue;
+      uint32_t j = i;
+      while (std::isnan(offsets[j]))
+         ++j;
+      for (uint32_t k = i; k < j; ++k)
+         offsets[k] = offsets[i - 1] + (offsets[j] - offsets[i - 1]) * (k - i + 1) / (j - i + 1);
+      i = j;
+   }
+   for (uint32_t i = 0; i < n; ++i) {
+      if (offsets[i] >= 0.0 && offsets[i] <= 1.0)
+         append_keyframe(text, offsets[i], decls[i]);
+   }
+   return text;
+}
+
+static css::AnimationTiming animation_options(JSContext* ctx, JSValueConst options)
+{
+   css::AnimationTiming timing;
+   timing.easing = css::Easing{css::Easing::Kind::Linear}; // the Web Animations default
+   double d;
+   if (JS_IsNumber(options)) {
+      JS_ToFloat64(ctx, &d, options);
+      timing.duration = (float)d;
+      return timing;
+   }
+   if (!JS_IsObject(options))
+      return timing;
+   auto number = [&](const char* name, float& out) {
+      JSValue v = JS_GetPropertyStr(ctx, options, name);
+      if (JS_IsNumber(v) && JS_ToFloat64(ctx, &d, v) == 0)
+         out = (float)d;
+      JS_FreeValue(ctx, v);
+   };
+   number("duration", timing.duration);
+   number("delay", timing.delay);
+   number("iterations", timing.iterations);
+   auto keyword = [&](const char* name) {
+      JSValue v = JS_GetPropertyStr(ctx, options, name);
+      std::string s = JS_IsString(v) ? string_arg(ctx, v) : std::string();
+      JS_FreeValue(ctx, v);
+      return s;
+   };
+   if (std::string easing = keyword("easing"); !easing.empty())
+      css::parse_easing(easing, timing.easing);
+   std::string direction = keyword("direction");
+   if (direction == "reverse")
+      timing.direction = css::PlaybackDirection::Reverse;
+   else if (direction == "alternate")
+      timing.direction = css::PlaybackDirection::Alternate;
+   else if (direction == "alternate-reverse")
+      timing.direction = css::PlaybackDirection::AlternateReverse;
+   std::string fill = keyword("fill");
+   if (fill == "forwards")
+      timing.fill = css::FillMode::Forwards;
+   else if (fill == "backwards")
+      timing.fill = css::FillMode::Backwards;
+   else if (fill == "both")
+      timing.fill = css::FillMode::Both;
+   return timing;
+}
+
+// Animation objects carry the native id as their opaque value
+static uint64_t animation_id(JSContext* ctx, JSValueConst this_val)
+{
+   return (uint64_t)(uintptr_t)JS_GetOpaque(this_val, state_from(ctx)->animation_class_id);
+}
+
+static JSValue js_animation_cancel(JSContext* ctx, JSValueConst this_val, int, JSValueConst*)
+{
+   animation_cancel(animation_id(ctx, this_val));
+   return JS_UNDEFINED;
+}
+
+static JSValue js_animation_finish(JSContext* ctx, JSValueConst this_val, int, JSValueConst*)
+{
+   animation_finish(animation_id(ctx, this_val));
+   return JS_UNDEFINED;
+}
+
+static JSValue js_animation_get_playState(JSContext* ctx, JSValueConst this_val, int, JSValueConst*)
+{
+   return JS_NewString(ctx, animation_play_state(animation_id(ctx, this_val)));
+}
+
+static JSValue js_element_animate(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv)
+{
+   auto node = get_cpp_node(ctx, this_val);
+   if (!node || node->nodeType != dom::NodeType::ELEMENT || argc < 1)
+      return JS_NULL;
+   auto el = std::static_pointer_cast<Element>(node);
+   auto keyframes = css::parse_keyframes("", keyframes_text(ctx, argv[0]));
+   uint64_t id = animation_play(el.get(), keyframes, animation_options(ctx, argc > 1 ? argv[1] : JS_UNDEFINED));
+   auto* st = state_from(ctx);
+   JSRuntime* rt = JS_GetRuntime(ctx);
+   if (st->animation_class_id == 0)
+      JS_NewClassID(rt, &st->animation_class_id);
+   if (!JS_IsRegisteredClass(rt, st->animation_class_id)) {
+      JSClassDef def{};
+      def.class_name = "Animation";
+      JS_NewClass(rt, st->animation_class_id, &def);
+      JSValue proto = JS_NewObject(ctx);
+      JS_SetPropertyStr(ctx, proto, "cancel", JS_NewCFunction(ctx, js_animation_cancel, "cancel", 0));
+      JS_SetPropertyStr(ctx, proto, "finish", JS_NewCFunction(ctx, js_animation_finish, "finish", 0));
+      JSAtom at = JS_NewAtom(ctx, "playState");
+      JS_DefinePropertyGetSet(ctx, proto, at, JS_NewCFunction(ctx, js_animation_get_playState, "playState", 0),
+                              JS_UNDEFINED, JS_PROP_CONFIGURABLE);
+      JS_FreeAtom(ctx, at);
+      JS_SetClassProto(ctx, st->animation_class_id, proto);
+   }
+   JSValue anim = JS_NewObjectClass(ctx, st->animation_class_id);
+   JS_SetOpaque(anim, (void*)(uintptr_t)id);
+   // Frames come from the native frame clock from here on
+   extern void native_request_animation_frame(JSContext*);
+   native_request_animation_frame(ctx);
+   return anim;
+}
+
 static const MethodDesc kMethods[] = {
     {"appendChild", js_appendChild, 1},
     {"insertBefore", js_insertBefore, 2},
@@ -906,6 +1343,8 @@ static const MethodDesc kMethods[] = {
     {"addEventListener", js_addEventListener, 2},
     {"removeEventListener", js_removeEventListener, 2},
     {"getContext", js_element_getContext, 1},
+    {"animate", js_element_animate, 2},
+    {"getBoundingClientRect", js_getBoundingClientRect, 0},
 };
 
 //
@@ -962,6 +1401,11 @@ void dom_define_node_proto(DomAdapterState* st, JSContext* ctx)
    JS_SetClassProto(ctx, st->dom_node_class_id, proto);
 }
 
+JSValue dom_wrap_node(JSContext* ctx, dom::Node* node)
+{
+   return node ? wrap_node_js(ctx, node->shared_from_this()) : JS_NULL;
+}
+
 JSValue dom_make_node(DomAdapterState*, JSContext* ctx, const char*, int, JSValue)
 {
    return JS_NULL;
@@ -998,7 +1442,7 @@ void dom_attach_renderer(JSContext* ctx)
    if (!node || node->nodeType != dom::NodeType::DOCUMENT)
       return;
    if (auto d = std::dynamic_pointer_cast<dom::Document>(node)) {
-      d->addObserver(st->renderer.get());
+      st->renderer->attach(d.get());
    }
 }
 
@@ -1014,6 +1458,8 @@ void dom_runtime_cleanup(DomAdapterState* st, JSContext* ctx)
       JS_FreeValue(ctx, v);
    st->node_wrappers.clear();
    st->node_registry.clear();
+   JS_FreeValue(ctx, st->style_proto);
+   st->style_proto = JS_UNDEFINED;
    st->in_dom_cleanup = false;
    fprintf(stderr, "[DOM_CLEANUP] after clear wrappers=%zu nodes=%zu\n", st->node_wrappers.size(),
            st->node_registry.size());
@@ -1051,10 +1497,104 @@ int dom_define_core(DomAdapterState* st, JSContext* ctx)
    return 0;
 }
 
+// CSSStyleSheet wrappers own a reference to the sheet; documents adopting it hold their own
+static void js_css_sheet_finalizer(JSRuntime* rt, JSValue val)
+{
+   auto* st = (DomAdapterState*)JS_GetRuntimeOpaque(rt);
+   if (!st)
+      return;
+   delete (std::shared_ptr<css::StyleSheet>*)JS_GetOpaque(val, st->css_sheet_class_id);
+}
+
+static std::shared_ptr<css::StyleSheet> get_css_sheet(JSContext* ctx, JSValueConst val)
+{
+   auto* sp = (std::shared_ptr<css::StyleSheet>*)JS_GetOpaque(val, state_from(ctx)->css_sheet_class_id);
+   return sp ? *sp : nullptr;
+}
+
+static JSValue js_css_sheet_ctor(JSContext* ctx, JSValueConst, int, JSValueConst*)
+{
+   JSValue obj = JS_NewObjectClass(ctx, state_from(ctx)->css_sheet_class_id);
+   if (JS_IsException(obj))
+      return obj;
+   JS_SetOpaque(obj, new std::shared_ptr<css::StyleSheet>(std::make_shared<css::StyleSheet>()));
+   return obj;
+}
+
+static JSValue js_css_sheet_replaceSync(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst* argv)
+{
+   auto sheet = get_css_sheet(ctx, this_val);
+   if (!sheet)
+      return JS_ThrowTypeError(ctx, "replaceSync: not a CSSStyleSheet");
+   const char* text = argc > 0 ? JS_ToCString(ctx, argv[0]) : nullptr;
+   sheet->replace(text ? text : "");
+   if (text)
+      JS_FreeCString(ctx, text);
+   // Adopting documents see the new version on their next layout pass
+   layout_mark_dirty();
+   return JS_UNDEFINED;
+}
+
+static JSValue js_document_get_adoptedStyleSheets(JSContext* ctx, JSValueConst this_val, int, JSValueConst*)
+{
+   JSValue arr = JS_GetPropertyStr(ctx, this_val, "__adoptedStyleSheets");
+   if (JS_IsUndefined(arr))
+      return JS_NewArray(ctx);
+   return arr;
+}
+
+// Assignment replaces the whole list; mutating the returned array in place is not observed
+static JSValue js_document_set_adoptedStyleSheets(JSContext* ctx, JSValueConst this_val, int argc,
+                                                  JSValueConst* argv)
+{
+   auto doc = std::dynamic_pointer_cast<Document>(get_cpp_node(ctx, this_val));
+   if (!doc || argc < 1)
+      return JS_UNDEFINED;
+   uint32_t len = 0;
+   JSValue lenv = JS_GetPropertyStr(ctx, argv[0], "length");
+   JS_ToUint32(ctx, &len, lenv);
+   JS_FreeValue(ctx, lenv);
+   std::vector<std::shared_ptr<css::StyleSheet>> sheets;
+   for (uint32_t i = 0; i < len; ++i) {
+      JSValue v = JS_GetPropertyUint32(ctx, argv[0], i);
+      if (auto sheet = get_css_sheet(ctx, v))
+         sheets.push_back(std::move(sheet));
+      JS_FreeValue(ctx, v);
+   }
+   set_adopted_style_sheets(doc.get(), std::move(sheets));
+   JS_DefinePropertyValueStr(ctx, this_val, "__adoptedStyleSheets", JS_DupValue(ctx, argv[0]),
+                             JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+   return JS_UNDEFINED;
+}
+
 // Attach document factory methods (internal API now that js_create* are static)
-void dom_attach_document_factories(DomAdapterState*, JSContext* ctx, JSValue document)
+void dom_attach_document_factories(DomAdapterState* st, JSContext* ctx, JSValue document)
 {
    JS_SetPropertyStr(ctx, document, "createElement", JS_NewCFunction(ctx, js_createElement, "createElement", 1));
    JS_SetPropertyStr(ctx, document, "createElementNS", JS_NewCFunction(ctx, js_createElementNS, "createElementNS", 2));
    JS_SetPropertyStr(ctx, document, "createTextNode", JS_NewCFunction(ctx, js_createTextNode, "createTextNode", 1));
+   // Constructable style sheets: new CSSStyleSheet(), sheet.replaceSync(text), document.adoptedStyleSheets = [...]
+   JSRuntime* rt = JS_GetRuntime(ctx);
+   if (st->css_sheet_class_id == 0)
+      JS_NewClassID(rt, &st->css_sheet_class_id);
+   if (!JS_IsRegisteredClass(rt, st->css_sheet_class_id)) {
+      JSClassDef def{};
+      def.class_name = "CSSStyleSheet";
+      def.finalizer = js_css_sheet_finalizer;
+      JS_NewClass(rt, st->css_sheet_class_id, &def);
+   }
+   JSValue proto = JS_NewObject(ctx);
+   JS_SetPropertyStr(ctx, proto, "replaceSync", JS_NewCFunction(ctx, js_css_sheet_replaceSync, "replaceSync", 1));
+   JSValue ctor = JS_NewCFunction2(ctx, js_css_sheet_ctor, "CSSStyleSheet", 0, JS_CFUNC_constructor, 0);
+   JS_SetConstructor(ctx, ctor, proto);
+   JS_SetClassProto(ctx, st->css_sheet_class_id, proto);
+   JSValue global = JS_GetGlobalObject(ctx);
+   JS_SetPropertyStr(ctx, global, "CSSStyleSheet", ctor);
+   JS_FreeValue(ctx, global);
+   JSAtom at = JS_NewAtom(ctx, "adoptedStyleSheets");
+   JS_DefinePropertyGetSet(
+       ctx, document, at,
+       JS_NewCFunction(ctx, js_document_get_adoptedStyleSheets, "adoptedStyleSheets", 0),
+       JS_NewCFunction(ctx, js_document_set_adoptedStyleSheets, "adoptedStyleSheets", 1), JS_PROP_CONFIGURABLE);
+   JS_FreeAtom(ctx, at);
 }
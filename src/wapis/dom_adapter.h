@@ -19,7 +19,8 @@ void dom_adapter_destroy(DomAdapterState*);
 // Public adapter API (instance-based). Responsibilities:
 //  - dom_define_node_proto: register the DOMNode prototype & class with a context
 //  - dom_create_document: create a Document (with body) bridged to the C++ DOM
-//  - dom_attach_document_factories: install createElement* / createTextNode on a document
+//  - dom_attach_document_factories: install createElement* / createTextNode and adoptedStyleSheets on a document,
+//    and the global CSSStyleSheet constructor
 //  - dom_runtime_cleanup: release wrapper identity maps (call before freeing the context)
 //  - dom_adapter_unregister_runtime: clear per-runtime registration state after runtime free
 //  - dom_define_core: ensure prototype installation (currently calls dom_define_node_proto)
@@ -38,6 +39,8 @@ void dom_attach_document_factories(DomAdapterState*, JSContext* ctx, JSValue doc
 int dom_element_canvas_id(DomAdapterState*, dom::Element* el, bool createIfMissing = false);
 // Internal accessor (layout engine) to map JS wrapper -> C++ node pointer (non-owning)
 extern "C" void* dom_get_cpp_node_opaque(JSContext* ctx, JSValueConst v);
+// The reverse: the JS wrapper of a C++ node (same object on every call; JS_NULL for null). Caller frees it.
+JSValue dom_wrap_node(JSContext* ctx, dom::Node* node);
 // Access per-context graphics state (owned by DomAdapterState)
 GfxStateHandle* dom_gfx_state(JSContext* ctx);
 // Cross-platform display scale storage per-context (used by renderer to allocate in device pixels)